@@ -0,0 +1,185 @@
+/*
+ * Microbenchmark of "hash_table.h" against the table it replaced, a fixed
+ * array of 100 chained buckets (kept below as `chained_table`). Run the
+ * `hash_table_bench` target; every workload also checks that both tables
+ * find the same values.
+ *
+ *   scopes:  many tiny tables, like the environment of each block and call
+ *   globals: one table of 10000 names, all looked up repeatedly
+ *   deletes: half of the 10000 names deleted, then all of them looked up
+ */
+
+#include "hash_table.h"
+#include <time.h>
+
+#define CHAINED_TABLE_CAPACITY 100
+#define NUM_SCOPES 1000000
+#define NUM_GLOBALS 10000
+#define NUM_GLOBAL_ROUNDS 100
+
+struct chained_node {
+  const char *key;
+  void *value;
+  struct chained_node *next;
+};
+
+struct chained_table {
+  struct chained_node *buckets[CHAINED_TABLE_CAPACITY];
+};
+
+static unsigned int chained_hash(const char *key) {
+  unsigned int hash = 0;
+  for (int i = 0; key[i] != '\0'; i++) {
+    hash = hash * 31 + key[i];
+  }
+  return hash % CHAINED_TABLE_CAPACITY;
+}
+
+static struct chained_table *chained_table_init() {
+  return calloc(1, sizeof(struct chained_table));
+}
+
+static void *chained_table_lookup(struct chained_table *table,
+                                  const char *key) {
+  for (struct chained_node *node = table->buckets[chained_hash(key)]; node;
+       node = node->next) {
+    if (strcmp(node->key, key) == 0) {
+      return node->value;
+    }
+  }
+  return NULL;
+}
+
+static void chained_table_insert(struct chained_table *table, const char *key,
+                                 void *value) {
+  unsigned int index = chained_hash(key);
+  struct chained_node *node = malloc(sizeof(struct chained_node));
+  node->key = key;
+  node->value = value;
+  node->next = table->buckets[index];
+  table->buckets[index] = node;
+}
+
+static void chained_table_delete(struct chained_table *table,
+                                 const char *key) {
+  struct chained_node **link = &table->buckets[chained_hash(key)];
+  for (; *link; link = &(*link)->next) {
+    if (strcmp((*link)->key, key) == 0) {
+      struct chained_node *node = *link;
+      *link = node->next;
+      free(node);
+      return;
+    }
+  }
+}
+
+static void chained_table_free(struct chained_table *table) {
+  for (size_t i = 0; i < CHAINED_TABLE_CAPACITY; i++) {
+    struct chained_node *node = table->buckets[i];
+    while (node) {
+      struct chained_node *next = node->next;
+      free(node);
+      node = next;
+    }
+  }
+  free(table);
+}
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static char *scope_names[] = {"i", "total", "n", "missing"};
+static char *global_names[NUM_GLOBALS];
+
+static size_t bench_scopes(bool is_chained) {
+  size_t found = 0;
+  for (size_t round = 0; round < NUM_SCOPES; round++) {
+    if (is_chained) {
+      struct chained_table *table = chained_table_init();
+      for (size_t i = 0; i < 3; i++) {
+        chained_table_insert(table, scope_names[i], scope_names[i]);
+      }
+      for (size_t i = 0; i < 16; i++) {
+        found += chained_table_lookup(table, scope_names[i % 4]) != NULL;
+      }
+      chained_table_free(table);
+    } else {
+      struct hash_table *table = hash_table_init();
+      for (size_t i = 0; i < 3; i++) {
+        hash_table_insert(table, scope_names[i], scope_names[i]);
+      }
+      for (size_t i = 0; i < 16; i++) {
+        found += hash_table_lookup(table, scope_names[i % 4]) != NULL;
+      }
+      hash_table_free(table);
+    }
+  }
+  return found;
+}
+
+static size_t bench_globals(bool is_chained, bool deletes) {
+  struct chained_table *chained = chained_table_init();
+  struct hash_table *table = hash_table_init();
+  for (size_t i = 0; i < NUM_GLOBALS; i++) {
+    if (is_chained) {
+      chained_table_insert(chained, global_names[i], global_names[i]);
+    } else {
+      hash_table_insert(table, global_names[i], global_names[i]);
+    }
+  }
+  for (size_t i = 0; deletes && i < NUM_GLOBALS; i += 2) {
+    if (is_chained) {
+      chained_table_delete(chained, global_names[i]);
+    } else {
+      hash_table_delete(table, global_names[i]);
+    }
+  }
+  size_t found = 0;
+  for (size_t round = 0; round < NUM_GLOBAL_ROUNDS; round++) {
+    for (size_t i = 0; i < NUM_GLOBALS; i++) {
+      void *value = is_chained ? chained_table_lookup(chained, global_names[i])
+                               : hash_table_lookup(table, global_names[i]);
+      found += value == global_names[i];
+    }
+  }
+  chained_table_free(chained);
+  hash_table_free(table);
+  return found;
+}
+
+static void report(const char *workload, double chained_time,
+                   double table_time, bool is_same) {
+  printf("%-8s  chained %8.3fs  open addressing %8.3fs  %5.1fx%s\n", workload,
+         chained_time, table_time, chained_time / table_time,
+         is_same ? "" : "  MISMATCH");
+}
+
+int main() {
+  for (size_t i = 0; i < NUM_GLOBALS; i++) {
+    global_names[i] = malloc(16);
+    snprintf(global_names[i], 16, "name_%zu", i);
+  }
+  printf("empty table: chained %zu bytes, open addressing %zu bytes\n",
+         sizeof(struct chained_table), sizeof(struct hash_table));
+
+  double start = now();
+  size_t chained_found = bench_scopes(true);
+  double chained_time = now() - start;
+  start = now();
+  size_t found = bench_scopes(false);
+  report("scopes", chained_time, now() - start, chained_found == found);
+
+  for (size_t deletes = 0; deletes < 2; deletes++) {
+    start = now();
+    chained_found = bench_globals(true, deletes);
+    chained_time = now() - start;
+    start = now();
+    found = bench_globals(false, deletes);
+    report(deletes ? "deletes" : "globals", chained_time, now() - start,
+           chained_found == found);
+  }
+  return 0;
+}
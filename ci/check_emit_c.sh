@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+
+# Compiles every test program with `jix --emit-c` and checks that the native
+# binary prints the same output as the interpreter. Run from the build
+# directory, after the test files were copied into it.
+
+status=0
+for script in *.jix; do
+  name="${script%.jix}"
+  ./jix --emit-c "$script" > "$name.c" || { status=1; continue; }
+  cc -I ../includes "$name.c" -L . -ljix_runtime -o "$name.aot" || {
+    echo "FAIL: $script does not compile"
+    status=1
+    continue
+  }
+  if [ "$(./jix "$script" 2>&1)" != "$(./"$name.aot" 2>&1)" ]; then
+    echo "FAIL: $script output differs from the interpreter"
+    status=1
+  fi
+done
+exit $status
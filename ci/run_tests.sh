@@ -10,3 +10,4 @@ cmake ..
 make
 cp ../test_files/* .
 ./jix_tests
+../ci/check_emit_c.sh
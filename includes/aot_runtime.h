@@ -0,0 +1,80 @@
+#ifndef AOT_RUNTIME_H
+#define AOT_RUNTIME_H
+
+#include "ast.h"
+#include "errors.h"
+#include "interpreter.h"
+#include "tokens.h"
+#include <stdbool.h>
+
+/*
+ * Runtime support for the C translation units emitted by `jix --emit-c`. The
+ * emitted code keeps the interpreter's object model and environments, and
+ * calls into these helpers for every operation, so that a compiled script
+ * behaves exactly like the interpreted one. Runtime errors are printed the
+ * same way `interpret` prints them, and terminate the program.
+ */
+
+typedef struct object *(*aot_native_fn)(struct interpreter_state *state);
+
+int aot_run(aot_native_fn program);
+void aot_set_lines(struct interpreter_state *state, size_t start_line,
+                   size_t end_line);
+void aot_fail(struct interpreter_state *state, char *error_message);
+
+struct object *aot_int(long value);
+struct object *aot_bool(bool value);
+/* Value of a string literal, made on first use and kept in `*literal` */
+struct object *aot_string(struct object **literal, const char *chars,
+                          size_t length);
+struct object *aot_nil();
+
+struct object *aot_lookup(struct interpreter_state *state, char *id);
+void aot_check_undeclared(struct interpreter_state *state, char *id);
+void aot_declare(struct interpreter_state *state, char *id,
+                 struct object *value);
+void aot_check_assignable(struct interpreter_state *state, char *id);
+void aot_assign(struct interpreter_state *state, char *id,
+                struct object *value);
+void aot_define_fn(struct interpreter_state *state, char *id,
+                   char **parameters, size_t num_parameters,
+                   char **free_names, size_t num_free_names,
+                   aot_native_fn body, bool is_pure);
+void aot_push_scope(struct interpreter_state *state);
+/* Leaves the scopes pushed since `env` was current */
+void aot_pop_scopes(struct interpreter_state *state, struct environment *env);
+
+bool aot_condition(struct interpreter_state *state, struct object *value,
+                   bool check_type, const char *error_message);
+struct object *aot_binary(struct interpreter_state *state, enum token_type op,
+                          struct object *lhs, struct object *rhs);
+struct object *aot_unary(struct interpreter_state *state, enum token_type op,
+                         struct object *operand);
+
+void aot_check_callable(struct interpreter_state *state, struct object *callee,
+                        size_t num_args);
+struct object *aot_call(struct interpreter_state *state, struct object *callee,
+                        struct object **args, size_t num_args);
+struct object *aot_tail_call(struct interpreter_state *state,
+                             struct object *callee, struct object **args,
+                             size_t num_args);
+
+struct object *aot_array_new(size_t capacity);
+void aot_array_push(struct object *array, struct object *value);
+void aot_check_array(struct interpreter_state *state, struct object *value,
+                     const char *error_message);
+struct object *aot_array_index(struct interpreter_state *state,
+                               struct object *array, struct object *index);
+/* Index proven within the array, see "bce.h" */
+struct object *aot_array_load(struct object *array, struct object *index);
+void aot_check_array_store(struct interpreter_state *state,
+                           struct object *array, struct object *index);
+void aot_array_store(struct object *array, struct object *index,
+                     struct object *value);
+struct object *aot_array_len(struct object *array);
+void aot_check_array_pop(struct interpreter_state *state,
+                         struct object *array);
+struct object *aot_array_pop(struct interpreter_state *state,
+                             struct object *array, struct object *index);
+
+#endif
@@ -31,6 +31,9 @@ enum ast_primary_node_type {
   METHOD_CALL_PRIMARY_NODE,
   ARRAY_CREATION_PRIMARY_NODE,
   ARRAY_ACCESS_PRIMARY_NODE,
+  INVARIANT_PRIMARY_NODE,
+  SAVED_PRIMARY_NODE,
+  REUSED_PRIMARY_NODE,
 };
 
 struct ast_node {
@@ -40,6 +43,11 @@ struct ast_node {
     size_t start_line;
     size_t end_line;
   } source_position;
+  /* Set when running with `--profile`, see "profile.h" */
+  struct profile_site *profile_site;
+  /* Value of a number, string, boolean or nil literal, returned by every
+   * evaluation, see `literal_init_value` */
+  struct object *literal;
 
   union {
     /* Function definition statement */
@@ -47,6 +55,9 @@ struct ast_node {
       char *id;
       struct vector *parameters; /* Vector of result(`char*`) */
       struct result *block;
+      bool is_pure; /* Calls are memoized, see "memo.h" */
+      /* Vector of `char*`, see "closure.h". NULL until computed. */
+      struct vector *free_names;
     } fn_def_stmt;
 
     /* Variable declaration statement */
@@ -72,6 +83,8 @@ struct ast_node {
     struct {
       struct result *expr;
       struct result *block;
+      struct trace *trace; /* Set once the loop gets hot, see "trace.h" */
+      struct vector *invariants; /* Invariant nodes to reset on entry */
     } while_stmt;
 
     /* For statement */
@@ -80,6 +93,8 @@ struct ast_node {
       struct result *expr_stmt;
       struct result *update_stmt;
       struct result *block;
+      struct trace *trace; /* Set once the loop gets hot, see "trace.h" */
+      struct vector *invariants; /* Invariant nodes to reset on entry */
     } for_stmt;
 
     /* Return statement */
@@ -96,6 +111,8 @@ struct ast_node {
       struct result *left;
       struct result *right;
       enum token_type op;
+      /* Both operands are proven integers, see "type_inference.h" */
+      bool is_int_typed;
     } binary;
 
     /* Unary node */
@@ -107,8 +124,8 @@ struct ast_node {
     /* Number node */
     long number;
 
-    /* String node */
-    char *string;
+    /* String node, see `struct string` in "interpreter.h" */
+    struct string *string;
 
     /* Identifier node */
     char *id;
@@ -136,7 +153,26 @@ struct ast_node {
     struct {
       struct result *primary; /* One of 3 from grammar */
       struct result *index;
+      /* The index is proven within the array, see "bce.h" */
+      bool is_in_bounds;
     } array_access;
+
+    /* Loop-invariant expression, see "licm.h" */
+    struct {
+      struct result *expr;
+      struct object *value; /* NULL until evaluated since the loop started */
+      size_t id;
+    } invariant;
+
+    /* Common subexpression, see "cse.h" */
+    struct {
+      struct result *expr;
+      struct object *value; /* Set every time the expression is evaluated */
+      size_t id;
+    } saved;
+
+    /* Later occurrence of a common subexpression */
+    struct ast_node *reused; /* Its `SAVED_PRIMARY_NODE` */
   };
 };
 
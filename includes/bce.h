@@ -0,0 +1,40 @@
+#ifndef BCE_H
+#define BCE_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Bounds-check elimination, run before "licm.h" among the -O1 passes (see
+ * "optimizer.h"). In a counted loop of the form
+ *
+ *   for (let i = <n>; i < a.len(); i = i + 1;) { ... }
+ *
+ * with `<n>` a non-negative integer literal, `i` starts within the range
+ * `0 <= i` and steps up by one until `a.len()`, so `0 <= i < a.len()` holds
+ * whenever the body starts. It keeps holding through the body as long as
+ * neither `i` nor `a` is assigned or declared there, no array is resized
+ * (`.add()`, `.pop()`), and no user function is called.
+ *
+ * Every `a[i]` read or assigned in the body of such a loop, nested loops
+ * included but not nested function definitions, is marked `is_in_bounds`.
+ * The evaluator, the stack VM and `--emit-c` then index the array without
+ * checking the type of the array, the type of the index nor its bounds.
+ */
+
+struct bce_loop {
+  char *index; /* `i` above */
+  char *array; /* `a` above */
+};
+
+struct bce {
+  struct hash_table *declared_names; /* Names declared by the program */
+  struct vector *loops; /* Vector of `bce_loop`, enclosing counted loops */
+};
+
+void eliminate_bounds_checks(struct vector *program);
+
+#endif
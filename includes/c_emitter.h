@@ -0,0 +1,45 @@
+#ifndef C_EMITTER_H
+#define C_EMITTER_H
+
+#include "ast.h"
+#include "string_builder.h"
+#include "vector.h"
+#include <stdbool.h>
+
+/*
+ * Lowers a parsed program to a standalone C translation unit. The result is
+ * linked against the `jix_runtime` library (see "aot_runtime.h"):
+ *
+ *   jix --emit-c script.jix > script.c
+ *   cc -I includes script.c -L build -ljix_runtime -o script
+ *
+ * Control flow, scoping and evaluation order are emitted as straight C code,
+ * while values keep the interpreter's object representation.
+ */
+
+struct c_emitter {
+  struct string_builder *prototypes;
+  struct string_builder *functions;
+  size_t next_id; /* Used to name temporaries, scopes and functions */
+};
+
+struct c_emitter_context {
+  struct string_builder *out;
+  size_t indent_level;
+  const char *loop_env; /* Scope to restore on 'break', NULL outside loops */
+  bool is_top_level;
+  bool is_function_body; /* `return f(...)` becomes a tail call */
+};
+
+char *emit_c_program(struct vector *program);
+void emit_c_statement(struct c_emitter *emitter,
+                      struct c_emitter_context *context, struct ast_node *stmt);
+void emit_c_block_statement(struct c_emitter *emitter,
+                            struct c_emitter_context *context,
+                            struct ast_node *stmt);
+char *emit_c_expression(struct c_emitter *emitter,
+                        struct c_emitter_context *context,
+                        struct ast_node *expr);
+char *emit_c_string_literal(const char *str);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CLOSURE_H
+#define CLOSURE_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "interpreter.h"
+#include "vector.h"
+
+/*
+ * Lexical closures. The body of a function resolves a name in its own scopes
+ * first, then in the variables it captured where it was defined, and last in
+ * the program's environment, never in the environment of its caller.
+ *
+ * The names a body mentions without declaring them, its free names, are
+ * looked up when the definition runs, in the scopes enclosing it up to (but
+ * not including) the program's environment. Every variable found becomes an
+ * upvalue of the new function, kept in a flat vector, so that the body
+ * reaches it without walking any environment chain. Names which are not found
+ * are left to the program's environment, and functions defined at the top
+ * level keep seeing the variables and functions declared after them.
+ *
+ * An upvalue stands for the variable rather than for its value: the function
+ * and the scope which declared the variable see each other's assignments.
+ * While the environment holding the variable lives, the upvalue is open and
+ * reads and writes go to that environment. The upvalue is closed when the
+ * environment goes away, e.g. when a call frame is popped, and the variable
+ * moves into the upvalue itself. A function capturing a variable which is
+ * already an upvalue of the function it is defined in shares that upvalue,
+ * so that every closure of a variable sees the same value.
+ */
+
+struct upvalue {
+  char *id;
+  struct environment *env; /* Holds the variable while open, NULL once closed */
+  struct object *closed;   /* The variable, once closed */
+  struct upvalue *next;    /* Next upvalue open on `env` */
+};
+
+struct free_names {
+  struct vector *scopes; /* Vector of hash tables of the declared names */
+  struct hash_table *found;
+  struct vector *names; /* Vector of `char*`, in order of first use */
+};
+
+/* Returns the free names of `fn_def`, as a new vector */
+struct vector *closure_find_free_names(struct ast_node *fn_def);
+/* Same, computed once the program is optimized and kept on the node */
+struct vector *closure_free_names(struct ast_node *fn_def);
+/* Sets the upvalues of `function`, defined in `state->env` */
+void closure_capture(struct interpreter_state *state, struct function *function,
+                     struct vector *free_names);
+/* Value of the variable, NULL when it is bound to nothing */
+struct object *upvalue_get(struct upvalue *upvalue);
+void upvalue_set(struct upvalue *upvalue, struct object *value);
+/* Closes the upvalues open on `env`, which goes away */
+void closure_close(struct environment *env);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CSE_H
+#define CSE_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Common subexpression elimination by local value numbering, run before
+ * "type_inference.h" among the -O1 passes (see "optimizer.h"). Within a run
+ * of straight-line statements (declarations, assignments, expression
+ * statements, 'return' and the condition of an 'if'), a binary operation,
+ * array indexing or `.len()` computed a second time with the same operands
+ * reuses the first value instead. The first occurrence becomes a
+ * `SAVED_PRIMARY_NODE`, which keeps its value every time it is evaluated, and
+ * the later ones `REUSED_PRIMARY_NODE`s reading it back.
+ *
+ * Following "docs/variable references.md", a value is forgotten once one of
+ * its names is assigned or declared again, and array indexing and `.len()`
+ * once any array is changed, since arrays are shared by their aliases. Calls
+ * to user functions, which can assign the program's variables and those they
+ * captured, forget everything. Binary operations and `.len()` give a new
+ * object, so they are only reused as the operand of another expression, never
+ * bound to a name or stored.
+ */
+
+struct cse_value {
+  char *key;             /* Canonical form of the expression */
+  struct ast_node *node; /* First occurrence */
+  bool is_forgotten;
+};
+
+struct cse {
+  struct hash_table *declared_names; /* Names declared by the program */
+  struct hash_table *available;      /* key -> cse_value */
+  struct vector *values; /* Values numbered since the run started */
+  size_t num_saved;
+};
+
+void eliminate_common_subexpressions(struct vector *program);
+
+#endif
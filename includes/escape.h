@@ -0,0 +1,49 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Escape analysis and scalar replacement of small arrays, the first -O1 pass
+ * after inlining (see "optimizer.h"). An array literal of one to
+ * `MAX_SCALAR_ELEMENTS` elements bound by a `let` escapes when its name is
+ * used for anything else than reading or assigning an element at a literal
+ * index within the array, or `.len()`: passed to or returned from a
+ * function, bound to another name, printed, compared, resized, or indexed by
+ * a computed index. Functions can capture the name (see "closure.h"), so a
+ * use of the name in any function body, or outside the statements following
+ * the `let` in its block, counts as escaping too, as does the name being
+ * declared more than once, assigned, or a parameter.
+ *
+ * An array which does not escape is never allocated:
+ *
+ *   let p = [x, y];        let p[0] = x;
+ *   p[1] = p[0] + 1;  =>   let p[1] = y;
+ *   return p.len();        p[1] = p[0] + 1;
+ *                          return 2;
+ *
+ * Each element is bound to a variable of its own, named after the element,
+ * which no source can spell, and `.len()` becomes the length.
+ */
+
+#define MAX_SCALAR_ELEMENTS 8
+
+struct scalar_replacement {
+  struct hash_table *declared_names;
+  struct hash_table *redeclared_names;
+  struct hash_table *assigned_names;
+  struct hash_table *references; /* Name -> `size_t` uses in the program */
+  /* Array being checked or replaced */
+  char *id;
+  size_t num_elements;
+  size_t num_scalar_uses; /* Uses of an element or `.len()` */
+  bool is_replacing;
+};
+
+void replace_scalar_arrays(struct vector *program);
+
+#endif
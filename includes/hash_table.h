@@ -1,28 +1,52 @@
 #ifndef HASH_TABLE_H
 #define HASH_TABLE_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define HASH_TABLE_CAPACITY 100
+/*
+ * String-keyed hash table with open addressing and Robin Hood linear probing.
+ * Keys and values are stored inline in a single array of entries, which is
+ * only allocated on the first insert and doubles whenever it gets more than
+ * `HASH_TABLE_MAX_LOAD` full. An entry never sits farther from the slot its
+ * key hashes to than the entry before it sits from its own (the displaced
+ * entry is swapped out on insert, and the following ones shift back on
+ * delete), so lookups stop at the first entry closer to home than the probe.
+ *
+ * Keys are not copied, and must outlive the table. Inserting a key which is
+ * already present replaces its value.
+ */
 
-struct hash_node {
-  const char *key;
+#define HASH_TABLE_INITIAL_CAPACITY 4 /* A power of two */
+#define HASH_TABLE_MAX_LOAD 0.875
+
+struct hash_entry {
+  const char *key; /* NULL for an empty slot */
   void *value;
-  struct hash_node *next;
+  uint32_t hash;     /* Low bits of `hash(key)` */
+  uint32_t distance; /* Slots away from the one `key` hashes to */
 };
 
 struct hash_table {
-  struct hash_node *buckets[HASH_TABLE_CAPACITY];
+  struct hash_entry *entries; /* NULL until the first insert */
+  uint32_t capacity;          /* Zero or a power of two */
+  uint32_t size;
 };
 
-unsigned int hash(const char *key);
+uint64_t hash(const char *key);
 struct hash_table *hash_table_init();
 void *hash_table_lookup(struct hash_table *table, const char *key);
 void hash_table_insert(struct hash_table *table, const char *key, void *value);
+/* Replaces the value of `key`, if present */
 void hash_table_update(struct hash_table *table, const char *key, void *value);
 void hash_table_delete(struct hash_table *table, const char *key);
+/* Iterates over the entries, in no particular order, starting with `*index`
+ * set to 0. Returns false once there are none left. */
+bool hash_table_next(struct hash_table *table, size_t *index,
+                     const char **key, void **value);
 void hash_table_free(struct hash_table *table);
 
 #endif
@@ -0,0 +1,91 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "ast.h"
+#include "interpreter.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Heap images. `jix --snapshot prelude.jix -o prelude.img` runs a script,
+ * then writes the program's environment it leaves behind to an image file:
+ * every global, and every value, function, upvalue and syntax tree reachable
+ * from them. `jix --image prelude.img main.jix` runs `main.jix` in that
+ * environment, without parsing nor running the prelude again.
+ *
+ * The image holds the runtime's own structures, copied one after the other
+ * (each at a multiple of 8 bytes), with every pointer replaced by its target's
+ * offset from the start of the image, so that the image can be loaded at any
+ * address. A table lists the pointers: loading maps the file privately, so
+ * that its pages are copy-on-write, adds the address of the mapping to each
+ * pointer, and inserts the globals into a new program environment. Nothing is
+ * parsed or allocated per value, and the image is never unmapped.
+ *
+ * What only makes sense in the process which wrote the image is left out:
+ * compiled traces, cached loop invariants and subexpressions, profile sites,
+ * and compiled VM chunks (compiled again on the first call, see "vm.h").
+ * Functions lose their memoization cache, since the program they run in can
+ * assign the names their purity was proven on. Builtin functions are stored
+ * by name. Arrays in an image move to the heap the first time they grow.
+ */
+
+#define IMAGE_MAGIC "jix-img"
+#define IMAGE_FORMAT_VERSION 1
+#define IMAGE_ALIGNMENT 8
+
+enum image_relocation_type {
+  IMAGE_RELOCATION_POINTER, /* Offset of a structure in the image */
+  IMAGE_RELOCATION_BUILTIN, /* Offset of the name of a builtin function */
+};
+
+struct image_relocation {
+  uint64_t offset; /* Of the pointer, from the start of the image */
+  uint64_t type;   /* enum image_relocation_type */
+};
+
+struct image_global {
+  char *id;
+  struct object *value;
+};
+
+/* Start of an image file */
+struct image_header {
+  char magic[8];
+  uint64_t version;
+  uint64_t size;    /* Of the whole image, header included */
+  uint64_t globals; /* Offset of the `image_global` array */
+  uint64_t num_globals;
+  uint64_t relocations; /* Offset of the `image_relocation` array */
+  uint64_t num_relocations;
+};
+
+/* Address of a structure already copied into the image, and its offset */
+struct image_copy {
+  const void *address; /* NULL for an empty slot */
+  size_t offset;
+};
+
+struct image_writer {
+  char *buffer; /* The image being written */
+  size_t size;
+  size_t capacity;
+  struct image_relocation *relocations;
+  size_t num_relocations;
+  size_t relocations_capacity;
+  /* Open addressing table of the copies, so that structures reachable
+   * through several pointers, or through cycles, are copied once */
+  struct image_copy *copies;
+  size_t num_copies;
+  size_t copies_capacity; /* A power of two */
+};
+
+/* Writes `globals` and everything reachable from them to `file_name`.
+ * Returns false, after printing why, if the file cannot be written. */
+bool image_write(struct environment *globals, const char *file_name);
+/* Maps the image in `file_name`, and returns a new program environment
+ * holding its globals, or NULL, after printing why, if it cannot be
+ * loaded */
+struct environment *image_load(const char *file_name);
+
+#endif
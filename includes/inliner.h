@@ -0,0 +1,60 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Function inlining, the first of the -O1 passes (see "optimizer.h"). A call
+ * to `f` is replaced by a copy of the body of `f` when:
+ *   - `f` is defined once, at the top level of the program and before the
+ *     top-level statement holding the call, and is never assigned to. Every
+ *     environment is enclosed by the program's, so the call can only ever
+ *     resolve to that definition.
+ *   - The names the body uses without declaring them, which resolve in the
+ *     program's environment (see "closure.h"), are not declared in any scope
+ *     enclosing the call either, short of the program's.
+ *   - The body does not refer to `f` itself, does not define functions, does
+ *     not declare a name twice in the same block, and its only 'return' is
+ *     its last statement.
+ *   - The call passes as many arguments as `f` has parameters, and makes up a
+ *     whole statement: `let x = f(...);`, `x = f(...);`, `return f(...);` or
+ *     `f(...);`.
+ *   - The body is small. It has at most INLINE_MAX_BODY_NODES nodes, and
+ *     copying it into every call site grows the program by at most
+ *     INLINE_MAX_GROWTH_NODES nodes.
+ * The arguments are bound to renamed parameters, `n` becoming `n$1`, and the
+ * locals of the body are renamed the same way. The body then runs in the
+ * caller's scope without allocating an environment, and without clashing with
+ * the caller's names: identifiers can not contain '$'.
+ */
+
+#define INLINE_MAX_BODY_NODES 32
+#define INLINE_MAX_GROWTH_NODES 256
+
+struct inline_candidate {
+  struct ast_node *fn_def;
+  size_t body_size; /* Number of AST nodes in the body */
+  size_t num_call_sites;
+  bool is_inlinable;
+};
+
+struct inliner {
+  /* Name -> inline_candidate, for functions defined once at the top level */
+  struct hash_table *candidates;
+  /* Candidates defined before the current top-level statement */
+  struct hash_table *visible;
+  /* Vector of hash tables, names declared in the caller's scopes */
+  struct vector *scopes;
+  /* Vector of hash tables, name -> renamed name, while copying a body */
+  struct vector *renames;
+  size_t num_renamed;
+  struct ast_node *site; /* Statement whose call is being inlined */
+};
+
+void inline_functions(struct vector *program);
+
+#endif
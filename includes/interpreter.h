@@ -6,17 +6,55 @@
 #include "hash_table.h"
 #include "tokens.h"
 #include "vector.h"
-
-#define RETURN_RESULT_IF_ERROR(return_value)                                   \
-  do {                                                                         \
-    if (return_value->type == RESULT_ERROR) {                                  \
-      return return_value;                                                     \
-    }                                                                          \
-  } while (0)
+#include <setjmp.h>
 
 struct environment {
-  struct hash_table *symbols; /* Key: char*, Value: object* */
+  /* Key: char*, Value: object*. NULL in a block or a call frame until
+   * something else than the arguments is inserted. */
+  struct hash_table *symbols;
   struct environment *parent_environment;
+  /* Set for the environment of a user function call, which lives on the
+   * call stack: the function, and the arguments in the order of its
+   * parameters */
+  struct function *function;
+  struct object **arguments;
+  /* Upvalues open on variables of this environment, see "closure.h" */
+  struct upvalue *captured;
+};
+
+/*
+ * User function calls get their environment and argument slots from a stack
+ * of large chunks, with a single bump of its top, and give them back by
+ * resetting the top once the call returns (see `environment_init_frame`).
+ * Chunks never move, so environments nested in a call can point to it.
+ */
+#define CALL_STACK_CHUNK_SIZE (64 * 1024)
+
+struct call_stack_chunk {
+  struct call_stack_chunk *previous;
+  struct call_stack_chunk *next; /* Kept once the stack shrinks below it */
+  size_t used;
+  size_t capacity;
+  char data[];
+};
+
+struct call_stack_mark {
+  struct call_stack_chunk *chunk;
+  size_t used;
+};
+
+/*
+ * Runtime errors unwind to the innermost handler with `longjmp`, rather than
+ * being returned through every evaluation function, so that evaluating an
+ * expression returns its value, and the code which succeeds checks nothing.
+ * Handlers are pushed on the state at the few places which recover from an
+ * error. Without one, the error is printed and the program exits, which is
+ * all the interpreter ever does with them: nothing is left to unwind.
+ */
+struct error_handler {
+  jmp_buf jump;
+  struct runtime_error *error; /* Set before jumping */
+  struct error_handler *previous;
 };
 
 struct interpreter_state {
@@ -25,8 +63,12 @@ struct interpreter_state {
     size_t end_line;
   } current_stmt_lines;
   bool is_break;
+  size_t call_depth; /* User function calls in progress */
   struct environment *env;
+  struct environment *globals; /* Environment of the program */
   struct hash_table *builtin_fns;
+  struct call_stack_chunk *call_stack; /* Chunk holding the top frame */
+  struct error_handler *error_handler; /* Innermost, NULL when none */
 };
 
 /* See documentation "docs/variable references.md" */
@@ -41,115 +83,188 @@ enum object_type {
   ARRAY_VALUE,
 };
 
+/* Characters of a string value, immutable, in a single block. String
+ * literals of the program are made once by the parser, and shared by every
+ * value they evaluate to. */
+struct string {
+  size_t length;
+  unsigned long hash; /* FNV-1a of the characters */
+  char chars[];       /* NUL-terminated, for the C library */
+};
+
+/* Elements of an array value, in a single block which grows by realloc. The
+ * array object is its only owner, so that the block can move. */
+struct array {
+  size_t size;
+  size_t capacity;
+  struct object *items[];
+};
+
+/*
+ * Every value is 16 bytes: an 8-byte header and an 8-byte payload. The
+ * header only uses its first three bytes, the rest is left for the mark bits
+ * of a collector. Strings and arrays keep their length in the block the payload
+ * points to, so that reaching an element or a character takes one hop.
+ */
 struct object {
-  enum object_type data_type;
+  unsigned char data_type; /* enum object_type */
+  bool is_builtin;         /* Of a function value */
+  bool is_in_image; /* Of an array whose block is in an image, see "image.h" */
   union {
     /* Immutable */
     long int_value;
     bool bool_value;
-    char *string_value;
-    struct {
-      bool is_builtin;
-      union {
-        struct builtin_fn *builtin_function;
-        struct function *function_value;
-      };
+    struct string *string_value;
+    union {
+      struct builtin_fn *builtin_function;
+      struct function *function_value;
     } function_value;
     /* Mutable */
-    struct vector *array_value;
+    struct array *array_value;
   };
 };
 
+_Static_assert(sizeof(struct object) == 16, "struct object is 16 bytes");
+
+/* Integers from SMALL_INT_MIN to SMALL_INT_MAX are shared, see `object_int` */
+#define SMALL_INT_MIN -128
+#define SMALL_INT_MAX 1023
+
 struct return_value {
   bool is_set;
-  struct result *value;
+  struct object *value;
+  /* Set by `return f(...)` inside a function, instead of `value`. The caller
+   * then runs `f` in place of the returning function. */
+  struct {
+    bool is_pending;
+    struct function *function;
+    struct vector *arguments; /* Vector of `object*` */
+  } tail_call;
 };
 
 struct function {
+  char *id; /* Name of the definition */
   struct vector *parameters;
+  /* Vector of `upvalue*`, the variables it captured, see "closure.h". NULL
+   * when it captured none. */
+  struct vector *upvalues;
   struct ast_node *body;
+  /* Body compiled ahead of time by `jix --emit-c`, NULL when interpreted */
+  struct object *(*native_body)(struct interpreter_state *state);
+  /* Body compiled for `jix --stackless`, NULL when interpreted, and until
+   * the first call of a function of an image */
+  struct vm_chunk *chunk;
+  /* Results of a pure function, see "memo.h", NULL for other functions */
+  struct memo_cache *memo;
 };
 
 struct object *interpret(struct vector *program);
-struct result *interpret_statement(struct ast_node *statement,
-                                   struct interpreter_state *state,
-                                   struct return_value *return_code);
-struct result *interpret_fn_def_statement(struct ast_node *stmt_node,
-                                          struct interpreter_state *state);
-struct result *interpret_expr_statement(struct ast_node *stmt_node,
-                                        struct interpreter_state *state,
-                                        struct return_value *return_code);
-struct result *interpret_return_statement(struct ast_node *stmt_node,
-                                          struct interpreter_state *state,
-                                          struct return_value *return_code);
-struct result *
-interpret_variable_decl_statement(struct ast_node *stmt_node,
-                                  struct interpreter_state *state,
-                                  struct return_value *return_code);
-struct result *
-interpret_variable_assignment_statement(struct ast_node *stmt_node,
-                                        struct interpreter_state *state,
-                                        struct return_value *return_code);
-struct result *interpret_if_statement(struct ast_node *stmt_node,
-                                      struct interpreter_state *state,
-                                      struct return_value *return_code);
-struct result *interpret_while_statement(struct ast_node *stmt_node,
-                                         struct interpreter_state *state,
-                                         struct return_value *return_code);
-struct result *interpret_for_statement(struct ast_node *stmt_node,
+/* Runs `program` in `globals`, e.g. the environment of an image, see
+ * "image.h" */
+struct object *interpret_in(struct vector *program,
+                            struct environment *globals);
+void interpret_statement(struct ast_node *statement,
+                         struct interpreter_state *state,
+                         struct return_value *return_code);
+void interpret_fn_def_statement(struct ast_node *stmt_node,
+                                struct interpreter_state *state);
+void interpret_expr_statement(struct ast_node *stmt_node,
+                              struct interpreter_state *state,
+                              struct return_value *return_code);
+void interpret_return_statement(struct ast_node *stmt_node,
+                                struct interpreter_state *state,
+                                struct return_value *return_code);
+void interpret_variable_decl_statement(struct ast_node *stmt_node,
                                        struct interpreter_state *state,
                                        struct return_value *return_code);
-struct result *interpret_break_statement(struct ast_node *stmt_node,
-                                         struct interpreter_state *state,
-                                         struct return_value *return_code);
-struct result *interpret_block_statement(struct ast_node *stmt_node,
-                                         struct interpreter_state *state,
-                                         struct return_value *return_code);
-
-struct result *eval_expression(struct ast_node *ast,
+void interpret_variable_assignment_statement(struct ast_node *stmt_node,
+                                             struct interpreter_state *state,
+                                             struct return_value *return_code);
+void interpret_if_statement(struct ast_node *stmt_node,
+                            struct interpreter_state *state,
+                            struct return_value *return_code);
+void interpret_while_statement(struct ast_node *stmt_node,
+                               struct interpreter_state *state,
+                               struct return_value *return_code);
+void interpret_for_statement(struct ast_node *stmt_node,
+                             struct interpreter_state *state,
+                             struct return_value *return_code);
+void interpret_break_statement(struct ast_node *stmt_node,
+                               struct interpreter_state *state,
+                               struct return_value *return_code);
+void interpret_tail_call(struct ast_node *fn_call,
+                         struct interpreter_state *state,
+                         struct return_value *return_code);
+void interpret_block_statement(struct ast_node *stmt_node,
+                               struct interpreter_state *state,
+                               struct return_value *return_code);
+
+struct object *eval_expression(struct ast_node *ast,
                                struct interpreter_state *state,
                                struct return_value *return_code);
-struct result *eval_binary_expression(struct ast_node *ast,
+struct object *eval_binary_expression(struct ast_node *ast,
                                       struct interpreter_state *state,
                                       struct return_value *return_code);
-struct result *eval_unary_expression(struct ast_node *ast,
+struct object *eval_binary_operation(enum token_type op, struct object *lhs,
+                                     struct object *rhs,
+                                     struct interpreter_state *state);
+struct object *eval_int_binary_operation(enum token_type op, long lhs,
+                                         long rhs);
+struct object *eval_unary_expression(struct ast_node *ast,
                                      struct interpreter_state *state,
                                      struct return_value *return_code);
-struct result *eval_logical_expression(enum token_type op, struct object *lhs,
+struct object *eval_unary_operation(enum token_type op, struct object *operand,
+                                    struct interpreter_state *state);
+struct object *eval_logical_expression(enum token_type op, struct object *lhs,
                                        struct object *rhs);
-struct result *eval_equality_expression(enum token_type op, struct object *lhs,
+struct object *eval_equality_expression(enum token_type op, struct object *lhs,
                                         struct object *rhs,
                                         struct interpreter_state *state);
-struct result *eval_comparitive_expression(enum token_type op,
+struct object *eval_comparitive_expression(enum token_type op,
                                            struct object *lhs,
                                            struct object *rhs,
                                            struct interpreter_state *state);
-struct result *
+struct object *
 eval_additive_multiplicative_expression(enum token_type op, struct object *lhs,
                                         struct object *rhs,
                                         struct interpreter_state *state);
-struct result *eval_primary_expression(struct ast_node *ast,
+struct object *eval_primary_expression(struct ast_node *ast,
                                        struct interpreter_state *state,
                                        struct return_value *return_code);
-struct result *
+struct object *
+eval_invariant_primary_expression(struct ast_node *ast,
+                                  struct interpreter_state *state,
+                                  struct return_value *return_code);
+void reset_loop_invariants(struct vector *invariants);
+struct object *
 eval_fn_call_primary_expression(struct ast_node *ast,
                                 struct interpreter_state *state,
                                 struct return_value *return_code);
-struct result *eval_builtin_fn_call_primary_expression(
+struct object *eval_user_fn_call(struct function *function,
+                                 struct environment *fn_call_env,
+                                 struct interpreter_state *state,
+                                 struct return_value *return_code);
+struct object *eval_builtin_fn_call_primary_expression(
     struct ast_node *ast, struct object *fn_call_primary,
     struct interpreter_state *state, struct return_value *return_code);
-struct result *
+struct object *
 eval_method_call_primary_expression(struct ast_node *ast,
                                     struct interpreter_state *state,
                                     struct return_value *return_code);
-struct result *
+struct object *
 eval_array_creation_primary_expression(struct ast_node *ast,
                                        struct interpreter_state *state,
                                        struct return_value *return_code);
-struct result *
+struct object *
 eval_array_access_primary_expression(struct ast_node *ast,
                                      struct interpreter_state *state,
                                      struct return_value *return_code);
+struct object *eval_array_pop_operation(struct object *array_obj,
+                                        struct object *index,
+                                        struct interpreter_state *state);
+struct object *eval_array_index_operation(struct object *array_obj,
+                                          struct object *array_index,
+                                          struct interpreter_state *state);
 
 struct environment *environment_init();
 struct environment *environment_init_enclosed(struct environment *enclosed_env);
@@ -160,6 +275,60 @@ void environment_insert_symbol(struct environment *env, char *key,
                                struct object *value);
 void environment_reassign_symbol(struct environment *env, char *key,
                                  struct object *value);
+/* Frees `env`, a scope which is left, but not the environments enclosing it.
+ * Its upvalues are closed first: closures are the only values which can still
+ * reach a scope once it is left, and they keep the variables they captured. */
 void environment_free(struct environment *env);
 
+/* New string of the `length` characters at `chars` */
+struct string *string_init(const char *chars, size_t length);
+struct string *string_concat(const char *lhs, size_t lhs_length,
+                             const char *rhs, size_t rhs_length);
+bool string_equals(struct string *lhs, struct string *rhs);
+/*
+ * Values are never modified once made, except for the elements of arrays, so
+ * that the same object can stand for every occurrence of a value. `true`,
+ * `false`, `nil` and the small integers are immortal singletons, and the
+ * value of each literal is made once and kept in its node.
+ */
+struct object *object_int(long value);
+struct object *object_bool(bool value);
+struct object *object_nil();
+/* Sets the `literal` of a number, string, boolean or nil node, to be called
+ * whenever a node becomes such a literal */
+void literal_init_value(struct ast_node *literal);
+struct array *array_init(size_t capacity);
+/* Appends `value` to the array of `array_obj`, whose block may move */
+void array_push(struct object *array_obj, struct object *value);
+struct object *array_remove_at(struct array *array, size_t index);
+/* Leaves and frees the block scopes entered since `env`, stopping at a call
+ * frame or at the program's environment */
+void environment_leave_scopes(struct interpreter_state *state,
+                              struct environment *env);
+
+struct call_stack_mark call_stack_mark(struct interpreter_state *state);
+/* Pops every frame pushed since `mark` was taken */
+void call_stack_release(struct interpreter_state *state,
+                        struct call_stack_mark mark);
+/* Pushes the environment of a call to `function`, enclosed by the program's
+ * environment, whose `arguments` the caller fills in */
+struct environment *environment_init_frame(struct interpreter_state *state,
+                                           struct function *function);
+/* Raises an error if `function` does not take `num_arguments` */
+void check_arity(struct function *function, size_t num_arguments,
+                 struct interpreter_state *state);
+
+/* The handler is popped before `longjmp` to it, or by the code which pushed
+ * it when nothing was raised. `setjmp(handler->jump)` must be called by the
+ * function pushing it, which must not return while it is pushed. */
+void interpreter_push_handler(struct interpreter_state *state,
+                              struct error_handler *handler);
+void interpreter_pop_handler(struct interpreter_state *state);
+/* Jumps to the innermost handler with `error`, or prints it and exits */
+_Noreturn void interpreter_raise_error(struct interpreter_state *state,
+                                       struct runtime_error *error);
+/* Raises `error_message`, at the lines of the current statement */
+_Noreturn void interpreter_raise(struct interpreter_state *state,
+                                 char *error_message);
+
 #endif
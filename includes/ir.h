@@ -0,0 +1,154 @@
+#ifndef IR_H
+#define IR_H
+
+#include "ast.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "string_builder.h"
+#include "tokens.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Mid-level intermediate representation in SSA form, lowered from the
+ * (optimized) AST for analyses and backends to build on:
+ *
+ *   jix --dump-ir script.jix
+ *
+ * The program and each function definition become an `ir_function`, a graph
+ * of basic blocks. A block starts with its phi nodes, holds straight-line
+ * instructions, and ends with a single terminator: 'jump', 'branch' or
+ * 'return'. Every instruction defines one value, numbered `%N` within its
+ * function, which is used by later instructions of blocks it dominates.
+ *
+ * Names resolve at runtime through environments, which a function body shares
+ * with the program and with the functions it captured variables of (see
+ * "closure.h"). A name is only promoted to SSA values, with phi nodes where
+ * control flow merges, when that can not be observed: it is declared once in
+ * its function, no other function mentions it, and it is lexically in scope.
+ * Every other name goes through the environment with 'load', 'declare' and
+ * 'store', inside the same 'push_scope'/'pop_scope' the evaluator uses.
+ *
+ * Values have a type when it is known from how they are built, e.g.
+ * literals, arrays and functions, and "type_inference.h" infers the type of
+ * the others where it can.
+ */
+
+enum ir_type {
+  IR_TYPE_UNKNOWN,
+  IR_TYPE_INT,
+  IR_TYPE_BOOL,
+  IR_TYPE_STRING,
+  IR_TYPE_NIL,
+  IR_TYPE_ARRAY,
+  IR_TYPE_FUNCTION,
+};
+
+enum ir_opcode {
+  IR_CONST_INT,    /* number */
+  IR_CONST_BOOL,   /* boolean */
+  IR_CONST_STRING, /* string */
+  IR_CONST_NIL,
+  IR_PARAM,        /* name: parameter of the function */
+  IR_PHI,          /* operands: one per predecessor, in the same order */
+  IR_BINARY,       /* op, operands: left, right */
+  IR_UNARY,        /* op, operands: operand */
+  IR_LOAD,         /* name: looked up in the environment */
+  IR_DECLARE,      /* name, operands: value */
+  IR_STORE,        /* name, operands: value */
+  IR_CALL,         /* operands: callee, arguments... */
+  IR_CALL_METHOD,  /* name: method (NULL if invalid), operands: array, args */
+  IR_ARRAY,        /* operands: elements */
+  IR_INDEX,        /* operands: array, index */
+  IR_STORE_INDEX,  /* operands: array, index, value */
+  IR_FUNCTION,     /* function: definition, declared under its name */
+  IR_PUSH_SCOPE,
+  IR_POP_SCOPE,
+  IR_JUMP,         /* targets[0] */
+  IR_BRANCH,       /* operands: condition, targets: then, else */
+  IR_RETURN,       /* operands: value, or none to return nothing */
+};
+
+struct ir_function;
+struct ir_block;
+
+struct ir_value {
+  size_t id;
+  enum ir_opcode opcode;
+  enum ir_type type;
+  struct ir_block *block;
+  struct vector *operands; /* Vector of `ir_value` */
+  struct ir_block *targets[2];
+  struct ast_node *node; /* Expression or statement lowered, if any */
+  union {
+    long number;
+    bool boolean;
+    char *string;
+    char *name;
+    enum token_type op;
+    struct ir_function *function;
+  };
+};
+
+struct ir_block {
+  size_t id; /* Index in `ir_function.blocks` */
+  struct ir_function *function;
+  struct vector *phis;         /* Vector of `ir_value` */
+  struct vector *instructions; /* Vector of `ir_value`, ends with terminator */
+  struct vector *predecessors; /* Vector of `ir_block`, one per edge */
+  /* SSA construction: all predecessors are known */
+  bool is_sealed;
+  struct hash_table *definitions; /* Promoted name -> current value */
+  struct vector *incomplete_phis; /* Phis waiting for the block to be sealed */
+};
+
+struct ir_function {
+  char *name; /* NULL for the program itself */
+  struct vector *parameters; /* Vector of `char*` */
+  struct vector *blocks;     /* Vector of `ir_block`, entry first */
+  size_t num_values;
+};
+
+struct ir_program {
+  struct ir_function *main;
+  struct vector *functions; /* Vector of `ir_function`, main included */
+  /* A 'break' outside of a loop, which the evaluator does not ignore: it skips
+   * the rest of the enclosing blocks, up to a loop of the caller */
+  bool has_stray_break;
+};
+
+/* Lowering state */
+struct ir_loop {
+  struct ir_block *exit;
+  size_t scope_depth; /* Scopes to keep on 'break' */
+};
+
+struct ir_builder {
+  struct ir_program *program;
+  struct ir_function *function;
+  struct ir_block *block; /* NULL once a 'return' or 'break' was lowered */
+  struct ir_loop *loop;
+  size_t scope_depth;
+  /* Name -> `ast_node` of the function mentioning it, the program's being
+   * `ir_builder.program`, or `shared_name` if several do */
+  struct hash_table *owners;
+  /* Promoted names of the current function */
+  struct hash_table *promoted;
+  /* Vector of hash tables, promoted names lexically in scope */
+  struct vector *scopes;
+  struct hash_table *saved; /* Id of a saved subexpression -> `ir_value` */
+};
+
+struct ir_program *lower_program_to_ir(struct vector *program);
+bool ir_is_terminator(enum ir_opcode opcode);
+bool ir_has_result(enum ir_opcode opcode);
+const char *get_string_from_ir_type(enum ir_type type);
+
+/* Checks the invariants above, see "ir_verifier.c" */
+struct result *verify_ir(struct ir_program *program);
+
+/* Textual form, see "ir_printer.c" */
+struct string_builder *print_ir(struct ir_program *program);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LICM_H
+#define LICM_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Loop-invariant code motion, run after "bce.h" and before "cse.h" among the
+ * -O1 passes (see "optimizer.h"). Expressions inside a 'while' or 'for' loop
+ * whose value can not change while the loop runs are wrapped in an
+ * `INVARIANT_PRIMARY_NODE`. Its value is computed the first time it is needed
+ * after the loop starts, and reused by every later iteration. Being computed
+ * lazily rather than before the loop, a hoisted expression which fails, or
+ * would never have been evaluated, behaves just like it did.
+ *
+ * Binary operations, array indexing and `.len()` on operands which are not
+ * assigned nor declared in the loop are hoisted, out of the outermost loop
+ * they are invariant in. Loops which call user functions, which could assign
+ * the program's variables and those they captured, are left alone. Array
+ * indexing also requires the loop to not change any array, and `.len()` to
+ * not `.add()` nor `.pop()`.
+ */
+
+struct licm_loop {
+  struct ast_node *node;
+  struct hash_table *written_names; /* Names assigned or declared */
+  bool has_side_effects; /* Calls user functions or uses unary operators */
+  bool resizes_arrays;   /* Calls `.add()`, `.pop()` or unknown methods */
+  bool stores_elements;  /* Assigns to an array element */
+};
+
+struct licm {
+  struct hash_table *declared_names; /* Names declared by the program */
+  struct vector *loops; /* Enclosing loops of the current function */
+  size_t num_invariants;
+};
+
+void hoist_loop_invariants(struct vector *program);
+/* Also used by "cse.h" and "bce.h" */
+bool is_builtin_callee(struct hash_table *declared_names,
+                       struct ast_node *callee);
+bool is_len_call(struct ast_node *method_call);
+/* Records what `stmt` may change into `loop`, whose `node` is not used */
+void scan_loop_statement(struct hash_table *declared_names,
+                         struct licm_loop *loop, struct ast_node *stmt);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "interpreter.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Memoization of pure functions, unless `--no-memoize` is given. A function
+ * defined at the top level of the program is pure when its result only
+ * depends on its arguments, and calling it has no effect besides its result:
+ *
+ *   - Every name it reads or assigns is one of its parameters or of its own
+ *     variables, declared before in an enclosing block, since anything else
+ *     resolves in the program's environment and can change between calls.
+ *   - It calls no function but pure ones, by the name of their definition,
+ *     and so neither `print()` nor a function it was passed.
+ *   - It does not assign array elements, nor call `.add()` or `.pop()`.
+ *   - It does not define functions, nor 'break' outside of its own loops.
+ *
+ * Names of functions are trusted only if nothing else in the program is
+ * declared or assigned under the same name. Purity is proven optimistically,
+ * so that recursive functions qualify.
+ *
+ * Calls to a pure function whose arguments are all integers or booleans look
+ * the arguments up in a cache of `MEMO_CACHE_SIZE` results owned by the
+ * function, direct-mapped on a hash of the arguments, and only run the body
+ * on a miss. Results other than integers and booleans are not cached, and
+ * cached results are copied out, so that callers never share them.
+ * `--memo-stats` prints the hits and misses of all caches on exit.
+ */
+
+#define MEMO_CACHE_SIZE 1024
+#define MEMO_MAX_ARGUMENTS 4
+
+struct memo_key {
+  size_t num_arguments;
+  enum object_type types[MEMO_MAX_ARGUMENTS];
+  long values[MEMO_MAX_ARGUMENTS];
+  size_t hash;
+};
+
+struct memo_entry {
+  bool is_used;
+  struct memo_key key;
+  struct object result;
+};
+
+struct memo_cache {
+  struct memo_entry entries[MEMO_CACHE_SIZE];
+};
+
+struct memo_stats {
+  size_t hits;
+  size_t misses;
+};
+
+struct purity {
+  struct hash_table *assigned_names;
+  struct hash_table *redeclared_names;
+  /* Name -> FN_DEF_STMT node, functions defined once at the top level */
+  struct hash_table *functions;
+  /* Function being checked */
+  struct vector *scopes; /* Vector of hash tables of its names */
+  size_t loop_depth;
+  bool is_pure;
+};
+
+/* Sets `is_pure` on the function definitions of `program`, see above */
+void mark_pure_functions(struct vector *program);
+
+struct memo_cache *memo_cache_init();
+
+void memo_key_init(struct memo_key *key);
+/* Adds an argument to `key`. Returns false if the call cannot be cached. */
+bool memo_key_add(struct memo_key *key, struct object *argument);
+/* Returns a copy of the result cached for `key`, or NULL */
+struct object *memo_lookup(struct function *function, struct memo_key *key);
+void memo_store(struct function *function, struct memo_key *key,
+                struct object *result);
+
+struct memo_stats memo_get_stats();
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+#include "hash_table.h"
+#include "vector.h"
+#include <stdbool.h>
+
+/*
+ * AST optimization passes, run between `parse_program` and evaluation. The
+ * passes rewrite the AST in place, and the result behaves exactly like the
+ * original program, runtime errors included. `-O0` disables them.
+ *
+ * -O1:
+ *   - Function inlining of small functions, see "inliner.h".
+ *   - Scalar replacement of arrays which do not escape, see "escape.h".
+ *   - Constant folding: operators whose operands are literals are evaluated
+ *     once, with the interpreter's own semantics. Operations which would fail
+ *     at runtime, and divisions by zero, are left in place.
+ *   - Constant propagation: a `let` initialized with a literal, whose name is
+ *     never the target of an assignment, is replaced by the literal where it
+ *     is lexically visible. Function bodies are not entered, since they may
+ *     run before the `let`.
+ *   - `if (true)` and `if (false)` are replaced by the branch they take.
+ *   - Dead code elimination: statements following a 'return' (or a 'break'
+ *     inside of a loop) are dropped, as well as expression statements which
+ *     have no effect and definitions of functions which are never referenced.
+ *   - Bounds-check elimination in counted loops, see "bce.h".
+ *   - Loop-invariant code motion, see "licm.h".
+ *   - Common subexpression elimination, see "cse.h".
+ *   - Type inference, see "type_inference.h".
+ */
+
+#define OPTIMIZATION_LEVEL_DEFAULT 1
+
+struct optimizer {
+  struct hash_table *assigned_names;   /* Names which are not constant */
+  struct hash_table *redeclared_names; /* Names declared more than once */
+  struct hash_table *live_names;       /* Names which may be referenced */
+  struct vector *scopes; /* Vector of hash tables, name -> literal node */
+  size_t loop_depth;     /* Loops around the statement, in its function */
+};
+
+struct name_collector {
+  struct hash_table *names;
+  struct hash_table *declared_names;
+  struct hash_table *redeclared_names;
+  /* Set when collecting references: function definitions are gathered here
+   * instead of being entered */
+  struct vector *fn_defs;
+};
+
+/* Collects the names which are assigned to and declared in `program` */
+void collect_names(struct name_collector *collector, struct vector *program);
+void optimize_program(struct vector *program, int optimization_level);
+/* Same, for a program whose environment outlives it, the prelude of an image
+ * (see "image.h"): code the passes never see can reference its names, and
+ * assign them. Calls are not inlined, arrays are not replaced by scalars, and
+ * functions defined at the top level are kept. */
+void optimize_open_program(struct vector *program, int optimization_level);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Slab pools for the structures the runtime allocates by the million: one
+ * pool per type, each handing out slots of a single size class (the size of
+ * the type rounded up to `POOL_ALIGNMENT`). A pool carves its slots out of
+ * slabs of `POOL_SLAB_SIZE` bytes, so that objects of the same type sit next
+ * to each other, and keeps the slots given back in a free list threaded
+ * through them. Allocating pops the free list or bumps a pointer into the
+ * current slab; only a fresh slab goes through malloc.
+ *
+ * The pools are thread-local, and need no locking: a slot must be freed on
+ * the thread which allocated it. Slabs are never returned to the system.
+ * `jix --pool-stats` prints the statistics of every pool on exit.
+ */
+
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_ALIGNMENT 8 /* Every pooled type holds pointers or longs */
+
+enum pool_type {
+  POOL_OBJECT,      /* struct object */
+  POOL_RESULT,      /* struct result */
+  POOL_ENVIRONMENT, /* struct environment, outside of the call stack */
+  POOL_HASH_TABLE,  /* struct hash_table, its entries are malloc'd */
+  POOL_VECTOR,      /* struct vector, its buffer is malloc'd */
+  NUM_POOLS,
+};
+
+struct pool_slot {
+  struct pool_slot *next; /* Next free slot */
+};
+
+struct pool_slab {
+  struct pool_slab *next;
+  char slots[];
+};
+
+struct pool {
+  const char *name;
+  size_t object_size; /* Size of the type */
+  size_t slot_size;   /* Size class the type rounds up to */
+  struct pool_slot *free_list;
+  char *bump;     /* Next slot never handed out in the newest slab */
+  char *bump_end; /* End of the newest slab */
+  struct pool_slab *slabs;
+  size_t num_slabs;
+  size_t live;       /* Slots handed out and not freed */
+  size_t high_water; /* Most slots ever live at once */
+};
+
+struct pool_stats {
+  const char *name;
+  size_t live;
+  size_t high_water;
+  size_t reserved_bytes; /* Slabs, headers included */
+  /* Reserved bytes which hold no live object: free slots, the rounding of
+   * each slot to its size class, and the unused tails of the slabs */
+  size_t wasted_bytes;
+};
+
+void *pool_alloc(enum pool_type type);
+void pool_free(enum pool_type type, void *ptr);
+struct pool_stats pool_get_stats(enum pool_type type);
+void pool_print_stats(FILE *out);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "ast.h"
+#include "interpreter.h"
+#include "trace.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Persistent profile of a script, kept next to it as `script.jix.prof` when
+ * running with `jix --profile`. Every run adds its counters to the file, and
+ * the next run starts out with what was learned so far:
+ *   - Loops which got a trace compiled are traced from their first iteration,
+ *     and loops whose trace was thrown away are never traced again.
+ *   - Binary operations which only ever saw integers take a specialized path.
+ * Branch biases, call-site counts and function call counts are recorded for
+ * the same sites. The profile is discarded when the script source changes.
+ */
+
+#define PROFILE_FILE_EXTENSION ".prof"
+#define PROFILE_FORMAT_VERSION 1
+
+enum profile_site_kind {
+  PROFILE_SITE_LOOP,      /* 'while' and 'for' statements */
+  PROFILE_SITE_BRANCH,    /* 'if' statements */
+  PROFILE_SITE_BINARY_OP, /* Binary nodes */
+  PROFILE_SITE_CALL,      /* Function call nodes */
+  PROFILE_SITE_FUNCTION,  /* Bodies of function definitions */
+};
+
+struct profile_site {
+  enum profile_site_kind kind;
+  struct ast_node *node;
+  size_t count; /* Loop entries, branches, operations or calls interpreted */
+  size_t taken; /* Branches which went into the 'if' block */
+  unsigned lhs_types; /* Bitmask of `1 << object_type` seen on either side */
+  unsigned rhs_types;
+  enum trace_status trace_status;
+  bool is_int_specialized; /* Only ever saw two integers */
+};
+
+struct profile {
+  char *file_path;
+  unsigned long source_hash;
+  struct vector *sites; /* Vector of `profile_site*`, in AST order */
+};
+
+struct profile *profile_load(struct vector *program, const char *script_path,
+                             const char *source);
+void profile_save(struct profile *profile);
+void profile_record_binary_op(struct profile_site *site, struct object *lhs,
+                              struct object *rhs);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "ast.h"
+#include "interpreter.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Number of interpreted iterations after which a loop is considered hot and
+ * gets a trace recorded for it. */
+#define TRACE_HOT_LOOP_THRESHOLD 8
+/* A trace which fails its guards more often than it completes iterations is
+ * thrown away, and the loop is left to the interpreter from then on. */
+#define TRACE_MAX_SIDE_EXITS 64
+#define TRACE_INITIAL_CAPACITY 16
+/* Copies of the body a counted trace runs between two checks of its trip
+ * count, see `trace_optimize`. */
+#define TRACE_UNROLL_FACTOR 4
+
+enum trace_status {
+  TRACE_UNRECORDED,
+  TRACE_COMPILED,
+  TRACE_BLACKLISTED,
+};
+
+enum trace_exit {
+  TRACE_EXIT_SIDE,     /* Interpreter must run the next iteration */
+  TRACE_EXIT_BREAK,    /* A 'break' statement left the loop */
+  TRACE_EXIT_LOOP_END, /* The loop condition became false */
+};
+
+enum trace_opcode {
+  TRACE_LOAD_CONST, /* regs[dst] = imm */
+  TRACE_MOVE,       /* regs[dst] = regs[lhs] */
+  TRACE_ADD,
+  TRACE_SUB,
+  TRACE_MUL,
+  TRACE_DIV,
+  TRACE_LESS,
+  TRACE_LESS_EQUAL,
+  TRACE_GREATER,
+  TRACE_GREATER_EQUAL,
+  TRACE_EQUAL,
+  TRACE_NOT_EQUAL,
+  TRACE_AND,
+  TRACE_OR,
+  TRACE_NEGATE,
+  TRACE_NOT,
+  TRACE_GUARD_TRUE,    /* Side exit unless regs[lhs] */
+  TRACE_GUARD_FALSE,   /* Side exit if regs[lhs] */
+  TRACE_GUARD_NONZERO, /* Side exit if regs[lhs] == 0 */
+  TRACE_BREAK,         /* Leave the loop */
+  TRACE_LOOP,          /* Next iteration if regs[lhs], else leave the loop */
+};
+
+struct trace_op {
+  enum trace_opcode opcode;
+  size_t dst;
+  size_t lhs;
+  size_t rhs;
+  long imm;
+};
+
+/* A variable which lives outside of the loop body. It is loaded into its
+ * register on trace entry and written back to its environment on exit. */
+struct trace_variable {
+  char *id;
+  size_t reg;
+  enum object_type type; /* Observed type, guarded on trace entry */
+  bool is_written;
+};
+
+struct trace {
+  enum trace_status status;
+  size_t hot_count;
+  size_t side_exits;
+  size_t iterations; /* Iterations completed inside the trace */
+  struct trace_variable *variables;
+  size_t num_variables;
+  struct trace_op *ops;
+  size_t num_ops;
+  size_t ops_capacity;
+  long *registers;
+  long *snapshot; /* Variable registers at the start of the iteration */
+  size_t num_registers;
+  struct trace_op *prologue; /* Run on trace entry, after the loads */
+  size_t num_prologue_ops;
+  /* Counted traces, see `trace_optimize` */
+  bool is_counted;
+  enum trace_opcode counter_compare; /* `counter_reg <op> bound_reg` */
+  size_t counter_reg;
+  size_t bound_reg;
+  long counter_step;
+  struct trace_op *unrolled_ops; /* `TRACE_UNROLL_FACTOR` copies of the body */
+  size_t num_body_ops;
+};
+
+struct trace *trace_init();
+void trace_free(struct trace *trace);
+
+/*
+ * Called by the interpreter at the top of every iteration of a 'while' or
+ * 'for' loop, after the loop condition was found to be true. Once the loop is
+ * hot, the operations of one iteration are recorded, along with the observed
+ * types of the variables they touch, into a linear trace. Branches become
+ * guards on the direction seen while recording. The trace is then run for as
+ * many iterations as it can, keeping the loop-carried variables in registers.
+ * Returns TRACE_EXIT_SIDE if the interpreter has to run the next iteration
+ * itself, in which case the environment reflects the start of that iteration.
+ */
+enum trace_exit trace_run_loop(struct trace **trace_slot,
+                               struct ast_node *loop_node,
+                               struct interpreter_state *state);
+
+/*
+ * Rewrites a freshly recorded trace around its induction variables: loop
+ * variables whose only update is `i = i + c` or `i = i - c`, with `c` a
+ * constant. A product `i * s` of such a variable with a loop invariant (a
+ * constant, or a variable the trace never writes) becomes a register of its
+ * own, computed once in the prologue and stepped by `c * s` next to `i`, so
+ * the multiplication turns into an addition:
+ *
+ *   t = i * s                         prologue: d = i * s, k = c * s
+ *   ...                        =>     ...
+ *   i = i + c                         i = i + c; d = d + k
+ *
+ * A trace without guards nor 'break' which ends on `i < n`, `i <= n`, `i > n`
+ * or `i >= n`, with `i` stepping towards the invariant `n`, is counted: its
+ * trip count follows from `i` and `n` on entry, and it runs that many times
+ * without checking the condition, `TRACE_UNROLL_FACTOR` copies of the body
+ * at a time, nor taking snapshots, since nothing can make it leave early.
+ */
+void trace_optimize(struct trace *trace);
+
+/* Loops of every program run by the process, printed by `--trace-stats` */
+struct trace_stats {
+  size_t compiled;    /* Traces recorded */
+  size_t blacklisted; /* Loops left to the interpreter */
+  size_t reduced;     /* Products turned into additions, see `trace_optimize` */
+  size_t counted;     /* Counted traces */
+};
+
+struct trace_stats trace_get_stats();
+
+/* Seeds the trace of a loop with its status from a previous run, see
+ * "profile.h". A loop which was compiled gets recorded on its first
+ * iteration, and a blacklisted one is never recorded. */
+void trace_prewarm(struct trace **trace_slot, enum trace_status status);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef TYPE_INFERENCE_H
+#define TYPE_INFERENCE_H
+
+#include "ast.h"
+#include "ir.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Flow-sensitive type inference over the SSA form of "ir.h", the last of the
+ * -O1 passes (see "optimizer.h"). The program and every function body are
+ * lowered, and the type of each value is propagated forward from literals,
+ * operators and `.len()`, through the phi nodes of promoted variables until
+ * it settles. A phi whose operands disagree, and values read from the
+ * environment, parameters, calls or array elements, stay unknown.
+ *
+ * A type holds for the values an operation gives when it succeeds: `a - b`
+ * is an integer, since it fails otherwise.
+ *
+ * Binary operators on integers whose operands are both proven integers are
+ * marked `is_int_typed`, and the evaluator, the stack VM and `--emit-c` run
+ * them without checking the types of their operands. Every other operation
+ * keeps its checks and runtime errors. Nothing is marked when the program
+ * has a 'break' outside of a loop, which makes the evaluator skip statements
+ * the IR does not know about.
+ */
+
+struct type_inference {
+  struct ir_function *function;
+  bool *is_inferred; /* Value id -> its type is known, or proven unknown */
+  bool is_changed;
+};
+
+void infer_types(struct ir_program *program);
+
+/* Lowers `program` and marks its binary operations, see above */
+void infer_program_types(struct vector *program);
+
+/* Binary operators `eval_int_binary_operation` implements */
+bool is_int_binary_operator(enum token_type op);
+
+#endif
@@ -14,10 +14,30 @@
 #define BUFFER_SIZE 10240
 #define IDENTIFIER_BUFFER_SIZE 50
 
+struct pipeline_options {
+  bool use_profile; /* `--profile`, see "profile.h" */
+  bool stackless;   /* `--stackless`, see "vm.h" */
+  size_t stack_limit;
+  int optimization_level; /* `-O0` or `-O1`, see "optimizer.h" */
+  bool no_memoize;        /* `--no-memoize`, see "memo.h" */
+  const char *image;      /* `--image`, NULL for none, see "image.h" */
+};
+
 char *read_file(const char *file_path);
 char *create_token_string_copy(const char *char_ptr, size_t start_index,
                                size_t current_index);
 struct object *interpreter_pipeline(const char *file_name);
+struct object *
+interpreter_pipeline_with_options(const char *file_name,
+                                  struct pipeline_options *options);
+/* Runs the script, then writes the program's environment to `image_name`,
+ * see "image.h". Returns false if either fails. */
+bool snapshot_pipeline(const char *file_name, const char *image_name,
+                       struct pipeline_options *options);
+char *emit_c_pipeline(const char *file_name,
+                      struct pipeline_options *options);
+struct ir_program *ir_pipeline(const char *file_name,
+                               struct pipeline_options *options);
 void print_ast_pipeline(const char *file_name);
 const char *convert_object_to_string(struct object *obj);
 char *format_string(const char *format, ...);
@@ -0,0 +1,120 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ast.h"
+#include "interpreter.h"
+#include "memo.h"
+#include "tokens.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Stackless evaluator, used with `jix --stackless`. The program and every
+ * function body are compiled to a flat list of instructions for a stack
+ * machine, and Jix calls push a `vm_frame` on an explicit frame stack instead
+ * of recursing through the C stack. Recursion depth is then only limited by
+ * the memory cap of the frame and operand stacks (`--stack-limit=<MiB>`).
+ *
+ * Scoping, evaluation order and error messages mirror the tree-walking
+ * interpreter. A 'break' only leaves the loop it lexically appears in.
+ */
+
+#define VM_DEFAULT_STACK_LIMIT (64 * 1024 * 1024)
+#define VM_INITIAL_CAPACITY 64
+
+enum vm_opcode {
+  VM_PUSH_LITERAL,      /* node: number, string, boolean or nil literal */
+  VM_PUSH_NULL,         /* Value of calls which don't return anything */
+  VM_POP,
+  VM_LOAD,              /* string: identifier */
+  VM_CHECK_UNDECLARED,  /* string: identifier */
+  VM_DECLARE,           /* string: identifier */
+  VM_CHECK_ASSIGNABLE,  /* string: identifier */
+  VM_ASSIGN,            /* string: identifier */
+  VM_DEF_FN,            /* node: function definition, chunk: its body */
+  VM_BINARY,            /* op */
+  VM_INT_BINARY,        /* op, on operands proven integers */
+  VM_UNARY,             /* op */
+  VM_JUMP,              /* operand: target */
+  VM_JUMP_IF_FALSE,     /* operand: target, string: error if not a boolean */
+  VM_TRACE_LOOP,        /* node: loop, operand: target once the loop is done */
+  VM_PUSH_SCOPE,
+  VM_POP_SCOPE,
+  VM_SET_LINES,         /* operand: start line, end_line */
+  VM_CHECK_CALLABLE,    /* operand: argument count */
+  VM_CALL,              /* operand: argument count */
+  VM_RETURN,
+  VM_TAIL_CALL,         /* operand: argument count, see `return f(...)` */
+  VM_END,               /* End of a body, returns nothing */
+  VM_ARRAY_NEW,         /* operand: number of elements */
+  VM_ARRAY_PUSH,        /* Pops the value, keeps the array */
+  VM_CHECK_ARRAY,       /* string: error if not an array */
+  VM_ARRAY_INDEX,
+  VM_ARRAY_LOAD,        /* Index proven within the array, see "bce.h" */
+  VM_CHECK_ARRAY_STORE,
+  VM_ARRAY_STORE,
+  VM_ARRAY_LEN,
+  VM_CHECK_ARRAY_POP,
+  VM_ARRAY_POP,         /* operand: 1 if an index was given */
+  VM_FAIL,              /* string: error message */
+  VM_LOAD_INVARIANT,    /* node: invariant, operand: target if cached */
+  VM_STORE_INVARIANT,   /* node: invariant, keeps the value */
+  VM_RESET_INVARIANTS,  /* node: loop */
+  VM_STORE_SAVED,       /* node: saved subexpression, keeps the value */
+  VM_LOAD_SAVED,        /* node: saved subexpression */
+};
+
+struct vm_instruction {
+  enum vm_opcode opcode;
+  enum token_type op;
+  long number;
+  char *string;
+  size_t operand;
+  size_t end_line;
+  struct ast_node *node;
+  struct vm_chunk *chunk;
+};
+
+struct vm_chunk {
+  struct vm_instruction *code;
+  size_t size;
+  size_t capacity;
+};
+
+struct vm_frame {
+  struct vm_chunk *chunk;
+  size_t pc;
+  struct function *function; /* NULL for the program */
+  struct environment *fn_env;
+  struct environment *env; /* Caller's environment, restored on return */
+  /* Top of the call stack when called, with the frames of the callee above */
+  struct call_stack_mark call_stack;
+  size_t stack_base; /* Operand stack slot of the callee */
+  /* Function whose result is cached under `memo_key` on return, see
+   * "memo.h" */
+  struct function *memoized;
+  struct memo_key memo_key;
+};
+
+struct vm {
+  struct interpreter_state *state;
+  struct vm_frame *frames;
+  size_t num_frames;
+  size_t frames_capacity;
+  struct object **stack;
+  size_t stack_size;
+  size_t stack_capacity;
+  size_t stack_limit; /* In bytes, for both stacks together */
+};
+
+struct vm_chunk *vm_compile_program(struct vector *program);
+struct result *vm_run(struct vm_chunk *program, struct interpreter_state *state,
+                      size_t stack_limit);
+struct object *vm_interpret(struct vector *program, size_t stack_limit);
+/* Runs `program` in `globals`, see `interpret_in` */
+struct object *vm_interpret_in(struct vector *program,
+                               struct environment *globals,
+                               size_t stack_limit);
+
+#endif
@@ -0,0 +1,301 @@
+#include "aot_runtime.h"
+#include "builtin_functions.h"
+#include "closure.h"
+#include "errors.h"
+#include "interpreter.h"
+#include "memo.h"
+#include "pool.h"
+#include "utils.h"
+#include "vector.h"
+
+int aot_run(aot_native_fn program) {
+  struct interpreter_state state = {.env = environment_init(),
+                                    .builtin_fns =
+                                        init_and_register_builtin_fns()};
+  state.globals = state.env;
+  struct object *interpreter_value = program(&state);
+  if (!interpreter_value) {
+    printf("Interpreter doesn't return a value.\n");
+  } else {
+    printf("Return: %li\n", interpreter_value->int_value);
+  }
+  return 0;
+}
+
+void aot_set_lines(struct interpreter_state *state, size_t start_line,
+                   size_t end_line) {
+  state->current_stmt_lines.start_line = start_line;
+  state->current_stmt_lines.end_line = end_line;
+}
+
+void aot_fail(struct interpreter_state *state, char *error_message) {
+  interpreter_raise(state, error_message);
+}
+
+struct object *aot_int(long value) { return object_int(value); }
+
+struct object *aot_bool(bool value) { return object_bool(value); }
+
+struct object *aot_string(struct object **literal, const char *chars,
+                          size_t length) {
+  if (!*literal) {
+    *literal = pool_alloc(POOL_OBJECT);
+    (*literal)->data_type = STRING_VALUE;
+    (*literal)->string_value = string_init(chars, length);
+  }
+  return *literal;
+}
+
+struct object *aot_nil() { return object_nil(); }
+
+struct object *aot_lookup(struct interpreter_state *state, char *id) {
+  struct object *symbol_lookup = environment_lookup_symbol(state->env, id);
+  if (symbol_lookup) {
+    return symbol_lookup;
+  }
+  struct builtin_fn *builtin_function =
+      lookup_builtin_fns(state->builtin_fns, id);
+  if (builtin_function == NULL) {
+    aot_fail(state, format_string("Identifier '%s' does not exist", id));
+  }
+  struct object *returner = pool_alloc(POOL_OBJECT);
+  returner->data_type = FUNCTION_VALUE;
+  returner->is_builtin = true;
+  returner->function_value.builtin_function = builtin_function;
+  return returner;
+}
+
+void aot_check_undeclared(struct interpreter_state *state, char *id) {
+  if (environment_lookup_symbol_current_env(state->env, id)) {
+    char *error_message =
+        format_string("Variable '%s' already exists in current scope", id);
+    aot_fail(state, error_message);
+  }
+}
+
+void aot_declare(struct interpreter_state *state, char *id,
+                 struct object *value) {
+  environment_insert_symbol(state->env, id, value);
+}
+
+void aot_check_assignable(struct interpreter_state *state, char *id) {
+  if (environment_lookup_symbol(state->env, id) == NULL) {
+    aot_fail(state, format_string("Variable '%s' does not exist", id));
+  }
+}
+
+void aot_assign(struct interpreter_state *state, char *id,
+                struct object *value) {
+  environment_reassign_symbol(state->env, id, value);
+}
+
+void aot_define_fn(struct interpreter_state *state, char *id,
+                   char **parameters, size_t num_parameters,
+                   char **free_names, size_t num_free_names,
+                   aot_native_fn body, bool is_pure) {
+  if (environment_lookup_symbol_current_env(state->env, id)) {
+    char *error_message =
+        format_string("Function '%s' already exists in current scope", id);
+    aot_fail(state, error_message);
+  }
+  struct function *fn_stmt = malloc(sizeof(struct function));
+  fn_stmt->id = id;
+  fn_stmt->body = NULL;
+  fn_stmt->parameters = vector_init();
+  for (size_t i = 0; i < num_parameters; i++) {
+    vector_push_back(fn_stmt->parameters, parameters[i]);
+  }
+  fn_stmt->native_body = body;
+  fn_stmt->chunk = NULL;
+  fn_stmt->memo = is_pure ? memo_cache_init() : NULL;
+  struct object *fn_stmt_value = pool_alloc(POOL_OBJECT);
+  fn_stmt_value->data_type = FUNCTION_VALUE;
+  fn_stmt_value->is_builtin = false;
+  fn_stmt_value->function_value.function_value = fn_stmt;
+  environment_insert_symbol(state->env, id, fn_stmt_value);
+  struct vector *free_name_vector = vector_init();
+  for (size_t i = 0; i < num_free_names; i++) {
+    vector_push_back(free_name_vector, free_names[i]);
+  }
+  closure_capture(state, fn_stmt, free_name_vector);
+  vector_free(free_name_vector);
+}
+
+void aot_push_scope(struct interpreter_state *state) {
+  state->env = environment_init_enclosed(state->env);
+}
+
+void aot_pop_scopes(struct interpreter_state *state, struct environment *env) {
+  environment_leave_scopes(state, env);
+}
+
+bool aot_condition(struct interpreter_state *state, struct object *value,
+                   bool check_type, const char *error_message) {
+  if (check_type && value->data_type != BOOLEAN_VALUE) {
+    aot_fail(state, strdup(error_message));
+  }
+  return value->bool_value;
+}
+
+struct object *aot_binary(struct interpreter_state *state, enum token_type op,
+                          struct object *lhs, struct object *rhs) {
+  return eval_binary_operation(op, lhs, rhs, state);
+}
+
+struct object *aot_unary(struct interpreter_state *state, enum token_type op,
+                         struct object *operand) {
+  return eval_unary_operation(op, operand, state);
+}
+
+void aot_check_callable(struct interpreter_state *state, struct object *callee,
+                        size_t num_args) {
+  if (callee->data_type != FUNCTION_VALUE) {
+    aot_fail(state, strdup("Function calls can only be performed on callable"));
+  }
+  if (!callee->is_builtin) {
+    check_arity(callee->function_value.function_value, num_args, state);
+    return;
+  }
+  struct builtin_fn *builtin_function = callee->function_value.builtin_function;
+  if (builtin_function->num_parameters != num_args) {
+    aot_fail(state, format_string("Function '%s' takes %ld, gut given %ld",
+                                  builtin_function->fn_name,
+                                  builtin_function->num_parameters, num_args));
+  }
+}
+
+/* Set by `aot_tail_call`, and run by `aot_call` once the body which made the
+ * call has returned */
+static struct {
+  bool is_pending;
+  struct function *function;
+  struct object **args;
+  size_t num_args;
+} pending_tail_call;
+
+struct object *aot_call(struct interpreter_state *state, struct object *callee,
+                        struct object **args, size_t num_args) {
+  if (callee->is_builtin) {
+    void *(*fn_ptr)(void *) = callee->function_value.builtin_function->fn_ptr;
+    fn_ptr(args[0]);
+    return NULL;
+  }
+  struct function *function = callee->function_value.function_value;
+  struct memo_key memo_key;
+  bool is_memoized =
+      function->memo != NULL && num_args == function->parameters->size;
+  memo_key_init(&memo_key);
+  for (size_t i = 0; i < num_args && is_memoized; i++) {
+    is_memoized = memo_key_add(&memo_key, args[i]);
+  }
+  struct object *cached =
+      is_memoized ? memo_lookup(function, &memo_key) : NULL;
+  if (cached) {
+    return cached;
+  }
+  struct function *memoized = function;
+  struct environment *parent_env = state->env;
+  struct call_stack_mark mark = call_stack_mark(state);
+  struct environment *fn_call_env = environment_init_frame(state, function);
+  memcpy(fn_call_env->arguments, args, sizeof(struct object *) * num_args);
+  struct object *returner;
+  for (;;) {
+    state->env = fn_call_env;
+    returner = function->native_body(state);
+    /* A `return` leaves the blocks of the body without popping them */
+    environment_leave_scopes(state, fn_call_env);
+    if (!pending_tail_call.is_pending) {
+      break;
+    }
+    pending_tail_call.is_pending = false;
+    struct function *tail_function = pending_tail_call.function;
+    if (tail_function != function) {
+      /* Released with this call */
+      fn_call_env = environment_init_frame(state, tail_function);
+    }
+    memcpy(fn_call_env->arguments, pending_tail_call.args,
+           sizeof(struct object *) * pending_tail_call.num_args);
+    free(pending_tail_call.args);
+    function = tail_function;
+  }
+  state->env = parent_env;
+  call_stack_release(state, mark);
+  if (is_memoized) {
+    memo_store(memoized, &memo_key, returner);
+  }
+  return returner;
+}
+
+struct object *aot_tail_call(struct interpreter_state *state,
+                             struct object *callee, struct object **args,
+                             size_t num_args) {
+  if (callee->is_builtin) {
+    return aot_call(state, callee, args, num_args);
+  }
+  pending_tail_call.is_pending = true;
+  pending_tail_call.function = callee->function_value.function_value;
+  pending_tail_call.args = malloc(sizeof(struct object *) * num_args);
+  memcpy(pending_tail_call.args, args, sizeof(struct object *) * num_args);
+  pending_tail_call.num_args = num_args;
+  return NULL;
+}
+
+struct object *aot_array_new(size_t capacity) {
+  struct object *array_obj = pool_alloc(POOL_OBJECT);
+  array_obj->data_type = ARRAY_VALUE;
+  array_obj->array_value = array_init(capacity);
+  array_obj->is_in_image = false;
+  return array_obj;
+}
+
+void aot_array_push(struct object *array, struct object *value) {
+  array_push(array, value);
+}
+
+void aot_check_array(struct interpreter_state *state, struct object *value,
+                     const char *error_message) {
+  if (value->data_type != ARRAY_VALUE) {
+    aot_fail(state, strdup(error_message));
+  }
+}
+
+struct object *aot_array_index(struct interpreter_state *state,
+                               struct object *array, struct object *index) {
+  return eval_array_index_operation(array, index, state);
+}
+
+struct object *aot_array_load(struct object *array, struct object *index) {
+  return array->array_value->items[index->int_value];
+}
+
+void aot_check_array_store(struct interpreter_state *state,
+                           struct object *array, struct object *index) {
+  if (index->data_type != INT_VALUE) {
+    aot_fail(state,
+             strdup("Variable array assignment index must be an integer"));
+  }
+  if (index->int_value < 0 || index->int_value >= array->array_value->size) {
+    aot_fail(state, strdup("Index out of bound"));
+  }
+}
+
+void aot_array_store(struct object *array, struct object *index,
+                     struct object *value) {
+  array->array_value->items[index->int_value] = value;
+}
+
+struct object *aot_array_len(struct object *array) {
+  return aot_int(array->array_value->size);
+}
+
+void aot_check_array_pop(struct interpreter_state *state,
+                         struct object *array) {
+  if (array->array_value->size <= 0) {
+    aot_fail(state, strdup("Calling .pop() on an empty array"));
+  }
+}
+
+struct object *aot_array_pop(struct interpreter_state *state,
+                             struct object *array, struct object *index) {
+  return eval_array_pop_operation(array, index, state);
+}
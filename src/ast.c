@@ -52,5 +52,11 @@ get_string_from_primary_ast_node_type(enum ast_primary_node_type node_type) {
     return "Array creation";
   case ARRAY_ACCESS_PRIMARY_NODE:
     return "Array creation";
+  case INVARIANT_PRIMARY_NODE:
+    return "Loop invariant";
+  case SAVED_PRIMARY_NODE:
+    return "Saved subexpression";
+  case REUSED_PRIMARY_NODE:
+    return "Reused subexpression";
   }
 }
@@ -3,6 +3,7 @@
 #include "string_builder.h"
 #include "tokens.h"
 #include "errors.h"
+#include "interpreter.h"
 
 struct string_builder *print_ast(struct vector *program) {
   struct string_builder *str = string_builder_init();
@@ -210,7 +211,7 @@ void print_primary_expression(struct result *node,
   }
   case STRING_PRIMARY_NODE: {
     string_builder_append(str, "\"");
-    string_builder_append(str, escape_special_characters(node->node->string));
+    string_builder_append(str, escape_special_characters(node->node->string->chars));
     string_builder_append(str, "\"");
     break;
   }
@@ -266,6 +267,18 @@ void print_primary_expression(struct result *node,
     string_builder_append(str, " ] ");
     break;
   }
+  case INVARIANT_PRIMARY_NODE: {
+    print_expression(node->node->invariant.expr, str);
+    break;
+  }
+  case SAVED_PRIMARY_NODE: {
+    print_expression(node->node->saved.expr, str);
+    break;
+  }
+  case REUSED_PRIMARY_NODE: {
+    print_expression(node->node->reused->saved.expr, str);
+    break;
+  }
   }
 }
 
@@ -0,0 +1,223 @@
+#include "bce.h"
+#include "ast.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "licm.h"
+#include "optimizer.h"
+#include "tokens.h"
+#include "vector.h"
+#include <string.h>
+
+static void check_statement(struct bce *bce, struct ast_node *stmt);
+static void check_expression(struct bce *bce, struct ast_node *expr);
+
+static bool is_identifier(struct ast_node *expr) {
+  return expr->node_type == PRIMARY_NODE &&
+         expr->primary_node_type == IDENTIFIER_PRIMARY_NODE;
+}
+
+static bool is_named(struct ast_node *expr, char *id) {
+  return is_identifier(expr) && strcmp(expr->id, id) == 0;
+}
+
+/* Fills `loop` if `stmt` is `for (let i = <n>; i < a.len(); i = i + 1;)` */
+static bool match_counted_loop(struct ast_node *stmt, struct bce_loop *loop) {
+  struct ast_node *init = stmt->for_stmt.init_stmt->node;
+  struct ast_node *start = init->var_decl_stmt.expr->node;
+  if (start->node_type != PRIMARY_NODE ||
+      start->primary_node_type != NUMBER_PRIMARY_NODE || start->number < 0) {
+    return false;
+  }
+  loop->index = init->var_decl_stmt.id;
+
+  struct ast_node *condition =
+      stmt->for_stmt.expr_stmt->node->expr_stmt_expr->node;
+  if (condition->node_type != BINARY_NODE || condition->binary.op != LESS ||
+      !is_named(condition->binary.left->node, loop->index)) {
+    return false;
+  }
+  struct ast_node *bound = condition->binary.right->node;
+  if (bound->node_type != PRIMARY_NODE ||
+      bound->primary_node_type != METHOD_CALL_PRIMARY_NODE ||
+      !is_len_call(bound) || !is_identifier(bound->method_call.object->node)) {
+    return false;
+  }
+  loop->array = bound->method_call.object->node->id;
+  if (strcmp(loop->array, loop->index) == 0) {
+    return false;
+  }
+
+  struct ast_node *update = stmt->for_stmt.update_stmt->node;
+  struct ast_node *step = update->var_assign_stmt.expr->node;
+  return is_named(update->var_assign_stmt.primary->node, loop->index) &&
+         step->node_type == BINARY_NODE && step->binary.op == PLUS &&
+         is_named(step->binary.left->node, loop->index) &&
+         step->binary.right->node->node_type == PRIMARY_NODE &&
+         step->binary.right->node->primary_node_type == NUMBER_PRIMARY_NODE &&
+         step->binary.right->node->number == 1;
+}
+
+/* Returns true if the body of the counted loop `stmt` keeps `0 <= i <
+ * a.len()` from start to end */
+static bool keeps_range(struct bce *bce, struct ast_node *stmt,
+                        struct bce_loop *loop) {
+  struct licm_loop scan = {.node = stmt,
+                           .written_names = hash_table_init(),
+                           .has_side_effects = false,
+                           .resizes_arrays = false,
+                           .stores_elements = false};
+  scan_loop_statement(bce->declared_names, &scan, stmt->for_stmt.block->node);
+  bool keeps = !scan.has_side_effects && !scan.resizes_arrays &&
+               !hash_table_lookup(scan.written_names, loop->index) &&
+               !hash_table_lookup(scan.written_names, loop->array);
+  hash_table_free(scan.written_names);
+  return keeps;
+}
+
+static void check_access(struct bce *bce, struct ast_node *access) {
+  struct ast_node *array = access->array_access.primary->node;
+  struct ast_node *index = access->array_access.index->node;
+  for (size_t i = 0; i < bce->loops->size; i++) {
+    struct bce_loop *loop = vector_at(bce->loops, i);
+    if (is_named(array, loop->array) && is_named(index, loop->index)) {
+      access->array_access.is_in_bounds = true;
+      return;
+    }
+  }
+}
+
+static void check_expressions(struct bce *bce, struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    check_expression(bce, val->node);
+  }
+}
+
+static void check_expression(struct bce *bce, struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    check_expression(bce, expr->binary.left->node);
+    check_expression(bce, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    check_expression(bce, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case FN_CALL_PRIMARY_NODE:
+    check_expression(bce, expr->fn_call.primary->node);
+    check_expressions(bce, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    check_expression(bce, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      check_expressions(bce,
+                        expr->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    check_expressions(bce, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    check_access(bce, expr);
+    check_expression(bce, expr->array_access.primary->node);
+    check_expression(bce, expr->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void check_block(struct bce *bce, struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    check_statement(bce, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+static void check_for_statement(struct bce *bce, struct ast_node *stmt) {
+  check_statement(bce, stmt->for_stmt.init_stmt->node);
+  check_statement(bce, stmt->for_stmt.expr_stmt->node);
+  check_statement(bce, stmt->for_stmt.update_stmt->node);
+  struct bce_loop loop;
+  bool is_counted =
+      match_counted_loop(stmt, &loop) && keeps_range(bce, stmt, &loop);
+  if (is_counted) {
+    vector_push_back(bce->loops, &loop);
+  }
+  check_block(bce, stmt->for_stmt.block->node);
+  if (is_counted) {
+    bce->loops->size--;
+  }
+}
+
+static void check_statement(struct bce *bce, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT: {
+    /* The body runs when called, where the loops around it may be done */
+    struct vector *loops = bce->loops;
+    bce->loops = vector_init();
+    check_block(bce, stmt->fn_def_stmt.block->node);
+    vector_free(bce->loops);
+    bce->loops = loops;
+    break;
+  }
+  case VARIABLE_DECL_STMT:
+    check_expression(bce, stmt->var_decl_stmt.expr->node);
+    break;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE) {
+      check_expression(bce, target);
+    }
+    check_expression(bce, stmt->var_assign_stmt.expr->node);
+    break;
+  }
+  case IF_STMT:
+    check_expression(bce, stmt->if_else_stmt.expr->node);
+    check_block(bce, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      check_block(bce, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    check_expression(bce, stmt->while_stmt.expr->node);
+    check_block(bce, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    check_for_statement(bce, stmt);
+    break;
+  case RETURN_STMT:
+    if (stmt->return_stmt_expr) {
+      check_expression(bce, stmt->return_stmt_expr->node);
+    }
+    break;
+  case BLOCK_STMT:
+    check_block(bce, stmt);
+    break;
+  case EXPR_STMT:
+    check_expression(bce, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+void eliminate_bounds_checks(struct vector *program) {
+  struct name_collector collector = {.names = hash_table_init(),
+                                     .declared_names = hash_table_init(),
+                                     .redeclared_names = hash_table_init(),
+                                     .fn_defs = NULL};
+  collect_names(&collector, program);
+  struct bce bce = {.declared_names = collector.declared_names,
+                    .loops = vector_init()};
+  for (size_t i = 0; i < program->size; i++) {
+    check_statement(&bce, vector_at(program, i));
+  }
+  vector_free(bce.loops);
+  hash_table_free(collector.names);
+  hash_table_free(collector.declared_names);
+  hash_table_free(collector.redeclared_names);
+}
@@ -27,12 +27,13 @@ void *builtin_print(struct object *value) {
     printf("%b", value->bool_value);
     break;
   case STRING_VALUE:
-    printf("%s", value->string_value);
+    fwrite(value->string_value->chars, 1, value->string_value->length,
+           stdout);
     break;
   case ARRAY_VALUE:
     printf("[ ");
     for (size_t i = 0; i < value->array_value->size; i++) {
-      builtin_print(vector_at(value->array_value, i));
+      builtin_print(value->array_value->items[i]);
       if (i != value->array_value->size - 1) {
         printf(",");
       }
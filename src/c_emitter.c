@@ -0,0 +1,603 @@
+#include "c_emitter.h"
+#include "ast.h"
+#include "closure.h"
+#include "string_builder.h"
+#include "tokens.h"
+#include "utils.h"
+#include "vector.h"
+#include <stdarg.h>
+
+static void emit_line(struct c_emitter_context *context, const char *format,
+                      ...) {
+  va_list args;
+  va_list args_copy;
+  va_start(args, format);
+  va_copy(args_copy, args);
+  int length = vsnprintf(NULL, 0, format, args_copy);
+  va_end(args_copy);
+  char *buffer = malloc(length + 1);
+  vsnprintf(buffer, length + 1, format, args);
+  va_end(args);
+  for (size_t i = 0; i < context->indent_level; i++) {
+    string_builder_append(context->out, "  ");
+  }
+  string_builder_append(context->out, buffer);
+  string_builder_append(context->out, "\n");
+  free(buffer);
+}
+
+static char *new_name(struct c_emitter *emitter, const char *prefix) {
+  return format_string("jix_%s%zu", prefix, emitter->next_id++);
+}
+
+static const char *get_token_enum_name(enum token_type op) {
+  switch (op) {
+  case MINUS:
+    return "MINUS";
+  case PLUS:
+    return "PLUS";
+  case SLASH:
+    return "SLASH";
+  case STAR:
+    return "STAR";
+  case BANG:
+    return "BANG";
+  case EQUAL_EQUAL:
+    return "EQUAL_EQUAL";
+  case BANG_EQUAL:
+    return "BANG_EQUAL";
+  case GREATER:
+    return "GREATER";
+  case GREATER_EQUAL:
+    return "GREATER_EQUAL";
+  case LESS:
+    return "LESS";
+  case LESS_EQUAL:
+    return "LESS_EQUAL";
+  case AND:
+    return "AND";
+  case OR:
+    return "OR";
+  default:
+    return "INVALID_TOKEN";
+  }
+}
+
+char *emit_c_string_literal(const char *str) {
+  struct string_builder *literal = string_builder_init();
+  string_builder_append(literal, "\"");
+  for (size_t i = 0; str[i] != '\0'; i++) {
+    unsigned char c = str[i];
+    char escaped[8] = {0};
+    switch (c) {
+    case '\\':
+    case '"':
+    case '?':
+      escaped[0] = '\\';
+      escaped[1] = c;
+      break;
+    case '\n':
+      strcpy(escaped, "\\n");
+      break;
+    case '\t':
+      strcpy(escaped, "\\t");
+      break;
+    default:
+      if (c < 0x20 || c >= 0x7f) {
+        snprintf(escaped, sizeof(escaped), "\\%03o", c);
+      } else {
+        escaped[0] = c;
+      }
+    }
+    string_builder_append(literal, escaped);
+  }
+  string_builder_append(literal, "\"");
+  char *returner = literal->str;
+  free(literal);
+  return returner;
+}
+
+static char *emit_method_call(struct c_emitter *emitter,
+                              struct c_emitter_context *context,
+                              struct ast_node *expr) {
+  char *array = emit_c_expression(emitter, context,
+                                  expr->method_call.object->node);
+  emit_line(context,
+            "aot_check_array(state, %s, \"Method calls are only supported for "
+            "arrays for now\");",
+            array);
+  char *returner = new_name(emitter, "t");
+  emit_line(context, "struct object *%s = NULL;", returner);
+  struct ast_node *member = expr->method_call.member->node;
+  if (member->primary_node_type != FN_CALL_PRIMARY_NODE) {
+    emit_line(context, "aot_fail(state, strdup(\"Array methods can only be "
+                       "function calls\"));");
+    return returner;
+  }
+  if (member->fn_call.primary->node->primary_node_type !=
+      IDENTIFIER_PRIMARY_NODE) {
+    emit_line(context, "aot_fail(state, strdup(\"Method calls to array should "
+                       "must be an identifier type\"));");
+    return returner;
+  }
+  char *method = member->fn_call.primary->node->id;
+  struct vector *parameters = member->fn_call.parameters;
+  if (strcmp(method, "add") == 0) {
+    for (size_t i = 0; i < parameters->size; i++) {
+      struct result *val = vector_at(parameters, i);
+      char *item = emit_c_expression(emitter, context, val->node);
+      emit_line(context, "aot_array_push(%s, %s);", array, item);
+    }
+  } else if (strcmp(method, "len") == 0) {
+    emit_line(context, "%s = aot_array_len(%s);", returner, array);
+  } else if (strcmp(method, "pop") == 0) {
+    emit_line(context, "aot_check_array_pop(state, %s);", array);
+    if (parameters->size > 1) {
+      emit_line(context, "aot_fail(state, strdup(\".pop() only supports one "
+                         "optional argument\"));");
+      return returner;
+    }
+    const char *index = "NULL";
+    if (parameters->size == 1) {
+      struct result *val = vector_at(parameters, 0);
+      index = emit_c_expression(emitter, context, val->node);
+    }
+    emit_line(context, "%s = aot_array_pop(state, %s, %s);", returner, array,
+              index);
+  } else {
+    char *error_message =
+        format_string("Invalid method '%s' for array operation", method);
+    emit_line(context, "aot_fail(state, strdup(%s));",
+              emit_c_string_literal(error_message));
+  }
+  return returner;
+}
+
+static char *emit_fn_call(struct c_emitter *emitter,
+                          struct c_emitter_context *context,
+                          struct ast_node *expr, bool is_tail_call) {
+  char *callee =
+      emit_c_expression(emitter, context, expr->fn_call.primary->node);
+  size_t num_args = expr->fn_call.parameters->size;
+  emit_line(context, "aot_check_callable(state, %s, %zu);", callee, num_args);
+  char *args = new_name(emitter, "args");
+  if (num_args == 0) {
+    emit_line(context, "struct object **%s = NULL;", args);
+  } else {
+    emit_line(context, "struct object *%s[%zu];", args, num_args);
+  }
+  for (size_t i = 0; i < num_args; i++) {
+    struct result *val = vector_at(expr->fn_call.parameters, i);
+    char *arg = emit_c_expression(emitter, context, val->node);
+    emit_line(context, "%s[%zu] = %s;", args, i, arg);
+  }
+  char *returner = new_name(emitter, "t");
+  emit_line(context, "struct object *%s = %s(state, %s, %s, %zu);", returner,
+            is_tail_call ? "aot_tail_call" : "aot_call", callee, args,
+            num_args);
+  return returner;
+}
+
+char *emit_c_expression(struct c_emitter *emitter,
+                        struct c_emitter_context *context,
+                        struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE: {
+    char *lhs = emit_c_expression(emitter, context, expr->binary.left->node);
+    char *rhs = emit_c_expression(emitter, context, expr->binary.right->node);
+    char *returner = new_name(emitter, "t");
+    if (expr->binary.is_int_typed) {
+      /* Both operands are proven integers, see "type_inference.h" */
+      bool is_arithmetic = expr->binary.op == PLUS ||
+                           expr->binary.op == MINUS ||
+                           expr->binary.op == STAR || expr->binary.op == SLASH;
+      emit_line(context,
+                "struct object *%s = %s(%s->int_value %s %s->int_value);",
+                returner, is_arithmetic ? "aot_int" : "aot_bool", lhs,
+                get_string_from_token_atom(expr->binary.op), rhs);
+      return returner;
+    }
+    emit_line(context, "struct object *%s = aot_binary(state, %s, %s, %s);",
+              returner, get_token_enum_name(expr->binary.op), lhs, rhs);
+    return returner;
+  }
+  case UNARY_NODE: {
+    char *operand =
+        emit_c_expression(emitter, context, expr->unary.primary->node);
+    char *returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_unary(state, %s, %s);",
+              returner, get_token_enum_name(expr->unary.op), operand);
+    return returner;
+  }
+  default:
+    break;
+  }
+  char *returner;
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE: {
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_int(%ldL);", returner,
+              expr->number);
+    break;
+  }
+  case STRING_PRIMARY_NODE: {
+    returner = new_name(emitter, "t");
+    char *literal = new_name(emitter, "literal");
+    emit_line(context, "static struct object *%s;", literal);
+    emit_line(context, "struct object *%s = aot_string(&%s, %s, %zu);",
+              returner, literal, emit_c_string_literal(expr->string->chars),
+              expr->string->length);
+    break;
+  }
+  case BOOLEAN_PRIMARY_NODE: {
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_bool(%s);", returner,
+              expr->boolean ? "true" : "false");
+    break;
+  }
+  case NIL_PRIMARY_NODE: {
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_nil();", returner);
+    break;
+  }
+  case IDENTIFIER_PRIMARY_NODE: {
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_lookup(state, %s);", returner,
+              emit_c_string_literal(expr->id));
+    break;
+  }
+  case FN_CALL_PRIMARY_NODE:
+    return emit_fn_call(emitter, context, expr, false);
+  case METHOD_CALL_PRIMARY_NODE:
+    return emit_method_call(emitter, context, expr);
+  case ARRAY_CREATION_PRIMARY_NODE: {
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_array_new(%zu);", returner,
+              expr->array->size);
+    for (size_t i = 0; i < expr->array->size; i++) {
+      struct result *val = vector_at(expr->array, i);
+      char *item = emit_c_expression(emitter, context, val->node);
+      emit_line(context, "aot_array_push(%s, %s);", returner, item);
+    }
+    break;
+  }
+  case ARRAY_ACCESS_PRIMARY_NODE: {
+    char *array = emit_c_expression(emitter, context,
+                                    expr->array_access.primary->node);
+    if (expr->array_access.is_in_bounds) {
+      char *index =
+          emit_c_expression(emitter, context, expr->array_access.index->node);
+      returner = new_name(emitter, "t");
+      emit_line(context, "struct object *%s = aot_array_load(%s, %s);",
+                returner, array, index);
+      break;
+    }
+    emit_line(context,
+              "aot_check_array(state, %s, \"Array access can only be used for "
+              "arrays\");",
+              array);
+    char *index =
+        emit_c_expression(emitter, context, expr->array_access.index->node);
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = aot_array_index(state, %s, %s);",
+              returner, array, index);
+    break;
+  }
+  case INVARIANT_PRIMARY_NODE: {
+    /* Declared by the loop, see `emit_loop_invariants` */
+    returner = format_string("jix_inv%zu", expr->invariant.id);
+    emit_line(context, "if (!%s) {", returner);
+    context->indent_level++;
+    char *value =
+        emit_c_expression(emitter, context, expr->invariant.expr->node);
+    emit_line(context, "%s = %s;", returner, value);
+    context->indent_level--;
+    emit_line(context, "}");
+    break;
+  }
+  case SAVED_PRIMARY_NODE:
+    string_builder_append(
+        emitter->prototypes,
+        format_string("static struct object *jix_cse%zu;\n", expr->saved.id));
+    returner = emit_c_expression(emitter, context, expr->saved.expr->node);
+    emit_line(context, "jix_cse%zu = %s;", expr->saved.id, returner);
+    break;
+  case REUSED_PRIMARY_NODE:
+    /* Copied right away, a later call may save the expression again */
+    returner = new_name(emitter, "t");
+    emit_line(context, "struct object *%s = jix_cse%zu;", returner,
+              expr->reused->saved.id);
+    break;
+  }
+  return returner;
+}
+
+/* Emits a static array of the string literals of `names`, and returns its
+ * name, or "NULL" when there are none */
+static char *emit_name_array(struct c_emitter *emitter, const char *prefix,
+                             struct vector *names) {
+  if (names->size == 0) {
+    return "NULL";
+  }
+  char *array = new_name(emitter, prefix);
+  struct string_builder *name_list = string_builder_init();
+  for (size_t i = 0; i < names->size; i++) {
+    string_builder_append(name_list,
+                          emit_c_string_literal(vector_at(names, i)));
+    if (i + 1 != names->size) {
+      string_builder_append(name_list, ", ");
+    }
+  }
+  string_builder_append(emitter->prototypes,
+                        format_string("static char *%s[] = {%s};\n", array,
+                                      name_list->str));
+  string_builder_free(name_list);
+  return array;
+}
+
+static void emit_fn_def_statement(struct c_emitter *emitter,
+                                  struct c_emitter_context *context,
+                                  struct ast_node *stmt) {
+  char *fn_name = new_name(emitter, "fn");
+  struct vector *parameters = stmt->fn_def_stmt.parameters;
+  char *params = emit_name_array(emitter, "params", parameters);
+  struct vector *free_names = closure_free_names(stmt);
+  char *free = emit_name_array(emitter, "free", free_names);
+  string_builder_append(
+      emitter->prototypes,
+      format_string("static struct object *%s(struct interpreter_state "
+                    "*state);\n",
+                    fn_name));
+
+  /* Function bodies are lifted to file scope. They are called with the
+   * parameters already bound by `aot_call`. */
+  struct c_emitter_context fn_context = {.out = string_builder_init(),
+                                         .indent_level = 1,
+                                         .loop_env = NULL,
+                                         .is_top_level = false,
+                                         .is_function_body = true};
+  emit_c_block_statement(emitter, &fn_context, stmt->fn_def_stmt.block->node);
+  string_builder_append(
+      emitter->functions,
+      format_string("static struct object *%s(struct interpreter_state "
+                    "*state) {\n%s  return NULL;\n}\n\n",
+                    fn_name, fn_context.out->str));
+  string_builder_free(fn_context.out);
+
+  emit_line(context, "aot_define_fn(state, %s, %s, %zu, %s, %zu, %s, %s);",
+            emit_c_string_literal(stmt->fn_def_stmt.id), params,
+            parameters->size, free, free_names->size, fn_name,
+            stmt->fn_def_stmt.is_pure ? "true" : "false");
+}
+
+/* Cached values of the loop's invariant expressions, which are computed again
+ * every time the loop starts */
+static void emit_loop_invariants(struct c_emitter_context *context,
+                                 struct vector *invariants) {
+  if (!invariants) {
+    return;
+  }
+  for (size_t i = 0; i < invariants->size; i++) {
+    struct ast_node *invariant = vector_at(invariants, i);
+    emit_line(context, "struct object *jix_inv%zu = NULL;",
+              invariant->invariant.id);
+  }
+}
+
+static void emit_loop_condition(struct c_emitter *emitter,
+                                struct c_emitter_context *context,
+                                struct ast_node *expr, const char *is_first,
+                                const char *error_message) {
+  char *cond = emit_c_expression(emitter, context, expr);
+  emit_line(context, "if (!aot_condition(state, %s, %s, \"%s\")) {", cond,
+            is_first, error_message);
+  emit_line(context, "  break;");
+  emit_line(context, "}");
+  emit_line(context, "%s = false;", is_first);
+}
+
+void emit_c_block_statement(struct c_emitter *emitter,
+                            struct c_emitter_context *context,
+                            struct ast_node *stmt) {
+  char *env = new_name(emitter, "env");
+  emit_line(context, "{");
+  context->indent_level++;
+  emit_line(context, "struct environment *%s = state->env;", env);
+  emit_line(context, "aot_push_scope(state);");
+  for (size_t i = 0; i < stmt->block_stmt_stmts->size; i++) {
+    emit_c_statement(emitter, context, vector_at(stmt->block_stmt_stmts, i));
+  }
+  emit_line(context, "aot_pop_scopes(state, %s);", env);
+  context->indent_level--;
+  emit_line(context, "}");
+}
+
+void emit_c_statement(struct c_emitter *emitter,
+                      struct c_emitter_context *context,
+                      struct ast_node *stmt) {
+  if (context->is_top_level) {
+    emit_line(context, "aot_set_lines(state, %zu, %zu);",
+              stmt->source_position.start_line,
+              stmt->source_position.end_line);
+  }
+  struct c_emitter_context inner_context = *context;
+  inner_context.is_top_level = false;
+  switch (stmt->node_type) {
+  case FN_DEF_STMT: {
+    emit_fn_def_statement(emitter, &inner_context, stmt);
+    break;
+  }
+  case VARIABLE_DECL_STMT: {
+    char *id = emit_c_string_literal(stmt->var_decl_stmt.id);
+    emit_line(context, "aot_check_undeclared(state, %s);", id);
+    char *value = emit_c_expression(emitter, &inner_context,
+                                    stmt->var_decl_stmt.expr->node);
+    emit_line(context, "aot_declare(state, %s, %s);", id, value);
+    break;
+  }
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+      char *id = emit_c_string_literal(target->id);
+      emit_line(context, "aot_check_assignable(state, %s);", id);
+      char *value = emit_c_expression(emitter, &inner_context,
+                                      stmt->var_assign_stmt.expr->node);
+      emit_line(context, "aot_assign(state, %s, %s);", id, value);
+      break;
+    }
+    char *array = emit_c_expression(emitter, &inner_context,
+                                    target->array_access.primary->node);
+    bool is_in_bounds = target->array_access.is_in_bounds;
+    if (!is_in_bounds) {
+      emit_line(context,
+                "aot_check_array(state, %s, \"Variable array assignment can "
+                "only be used for arrays\");",
+                array);
+    }
+    char *index = emit_c_expression(emitter, &inner_context,
+                                    target->array_access.index->node);
+    if (!is_in_bounds) {
+      emit_line(context, "aot_check_array_store(state, %s, %s);", array,
+                index);
+    }
+    char *value = emit_c_expression(emitter, &inner_context,
+                                    stmt->var_assign_stmt.expr->node);
+    emit_line(context, "aot_array_store(%s, %s, %s);", array, index, value);
+    break;
+  }
+  case IF_STMT: {
+    char *cond = emit_c_expression(emitter, &inner_context,
+                                   stmt->if_else_stmt.expr->node);
+    emit_line(context,
+              "if (aot_condition(state, %s, true, \"The result of the "
+              "<expression> inside 'if' statement should result in a boolean "
+              "value\")) {",
+              cond);
+    inner_context.indent_level++;
+    emit_c_block_statement(emitter, &inner_context,
+                           stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      emit_line(context, "} else {");
+      emit_c_block_statement(emitter, &inner_context,
+                             stmt->if_else_stmt.else_block->node);
+    }
+    emit_line(context, "}");
+    break;
+  }
+  case WHILE_STMT: {
+    char *env = new_name(emitter, "env");
+    char *is_first = new_name(emitter, "first");
+    emit_line(context, "{");
+    inner_context.indent_level++;
+    emit_line(&inner_context, "struct environment *%s = state->env;", env);
+    emit_line(&inner_context, "(void)%s;", env);
+    emit_loop_invariants(&inner_context, stmt->while_stmt.invariants);
+    emit_line(&inner_context, "bool %s = true;", is_first);
+    emit_line(&inner_context, "for (;;) {");
+    inner_context.indent_level++;
+    inner_context.loop_env = env;
+    emit_loop_condition(emitter, &inner_context,
+                        stmt->while_stmt.expr->node, is_first,
+                        "The <expression> of 'while' must return boolean");
+    emit_c_block_statement(emitter, &inner_context,
+                           stmt->while_stmt.block->node);
+    inner_context.indent_level--;
+    emit_line(&inner_context, "}");
+    emit_line(context, "}");
+    break;
+  }
+  case FOR_STMT: {
+    char *parent_env = new_name(emitter, "env");
+    char *env = new_name(emitter, "env");
+    char *is_first = new_name(emitter, "first");
+    emit_line(context, "{");
+    inner_context.indent_level++;
+    emit_line(&inner_context, "struct environment *%s = state->env;",
+              parent_env);
+    emit_line(&inner_context, "aot_push_scope(state);");
+    emit_line(&inner_context, "struct environment *%s = state->env;", env);
+    emit_c_statement(emitter, &inner_context,
+                     stmt->for_stmt.init_stmt->node);
+    emit_loop_invariants(&inner_context, stmt->for_stmt.invariants);
+    emit_line(&inner_context, "bool %s = true;", is_first);
+    emit_line(&inner_context, "for (;;) {");
+    inner_context.indent_level++;
+    inner_context.loop_env = env;
+    emit_loop_condition(
+        emitter, &inner_context,
+        stmt->for_stmt.expr_stmt->node->expr_stmt_expr->node, is_first,
+        "The expression of 'for' loop must result in a boolean value");
+    emit_c_block_statement(emitter, &inner_context,
+                           stmt->for_stmt.block->node);
+    emit_c_statement(emitter, &inner_context,
+                     stmt->for_stmt.update_stmt->node);
+    inner_context.indent_level--;
+    emit_line(&inner_context, "}");
+    emit_line(&inner_context, "aot_pop_scopes(state, %s);", parent_env);
+    emit_line(context, "}");
+    break;
+  }
+  case BREAK_STMT: {
+    if (context->loop_env) {
+      emit_line(context, "aot_pop_scopes(state, %s);", context->loop_env);
+      emit_line(context, "break;");
+    }
+    break;
+  }
+  case RETURN_STMT: {
+    struct ast_node *expr = stmt->return_stmt_expr->node;
+    char *value = context->is_function_body &&
+                          expr->node_type == PRIMARY_NODE &&
+                          expr->primary_node_type == FN_CALL_PRIMARY_NODE
+                      ? emit_fn_call(emitter, &inner_context, expr, true)
+                      : emit_c_expression(emitter, &inner_context, expr);
+    emit_line(context, "return %s;", value);
+    break;
+  }
+  case BLOCK_STMT: {
+    emit_c_block_statement(emitter, &inner_context, stmt);
+    break;
+  }
+  case EXPR_STMT: {
+    char *value =
+        emit_c_expression(emitter, &inner_context, stmt->expr_stmt_expr->node);
+    emit_line(context, "(void)%s;", value);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+char *emit_c_program(struct vector *program) {
+  struct c_emitter emitter = {.prototypes = string_builder_init(),
+                              .functions = string_builder_init(),
+                              .next_id = 0};
+  struct c_emitter_context context = {.out = string_builder_init(),
+                                      .indent_level = 1,
+                                      .loop_env = NULL,
+                                      .is_top_level = true,
+                                      .is_function_body = false};
+  for (size_t i = 0; i < program->size; i++) {
+    emit_c_statement(&emitter, &context, vector_at(program, i));
+  }
+  struct string_builder *source = string_builder_init();
+  string_builder_append(source, "/* Generated by `jix --emit-c` */\n");
+  string_builder_append(source, "#include \"aot_runtime.h\"\n\n");
+  string_builder_append(source, emitter.prototypes->str);
+  string_builder_append(source, "\n");
+  string_builder_append(source, emitter.functions->str);
+  string_builder_append(
+      source, "static struct object *jix_main(struct interpreter_state *state) "
+              "{\n");
+  string_builder_append(source, context.out->str);
+  string_builder_append(source, "  return NULL;\n}\n\n");
+  string_builder_append(source,
+                        "int main(void) { return aot_run(jix_main); }\n");
+  string_builder_free(emitter.prototypes);
+  string_builder_free(emitter.functions);
+  string_builder_free(context.out);
+  char *returner = source->str;
+  free(source);
+  return returner;
+}
@@ -0,0 +1,254 @@
+#include "closure.h"
+#include "ast.h"
+#include "hash_table.h"
+#include "interpreter.h"
+#include "vector.h"
+#include <string.h>
+
+static bool is_declared;
+
+static void scan_statement(struct free_names *scan, struct ast_node *stmt);
+static void scan_expression(struct free_names *scan, struct ast_node *expr);
+
+static void push_scope(struct free_names *scan) {
+  vector_push_back(scan->scopes, hash_table_init());
+}
+
+static void pop_scope(struct free_names *scan) {
+  hash_table_free(vector_remove_at(scan->scopes, scan->scopes->size - 1));
+}
+
+static void declare(struct free_names *scan, char *id) {
+  struct hash_table *scope = vector_at(scan->scopes, scan->scopes->size - 1);
+  hash_table_insert(scope, id, &is_declared);
+}
+
+static void use(struct free_names *scan, char *id) {
+  for (size_t i = 0; i < scan->scopes->size; i++) {
+    if (hash_table_lookup(vector_at(scan->scopes, i), id)) {
+      return;
+    }
+  }
+  if (!hash_table_lookup(scan->found, id)) {
+    hash_table_insert(scan->found, id, &is_declared);
+    vector_push_back(scan->names, id);
+  }
+}
+
+static void scan_expressions(struct free_names *scan,
+                             struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    scan_expression(scan, val->node);
+  }
+}
+
+static void scan_expression(struct free_names *scan, struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    scan_expression(scan, expr->binary.left->node);
+    scan_expression(scan, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    scan_expression(scan, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE:
+    use(scan, expr->id);
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    scan_expression(scan, expr->fn_call.primary->node);
+    scan_expressions(scan, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    scan_expression(scan, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      scan_expressions(scan,
+                       expr->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    scan_expressions(scan, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    scan_expression(scan, expr->array_access.primary->node);
+    scan_expression(scan, expr->array_access.index->node);
+    break;
+  case INVARIANT_PRIMARY_NODE:
+    scan_expression(scan, expr->invariant.expr->node);
+    break;
+  case SAVED_PRIMARY_NODE:
+    scan_expression(scan, expr->saved.expr->node);
+    break;
+  case REUSED_PRIMARY_NODE:
+    scan_expression(scan, expr->reused->saved.expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void scan_block(struct free_names *scan, struct ast_node *block) {
+  push_scope(scan);
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    scan_statement(scan, vector_at(block->block_stmt_stmts, i));
+  }
+  pop_scope(scan);
+}
+
+/* Scans the body of a function, in a scope of its parameters */
+static void scan_function(struct free_names *scan, struct ast_node *fn_def) {
+  push_scope(scan);
+  for (size_t i = 0; i < fn_def->fn_def_stmt.parameters->size; i++) {
+    declare(scan, vector_at(fn_def->fn_def_stmt.parameters, i));
+  }
+  scan_block(scan, fn_def->fn_def_stmt.block->node);
+  pop_scope(scan);
+}
+
+static void scan_statement(struct free_names *scan, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    /* Declared before its upvalues are captured, so that it can call
+     * itself */
+    declare(scan, stmt->fn_def_stmt.id);
+    scan_function(scan, stmt);
+    break;
+  case VARIABLE_DECL_STMT:
+    scan_expression(scan, stmt->var_decl_stmt.expr->node);
+    declare(scan, stmt->var_decl_stmt.id);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    scan_expression(scan, stmt->var_assign_stmt.primary->node);
+    scan_expression(scan, stmt->var_assign_stmt.expr->node);
+    break;
+  case IF_STMT:
+    scan_expression(scan, stmt->if_else_stmt.expr->node);
+    scan_block(scan, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      scan_block(scan, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    scan_expression(scan, stmt->while_stmt.expr->node);
+    scan_block(scan, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    push_scope(scan);
+    scan_statement(scan, stmt->for_stmt.init_stmt->node);
+    scan_statement(scan, stmt->for_stmt.expr_stmt->node);
+    scan_block(scan, stmt->for_stmt.block->node);
+    scan_statement(scan, stmt->for_stmt.update_stmt->node);
+    pop_scope(scan);
+    break;
+  case RETURN_STMT:
+    if (stmt->return_stmt_expr) {
+      scan_expression(scan, stmt->return_stmt_expr->node);
+    }
+    break;
+  case BLOCK_STMT:
+    scan_block(scan, stmt);
+    break;
+  case EXPR_STMT:
+    scan_expression(scan, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+struct vector *closure_find_free_names(struct ast_node *fn_def) {
+  struct free_names scan = {.scopes = vector_init(),
+                            .found = hash_table_init(),
+                            .names = vector_init()};
+  scan_function(&scan, fn_def);
+  vector_free(scan.scopes);
+  hash_table_free(scan.found);
+  return scan.names;
+}
+
+struct vector *closure_free_names(struct ast_node *fn_def) {
+  if (!fn_def->fn_def_stmt.free_names) {
+    fn_def->fn_def_stmt.free_names = closure_find_free_names(fn_def);
+  }
+  return fn_def->fn_def_stmt.free_names;
+}
+
+/* Returns the upvalue of the variable `id` of `env`, or NULL if `env` has no
+ * such variable */
+static struct upvalue *capture(struct environment *env, char *id) {
+  if (!environment_lookup_symbol_current_env(env, id)) {
+    return NULL;
+  }
+  /* A function's upvalues never share the name of one of its parameters */
+  if (env->function && env->function->upvalues) {
+    for (size_t i = 0; i < env->function->upvalues->size; i++) {
+      struct upvalue *upvalue = vector_at(env->function->upvalues, i);
+      if (strcmp(upvalue->id, id) == 0) {
+        return upvalue;
+      }
+    }
+  }
+  for (struct upvalue *upvalue = env->captured; upvalue;
+       upvalue = upvalue->next) {
+    if (strcmp(upvalue->id, id) == 0) {
+      return upvalue;
+    }
+  }
+  struct upvalue *upvalue = malloc(sizeof(struct upvalue));
+  upvalue->id = id;
+  upvalue->env = env;
+  upvalue->closed = NULL;
+  upvalue->next = env->captured;
+  env->captured = upvalue;
+  return upvalue;
+}
+
+void closure_capture(struct interpreter_state *state, struct function *function,
+                     struct vector *free_names) {
+  function->upvalues = NULL;
+  for (size_t i = 0; i < free_names->size; i++) {
+    char *id = vector_at(free_names, i);
+    struct upvalue *upvalue = NULL;
+    for (struct environment *env = state->env;
+         env && env != state->globals && !upvalue;
+         env = env->parent_environment) {
+      upvalue = capture(env, id);
+    }
+    if (!upvalue) {
+      continue;
+    }
+    if (!function->upvalues) {
+      function->upvalues = vector_init();
+    }
+    vector_push_back(function->upvalues, upvalue);
+  }
+}
+
+struct object *upvalue_get(struct upvalue *upvalue) {
+  if (!upvalue->env) {
+    return upvalue->closed;
+  }
+  return environment_lookup_symbol_current_env(upvalue->env, upvalue->id);
+}
+
+void upvalue_set(struct upvalue *upvalue, struct object *value) {
+  if (!upvalue->env) {
+    upvalue->closed = value;
+    return;
+  }
+  environment_insert_symbol(upvalue->env, upvalue->id, value);
+}
+
+void closure_close(struct environment *env) {
+  for (struct upvalue *upvalue = env->captured; upvalue;
+       upvalue = upvalue->next) {
+    upvalue->closed = upvalue_get(upvalue);
+    upvalue->env = NULL;
+  }
+  env->captured = NULL;
+}
@@ -0,0 +1,352 @@
+#include "cse.h"
+#include "ast.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "licm.h"
+#include "optimizer.h"
+#include "utils.h"
+#include "vector.h"
+#include <string.h>
+
+static void number_statements(struct cse *cse, struct vector *stmts);
+static void number_expression(struct cse *cse, struct ast_node *expr,
+                              bool is_operand);
+
+/* Looks through the nodes this pass adds, to the expression they stand for */
+static struct ast_node *original_expression(struct ast_node *expr) {
+  if (expr->node_type == PRIMARY_NODE &&
+      expr->primary_node_type == REUSED_PRIMARY_NODE) {
+    expr = expr->reused;
+  }
+  if (expr->node_type == PRIMARY_NODE &&
+      expr->primary_node_type == SAVED_PRIMARY_NODE) {
+    expr = expr->saved.expr->node;
+  }
+  return expr;
+}
+
+/* Canonical form of a pure expression, equal for expressions computing the
+ * same value from the same names, or NULL */
+static char *expression_key(struct ast_node *expr) {
+  expr = original_expression(expr);
+  if (expr->node_type == BINARY_NODE) {
+    char *left = expression_key(expr->binary.left->node);
+    char *right = left ? expression_key(expr->binary.right->node) : NULL;
+    char *key =
+        right ? format_string("(%s %d %s)", left, expr->binary.op, right)
+              : NULL;
+    free(left);
+    free(right);
+    return key;
+  }
+  if (expr->node_type != PRIMARY_NODE) {
+    return NULL;
+  }
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+    return format_string("%ld", expr->number);
+  case STRING_PRIMARY_NODE:
+    /* The length keeps quotes inside of the string unambiguous */
+    return format_string("\"%zu:%s\"", expr->string->length,
+                         expr->string->chars);
+  case BOOLEAN_PRIMARY_NODE:
+    return strdup(expr->boolean ? "true" : "false");
+  case NIL_PRIMARY_NODE:
+    return strdup("nil");
+  case IDENTIFIER_PRIMARY_NODE:
+    return strdup(expr->id);
+  case METHOD_CALL_PRIMARY_NODE: {
+    if (!is_len_call(expr)) {
+      return NULL;
+    }
+    char *object = expression_key(expr->method_call.object->node);
+    char *key = object ? format_string("%s.len()", object) : NULL;
+    free(object);
+    return key;
+  }
+  case ARRAY_ACCESS_PRIMARY_NODE: {
+    char *array = expression_key(expr->array_access.primary->node);
+    char *index = array ? expression_key(expr->array_access.index->node) : NULL;
+    char *key = index ? format_string("%s[%s]", array, index) : NULL;
+    free(array);
+    free(index);
+    return key;
+  }
+  default:
+    return NULL;
+  }
+}
+
+/* Expressions worth numbering: not plain names nor literals */
+static bool is_computation(struct ast_node *expr) {
+  return expr->node_type == BINARY_NODE ||
+         (expr->node_type == PRIMARY_NODE &&
+          ((expr->primary_node_type == METHOD_CALL_PRIMARY_NODE &&
+            is_len_call(expr)) ||
+           expr->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE));
+}
+
+static bool mentions_name(struct ast_node *expr, char *id) {
+  expr = original_expression(expr);
+  if (expr->node_type == BINARY_NODE) {
+    return mentions_name(expr->binary.left->node, id) ||
+           mentions_name(expr->binary.right->node, id);
+  }
+  switch (expr->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE:
+    return strcmp(expr->id, id) == 0;
+  case METHOD_CALL_PRIMARY_NODE:
+    return mentions_name(expr->method_call.object->node, id);
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    return mentions_name(expr->array_access.primary->node, id) ||
+           mentions_name(expr->array_access.index->node, id);
+  default:
+    return false;
+  }
+}
+
+static bool reads_arrays(struct ast_node *expr) {
+  expr = original_expression(expr);
+  if (expr->node_type == BINARY_NODE) {
+    return reads_arrays(expr->binary.left->node) ||
+           reads_arrays(expr->binary.right->node);
+  }
+  return expr->primary_node_type == METHOD_CALL_PRIMARY_NODE ||
+         expr->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE;
+}
+
+static void forget(struct cse *cse, struct cse_value *value) {
+  if (!value->is_forgotten) {
+    hash_table_delete(cse->available, value->key);
+    value->is_forgotten = true;
+  }
+}
+
+static void forget_all(struct cse *cse) {
+  for (size_t i = 0; i < cse->values->size; i++) {
+    forget(cse, vector_at(cse->values, i));
+  }
+}
+
+static void forget_name(struct cse *cse, char *id) {
+  for (size_t i = 0; i < cse->values->size; i++) {
+    struct cse_value *value = vector_at(cse->values, i);
+    if (mentions_name(value->node, id)) {
+      forget(cse, value);
+    }
+  }
+}
+
+static void forget_arrays(struct cse *cse) {
+  for (size_t i = 0; i < cse->values->size; i++) {
+    struct cse_value *value = vector_at(cse->values, i);
+    if (reads_arrays(value->node)) {
+      forget(cse, value);
+    }
+  }
+}
+
+/* Ends the current run of straight-line statements */
+static void end_run(struct cse *cse) {
+  for (size_t i = 0; i < cse->values->size; i++) {
+    struct cse_value *value = vector_at(cse->values, i);
+    forget(cse, value);
+    free(value->key);
+    free(value);
+  }
+  cse->values->size = 0;
+}
+
+static void save(struct cse *cse, struct ast_node *expr) {
+  struct ast_node *inner = malloc(sizeof(struct ast_node));
+  *inner = *expr;
+  expr->node_type = PRIMARY_NODE;
+  expr->primary_node_type = SAVED_PRIMARY_NODE;
+  expr->profile_site = NULL;
+  expr->saved.expr = result_ok_node(inner);
+  expr->saved.value = NULL;
+  expr->saved.id = cse->num_saved++;
+}
+
+static void reuse(struct cse *cse, struct cse_value *value,
+                  struct ast_node *expr) {
+  if (value->node->primary_node_type != SAVED_PRIMARY_NODE ||
+      value->node->node_type != PRIMARY_NODE) {
+    save(cse, value->node);
+  }
+  expr->node_type = PRIMARY_NODE;
+  expr->primary_node_type = REUSED_PRIMARY_NODE;
+  expr->profile_site = NULL;
+  expr->reused = value->node;
+}
+
+/* `.len()` is given arguments it never evaluates, which must not be saved */
+static bool ignores_arguments(struct ast_node *member) {
+  struct ast_node *method = member->fn_call.primary->node;
+  return method->primary_node_type == IDENTIFIER_PRIMARY_NODE &&
+         strcmp(method->id, "len") == 0;
+}
+
+static void number_expressions(struct cse *cse, struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    number_expression(cse, val->node, false);
+  }
+}
+
+/* Numbers `expr` and its operands in evaluation order. `is_operand` is set
+ * when its value is only used to compute another one. */
+static void number_expression(struct cse *cse, struct ast_node *expr,
+                              bool is_operand) {
+  char *key = is_computation(expr) ? expression_key(expr) : NULL;
+  if (key) {
+    struct cse_value *value = hash_table_lookup(cse->available, key);
+    if (value &&
+        (is_operand || expr->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE)) {
+      /* Indexing gives the element itself, which is safe to share */
+      reuse(cse, value, expr);
+      free(key);
+      return;
+    }
+  }
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    number_expression(cse, expr->binary.left->node, true);
+    number_expression(cse, expr->binary.right->node, true);
+    break;
+  case UNARY_NODE:
+    number_expression(cse, expr->unary.primary->node, true);
+    break;
+  default:
+    switch (expr->primary_node_type) {
+    case FN_CALL_PRIMARY_NODE:
+      number_expression(cse, expr->fn_call.primary->node, true);
+      number_expressions(cse, expr->fn_call.parameters);
+      if (!is_builtin_callee(cse->declared_names,
+                             expr->fn_call.primary->node)) {
+        forget_all(cse);
+      }
+      break;
+    case METHOD_CALL_PRIMARY_NODE: {
+      struct ast_node *member = expr->method_call.member->node;
+      number_expression(cse, expr->method_call.object->node, true);
+      if (member->primary_node_type == FN_CALL_PRIMARY_NODE &&
+          !ignores_arguments(member)) {
+        number_expressions(cse, member->fn_call.parameters);
+      }
+      if (!is_len_call(expr)) {
+        forget_arrays(cse);
+      }
+      break;
+    }
+    case ARRAY_CREATION_PRIMARY_NODE:
+      number_expressions(cse, expr->array);
+      break;
+    case ARRAY_ACCESS_PRIMARY_NODE:
+      number_expression(cse, expr->array_access.primary->node, true);
+      number_expression(cse, expr->array_access.index->node, true);
+      break;
+    default:
+      /* Names and literals, or loop invariants which are already cached */
+      break;
+    }
+  }
+  if (!key) {
+    return;
+  }
+  if (hash_table_lookup(cse->available, key)) {
+    free(key);
+    return;
+  }
+  struct cse_value *value = malloc(sizeof(struct cse_value));
+  value->key = key;
+  value->node = expr;
+  value->is_forgotten = false;
+  hash_table_insert(cse->available, key, value);
+  vector_push_back(cse->values, value);
+}
+
+static void number_block(struct cse *cse, struct ast_node *block) {
+  number_statements(cse, block->block_stmt_stmts);
+}
+
+static void number_statement(struct cse *cse, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case VARIABLE_DECL_STMT:
+    number_expression(cse, stmt->var_decl_stmt.expr->node, false);
+    forget_name(cse, stmt->var_decl_stmt.id);
+    return;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+      number_expression(cse, stmt->var_assign_stmt.expr->node, false);
+      forget_name(cse, target->id);
+    } else {
+      number_expression(cse, target->array_access.primary->node, true);
+      number_expression(cse, target->array_access.index->node, true);
+      number_expression(cse, stmt->var_assign_stmt.expr->node, false);
+      forget_arrays(cse);
+    }
+    return;
+  }
+  case EXPR_STMT:
+    number_expression(cse, stmt->expr_stmt_expr->node, false);
+    return;
+  case RETURN_STMT:
+    number_expression(cse, stmt->return_stmt_expr->node, false);
+    return;
+  case IF_STMT:
+    /* The condition is the last thing the run evaluates */
+    number_expression(cse, stmt->if_else_stmt.expr->node, true);
+    end_run(cse);
+    number_block(cse, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      number_block(cse, stmt->if_else_stmt.else_block->node);
+    }
+    return;
+  case WHILE_STMT:
+    end_run(cse);
+    number_block(cse, stmt->while_stmt.block->node);
+    return;
+  case FOR_STMT:
+    end_run(cse);
+    number_block(cse, stmt->for_stmt.block->node);
+    return;
+  case FN_DEF_STMT:
+    end_run(cse);
+    number_block(cse, stmt->fn_def_stmt.block->node);
+    return;
+  case BLOCK_STMT:
+    end_run(cse);
+    number_block(cse, stmt);
+    return;
+  default:
+    end_run(cse);
+    return;
+  }
+}
+
+static void number_statements(struct cse *cse, struct vector *stmts) {
+  for (size_t i = 0; i < stmts->size; i++) {
+    number_statement(cse, vector_at(stmts, i));
+  }
+  end_run(cse);
+}
+
+void eliminate_common_subexpressions(struct vector *program) {
+  struct name_collector collector = {.names = hash_table_init(),
+                                     .declared_names = hash_table_init(),
+                                     .redeclared_names = hash_table_init(),
+                                     .fn_defs = NULL};
+  collect_names(&collector, program);
+  struct cse cse = {.declared_names = collector.declared_names,
+                    .available = hash_table_init(),
+                    .values = vector_init(),
+                    .num_saved = 0};
+  number_statements(&cse, program);
+  vector_free(cse.values);
+  hash_table_free(cse.available);
+  hash_table_free(collector.names);
+  hash_table_free(collector.declared_names);
+  hash_table_free(collector.redeclared_names);
+}
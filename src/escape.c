@@ -0,0 +1,406 @@
+#include "escape.h"
+#include "ast.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "licm.h"
+#include "optimizer.h"
+#include "utils.h"
+#include "vector.h"
+#include <string.h>
+
+static void count_statement(struct scalar_replacement *replacement,
+                            struct ast_node *stmt);
+static void count_expression(struct scalar_replacement *replacement,
+                             struct ast_node *expr);
+static void visit_statement(struct scalar_replacement *replacement,
+                            struct ast_node *stmt);
+static void visit_expression(struct scalar_replacement *replacement,
+                             struct ast_node *expr);
+static void replace_in_statements(struct scalar_replacement *replacement,
+                                  struct vector *stmts);
+
+/* Counts every use of every name */
+static void count_reference(struct scalar_replacement *replacement,
+                            char *id) {
+  size_t *count = hash_table_lookup(replacement->references, id);
+  if (!count) {
+    count = calloc(1, sizeof(size_t));
+    hash_table_insert(replacement->references, id, count);
+  }
+  (*count)++;
+}
+
+static void count_expressions(struct scalar_replacement *replacement,
+                              struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    count_expression(replacement, val->node);
+  }
+}
+
+static void count_expression(struct scalar_replacement *replacement,
+                             struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    count_expression(replacement, expr->binary.left->node);
+    count_expression(replacement, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    count_expression(replacement, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE:
+    count_reference(replacement, expr->id);
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    count_expression(replacement, expr->fn_call.primary->node);
+    count_expressions(replacement, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    count_expression(replacement, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      count_expressions(replacement,
+                        expr->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    count_expressions(replacement, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    count_expression(replacement, expr->array_access.primary->node);
+    count_expression(replacement, expr->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void count_block(struct scalar_replacement *replacement,
+                        struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    count_statement(replacement, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+static void count_statement(struct scalar_replacement *replacement,
+                            struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    count_block(replacement, stmt->fn_def_stmt.block->node);
+    break;
+  case VARIABLE_DECL_STMT:
+    count_expression(replacement, stmt->var_decl_stmt.expr->node);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    count_expression(replacement, stmt->var_assign_stmt.primary->node);
+    count_expression(replacement, stmt->var_assign_stmt.expr->node);
+    break;
+  case IF_STMT:
+    count_expression(replacement, stmt->if_else_stmt.expr->node);
+    count_block(replacement, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      count_block(replacement, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    count_expression(replacement, stmt->while_stmt.expr->node);
+    count_block(replacement, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    count_statement(replacement, stmt->for_stmt.init_stmt->node);
+    count_statement(replacement, stmt->for_stmt.expr_stmt->node);
+    count_statement(replacement, stmt->for_stmt.update_stmt->node);
+    count_block(replacement, stmt->for_stmt.block->node);
+    break;
+  case RETURN_STMT:
+    if (stmt->return_stmt_expr) {
+      count_expression(replacement, stmt->return_stmt_expr->node);
+    }
+    break;
+  case BLOCK_STMT:
+    count_block(replacement, stmt);
+    break;
+  case EXPR_STMT:
+    count_expression(replacement, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static bool is_array_name(struct scalar_replacement *replacement,
+                          struct ast_node *expr) {
+  return expr->node_type == PRIMARY_NODE &&
+         expr->primary_node_type == IDENTIFIER_PRIMARY_NODE &&
+         strcmp(expr->id, replacement->id) == 0;
+}
+
+static char *element_name(char *id, long index) {
+  return format_string("%s[%ld]", id, index);
+}
+
+/* Counts, or replaces, the uses of `replacement.id` which read or assign an
+ * element at a literal index, or take `.len()` */
+static bool visit_scalar_use(struct scalar_replacement *replacement,
+                             struct ast_node *expr) {
+  if (expr->node_type != PRIMARY_NODE) {
+    return false;
+  }
+  if (expr->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE &&
+      is_array_name(replacement, expr->array_access.primary->node)) {
+    struct ast_node *index = expr->array_access.index->node;
+    if (index->node_type != PRIMARY_NODE ||
+        index->primary_node_type != NUMBER_PRIMARY_NODE ||
+        index->number < 0 || index->number >= replacement->num_elements) {
+      return false;
+    }
+    replacement->num_scalar_uses++;
+    if (replacement->is_replacing) {
+      expr->primary_node_type = IDENTIFIER_PRIMARY_NODE;
+      expr->id = element_name(replacement->id, index->number);
+    }
+    return true;
+  }
+  if (expr->primary_node_type == METHOD_CALL_PRIMARY_NODE &&
+      is_len_call(expr) &&
+      is_array_name(replacement, expr->method_call.object->node)) {
+    replacement->num_scalar_uses++;
+    if (replacement->is_replacing) {
+      expr->primary_node_type = NUMBER_PRIMARY_NODE;
+      expr->number = replacement->num_elements;
+      literal_init_value(expr);
+    }
+    return true;
+  }
+  return false;
+}
+
+static void visit_expressions(struct scalar_replacement *replacement,
+                              struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    visit_expression(replacement, val->node);
+  }
+}
+
+static void visit_expression(struct scalar_replacement *replacement,
+                             struct ast_node *expr) {
+  if (visit_scalar_use(replacement, expr)) {
+    return;
+  }
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    visit_expression(replacement, expr->binary.left->node);
+    visit_expression(replacement, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    visit_expression(replacement, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case FN_CALL_PRIMARY_NODE:
+    visit_expression(replacement, expr->fn_call.primary->node);
+    visit_expressions(replacement, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    visit_expression(replacement, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      visit_expressions(replacement,
+                        expr->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    visit_expressions(replacement, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    visit_expression(replacement, expr->array_access.primary->node);
+    visit_expression(replacement, expr->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void visit_block(struct scalar_replacement *replacement,
+                        struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    visit_statement(replacement, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+/* Function bodies are not entered: a use there escapes */
+static void visit_statement(struct scalar_replacement *replacement,
+                            struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case VARIABLE_DECL_STMT:
+    visit_expression(replacement, stmt->var_decl_stmt.expr->node);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    visit_expression(replacement, stmt->var_assign_stmt.primary->node);
+    visit_expression(replacement, stmt->var_assign_stmt.expr->node);
+    break;
+  case IF_STMT:
+    visit_expression(replacement, stmt->if_else_stmt.expr->node);
+    visit_block(replacement, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      visit_block(replacement, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    visit_expression(replacement, stmt->while_stmt.expr->node);
+    visit_block(replacement, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    visit_statement(replacement, stmt->for_stmt.init_stmt->node);
+    visit_statement(replacement, stmt->for_stmt.expr_stmt->node);
+    visit_statement(replacement, stmt->for_stmt.update_stmt->node);
+    visit_block(replacement, stmt->for_stmt.block->node);
+    break;
+  case RETURN_STMT:
+    if (stmt->return_stmt_expr) {
+      visit_expression(replacement, stmt->return_stmt_expr->node);
+    }
+    break;
+  case BLOCK_STMT:
+    visit_block(replacement, stmt);
+    break;
+  case EXPR_STMT:
+    visit_expression(replacement, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Visits the statements following the declaration at `index` */
+static void visit_scope(struct scalar_replacement *replacement,
+                        struct vector *stmts, size_t index) {
+  for (size_t i = index + 1; i < stmts->size; i++) {
+    visit_statement(replacement, vector_at(stmts, i));
+  }
+}
+
+static bool is_scalar_replaceable(struct scalar_replacement *replacement,
+                                  struct vector *stmts, size_t index) {
+  struct ast_node *decl = vector_at(stmts, index);
+  if (decl->node_type != VARIABLE_DECL_STMT) {
+    return false;
+  }
+  char *id = decl->var_decl_stmt.id;
+  struct ast_node *array = decl->var_decl_stmt.expr->node;
+  if (array->node_type != PRIMARY_NODE ||
+      array->primary_node_type != ARRAY_CREATION_PRIMARY_NODE ||
+      array->array->size == 0 || array->array->size > MAX_SCALAR_ELEMENTS ||
+      hash_table_lookup(replacement->redeclared_names, id) ||
+      hash_table_lookup(replacement->assigned_names, id)) {
+    return false;
+  }
+  size_t *num_references = hash_table_lookup(replacement->references, id);
+  replacement->id = id;
+  replacement->num_elements = array->array->size;
+  replacement->num_scalar_uses = 0;
+  replacement->is_replacing = false;
+  visit_scope(replacement, stmts, index);
+  return replacement->num_scalar_uses ==
+         (num_references ? *num_references : 0);
+}
+
+/* Replaces the declaration at `index` by one per element */
+static void replace_array(struct scalar_replacement *replacement,
+                          struct vector *stmts, size_t index) {
+  replacement->is_replacing = true;
+  visit_scope(replacement, stmts, index);
+  struct ast_node *decl = vector_at(stmts, index);
+  struct vector *array = decl->var_decl_stmt.expr->node->array;
+  struct vector *rest = vector_init();
+  for (size_t i = index + 1; i < stmts->size; i++) {
+    vector_push_back(rest, vector_at(stmts, i));
+  }
+  stmts->size = index;
+  for (size_t i = 0; i < array->size; i++) {
+    struct result *element = vector_at(array, i);
+    struct ast_node *element_decl = malloc(sizeof(struct ast_node));
+    *element_decl = *decl;
+    element_decl->profile_site = NULL;
+    element_decl->var_decl_stmt.id = element_name(replacement->id, i);
+    element_decl->var_decl_stmt.expr = element;
+    vector_push_back(stmts, element_decl);
+  }
+  for (size_t i = 0; i < rest->size; i++) {
+    vector_push_back(stmts, vector_at(rest, i));
+  }
+  vector_free(rest);
+}
+
+static void replace_in_block(struct scalar_replacement *replacement,
+                             struct ast_node *block) {
+  replace_in_statements(replacement, block->block_stmt_stmts);
+}
+
+static void replace_in_statements(struct scalar_replacement *replacement,
+                                  struct vector *stmts) {
+  for (size_t i = 0; i < stmts->size; i++) {
+    struct ast_node *stmt = vector_at(stmts, i);
+    if (is_scalar_replaceable(replacement, stmts, i)) {
+      size_t num_elements = replacement->num_elements;
+      replace_array(replacement, stmts, i);
+      /* Element declarations hold no arrays to replace */
+      i += num_elements - 1;
+      continue;
+    }
+    switch (stmt->node_type) {
+    case FN_DEF_STMT:
+      replace_in_block(replacement, stmt->fn_def_stmt.block->node);
+      break;
+    case IF_STMT:
+      replace_in_block(replacement, stmt->if_else_stmt.if_block->node);
+      if (stmt->if_else_stmt.else_block) {
+        replace_in_block(replacement, stmt->if_else_stmt.else_block->node);
+      }
+      break;
+    case WHILE_STMT:
+      replace_in_block(replacement, stmt->while_stmt.block->node);
+      break;
+    case FOR_STMT:
+      replace_in_block(replacement, stmt->for_stmt.block->node);
+      break;
+    case BLOCK_STMT:
+      replace_in_block(replacement, stmt);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void replace_scalar_arrays(struct vector *program) {
+  struct name_collector collector = {.names = hash_table_init(),
+                                     .declared_names = hash_table_init(),
+                                     .redeclared_names = hash_table_init(),
+                                     .fn_defs = NULL};
+  collect_names(&collector, program);
+  struct scalar_replacement replacement = {
+      .declared_names = collector.declared_names,
+      .redeclared_names = collector.redeclared_names,
+      .assigned_names = collector.names,
+      .references = hash_table_init(),
+      .id = NULL,
+      .num_elements = 0,
+      .num_scalar_uses = 0,
+      .is_replacing = false};
+  for (size_t i = 0; i < program->size; i++) {
+    count_statement(&replacement, vector_at(program, i));
+  }
+  replace_in_statements(&replacement, program);
+  hash_table_free(replacement.references);
+  hash_table_free(collector.names);
+  hash_table_free(collector.declared_names);
+  hash_table_free(collector.redeclared_names);
+}
@@ -1,88 +1,152 @@
 #include "hash_table.h"
+#include "pool.h"
 
-unsigned int hash(const char *key) {
-  unsigned int hash = 0;
-  for (int i = 0; key[i] != '\0'; i++) {
-    hash = hash * 31 + key[i];
+/* FNV-1a, followed by the finalizer of MurmurHash3 so that the low bits used
+ * to pick a slot depend on every character */
+uint64_t hash(const char *key) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; key[i] != '\0'; i++) {
+    hash ^= (unsigned char)key[i];
+    hash *= 0x100000001b3;
   }
-  return hash % HASH_TABLE_CAPACITY;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccd;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53;
+  hash ^= hash >> 33;
+  return hash;
 }
 
 struct hash_table *hash_table_init() {
-  struct hash_table *table = malloc(sizeof(struct hash_table));
+  struct hash_table *table = pool_alloc(POOL_HASH_TABLE);
   if (!table) {
     return NULL;
   }
-  for (size_t i = 0; i < HASH_TABLE_CAPACITY; i++) {
-    table->buckets[i] = NULL;
-  }
+  table->entries = NULL;
+  table->capacity = 0;
+  table->size = 0;
   return table;
 }
 
-void *hash_table_lookup(struct hash_table *table, const char *key) {
-  unsigned int index = hash(key);
-  struct hash_node *node = table->buckets[index];
-  while (node) {
-    if (strcmp(node->key, key) == 0) {
-      return node->value;
+/* Returns the slot holding `key`, or NULL */
+static struct hash_entry *hash_table_find(struct hash_table *table,
+                                          const char *key) {
+  if (table->size == 0) {
+    return NULL;
+  }
+  uint32_t key_hash = hash(key);
+  uint32_t mask = table->capacity - 1;
+  uint32_t i = key_hash & mask;
+  for (uint32_t distance = 0;; distance++) {
+    struct hash_entry *entry = &table->entries[i];
+    if (!entry->key || entry->distance < distance) {
+      return NULL;
     }
-    node = node->next;
+    if (entry->hash == key_hash && strcmp(entry->key, key) == 0) {
+      return entry;
+    }
+    i = (i + 1) & mask;
   }
-  return NULL;
 }
 
-void hash_table_insert(struct hash_table *table, const char *key, void *value) {
-  unsigned int index = hash(key);
-  struct hash_node *new_node = malloc(sizeof(struct hash_node));
-  if (!new_node) {
-    perror("Hash table node allocation memory error\n");
+/* Places `entry`, whose key is not in the table, swapping it with the
+ * entries closer to their home slot on the way */
+static void hash_table_place(struct hash_table *table,
+                             struct hash_entry entry) {
+  uint32_t mask = table->capacity - 1;
+  entry.distance = 0;
+  for (uint32_t i = entry.hash & mask;; i = (i + 1) & mask) {
+    struct hash_entry *slot = &table->entries[i];
+    if (!slot->key) {
+      *slot = entry;
+      table->size++;
+      return;
+    }
+    if (slot->distance < entry.distance) {
+      struct hash_entry displaced = *slot;
+      *slot = entry;
+      entry = displaced;
+    }
+    entry.distance++;
+  }
+}
+
+static void hash_table_grow(struct hash_table *table) {
+  struct hash_entry *entries = table->entries;
+  uint32_t capacity = table->capacity;
+  table->capacity = capacity ? capacity * 2 : HASH_TABLE_INITIAL_CAPACITY;
+  table->entries = calloc(table->capacity, sizeof(struct hash_entry));
+  if (!table->entries) {
+    perror("Hash table entries allocation memory error\n");
     exit(1);
   }
-  new_node->key = key;
-  new_node->value = value;
-  new_node->next = table->buckets[index];
-  table->buckets[index] = new_node;
+  table->size = 0;
+  for (uint32_t i = 0; i < capacity; i++) {
+    if (entries[i].key) {
+      hash_table_place(table, entries[i]);
+    }
+  }
+  free(entries);
+}
+
+void *hash_table_lookup(struct hash_table *table, const char *key) {
+  struct hash_entry *entry = hash_table_find(table, key);
+  return entry ? entry->value : NULL;
+}
+
+void hash_table_insert(struct hash_table *table, const char *key, void *value) {
+  struct hash_entry *entry = hash_table_find(table, key);
+  if (entry) {
+    entry->value = value;
+    return;
+  }
+  if (table->size + 1 > table->capacity * HASH_TABLE_MAX_LOAD) {
+    hash_table_grow(table);
+  }
+  hash_table_place(table, (struct hash_entry){
+                              .key = key, .value = value, .hash = hash(key)});
 }
 
 void hash_table_update(struct hash_table *table, const char *key, void *value) {
-  unsigned int index = hash(key);
-  struct hash_node *node = table->buckets[index];
-  while (node) {
-    if (strcmp(node->key, key) == 0) {
-      node->value = value;
-      return;
-    }
-    node = node->next;
+  struct hash_entry *entry = hash_table_find(table, key);
+  if (entry) {
+    entry->value = value;
   }
 }
 
 void hash_table_delete(struct hash_table *table, const char *key) {
-  unsigned int index = hash(key);
-  struct hash_node *node = table->buckets[index];
-  struct hash_node *prev = NULL;
-  while (node) {
-    if (strcmp(node->key, key) == 0) {
-      if (prev) {
-        prev->next = node->next;
-      } else {
-        table->buckets[index] = node->next;
-      }
-      free(node);
-      return;
-    }
-    prev = node;
-    node = node->next;
+  struct hash_entry *entry = hash_table_find(table, key);
+  if (!entry) {
+    return;
   }
+  /* Shift the entries displaced by this one back towards their home slot */
+  uint32_t mask = table->capacity - 1;
+  uint32_t i = entry - table->entries;
+  for (uint32_t next = (i + 1) & mask;
+       table->entries[next].key && table->entries[next].distance > 0;
+       i = next, next = (next + 1) & mask) {
+    table->entries[i] = table->entries[next];
+    table->entries[i].distance--;
+  }
+  table->entries[i].key = NULL;
+  table->size--;
 }
 
-void hash_table_free(struct hash_table *table) {
-  for (size_t i = 0; i < HASH_TABLE_CAPACITY; i++) {
-    struct hash_node *node = table->buckets[i];
-    while (node) {
-      struct hash_node *next = node->next;
-      free(node);
-      node = next;
+bool hash_table_next(struct hash_table *table, size_t *index,
+                     const char **key, void **value) {
+  for (; *index < table->capacity; (*index)++) {
+    struct hash_entry *entry = &table->entries[*index];
+    if (entry->key) {
+      *key = entry->key;
+      *value = entry->value;
+      (*index)++;
+      return true;
     }
   }
-  free(table);
+  return false;
+}
+
+void hash_table_free(struct hash_table *table) {
+  free(table->entries);
+  pool_free(POOL_HASH_TABLE, table);
 }
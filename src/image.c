@@ -0,0 +1,604 @@
+#include "image.h"
+#include "ast.h"
+#include "builtin_functions.h"
+#include "closure.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "interpreter.h"
+#include "vector.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IMAGE_SIZE_CLASS(size)                                                 \
+  (((size) + IMAGE_ALIGNMENT - 1) & ~(size_t)(IMAGE_ALIGNMENT - 1))
+/* Offset in the image of `field`, in the `type` copied at `offset` */
+#define IMAGE_FIELD(offset, type, field) ((offset) + offsetof(type, field))
+
+/* Elements of the vectors of the runtime, see `write_vector` */
+enum image_item_type {
+  IMAGE_ITEM_CHARS,   /* char* */
+  IMAGE_ITEM_RESULT,  /* result* of an ast_node */
+  IMAGE_ITEM_NODE,    /* ast_node* */
+  IMAGE_ITEM_UPVALUE, /* upvalue* */
+};
+
+static size_t write_object(struct image_writer *writer, struct object *obj);
+static size_t write_node(struct image_writer *writer, struct ast_node *node);
+
+static void *grow(void *buffer, size_t *capacity, size_t needed,
+                  size_t item_size) {
+  if (needed <= *capacity) {
+    return buffer;
+  }
+  while (*capacity < needed) {
+    *capacity = *capacity ? *capacity * 2 : 1024;
+  }
+  buffer = realloc(buffer, *capacity * item_size);
+  if (!buffer) {
+    perror("Image allocation memory error\n");
+    exit(1);
+  }
+  return buffer;
+}
+
+/* Reserves `size` zeroed bytes at the end of the image */
+static size_t image_alloc(struct image_writer *writer, size_t size) {
+  size_t offset = writer->size;
+  size_t new_size = offset + IMAGE_SIZE_CLASS(size);
+  size_t old_capacity = writer->capacity;
+  writer->buffer = grow(writer->buffer, &writer->capacity, new_size, 1);
+  memset(writer->buffer + old_capacity, 0, writer->capacity - old_capacity);
+  writer->size = new_size;
+  return offset;
+}
+
+static size_t copy_slot(struct image_writer *writer, const void *address) {
+  size_t mask = writer->copies_capacity - 1;
+  size_t slot = ((uintptr_t)address >> 3) * 0x9E3779B97F4A7C15ull >> 32;
+  for (slot &= mask; writer->copies[slot].address &&
+                     writer->copies[slot].address != address;
+       slot = (slot + 1) & mask) {
+  }
+  return slot;
+}
+
+/* Offset of the copy of `address`, or 0 when it was not copied yet */
+static size_t image_find(struct image_writer *writer, const void *address) {
+  if (!writer->copies_capacity) {
+    return 0;
+  }
+  return writer->copies[copy_slot(writer, address)].offset;
+}
+
+static void image_remember(struct image_writer *writer, const void *address,
+                           size_t offset) {
+  if ((writer->num_copies + 1) * 2 > writer->copies_capacity) {
+    struct image_copy *old_copies = writer->copies;
+    size_t old_capacity = writer->copies_capacity;
+    writer->copies_capacity = old_capacity ? old_capacity * 2 : 1024;
+    writer->copies =
+        calloc(writer->copies_capacity, sizeof(struct image_copy));
+    if (!writer->copies) {
+      perror("Image allocation memory error\n");
+      exit(1);
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_copies[i].address) {
+        writer->copies[copy_slot(writer, old_copies[i].address)] =
+            old_copies[i];
+      }
+    }
+    free(old_copies);
+  }
+  struct image_copy *copy = &writer->copies[copy_slot(writer, address)];
+  copy->address = address;
+  copy->offset = offset;
+  writer->num_copies++;
+}
+
+/* Copies the `size` bytes at `address` to the end of the image. The pointers
+ * of the copy must then all be set with `image_link`. */
+static size_t image_copy(struct image_writer *writer, const void *address,
+                         size_t size) {
+  size_t offset = image_alloc(writer, size);
+  memcpy(writer->buffer + offset, address, size);
+  image_remember(writer, address, offset);
+  return offset;
+}
+
+static void image_relocate(struct image_writer *writer, size_t slot,
+                           enum image_relocation_type type) {
+  writer->relocations =
+      grow(writer->relocations, &writer->relocations_capacity,
+           writer->num_relocations + 1, sizeof(struct image_relocation));
+  writer->relocations[writer->num_relocations++] =
+      (struct image_relocation){.offset = slot, .type = type};
+}
+
+static void image_set(struct image_writer *writer, size_t slot,
+                      uint64_t value) {
+  memcpy(writer->buffer + slot, &value, sizeof(value));
+}
+
+/* Points the pointer at `slot` to the structure at `target`, or sets it to
+ * NULL when `target` is 0 */
+static void image_link(struct image_writer *writer, size_t slot,
+                       size_t target) {
+  image_set(writer, slot, target);
+  if (target) {
+    image_relocate(writer, slot, IMAGE_RELOCATION_POINTER);
+  }
+}
+
+static size_t write_chars(struct image_writer *writer, const char *chars) {
+  if (!chars) {
+    return 0;
+  }
+  size_t offset = image_find(writer, chars);
+  return offset ? offset : image_copy(writer, chars, strlen(chars) + 1);
+}
+
+static size_t write_string(struct image_writer *writer,
+                           struct string *string) {
+  size_t offset = image_find(writer, string);
+  return offset ? offset
+                : image_copy(writer, string,
+                             sizeof(struct string) + string->length + 1);
+}
+
+static size_t write_result(struct image_writer *writer,
+                           struct result *result) {
+  if (!result) {
+    return 0;
+  }
+  size_t offset = image_find(writer, result);
+  if (offset) {
+    return offset;
+  }
+  offset = image_copy(writer, result, sizeof(struct result));
+  image_link(writer, IMAGE_FIELD(offset, struct result, node),
+             write_node(writer, result->node));
+  return offset;
+}
+
+static size_t write_upvalue(struct image_writer *writer,
+                            struct upvalue *upvalue) {
+  size_t offset = image_find(writer, upvalue);
+  if (offset) {
+    return offset;
+  }
+  offset = image_copy(writer, upvalue, sizeof(struct upvalue));
+  image_link(writer, IMAGE_FIELD(offset, struct upvalue, id),
+             write_chars(writer, upvalue->id));
+  /* Closed in the image, whether or not its environment is still there */
+  image_link(writer, IMAGE_FIELD(offset, struct upvalue, env), 0);
+  image_link(writer, IMAGE_FIELD(offset, struct upvalue, closed),
+             write_object(writer, upvalue_get(upvalue)));
+  image_link(writer, IMAGE_FIELD(offset, struct upvalue, next), 0);
+  return offset;
+}
+
+static size_t write_item(struct image_writer *writer, void *item,
+                         enum image_item_type item_type) {
+  switch (item_type) {
+  case IMAGE_ITEM_CHARS:
+    return write_chars(writer, item);
+  case IMAGE_ITEM_RESULT:
+    return write_result(writer, item);
+  case IMAGE_ITEM_NODE:
+    return write_node(writer, item);
+  case IMAGE_ITEM_UPVALUE:
+    return write_upvalue(writer, item);
+  }
+  return 0;
+}
+
+/* Copies the vector with its buffer cut down to its size, since nothing
+ * grows the vectors of a syntax tree or a function once they are built */
+static size_t write_vector(struct image_writer *writer, struct vector *vector,
+                           enum image_item_type item_type) {
+  if (!vector) {
+    return 0;
+  }
+  size_t offset = image_find(writer, vector);
+  if (offset) {
+    return offset;
+  }
+  offset = image_copy(writer, vector, sizeof(struct vector));
+  size_t buffer = 0;
+  if (vector->size) {
+    buffer = image_alloc(writer, vector->size * sizeof(void *));
+    for (size_t i = 0; i < vector->size; i++) {
+      image_link(writer, buffer + i * sizeof(void *),
+                 write_item(writer, vector_at(vector, i), item_type));
+    }
+  }
+  image_link(writer, IMAGE_FIELD(offset, struct vector, _internal_buffer),
+             buffer);
+  image_set(writer, IMAGE_FIELD(offset, struct vector, capacity),
+            vector->size);
+  return offset;
+}
+
+static void write_primary_node(struct image_writer *writer,
+                               struct ast_node *node, size_t offset) {
+  switch (node->primary_node_type) {
+  case STRING_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, string),
+               write_string(writer, node->string));
+    break;
+  case IDENTIFIER_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, id),
+               write_chars(writer, node->id));
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, fn_call.primary),
+               write_result(writer, node->fn_call.primary));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, fn_call.parameters),
+               write_vector(writer, node->fn_call.parameters,
+                            IMAGE_ITEM_RESULT));
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, method_call.object),
+               write_result(writer, node->method_call.object));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, method_call.member),
+               write_result(writer, node->method_call.member));
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, array),
+               write_vector(writer, node->array, IMAGE_ITEM_RESULT));
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, array_access.primary),
+               write_result(writer, node->array_access.primary));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, array_access.index),
+               write_result(writer, node->array_access.index));
+    break;
+  case INVARIANT_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, invariant.expr),
+               write_result(writer, node->invariant.expr));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, invariant.value),
+               0);
+    break;
+  case SAVED_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, saved.expr),
+               write_result(writer, node->saved.expr));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, saved.value), 0);
+    break;
+  case REUSED_PRIMARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, reused),
+               write_node(writer, node->reused));
+    break;
+  default:
+    /* Numbers, booleans and nil only hold their `literal` */
+    break;
+  }
+}
+
+static size_t write_node(struct image_writer *writer, struct ast_node *node) {
+  if (!node) {
+    return 0;
+  }
+  size_t offset = image_find(writer, node);
+  if (offset) {
+    return offset;
+  }
+  offset = image_copy(writer, node, sizeof(struct ast_node));
+  image_link(writer, IMAGE_FIELD(offset, struct ast_node, profile_site), 0);
+  image_link(writer, IMAGE_FIELD(offset, struct ast_node, literal),
+             write_object(writer, node->literal));
+  switch (node->node_type) {
+  case FN_DEF_STMT:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, fn_def_stmt.id),
+               write_chars(writer, node->fn_def_stmt.id));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, fn_def_stmt.parameters),
+               write_vector(writer, node->fn_def_stmt.parameters,
+                            IMAGE_ITEM_CHARS));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, fn_def_stmt.block),
+               write_result(writer, node->fn_def_stmt.block));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, fn_def_stmt.free_names),
+               write_vector(writer, node->fn_def_stmt.free_names,
+                            IMAGE_ITEM_CHARS));
+    break;
+  case EXPR_STMT:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, expr_stmt_expr),
+               write_result(writer, node->expr_stmt_expr));
+    break;
+  case RETURN_STMT:
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, return_stmt_expr),
+               write_result(writer, node->return_stmt_expr));
+    break;
+  case VARIABLE_DECL_STMT:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, var_decl_stmt.id),
+               write_chars(writer, node->var_decl_stmt.id));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, var_decl_stmt.expr),
+               write_result(writer, node->var_decl_stmt.expr));
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, var_assign_stmt.primary),
+               write_result(writer, node->var_assign_stmt.primary));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, var_assign_stmt.expr),
+               write_result(writer, node->var_assign_stmt.expr));
+    break;
+  case IF_STMT:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, if_else_stmt.expr),
+               write_result(writer, node->if_else_stmt.expr));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, if_else_stmt.if_block),
+               write_result(writer, node->if_else_stmt.if_block));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, if_else_stmt.else_block),
+               write_result(writer, node->if_else_stmt.else_block));
+    break;
+  case WHILE_STMT:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, while_stmt.expr),
+               write_result(writer, node->while_stmt.expr));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, while_stmt.block),
+               write_result(writer, node->while_stmt.block));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, while_stmt.trace),
+               0);
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, while_stmt.invariants),
+               write_vector(writer, node->while_stmt.invariants,
+                            IMAGE_ITEM_NODE));
+    break;
+  case FOR_STMT:
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, for_stmt.init_stmt),
+               write_result(writer, node->for_stmt.init_stmt));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, for_stmt.expr_stmt),
+               write_result(writer, node->for_stmt.expr_stmt));
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, for_stmt.update_stmt),
+               write_result(writer, node->for_stmt.update_stmt));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, for_stmt.block),
+               write_result(writer, node->for_stmt.block));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, for_stmt.trace),
+               0);
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, for_stmt.invariants),
+               write_vector(writer, node->for_stmt.invariants,
+                            IMAGE_ITEM_NODE));
+    break;
+  case BLOCK_STMT:
+    image_link(writer,
+               IMAGE_FIELD(offset, struct ast_node, block_stmt_stmts),
+               write_vector(writer, node->block_stmt_stmts, IMAGE_ITEM_NODE));
+    break;
+  case BINARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, binary.left),
+               write_result(writer, node->binary.left));
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, binary.right),
+               write_result(writer, node->binary.right));
+    break;
+  case UNARY_NODE:
+    image_link(writer, IMAGE_FIELD(offset, struct ast_node, unary.primary),
+               write_result(writer, node->unary.primary));
+    break;
+  case PRIMARY_NODE:
+    write_primary_node(writer, node, offset);
+    break;
+  default:
+    break;
+  }
+  return offset;
+}
+
+static size_t write_function(struct image_writer *writer,
+                             struct function *function) {
+  size_t offset = image_find(writer, function);
+  if (offset) {
+    return offset;
+  }
+  offset = image_copy(writer, function, sizeof(struct function));
+  image_link(writer, IMAGE_FIELD(offset, struct function, id),
+             write_chars(writer, function->id));
+  image_link(writer, IMAGE_FIELD(offset, struct function, parameters),
+             write_vector(writer, function->parameters, IMAGE_ITEM_CHARS));
+  image_link(writer, IMAGE_FIELD(offset, struct function, upvalues),
+             write_vector(writer, function->upvalues, IMAGE_ITEM_UPVALUE));
+  image_link(writer, IMAGE_FIELD(offset, struct function, body),
+             write_node(writer, function->body));
+  image_link(writer, IMAGE_FIELD(offset, struct function, native_body), 0);
+  image_link(writer, IMAGE_FIELD(offset, struct function, chunk), 0);
+  image_link(writer, IMAGE_FIELD(offset, struct function, memo), 0);
+  return offset;
+}
+
+/* Copies the elements of an array, with the block cut down to its size */
+static size_t write_array(struct image_writer *writer, struct array *array) {
+  size_t offset = image_alloc(writer, sizeof(struct array) +
+                                          array->size * sizeof(void *));
+  struct array header = {.size = array->size, .capacity = array->size};
+  memcpy(writer->buffer + offset, &header, sizeof(header));
+  for (size_t i = 0; i < array->size; i++) {
+    image_link(writer,
+               offset + offsetof(struct array, items) + i * sizeof(void *),
+               write_object(writer, array->items[i]));
+  }
+  return offset;
+}
+
+static size_t write_object(struct image_writer *writer, struct object *obj) {
+  if (!obj) {
+    return 0;
+  }
+  size_t offset = image_find(writer, obj);
+  if (offset) {
+    return offset;
+  }
+  offset = image_copy(writer, obj, sizeof(struct object));
+  switch (obj->data_type) {
+  case STRING_VALUE:
+    image_link(writer, IMAGE_FIELD(offset, struct object, string_value),
+               write_string(writer, obj->string_value));
+    break;
+  case ARRAY_VALUE:
+    writer->buffer[IMAGE_FIELD(offset, struct object, is_in_image)] = true;
+    image_link(writer, IMAGE_FIELD(offset, struct object, array_value),
+               write_array(writer, obj->array_value));
+    break;
+  case FUNCTION_VALUE:
+    if (obj->is_builtin) {
+      /* By name, the loading process looks it up in its own builtins */
+      size_t slot = IMAGE_FIELD(offset, struct object, function_value);
+      image_set(writer, slot,
+                write_chars(writer,
+                            obj->function_value.builtin_function->fn_name));
+      image_relocate(writer, slot, IMAGE_RELOCATION_BUILTIN);
+    } else {
+      image_link(writer, IMAGE_FIELD(offset, struct object, function_value),
+                 write_function(writer, obj->function_value.function_value));
+    }
+    break;
+  default:
+    /* Integers, booleans and nil hold no pointer */
+    break;
+  }
+  return offset;
+}
+
+bool image_write(struct environment *globals, const char *file_name) {
+  struct image_writer writer = {0};
+  size_t header = image_alloc(&writer, sizeof(struct image_header));
+  size_t num_globals = 0;
+  size_t index = 0;
+  const char *key;
+  void *value;
+  while (globals->symbols &&
+         hash_table_next(globals->symbols, &index, &key, &value)) {
+    num_globals++;
+  }
+  size_t image_globals =
+      image_alloc(&writer, num_globals * sizeof(struct image_global));
+  index = 0;
+  for (size_t i = 0; i < num_globals; i++) {
+    hash_table_next(globals->symbols, &index, &key, &value);
+    size_t global = image_globals + i * sizeof(struct image_global);
+    image_link(&writer, IMAGE_FIELD(global, struct image_global, id),
+               write_chars(&writer, key));
+    image_link(&writer, IMAGE_FIELD(global, struct image_global, value),
+               write_object(&writer, value));
+  }
+  size_t relocations = writer.size;
+  size_t relocations_size =
+      writer.num_relocations * sizeof(struct image_relocation);
+  struct image_header image_header = {
+      .magic = IMAGE_MAGIC,
+      .version = IMAGE_FORMAT_VERSION,
+      .size = relocations + relocations_size,
+      .globals = image_globals,
+      .num_globals = num_globals,
+      .relocations = relocations,
+      .num_relocations = writer.num_relocations};
+  memcpy(writer.buffer + header, &image_header, sizeof(image_header));
+
+  FILE *file = fopen(file_name, "wb");
+  bool is_written =
+      file &&
+      fwrite(writer.buffer, 1, writer.size, file) == writer.size &&
+      fwrite(writer.relocations, 1, relocations_size, file) ==
+          relocations_size;
+  if (file && fclose(file) != 0) {
+    is_written = false;
+  }
+  if (!is_written) {
+    perror("Error writing image");
+  }
+  free(writer.buffer);
+  free(writer.relocations);
+  free(writer.copies);
+  return is_written;
+}
+
+static struct environment *image_error(const char *file_name,
+                                       const char *message) {
+  fprintf(stderr, "Error loading image '%s': %s\n", file_name, message);
+  return NULL;
+}
+
+struct environment *image_load(const char *file_name) {
+  int fd = open(file_name, O_RDONLY);
+  if (fd < 0) {
+    perror("Error opening image");
+    return NULL;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0 ||
+      (size_t)file_stat.st_size < sizeof(struct image_header)) {
+    close(fd);
+    return image_error(file_name, "not an image");
+  }
+  size_t size = file_stat.st_size;
+  /* Private, so that relocating and running the program copy the pages they
+   * write to, and never change the file */
+  char *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("Error mapping image");
+    return NULL;
+  }
+  struct image_header *header = (struct image_header *)base;
+  if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+      header->version != IMAGE_FORMAT_VERSION || header->size != size ||
+      header->relocations < sizeof(struct image_header) ||
+      header->relocations > size ||
+      header->num_relocations >
+          (size - header->relocations) / sizeof(struct image_relocation) ||
+      header->globals > size ||
+      header->num_globals >
+          (size - header->globals) / sizeof(struct image_global)) {
+    munmap(base, size);
+    return image_error(file_name, "not an image of this version of jix");
+  }
+
+  struct hash_table *builtin_fns = init_and_register_builtin_fns();
+  struct image_relocation *relocations =
+      (struct image_relocation *)(base + header->relocations);
+  for (size_t i = 0; i < header->num_relocations; i++) {
+    uint64_t slot = relocations[i].offset;
+    uint64_t target;
+    if (slot > header->relocations - sizeof(target)) {
+      munmap(base, size);
+      return image_error(file_name, "relocation out of bounds");
+    }
+    memcpy(&target, base + slot, sizeof(target));
+    if (target >= header->relocations) {
+      munmap(base, size);
+      return image_error(file_name, "relocation out of bounds");
+    }
+    void *pointer = base + target;
+    if (relocations[i].type == IMAGE_RELOCATION_BUILTIN) {
+      pointer = lookup_builtin_fns(builtin_fns, base + target);
+    }
+    memcpy(base + slot, &pointer, sizeof(pointer));
+  }
+  hash_table_free(builtin_fns);
+
+  struct environment *globals = environment_init();
+  struct image_global *image_globals =
+      (struct image_global *)(base + header->globals);
+  for (size_t i = 0; i < header->num_globals; i++) {
+    environment_insert_symbol(globals, image_globals[i].id,
+                              image_globals[i].value);
+  }
+  return globals;
+}
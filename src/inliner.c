@@ -0,0 +1,675 @@
+#include "inliner.h"
+#include "ast.h"
+#include "closure.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "optimizer.h"
+#include "utils.h"
+#include "vector.h"
+#include <string.h>
+
+static void analyze_statement(struct inliner *inliner,
+                              struct inline_candidate *owner,
+                              struct ast_node *stmt, size_t loop_depth,
+                              bool is_last);
+static struct ast_node *copy_statement(struct inliner *inliner,
+                                       struct ast_node *stmt);
+static struct ast_node *copy_expression(struct inliner *inliner,
+                                        struct ast_node *expr);
+static void inline_statement(struct inliner *inliner, struct ast_node *stmt,
+                             struct vector *out);
+
+/* Scope entry of a name which is declared in the caller */
+static int declared;
+
+static void analyze_expressions(struct inliner *inliner,
+                                struct inline_candidate *owner,
+                                struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    analyze_statement(inliner, owner, val->node, 0, false);
+  }
+}
+
+/* Returns true if `block` declares a name twice, which fails at runtime with
+ * the name of the local: renamed, it would no longer be the source's */
+static bool declares_twice(struct ast_node *block) {
+  struct hash_table *names = hash_table_init();
+  bool is_twice = false;
+  for (size_t i = 0; i < block->block_stmt_stmts->size && !is_twice; i++) {
+    struct ast_node *stmt = vector_at(block->block_stmt_stmts, i);
+    if (stmt->node_type != VARIABLE_DECL_STMT) {
+      continue;
+    }
+    is_twice = hash_table_lookup(names, stmt->var_decl_stmt.id) != NULL;
+    hash_table_insert(names, stmt->var_decl_stmt.id, &declared);
+  }
+  hash_table_free(names);
+  return is_twice;
+}
+
+static void analyze_block(struct inliner *inliner,
+                          struct inline_candidate *owner,
+                          struct ast_node *block, size_t loop_depth) {
+  if (owner && declares_twice(block)) {
+    owner->is_inlinable = false;
+  }
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    analyze_statement(inliner, owner, vector_at(block->block_stmt_stmts, i),
+                      loop_depth, false);
+  }
+}
+
+/* Counts call sites of the candidates and, inside the body of `owner`, its
+ * size and whatever keeps it from being inlined. `is_last` is set for the
+ * last statement of the body. */
+static void analyze_statement(struct inliner *inliner,
+                              struct inline_candidate *owner,
+                              struct ast_node *stmt, size_t loop_depth,
+                              bool is_last) {
+  if (owner) {
+    owner->body_size++;
+  }
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    if (owner) {
+      owner->is_inlinable = false;
+    }
+    analyze_block(inliner, owner, stmt->fn_def_stmt.block->node, 0);
+    return;
+  case VARIABLE_DECL_STMT:
+    analyze_statement(inliner, owner, stmt->var_decl_stmt.expr->node, 0,
+                      false);
+    return;
+  case VARIABLE_ASSIGN_STMT:
+    analyze_statement(inliner, owner, stmt->var_assign_stmt.primary->node, 0,
+                      false);
+    analyze_statement(inliner, owner, stmt->var_assign_stmt.expr->node, 0,
+                      false);
+    return;
+  case IF_STMT:
+    analyze_statement(inliner, owner, stmt->if_else_stmt.expr->node, 0, false);
+    analyze_block(inliner, owner, stmt->if_else_stmt.if_block->node,
+                  loop_depth);
+    if (stmt->if_else_stmt.else_block) {
+      analyze_block(inliner, owner, stmt->if_else_stmt.else_block->node,
+                    loop_depth);
+    }
+    return;
+  case WHILE_STMT:
+    analyze_statement(inliner, owner, stmt->while_stmt.expr->node, 0, false);
+    analyze_block(inliner, owner, stmt->while_stmt.block->node,
+                  loop_depth + 1);
+    return;
+  case FOR_STMT:
+    analyze_statement(inliner, owner, stmt->for_stmt.init_stmt->node, 0,
+                      false);
+    analyze_statement(inliner, owner, stmt->for_stmt.expr_stmt->node, 0,
+                      false);
+    analyze_statement(inliner, owner, stmt->for_stmt.update_stmt->node, 0,
+                      false);
+    analyze_block(inliner, owner, stmt->for_stmt.block->node, loop_depth + 1);
+    return;
+  case BREAK_STMT:
+    /* A 'break' outside of a loop would leave the caller's loop */
+    if (owner && loop_depth == 0) {
+      owner->is_inlinable = false;
+    }
+    return;
+  case RETURN_STMT:
+    if (owner && !is_last) {
+      owner->is_inlinable = false;
+    }
+    analyze_statement(inliner, owner, stmt->return_stmt_expr->node, 0, false);
+    return;
+  case BLOCK_STMT:
+    analyze_block(inliner, owner, stmt, loop_depth);
+    return;
+  case EXPR_STMT:
+    analyze_statement(inliner, owner, stmt->expr_stmt_expr->node, 0, false);
+    return;
+  case BINARY_NODE:
+    analyze_statement(inliner, owner, stmt->binary.left->node, 0, false);
+    analyze_statement(inliner, owner, stmt->binary.right->node, 0, false);
+    return;
+  case UNARY_NODE:
+    analyze_statement(inliner, owner, stmt->unary.primary->node, 0, false);
+    return;
+  default:
+    break;
+  }
+  switch (stmt->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE:
+    if (owner && strcmp(stmt->id, owner->fn_def->fn_def_stmt.id) == 0) {
+      owner->is_inlinable = false;
+    }
+    break;
+  case FN_CALL_PRIMARY_NODE: {
+    struct ast_node *callee = stmt->fn_call.primary->node;
+    if (callee->node_type == PRIMARY_NODE &&
+        callee->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+      struct inline_candidate *candidate =
+          hash_table_lookup(inliner->candidates, callee->id);
+      if (candidate) {
+        candidate->num_call_sites++;
+      }
+    }
+    analyze_statement(inliner, owner, callee, 0, false);
+    analyze_expressions(inliner, owner, stmt->fn_call.parameters);
+    break;
+  }
+  case METHOD_CALL_PRIMARY_NODE:
+    analyze_statement(inliner, owner, stmt->method_call.object->node, 0,
+                      false);
+    if (stmt->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      analyze_expressions(inliner, owner,
+                          stmt->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    analyze_expressions(inliner, owner, stmt->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    analyze_statement(inliner, owner, stmt->array_access.primary->node, 0,
+                      false);
+    analyze_statement(inliner, owner, stmt->array_access.index->node, 0,
+                      false);
+    break;
+  default:
+    break;
+  }
+}
+
+/* New node, attributed to the lines of the call site */
+static struct ast_node *new_node(struct inliner *inliner,
+                                 enum ast_node_type node_type) {
+  struct ast_node *node = calloc(1, sizeof(struct ast_node));
+  node->node_type = node_type;
+  node->source_position.start_line = inliner->site->source_position.start_line;
+  node->source_position.end_line = inliner->site->source_position.end_line;
+  return node;
+}
+
+static void push_renames(struct inliner *inliner) {
+  vector_push_back(inliner->renames, hash_table_init());
+}
+
+static void pop_renames(struct inliner *inliner) {
+  hash_table_free(vector_at(inliner->renames, inliner->renames->size - 1));
+  inliner->renames->size--;
+}
+
+/* Name of a local of the body being copied, after renaming */
+static char *renamed(struct inliner *inliner, char *id) {
+  for (size_t i = inliner->renames->size; i > 0; i--) {
+    char *new_id = hash_table_lookup(vector_at(inliner->renames, i - 1), id);
+    if (new_id) {
+      return new_id;
+    }
+  }
+  return id;
+}
+
+static char *rename_declaration(struct inliner *inliner, char *id) {
+  struct hash_table *scope =
+      vector_at(inliner->renames, inliner->renames->size - 1);
+  char *new_id = format_string("%s$%zu", id, ++inliner->num_renamed);
+  hash_table_insert(scope, id, new_id);
+  return new_id;
+}
+
+static struct result *copy_expression_result(struct inliner *inliner,
+                                             struct result *expr) {
+  return result_ok_node(copy_expression(inliner, expr->node));
+}
+
+static struct vector *copy_expressions(struct inliner *inliner,
+                                       struct vector *expressions) {
+  struct vector *copy = vector_init();
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    vector_push_back(copy, copy_expression_result(inliner, val));
+  }
+  return copy;
+}
+
+static struct ast_node *copy_expression(struct inliner *inliner,
+                                        struct ast_node *expr) {
+  struct ast_node *copy = new_node(inliner, expr->node_type);
+  copy->primary_node_type = expr->primary_node_type;
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    copy->binary.op = expr->binary.op;
+    copy->binary.left = copy_expression_result(inliner, expr->binary.left);
+    copy->binary.right = copy_expression_result(inliner, expr->binary.right);
+    return copy;
+  case UNARY_NODE:
+    copy->unary.op = expr->unary.op;
+    copy->unary.primary = copy_expression_result(inliner, expr->unary.primary);
+    return copy;
+  default:
+    break;
+  }
+  copy->literal = expr->literal;
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+    copy->number = expr->number;
+    break;
+  case STRING_PRIMARY_NODE:
+    copy->string = expr->string;
+    break;
+  case IDENTIFIER_PRIMARY_NODE:
+    copy->id = renamed(inliner, expr->id);
+    break;
+  case BOOLEAN_PRIMARY_NODE:
+    copy->boolean = expr->boolean;
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    copy->fn_call.primary =
+        copy_expression_result(inliner, expr->fn_call.primary);
+    copy->fn_call.parameters =
+        copy_expressions(inliner, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE: {
+    copy->method_call.object =
+        copy_expression_result(inliner, expr->method_call.object);
+    struct ast_node *member = expr->method_call.member->node;
+    struct ast_node *member_copy = new_node(inliner, member->node_type);
+    *member_copy = *member;
+    /* The method name is not a variable, and is never renamed */
+    if (member->primary_node_type == FN_CALL_PRIMARY_NODE) {
+      member_copy->fn_call.parameters =
+          copy_expressions(inliner, member->fn_call.parameters);
+    }
+    member_copy->source_position = copy->source_position;
+    member_copy->profile_site = NULL;
+    copy->method_call.member = result_ok_node(member_copy);
+    break;
+  }
+  case ARRAY_CREATION_PRIMARY_NODE:
+    copy->array = copy_expressions(inliner, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    copy->array_access.primary =
+        copy_expression_result(inliner, expr->array_access.primary);
+    copy->array_access.index =
+        copy_expression_result(inliner, expr->array_access.index);
+    break;
+  default:
+    break;
+  }
+  return copy;
+}
+
+static struct result *copy_statement_result(struct inliner *inliner,
+                                            struct result *stmt) {
+  return result_ok_node(copy_statement(inliner, stmt->node));
+}
+
+static struct result *copy_block(struct inliner *inliner,
+                                 struct result *block) {
+  struct ast_node *copy = new_node(inliner, BLOCK_STMT);
+  struct vector *stmts = block->node->block_stmt_stmts;
+  copy->block_stmt_stmts = vector_init();
+  push_renames(inliner);
+  for (size_t i = 0; i < stmts->size; i++) {
+    vector_push_back(copy->block_stmt_stmts,
+                     copy_statement(inliner, vector_at(stmts, i)));
+  }
+  pop_renames(inliner);
+  return result_ok_node(copy);
+}
+
+static struct ast_node *copy_statement(struct inliner *inliner,
+                                       struct ast_node *stmt) {
+  struct ast_node *copy = new_node(inliner, stmt->node_type);
+  switch (stmt->node_type) {
+  case VARIABLE_DECL_STMT:
+    /* The initializer does not see the name it initializes */
+    copy->var_decl_stmt.expr =
+        copy_expression_result(inliner, stmt->var_decl_stmt.expr);
+    copy->var_decl_stmt.id =
+        rename_declaration(inliner, stmt->var_decl_stmt.id);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    copy->var_assign_stmt.primary =
+        copy_expression_result(inliner, stmt->var_assign_stmt.primary);
+    copy->var_assign_stmt.expr =
+        copy_expression_result(inliner, stmt->var_assign_stmt.expr);
+    break;
+  case IF_STMT:
+    copy->if_else_stmt.expr =
+        copy_expression_result(inliner, stmt->if_else_stmt.expr);
+    copy->if_else_stmt.if_block =
+        copy_block(inliner, stmt->if_else_stmt.if_block);
+    if (stmt->if_else_stmt.else_block) {
+      copy->if_else_stmt.else_block =
+          copy_block(inliner, stmt->if_else_stmt.else_block);
+    }
+    break;
+  case WHILE_STMT:
+    copy->while_stmt.expr =
+        copy_expression_result(inliner, stmt->while_stmt.expr);
+    copy->while_stmt.block = copy_block(inliner, stmt->while_stmt.block);
+    break;
+  case FOR_STMT:
+    push_renames(inliner);
+    copy->for_stmt.init_stmt =
+        copy_statement_result(inliner, stmt->for_stmt.init_stmt);
+    copy->for_stmt.expr_stmt =
+        copy_statement_result(inliner, stmt->for_stmt.expr_stmt);
+    copy->for_stmt.update_stmt =
+        copy_statement_result(inliner, stmt->for_stmt.update_stmt);
+    copy->for_stmt.block = copy_block(inliner, stmt->for_stmt.block);
+    pop_renames(inliner);
+    break;
+  case RETURN_STMT:
+    copy->return_stmt_expr =
+        copy_expression_result(inliner, stmt->return_stmt_expr);
+    break;
+  case BLOCK_STMT: {
+    struct result block = {.type = RESULT_OK, .node = stmt};
+    return copy_block(inliner, &block)->node;
+  }
+  case EXPR_STMT:
+    copy->expr_stmt_expr =
+        copy_expression_result(inliner, stmt->expr_stmt_expr);
+    break;
+  default:
+    break;
+  }
+  return copy;
+}
+
+static bool is_declared(struct inliner *inliner, char *id) {
+  for (size_t i = inliner->scopes->size; i > 0; i--) {
+    if (hash_table_lookup(vector_at(inliner->scopes, i - 1), id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void declare_name(struct inliner *inliner, char *id) {
+  struct hash_table *scope =
+      vector_at(inliner->scopes, inliner->scopes->size - 1);
+  hash_table_insert(scope, id, &declared);
+}
+
+/* Returns true if the names the body of `fn_def` does not declare resolve to
+ * the program's environment at the call site too, as they do in the body */
+static bool resolves_the_same(struct inliner *inliner,
+                              struct ast_node *fn_def) {
+  struct vector *free_names = closure_find_free_names(fn_def);
+  bool is_same = true;
+  for (size_t i = 0; i < free_names->size && is_same; i++) {
+    char *id = vector_at(free_names, i);
+    for (size_t j = 1; j < inliner->scopes->size && is_same; j++) {
+      is_same = !hash_table_lookup(vector_at(inliner->scopes, j), id);
+    }
+  }
+  vector_free(free_names);
+  return is_same;
+}
+
+/* Returns the value slot of a statement which is a whole call to an inlinable
+ * function, or NULL */
+static struct result **call_site(struct inliner *inliner,
+                                 struct ast_node *stmt) {
+  struct result **value;
+  switch (stmt->node_type) {
+  case VARIABLE_DECL_STMT: {
+    /* Declaring an existing name fails before the call is made */
+    struct hash_table *scope =
+        vector_at(inliner->scopes, inliner->scopes->size - 1);
+    if (hash_table_lookup(scope, stmt->var_decl_stmt.id)) {
+      return NULL;
+    }
+    value = &stmt->var_decl_stmt.expr;
+    break;
+  }
+  case VARIABLE_ASSIGN_STMT: {
+    /* So does assigning to a name which does not exist */
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type != IDENTIFIER_PRIMARY_NODE ||
+        !is_declared(inliner, target->id)) {
+      return NULL;
+    }
+    value = &stmt->var_assign_stmt.expr;
+    break;
+  }
+  case RETURN_STMT:
+    value = &stmt->return_stmt_expr;
+    break;
+  case EXPR_STMT:
+    value = &stmt->expr_stmt_expr;
+    break;
+  default:
+    return NULL;
+  }
+  struct ast_node *call = (*value)->node;
+  if (call->node_type != PRIMARY_NODE ||
+      call->primary_node_type != FN_CALL_PRIMARY_NODE) {
+    return NULL;
+  }
+  struct ast_node *callee = call->fn_call.primary->node;
+  if (callee->node_type != PRIMARY_NODE ||
+      callee->primary_node_type != IDENTIFIER_PRIMARY_NODE) {
+    return NULL;
+  }
+  struct inline_candidate *candidate =
+      hash_table_lookup(inliner->visible, callee->id);
+  if (!candidate || !candidate->is_inlinable ||
+      call->fn_call.parameters->size !=
+          candidate->fn_def->fn_def_stmt.parameters->size) {
+    return NULL;
+  }
+  struct vector *body =
+      candidate->fn_def->fn_def_stmt.block->node->block_stmt_stmts;
+  bool has_return =
+      body->size > 0 &&
+      ((struct ast_node *)vector_at(body, body->size - 1))->node_type ==
+          RETURN_STMT;
+  if (!has_return && stmt->node_type != EXPR_STMT) {
+    return NULL;
+  }
+  return resolves_the_same(inliner, candidate->fn_def) ? value : NULL;
+}
+
+/* Appends the statements replacing the call of `stmt` to `out` */
+static void expand_call_site(struct inliner *inliner, struct ast_node *stmt,
+                             struct result **value, struct vector *out) {
+  struct ast_node *call = (*value)->node;
+  struct inline_candidate *candidate =
+      hash_table_lookup(inliner->visible, call->fn_call.primary->node->id);
+  struct ast_node *fn_def = candidate->fn_def;
+  inliner->site = stmt;
+  /* Arguments are evaluated in order, in the caller's scope, before the body
+   * runs */
+  push_renames(inliner);
+  for (size_t i = 0; i < call->fn_call.parameters->size; i++) {
+    struct ast_node *parameter = new_node(inliner, VARIABLE_DECL_STMT);
+    parameter->var_decl_stmt.expr = vector_at(call->fn_call.parameters, i);
+    parameter->var_decl_stmt.id = rename_declaration(
+        inliner, vector_at(fn_def->fn_def_stmt.parameters, i));
+    vector_push_back(out, parameter);
+  }
+  push_renames(inliner);
+  struct vector *body = fn_def->fn_def_stmt.block->node->block_stmt_stmts;
+  for (size_t i = 0; i < body->size; i++) {
+    struct ast_node *body_stmt = vector_at(body, i);
+    if (body_stmt->node_type == RETURN_STMT) {
+      *value = copy_expression_result(inliner, body_stmt->return_stmt_expr);
+      vector_push_back(out, stmt);
+    } else {
+      vector_push_back(out, copy_statement(inliner, body_stmt));
+    }
+  }
+  pop_renames(inliner);
+  pop_renames(inliner);
+}
+
+static void inline_statements(struct inliner *inliner, struct vector *stmts) {
+  struct vector *inlined = vector_init();
+  for (size_t i = 0; i < stmts->size; i++) {
+    inline_statement(inliner, vector_at(stmts, i), inlined);
+  }
+  stmts->size = 0;
+  for (size_t i = 0; i < inlined->size; i++) {
+    vector_push_back(stmts, vector_at(inlined, i));
+  }
+  vector_free(inlined);
+}
+
+static void inline_block(struct inliner *inliner, struct ast_node *block) {
+  vector_push_back(inliner->scopes, hash_table_init());
+  inline_statements(inliner, block->block_stmt_stmts);
+  hash_table_free(vector_at(inliner->scopes, inliner->scopes->size - 1));
+  inliner->scopes->size--;
+}
+
+/* Appends `stmt`, or what replaces it, to `out` */
+static void inline_statement(struct inliner *inliner, struct ast_node *stmt,
+                             struct vector *out) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    declare_name(inliner, stmt->fn_def_stmt.id);
+    /* The body sees the scopes enclosing the definition, see "closure.h" */
+    vector_push_back(inliner->scopes, hash_table_init());
+    for (size_t i = 0; i < stmt->fn_def_stmt.parameters->size; i++) {
+      declare_name(inliner, vector_at(stmt->fn_def_stmt.parameters, i));
+    }
+    inline_block(inliner, stmt->fn_def_stmt.block->node);
+    hash_table_free(vector_at(inliner->scopes, inliner->scopes->size - 1));
+    inliner->scopes->size--;
+    break;
+  case IF_STMT:
+    inline_block(inliner, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      inline_block(inliner, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    inline_block(inliner, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    vector_push_back(inliner->scopes, hash_table_init());
+    declare_name(inliner, stmt->for_stmt.init_stmt->node->var_decl_stmt.id);
+    inline_block(inliner, stmt->for_stmt.block->node);
+    hash_table_free(vector_at(inliner->scopes, inliner->scopes->size - 1));
+    inliner->scopes->size--;
+    break;
+  case BLOCK_STMT:
+    inline_block(inliner, stmt);
+    break;
+  default: {
+    struct result **value = call_site(inliner, stmt);
+    if (value) {
+      expand_call_site(inliner, stmt, value, out);
+      if (stmt->node_type == VARIABLE_DECL_STMT) {
+        declare_name(inliner, stmt->var_decl_stmt.id);
+      }
+      return;
+    }
+    if (stmt->node_type == VARIABLE_DECL_STMT) {
+      declare_name(inliner, stmt->var_decl_stmt.id);
+    }
+    break;
+  }
+  }
+  vector_push_back(out, stmt);
+}
+
+void inline_functions(struct vector *program) {
+  struct hash_table *assigned_names = hash_table_init();
+  struct name_collector collector = {.names = assigned_names,
+                                     .declared_names = hash_table_init(),
+                                     .redeclared_names = hash_table_init(),
+                                     .fn_defs = NULL};
+  collect_names(&collector, program);
+  struct inliner inliner = {.candidates = hash_table_init(),
+                            .visible = hash_table_init(),
+                            .scopes = vector_init(),
+                            .renames = vector_init(),
+                            .num_renamed = 0,
+                            .site = NULL};
+  for (size_t i = 0; i < program->size; i++) {
+    struct ast_node *stmt = vector_at(program, i);
+    if (stmt->node_type != FN_DEF_STMT ||
+        hash_table_lookup(assigned_names, stmt->fn_def_stmt.id) ||
+        hash_table_lookup(collector.redeclared_names, stmt->fn_def_stmt.id)) {
+      continue;
+    }
+    struct inline_candidate *candidate =
+        malloc(sizeof(struct inline_candidate));
+    candidate->fn_def = stmt;
+    candidate->body_size = 0;
+    candidate->num_call_sites = 0;
+    candidate->is_inlinable = true;
+    hash_table_insert(inliner.candidates, stmt->fn_def_stmt.id, candidate);
+  }
+  for (size_t i = 0; i < program->size; i++) {
+    struct ast_node *stmt = vector_at(program, i);
+    struct inline_candidate *candidate =
+        stmt->node_type == FN_DEF_STMT
+            ? hash_table_lookup(inliner.candidates, stmt->fn_def_stmt.id)
+            : NULL;
+    if (!candidate) {
+      analyze_statement(&inliner, NULL, stmt, 0, false);
+      continue;
+    }
+    struct vector *body = stmt->fn_def_stmt.block->node->block_stmt_stmts;
+    for (size_t j = 0; j < body->size; j++) {
+      analyze_statement(&inliner, candidate, vector_at(body, j), 0,
+                        j == body->size - 1);
+    }
+    if (declares_twice(stmt->fn_def_stmt.block->node)) {
+      candidate->is_inlinable = false;
+    }
+  }
+  /* Every call site copies the body, and the definition itself goes away
+   * once nothing refers to it */
+  for (size_t i = 0; i < program->size; i++) {
+    struct ast_node *stmt = vector_at(program, i);
+    struct inline_candidate *candidate =
+        stmt->node_type == FN_DEF_STMT
+            ? hash_table_lookup(inliner.candidates, stmt->fn_def_stmt.id)
+            : NULL;
+    if (!candidate || candidate->num_call_sites == 0) {
+      continue;
+    }
+    size_t growth = candidate->body_size * (candidate->num_call_sites - 1);
+    candidate->is_inlinable = candidate->is_inlinable &&
+                              candidate->body_size <= INLINE_MAX_BODY_NODES &&
+                              growth <= INLINE_MAX_GROWTH_NODES;
+  }
+
+  /* Top-level statements only see the functions defined before them */
+  struct vector *inlined = vector_init();
+  vector_push_back(inliner.scopes, hash_table_init());
+  for (size_t i = 0; i < program->size; i++) {
+    struct ast_node *stmt = vector_at(program, i);
+    inline_statement(&inliner, stmt, inlined);
+    if (stmt->node_type == FN_DEF_STMT) {
+      struct inline_candidate *candidate =
+          hash_table_lookup(inliner.candidates, stmt->fn_def_stmt.id);
+      if (candidate) {
+        hash_table_insert(inliner.visible, stmt->fn_def_stmt.id, candidate);
+      }
+    }
+  }
+  program->size = 0;
+  for (size_t i = 0; i < inlined->size; i++) {
+    vector_push_back(program, vector_at(inlined, i));
+  }
+  vector_free(inlined);
+  hash_table_free(vector_at(inliner.scopes, 0));
+  vector_free(inliner.scopes);
+  vector_free(inliner.renames);
+  hash_table_free(inliner.visible);
+  hash_table_free(inliner.candidates);
+  hash_table_free(collector.declared_names);
+  hash_table_free(collector.redeclared_names);
+  hash_table_free(assigned_names);
+}
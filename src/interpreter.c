@@ -1,298 +1,346 @@
 #include "interpreter.h"
 #include "ast.h"
 #include "builtin_functions.h"
+#include "closure.h"
 #include "errors.h"
 #include "hash_table.h"
+#include "memo.h"
 #include "parser.h"
+#include "pool.h"
+#include "profile.h"
 #include "tokens.h"
+#include "trace.h"
 #include "utils.h"
 #include "vector.h"
 
 struct object *interpret(struct vector *program) {
+  return interpret_in(program, environment_init());
+}
+
+struct object *interpret_in(struct vector *program,
+                            struct environment *globals) {
   if (!program) {
     return NULL;
   }
-  struct interpreter_state state = {.env = environment_init(),
+  /* No error handler: a runtime error is printed, and exits */
+  struct interpreter_state state = {.env = globals,
                                     .builtin_fns =
                                         init_and_register_builtin_fns()};
-  struct return_value *return_code = malloc(sizeof(struct object));
+  state.globals = state.env;
+  struct return_value *return_code = malloc(sizeof(struct return_value));
   return_code->is_set = false;
   return_code->value = NULL;
+  return_code->tail_call.is_pending = false;
   for (size_t i = 0; i < program->size; i++) {
     struct ast_node *stmt = vector_at(program, i);
     state.current_stmt_lines.start_line = stmt->source_position.start_line;
     state.current_stmt_lines.end_line = stmt->source_position.end_line;
-    struct result *ret = interpret_statement(stmt, &state, return_code);
-    if (ret->type == RESULT_ERROR) {
-      print_interpreter_error(ret->error.runtime);
-      exit(1);
-    }
+    interpret_statement(stmt, &state, return_code);
   }
-  return return_code->value->object;
-}
-
-struct result *interpret_statement(struct ast_node *statement,
-                                   struct interpreter_state *state,
-                                   struct return_value *return_code) {
-  if (!return_code->is_set) {
-    switch (statement->node_type) {
-    case FN_DEF_STMT:
-      return interpret_fn_def_statement(statement, state);
-    case VARIABLE_DECL_STMT:
-      return interpret_variable_decl_statement(statement, state, return_code);
-    case VARIABLE_ASSIGN_STMT:
-      return interpret_variable_assignment_statement(statement, state,
-                                                     return_code);
-    case IF_STMT:
-      return interpret_if_statement(statement, state, return_code);
-    case WHILE_STMT:
-      return interpret_while_statement(statement, state, return_code);
-    case FOR_STMT:
-      return interpret_for_statement(statement, state, return_code);
-    case BREAK_STMT:
-      return interpret_break_statement(statement, state, return_code);
-    case RETURN_STMT:
-      return interpret_return_statement(statement, state, return_code);
-    case BLOCK_STMT:
-      return interpret_block_statement(statement, state, return_code);
-    case EXPR_STMT:
-      return interpret_expr_statement(statement, state, return_code);
-    default: {
-      char *error_message = strdup("Invalid statement");
-      return result_error_runtime(runtime_error_init(
-          error_message, statement->source_position.start_line,
-          statement->source_position.end_line));
-    }
-    }
-  }
-  return result_ok_object(NULL);
-}
-
-struct result *interpret_fn_def_statement(struct ast_node *stmt_node,
-                                          struct interpreter_state *state) {
+  /* Like the stackless evaluator, a program may end without 'return' */
+  return return_code->value;
+}
+
+void interpret_statement(struct ast_node *statement,
+                         struct interpreter_state *state,
+                         struct return_value *return_code) {
+  if (return_code->is_set) {
+    return;
+  }
+  switch (statement->node_type) {
+  case FN_DEF_STMT:
+    interpret_fn_def_statement(statement, state);
+    break;
+  case VARIABLE_DECL_STMT:
+    interpret_variable_decl_statement(statement, state, return_code);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    interpret_variable_assignment_statement(statement, state, return_code);
+    break;
+  case IF_STMT:
+    interpret_if_statement(statement, state, return_code);
+    break;
+  case WHILE_STMT:
+    interpret_while_statement(statement, state, return_code);
+    break;
+  case FOR_STMT:
+    interpret_for_statement(statement, state, return_code);
+    break;
+  case BREAK_STMT:
+    interpret_break_statement(statement, state, return_code);
+    break;
+  case RETURN_STMT:
+    interpret_return_statement(statement, state, return_code);
+    break;
+  case BLOCK_STMT:
+    interpret_block_statement(statement, state, return_code);
+    break;
+  case EXPR_STMT:
+    interpret_expr_statement(statement, state, return_code);
+    break;
+  default: {
+    char *error_message = strdup("Invalid statement");
+    interpreter_raise_error(
+        state, runtime_error_init(error_message,
+                                  statement->source_position.start_line,
+                                  statement->source_position.end_line));
+  }
+  }
+}
+
+void interpret_fn_def_statement(struct ast_node *stmt_node,
+                                struct interpreter_state *state) {
   /* Functions are local to environment. Child environments have access to
    * parent environment, but not vice versa. Works much like variable
    * declaration statements. */
   if (environment_lookup_symbol_current_env(state->env,
                                             stmt_node->fn_def_stmt.id)) {
-    char *error_message =
-        format_string("Function '%s' already exists in current scope",
-                      stmt_node->fn_def_stmt.id);
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    interpreter_raise(
+        state, format_string("Function '%s' already exists in current scope",
+                             stmt_node->fn_def_stmt.id));
   }
   struct function *fn_stmt = malloc(sizeof(struct function));
+  fn_stmt->id = stmt_node->fn_def_stmt.id;
   fn_stmt->body = stmt_node->fn_def_stmt.block->node;
   fn_stmt->parameters = stmt_node->fn_def_stmt.parameters;
-  struct object *fn_stmt_value = malloc(sizeof(struct object));
+  fn_stmt->native_body = NULL;
+  fn_stmt->chunk = NULL;
+  fn_stmt->memo = stmt_node->fn_def_stmt.is_pure ? memo_cache_init() : NULL;
+  struct object *fn_stmt_value = pool_alloc(POOL_OBJECT);
   fn_stmt_value->data_type = FUNCTION_VALUE;
-  fn_stmt_value->function_value.is_builtin = false;
+  fn_stmt_value->is_builtin = false;
   fn_stmt_value->function_value.function_value = fn_stmt;
   environment_insert_symbol(state->env, stmt_node->fn_def_stmt.id,
                             fn_stmt_value);
-  return result_ok_object(NULL);
+  closure_capture(state, fn_stmt, closure_free_names(stmt_node));
 }
 
-struct result *
-interpret_variable_decl_statement(struct ast_node *stmt_node,
-                                  struct interpreter_state *state,
-                                  struct return_value *return_code) {
+void interpret_variable_decl_statement(struct ast_node *stmt_node,
+                                       struct interpreter_state *state,
+                                       struct return_value *return_code) {
   /* Allow creating scope-local variable name of same name in a scope even
    * if it exists in previous scopes. */
   if (environment_lookup_symbol_current_env(state->env,
                                             stmt_node->var_decl_stmt.id)) {
-    char *error_message =
-        format_string("Variable '%s' already exists in current scope",
-                      stmt_node->var_decl_stmt.id);
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
-  }
-  struct result *variable_value =
+    interpreter_raise(
+        state, format_string("Variable '%s' already exists in current scope",
+                             stmt_node->var_decl_stmt.id));
+  }
+  struct object *variable_value =
       eval_expression(stmt_node->var_decl_stmt.expr->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(variable_value);
   environment_insert_symbol(state->env, stmt_node->var_decl_stmt.id,
-                            variable_value->object);
-  return result_ok_object(NULL);
+                            variable_value);
 }
 
-struct result *
-interpret_variable_assignment_statement(struct ast_node *stmt_node,
-                                        struct interpreter_state *state,
-                                        struct return_value *return_code) {
+void interpret_variable_assignment_statement(struct ast_node *stmt_node,
+                                             struct interpreter_state *state,
+                                             struct return_value *return_code) {
   /* Check current scope, if not traverse to previous parent scope. */
-  char *error_message;
   if (stmt_node->var_assign_stmt.primary->node->primary_node_type ==
       IDENTIFIER_PRIMARY_NODE) {
     if (environment_lookup_symbol(
             state->env, stmt_node->var_assign_stmt.primary->node->id) == NULL) {
-      error_message =
-          format_string("Variable '%s' does not exist",
-                        stmt_node->var_assign_stmt.primary->node->id);
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
-    }
-    struct result *variable_value = eval_expression(
+      interpreter_raise(
+          state, format_string("Variable '%s' does not exist",
+                               stmt_node->var_assign_stmt.primary->node->id));
+    }
+    struct object *variable_value = eval_expression(
         stmt_node->var_assign_stmt.expr->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(variable_value);
     environment_reassign_symbol(state->env,
                                 stmt_node->var_assign_stmt.primary->node->id,
-                                variable_value->object);
-  } else {
-    struct result *array_obj = eval_primary_expression(
-        stmt_node->var_assign_stmt.primary->node->array_access.primary->node,
-        state, return_code);
-    RETURN_RESULT_IF_ERROR(array_obj);
-    if (array_obj->object->data_type != ARRAY_VALUE) {
-      error_message =
-          strdup("Variable array assignment can only be used for arrays");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
-    }
-    struct result *array_index = eval_expression(
-        stmt_node->var_assign_stmt.primary->node->array_access.index->node,
-        state, return_code);
-    RETURN_RESULT_IF_ERROR(array_index);
-    if (array_index->object->data_type != INT_VALUE) {
-      error_message =
-          strdup("Variable array assignment index must be an integer");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
-    }
-    if (array_index->object->int_value >=
-        array_obj->object->array_value->size) {
-      error_message = strdup("Index out of bound");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
-    }
-    struct result *expr = eval_expression(stmt_node->var_assign_stmt.expr->node,
-                                          state, return_code);
-    RETURN_RESULT_IF_ERROR(expr);
-    vector_replace_at(array_obj->object->array_value,
-                      array_index->object->int_value, expr->object);
-  }
-  return result_ok_object(NULL);
-}
-
-struct result *interpret_if_statement(struct ast_node *stmt_node,
-                                      struct interpreter_state *state,
-                                      struct return_value *return_code) {
-  struct result *if_expr =
+                                variable_value);
+    return;
+  }
+  struct ast_node *target = stmt_node->var_assign_stmt.primary->node;
+  struct object *array_obj = eval_primary_expression(
+      target->array_access.primary->node, state, return_code);
+  if (target->array_access.is_in_bounds) {
+    struct object *array_index =
+        eval_expression(target->array_access.index->node, state, return_code);
+    struct object *expr = eval_expression(
+        stmt_node->var_assign_stmt.expr->node, state, return_code);
+    array_obj->array_value->items[array_index->int_value] = expr;
+    return;
+  }
+  if (array_obj->data_type != ARRAY_VALUE) {
+    interpreter_raise(
+        state,
+        strdup("Variable array assignment can only be used for arrays"));
+  }
+  struct object *array_index =
+      eval_expression(target->array_access.index->node, state, return_code);
+  if (array_index->data_type != INT_VALUE) {
+    interpreter_raise(
+        state, strdup("Variable array assignment index must be an integer"));
+  }
+  if (array_index->int_value < 0 ||
+      array_index->int_value >= array_obj->array_value->size) {
+    interpreter_raise(state, strdup("Index out of bound"));
+  }
+  struct object *expr = eval_expression(stmt_node->var_assign_stmt.expr->node,
+                                        state, return_code);
+  array_obj->array_value->items[array_index->int_value] = expr;
+}
+
+void interpret_if_statement(struct ast_node *stmt_node,
+                            struct interpreter_state *state,
+                            struct return_value *return_code) {
+  struct object *if_expr =
       eval_expression(stmt_node->if_else_stmt.expr->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(if_expr);
-  if (if_expr->object->data_type != BOOLEAN_VALUE) {
-    char *error_message = strdup("The result of the <expression> inside 'if' "
-                                 "statement should result in a boolean value");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
-  }
-  if (if_expr->object->bool_value) {
-    struct result *ret = interpret_block_statement(
-        stmt_node->if_else_stmt.if_block->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-  } else {
-    if (stmt_node->if_else_stmt.else_block != NULL) {
-      struct result *ret = interpret_block_statement(
-          stmt_node->if_else_stmt.else_block->node, state, return_code);
-      RETURN_RESULT_IF_ERROR(ret);
-    }
+  if (if_expr->data_type != BOOLEAN_VALUE) {
+    interpreter_raise(state,
+                      strdup("The result of the <expression> inside 'if' "
+                             "statement should result in a boolean value"));
+  }
+  struct profile_site *site = stmt_node->profile_site;
+  if (site) {
+    site->count++;
+    site->taken += if_expr->bool_value;
+  }
+  if (if_expr->bool_value) {
+    interpret_block_statement(stmt_node->if_else_stmt.if_block->node, state,
+                              return_code);
+  } else if (stmt_node->if_else_stmt.else_block != NULL) {
+    interpret_block_statement(stmt_node->if_else_stmt.else_block->node, state,
+                              return_code);
   }
-  return result_ok_object(NULL);
 }
 
-struct result *interpret_while_statement(struct ast_node *stmt_node,
-                                         struct interpreter_state *state,
-                                         struct return_value *return_code) {
-  struct result *while_expr =
+void interpret_while_statement(struct ast_node *stmt_node,
+                               struct interpreter_state *state,
+                               struct return_value *return_code) {
+  if (stmt_node->profile_site) {
+    stmt_node->profile_site->count++;
+  }
+  reset_loop_invariants(stmt_node->while_stmt.invariants);
+  struct object *while_expr =
       eval_expression(stmt_node->while_stmt.expr->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(while_expr);
-  if (while_expr->object->data_type != BOOLEAN_VALUE) {
-    char *error_message =
-        strdup("The <expression> of 'while' must return boolean");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
-  }
-  while (while_expr->object->bool_value) {
+  if (while_expr->data_type != BOOLEAN_VALUE) {
+    interpreter_raise(
+        state, strdup("The <expression> of 'while' must return boolean"));
+  }
+  while (while_expr->bool_value) {
+    enum trace_exit trace_exit =
+        trace_run_loop(&stmt_node->while_stmt.trace, stmt_node, state);
+    if (trace_exit != TRACE_EXIT_SIDE) {
+      break;
+    }
+    interpret_block_statement(stmt_node->while_stmt.block->node, state,
+                              return_code);
     if (state->is_break) {
       state->is_break = false;
       break;
     }
-    struct result *ret = interpret_block_statement(
-        stmt_node->while_stmt.block->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
+    if (return_code->is_set) {
+      break;
+    }
     while_expr =
         eval_expression(stmt_node->while_stmt.expr->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(while_expr);
   }
-  return result_ok_object(NULL);
 }
 
-struct result *interpret_for_statement(struct ast_node *stmt_node,
-                                       struct interpreter_state *state,
-                                       struct return_value *return_code) {
+void interpret_for_statement(struct ast_node *stmt_node,
+                             struct interpreter_state *state,
+                             struct return_value *return_code) {
+  if (stmt_node->profile_site) {
+    stmt_node->profile_site->count++;
+  }
+  reset_loop_invariants(stmt_node->for_stmt.invariants);
   struct environment *parent_env = state->env;
   struct environment *block_env = environment_init_enclosed(state->env);
   state->env = block_env;
-  struct result *ret = interpret_variable_decl_statement(
-      stmt_node->for_stmt.init_stmt->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(ret);
-  struct result *for_expr =
+  interpret_variable_decl_statement(stmt_node->for_stmt.init_stmt->node, state,
+                                    return_code);
+  struct object *for_expr =
       eval_expression(stmt_node->for_stmt.expr_stmt->node->expr_stmt_expr->node,
                       state, return_code);
-  RETURN_RESULT_IF_ERROR(for_expr);
-  if (for_expr->object->data_type != BOOLEAN_VALUE) {
-    char *error_message =
-        strdup("The expression of 'for' loop must result in a boolean value");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
-  }
-  while (for_expr->object->bool_value) {
+  if (for_expr->data_type != BOOLEAN_VALUE) {
+    interpreter_raise(
+        state,
+        strdup("The expression of 'for' loop must result in a boolean value"));
+  }
+  while (for_expr->bool_value) {
+    enum trace_exit trace_exit =
+        trace_run_loop(&stmt_node->for_stmt.trace, stmt_node, state);
+    if (trace_exit != TRACE_EXIT_SIDE) {
+      break;
+    }
+    interpret_block_statement(stmt_node->for_stmt.block->node, state,
+                              return_code);
     if (state->is_break) {
       state->is_break = false;
       break;
     }
-    struct result *ret = interpret_block_statement(
-        stmt_node->for_stmt.block->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-    ret = interpret_variable_assignment_statement(
+    if (return_code->is_set) {
+      break;
+    }
+    interpret_variable_assignment_statement(
         stmt_node->for_stmt.update_stmt->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
     for_expr = eval_expression(
         stmt_node->for_stmt.expr_stmt->node->expr_stmt_expr->node, state,
         return_code);
   }
-  return result_ok_object(NULL);
+  environment_leave_scopes(state, parent_env);
 }
 
-struct result *interpret_break_statement(struct ast_node *stmt_node,
-                                         struct interpreter_state *state,
-                                         struct return_value *return_code) {
+void interpret_break_statement(struct ast_node *stmt_node,
+                               struct interpreter_state *state,
+                               struct return_value *return_code) {
   state->is_break = true;
-  return result_ok_object(NULL);
 }
 
-struct result *interpret_return_statement(struct ast_node *stmt_node,
-                                          struct interpreter_state *state,
-                                          struct return_value *return_code) {
-  struct result *return_expr =
-      eval_expression(stmt_node->return_stmt_expr->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(return_expr);
+void interpret_return_statement(struct ast_node *stmt_node,
+                                struct interpreter_state *state,
+                                struct return_value *return_code) {
+  struct ast_node *return_expr_node = stmt_node->return_stmt_expr->node;
+  if (state->call_depth > 0 && return_expr_node->node_type == PRIMARY_NODE &&
+      return_expr_node->primary_node_type == FN_CALL_PRIMARY_NODE) {
+    interpret_tail_call(return_expr_node, state, return_code);
+    return;
+  }
+  struct object *return_expr =
+      eval_expression(return_expr_node, state, return_code);
   return_code->is_set = true;
   return_code->value = return_expr;
-  return result_ok_object(NULL);
 }
 
-struct result *interpret_block_statement(struct ast_node *stmt_node,
-                                         struct interpreter_state *state,
-                                         struct return_value *return_code) {
+void interpret_tail_call(struct ast_node *fn_call,
+                         struct interpreter_state *state,
+                         struct return_value *return_code) {
+  /* Only calls to user functions by name are run in place, so that the
+   * callee expression is never evaluated twice */
+  struct ast_node *callee_node = fn_call->fn_call.primary->node;
+  struct object *callee =
+      callee_node->primary_node_type == IDENTIFIER_PRIMARY_NODE
+          ? environment_lookup_symbol(state->env, callee_node->id)
+          : NULL;
+  if (!callee || callee->data_type != FUNCTION_VALUE ||
+      callee->is_builtin) {
+    struct object *return_expr = eval_expression(fn_call, state, return_code);
+    return_code->is_set = true;
+    return_code->value = return_expr;
+    return;
+  }
+  check_arity(callee->function_value.function_value,
+              fn_call->fn_call.parameters->size, state);
+  if (fn_call->profile_site) {
+    fn_call->profile_site->count++;
+  }
+  struct vector *arguments = vector_init();
+  for (size_t i = 0; i < fn_call->fn_call.parameters->size; i++) {
+    struct result *val = vector_at(fn_call->fn_call.parameters, i);
+    vector_push_back(arguments, eval_expression(val->node, state, return_code));
+  }
+  return_code->is_set = true;
+  return_code->value = NULL;
+  return_code->tail_call.is_pending = true;
+  return_code->tail_call.function = callee->function_value.function_value;
+  return_code->tail_call.arguments = arguments;
+}
+
+void interpret_block_statement(struct ast_node *stmt_node,
+                               struct interpreter_state *state,
+                               struct return_value *return_code) {
   struct environment *parent_env = state->env;
   struct environment *block_env = environment_init_enclosed(state->env);
   state->env = block_env;
@@ -300,24 +348,19 @@ struct result *interpret_block_statement(struct ast_node *stmt_node,
     if (return_code->is_set || state->is_break) {
       break;
     }
-    struct result *ret = interpret_statement(
-        vector_at(stmt_node->block_stmt_stmts, i), state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
+    interpret_statement(vector_at(stmt_node->block_stmt_stmts, i), state,
+                        return_code);
   }
-  state->env = parent_env;
-  return result_ok_object(NULL);
+  environment_leave_scopes(state, parent_env);
 }
 
-struct result *interpret_expr_statement(struct ast_node *stmt_node,
-                                        struct interpreter_state *state,
-                                        struct return_value *return_code) {
-  struct result *ret =
-      eval_expression(stmt_node->expr_stmt_expr->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(ret);
-  return result_ok_object(NULL);
+void interpret_expr_statement(struct ast_node *stmt_node,
+                              struct interpreter_state *state,
+                              struct return_value *return_code) {
+  eval_expression(stmt_node->expr_stmt_expr->node, state, return_code);
 }
 
-struct result *eval_expression(struct ast_node *ast,
+struct object *eval_expression(struct ast_node *ast,
                                struct interpreter_state *state,
                                struct return_value *return_code) {
   switch (ast->node_type) {
@@ -327,226 +370,240 @@ struct result *eval_expression(struct ast_node *ast,
     return eval_unary_expression(ast, state, return_code);
   case PRIMARY_NODE:
     return eval_primary_expression(ast, state, return_code);
-  default: {
-    char *error_message =
-        strdup("Invalid expression type inside `eval_expression`");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
-  }
+  default:
+    interpreter_raise(
+        state, strdup("Invalid expression type inside `eval_expression`"));
   }
 }
 
-struct result *eval_binary_expression(struct ast_node *ast,
+struct object *eval_binary_expression(struct ast_node *ast,
                                       struct interpreter_state *state,
                                       struct return_value *return_code) {
-  struct result *lhs =
+  struct object *lhs =
       eval_expression(ast->binary.left->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(lhs);
-  struct result *rhs =
+  struct object *rhs =
       eval_expression(ast->binary.right->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(rhs);
-  switch (ast->binary.op) {
+  struct profile_site *site = ast->profile_site;
+  if (site) {
+    if (site->is_int_specialized && lhs->data_type == INT_VALUE &&
+        rhs->data_type == INT_VALUE) {
+      site->count++;
+      return eval_int_binary_operation(ast->binary.op, lhs->int_value,
+                                       rhs->int_value);
+    }
+    profile_record_binary_op(site, lhs, rhs);
+  }
+  if (ast->binary.is_int_typed) {
+    return eval_int_binary_operation(ast->binary.op, lhs->int_value,
+                                     rhs->int_value);
+  }
+  return eval_binary_operation(ast->binary.op, lhs, rhs, state);
+}
+
+struct object *eval_int_binary_operation(enum token_type op, long lhs,
+                                         long rhs) {
+  switch (op) {
+  case PLUS:
+    return object_int(lhs + rhs);
+  case MINUS:
+    return object_int(lhs - rhs);
+  case STAR:
+    return object_int(lhs * rhs);
+  case SLASH:
+    return object_int(lhs / rhs);
+  case EQUAL_EQUAL:
+    return object_bool(lhs == rhs);
+  case BANG_EQUAL:
+    return object_bool(lhs != rhs);
+  case GREATER:
+    return object_bool(lhs > rhs);
+  case GREATER_EQUAL:
+    return object_bool(lhs >= rhs);
+  case LESS:
+    return object_bool(lhs < rhs);
+  case LESS_EQUAL:
+    return object_bool(lhs <= rhs);
+  default: {
+    /* Only called for operations the profile specialized, see "profile.c" */
+    return object_bool(false);
+  }
+  }
+}
+
+struct object *eval_binary_operation(enum token_type op, struct object *lhs,
+                                     struct object *rhs,
+                                     struct interpreter_state *state) {
+  switch (op) {
   case OR:
   case AND:
-    return eval_logical_expression(ast->binary.op, lhs->object, rhs->object);
+    return eval_logical_expression(op, lhs, rhs);
   case EQUAL_EQUAL:
   case BANG_EQUAL:
-    return eval_equality_expression(ast->binary.op, lhs->object, rhs->object,
-                                    state);
+    return eval_equality_expression(op, lhs, rhs, state);
   case GREATER:
   case GREATER_EQUAL:
   case LESS:
   case LESS_EQUAL:
-    return eval_comparitive_expression(ast->binary.op, lhs->object, rhs->object,
-                                       state);
+    return eval_comparitive_expression(op, lhs, rhs, state);
   case PLUS:
   case MINUS:
   case STAR:
   case SLASH:
-    return eval_additive_multiplicative_expression(ast->binary.op, lhs->object,
-                                                   rhs->object, state);
-  default: {
-    char *error_message =
-        format_string("Invalid operation '%s' in binary node",
-                      get_string_from_token_atom(ast->binary.op));
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
-  }
+    return eval_additive_multiplicative_expression(op, lhs, rhs, state);
+  default:
+    interpreter_raise(state,
+                      format_string("Invalid operation '%s' in binary node",
+                                    get_string_from_token_atom(op)));
   }
 }
 
-struct result *eval_unary_expression(struct ast_node *ast,
+struct object *eval_unary_expression(struct ast_node *ast,
                                      struct interpreter_state *state,
                                      struct return_value *return_code) {
-  struct result *primary_expr =
-      eval_primary_expression(ast->unary.primary->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(primary_expr);
-  char *error_message;
-  if (ast->unary.op != NIL) {
-    switch (ast->unary.op) {
-    case MINUS: {
-      if (primary_expr->object->data_type != INT_VALUE) {
-        error_message = strdup("Unary '-' can only be applied to integers");
-        return result_error_runtime(runtime_error_init(
-            error_message, state->current_stmt_lines.start_line,
-            state->current_stmt_lines.end_line));
-      }
-      primary_expr->object->int_value = -primary_expr->object->int_value;
-      break;
-    }
-    case BANG: {
-      if (primary_expr->object->data_type != BOOLEAN_VALUE) {
-        char *error_message =
-            strdup("Unary '!' can only be applied to booleans");
-        return result_error_runtime(runtime_error_init(
-            error_message, state->current_stmt_lines.start_line,
-            state->current_stmt_lines.end_line));
-      }
-      primary_expr->object->bool_value = !primary_expr->object->bool_value;
-      break;
-    }
-    default: {
-      char *error_message = strdup("Invalid unary operation");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
+  /* The operand is a primary, or any expression in parentheses */
+  struct object *primary_expr =
+      eval_expression(ast->unary.primary->node, state, return_code);
+  return eval_unary_operation(ast->unary.op, primary_expr, state);
+}
+
+struct object *eval_unary_operation(enum token_type op, struct object *operand,
+                                    struct interpreter_state *state) {
+  switch (op) {
+  case NIL:
+    return operand;
+  case MINUS:
+    if (operand->data_type != INT_VALUE) {
+      interpreter_raise(state,
+                        strdup("Unary '-' can only be applied to integers"));
     }
+    /* A new value: `operand` may be a variable's, or shared */
+    return object_int(-operand->int_value);
+  case BANG:
+    if (operand->data_type != BOOLEAN_VALUE) {
+      interpreter_raise(state,
+                        strdup("Unary '!' can only be applied to booleans"));
     }
+    return object_bool(!operand->bool_value);
+  default:
+    interpreter_raise(state, strdup("Invalid unary operation"));
   }
-  return primary_expr;
 }
 
-struct result *eval_logical_expression(enum token_type op, struct object *lhs,
+struct object *eval_logical_expression(enum token_type op, struct object *lhs,
                                        struct object *rhs) {
-  struct object *returner = malloc(sizeof(struct object));
-  returner->data_type = BOOLEAN_VALUE;
-  returner->bool_value = (op == AND) ? (lhs->bool_value && rhs->bool_value)
-                                     : (lhs->bool_value || rhs->bool_value);
-  return result_ok_object(returner);
+  return object_bool((op == AND) ? (lhs->bool_value && rhs->bool_value)
+                                 : (lhs->bool_value || rhs->bool_value));
 }
 
-struct result *eval_equality_expression(enum token_type op, struct object *lhs,
+struct object *eval_equality_expression(enum token_type op, struct object *lhs,
                                         struct object *rhs,
                                         struct interpreter_state *state) {
-  struct object *returner = malloc(sizeof(struct object));
-  returner->data_type = BOOLEAN_VALUE;
+  bool returner;
   if (lhs->data_type == INT_VALUE && rhs->data_type == INT_VALUE) {
-    returner->bool_value = (op == EQUAL_EQUAL)
-                               ? (lhs->int_value == rhs->int_value)
-                               : (lhs->int_value != rhs->int_value);
+    returner = (op == EQUAL_EQUAL) ? (lhs->int_value == rhs->int_value)
+                                   : (lhs->int_value != rhs->int_value);
   } else if (lhs->data_type == BOOLEAN_VALUE &&
              rhs->data_type == BOOLEAN_VALUE) {
-    returner->bool_value = (op == EQUAL_EQUAL)
-                               ? (lhs->bool_value == rhs->bool_value)
-                               : (lhs->bool_value != rhs->bool_value);
+    returner = (op == EQUAL_EQUAL) ? (lhs->bool_value == rhs->bool_value)
+                                   : (lhs->bool_value != rhs->bool_value);
   } else if (lhs->data_type == STRING_VALUE && rhs->data_type == STRING_VALUE) {
-    returner->bool_value =
-        (op == EQUAL_EQUAL)
-            ? (strcmp(lhs->string_value, rhs->string_value) == 0)
-            : false;
+    returner = (op == EQUAL_EQUAL)
+                   ? string_equals(lhs->string_value, rhs->string_value)
+                   : false;
   } else {
-
-    char *error_message =
+    interpreter_raise(
+        state,
         strdup("Equality operator can only be performed between two operands "
-               "of integers, strings, or booleans");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+               "of integers, strings, or booleans"));
   }
-  return result_ok_object(returner);
+  return object_bool(returner);
 }
 
-struct result *eval_comparitive_expression(enum token_type op,
+struct object *eval_comparitive_expression(enum token_type op,
                                            struct object *lhs,
                                            struct object *rhs,
                                            struct interpreter_state *state) {
-  struct object *returner = malloc(sizeof(struct object));
-  returner->data_type = BOOLEAN_VALUE;
+  bool returner = false;
   if (lhs->data_type != INT_VALUE || rhs->data_type != INT_VALUE) {
-    char *error_message = strdup("Comparitive expression can only be "
-                                 "performed between two integers.\n");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    interpreter_raise(state, strdup("Comparitive expression can only be "
+                                    "performed between two integers.\n"));
   }
   long lhs_value = lhs->int_value;
   long rhs_value = rhs->int_value;
   switch (op) {
   case GREATER: {
-    returner->bool_value = (lhs_value > rhs_value);
+    returner = (lhs_value > rhs_value);
     break;
   }
   case GREATER_EQUAL: {
-    returner->bool_value = (lhs_value >= rhs_value);
+    returner = (lhs_value >= rhs_value);
     break;
   }
   case LESS: {
-    returner->bool_value = (lhs_value < rhs_value);
+    returner = (lhs_value < rhs_value);
     break;
   }
   case LESS_EQUAL: {
-    returner->bool_value = (lhs_value <= rhs_value);
+    returner = (lhs_value <= rhs_value);
     break;
   }
   default: {
   }
   }
-  return result_ok_object(returner);
+  return object_bool(returner);
 }
 
-struct result *
+struct object *
 eval_additive_multiplicative_expression(enum token_type op, struct object *lhs,
                                         struct object *rhs,
                                         struct interpreter_state *state) {
-  struct object *returner = malloc(sizeof(struct object));
   if (lhs->data_type == STRING_VALUE || rhs->data_type == STRING_VALUE) {
     if (op != PLUS) {
-      char *error_message = strdup("Only '+' can be performed on strings");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
+      interpreter_raise(state, strdup("Only '+' can be performed on strings"));
     }
     const char *lhs_string;
     const char *rhs_string;
     if (lhs->data_type != STRING_VALUE) {
       lhs_string = convert_object_to_string(lhs);
-      rhs_string = rhs->string_value;
+      rhs_string = rhs->string_value->chars;
     } else {
-      lhs_string = lhs->string_value;
+      lhs_string = lhs->string_value->chars;
       rhs_string = convert_object_to_string(rhs);
     }
-    size_t lhs_length = strlen(lhs_string);
-    size_t rhs_length = strlen(rhs_string);
+    size_t lhs_length = lhs->data_type == STRING_VALUE
+                            ? lhs->string_value->length
+                            : strlen(lhs_string);
+    size_t rhs_length = rhs->data_type == STRING_VALUE
+                            ? rhs->string_value->length
+                            : strlen(rhs_string);
+    struct object *returner = pool_alloc(POOL_OBJECT);
     returner->data_type = STRING_VALUE;
-    returner->string_value = format_string("%s%s", lhs_string, rhs_string);
-    return result_ok_object(returner);
+    returner->string_value =
+        string_concat(lhs_string, lhs_length, rhs_string, rhs_length);
+    return returner;
   }
-  returner->data_type = INT_VALUE;
   if (lhs->data_type != INT_VALUE || rhs->data_type != INT_VALUE) {
-    char *error_message =
+    interpreter_raise(
+        state,
         strdup("For additive and multiplicative expressions, both operands "
-               "must be of integer type or strings");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+               "must be of integer type or strings"));
   }
+  long returner = 0;
   switch (op) {
   case PLUS: {
-    returner->int_value = lhs->int_value + rhs->int_value;
+    returner = lhs->int_value + rhs->int_value;
     break;
   }
   case MINUS: {
-    returner->int_value = lhs->int_value - rhs->int_value;
+    returner = lhs->int_value - rhs->int_value;
     break;
   }
   case STAR: {
-    returner->int_value = lhs->int_value * rhs->int_value;
+    returner = lhs->int_value * rhs->int_value;
     break;
   }
   case SLASH: {
-    returner->int_value = lhs->int_value / rhs->int_value;
+    returner = lhs->int_value / rhs->int_value;
     break;
   }
   default: {
@@ -555,406 +612,736 @@ eval_additive_multiplicative_expression(enum token_type op, struct object *lhs,
      */
   }
   }
-  return result_ok_object(returner);
+  return object_int(returner);
 }
 
-struct result *eval_primary_expression(struct ast_node *ast,
+struct object *eval_primary_expression(struct ast_node *ast,
                                        struct interpreter_state *state,
                                        struct return_value *return_code) {
-  struct object *returner = malloc(sizeof(struct object));
   switch (ast->primary_node_type) {
-  case NUMBER_PRIMARY_NODE: {
-    returner->data_type = INT_VALUE;
-    returner->int_value = ast->number;
-    break;
-  }
-  case STRING_PRIMARY_NODE: {
-    returner->data_type = STRING_VALUE;
-    returner->string_value = ast->string;
-    break;
-  }
-  case BOOLEAN_PRIMARY_NODE: {
-    returner->data_type = BOOLEAN_VALUE;
-    returner->bool_value = ast->boolean;
-    break;
-  }
+  case NUMBER_PRIMARY_NODE:
+  case STRING_PRIMARY_NODE:
+  case BOOLEAN_PRIMARY_NODE:
+  case NIL_PRIMARY_NODE:
+    return ast->literal;
   case IDENTIFIER_PRIMARY_NODE: {
     struct object *symbol_lookup =
         environment_lookup_symbol(state->env, ast->id);
-    if (!symbol_lookup) {
-      struct builtin_fn *builtin_function =
-          lookup_builtin_fns(state->builtin_fns, ast->id);
-      if (builtin_function != NULL) {
-        returner->data_type = FUNCTION_VALUE;
-        returner->function_value.is_builtin = true;
-        returner->function_value.builtin_function = builtin_function;
-        break;
-      } else {
-        char *error_message =
-            format_string("Identifier '%s' does not exist", ast->id);
-        return result_error_runtime(runtime_error_init(
-            error_message, state->current_stmt_lines.start_line,
-            state->current_stmt_lines.end_line));
-      }
+    if (symbol_lookup) {
+      return symbol_lookup;
     }
-    returner = symbol_lookup;
-    break;
-  }
-  case NIL_PRIMARY_NODE: {
-    returner->data_type = NIL_VALUE;
-    break;
-  }
-  case FN_CALL_PRIMARY_NODE: {
-    struct result *ret =
-        eval_fn_call_primary_expression(ast, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-    returner = ret->object;
-    break;
-  }
-  case METHOD_CALL_PRIMARY_NODE: {
-    struct result *ret =
-        eval_method_call_primary_expression(ast, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-    returner = ret->object;
-    break;
+    struct builtin_fn *builtin_function =
+        lookup_builtin_fns(state->builtin_fns, ast->id);
+    if (builtin_function == NULL) {
+      interpreter_raise(
+          state, format_string("Identifier '%s' does not exist", ast->id));
+    }
+    struct object *returner = pool_alloc(POOL_OBJECT);
+    returner->data_type = FUNCTION_VALUE;
+    returner->is_builtin = true;
+    returner->function_value.builtin_function = builtin_function;
+    return returner;
   }
-  case ARRAY_CREATION_PRIMARY_NODE: {
-    struct result *ret =
-        eval_array_creation_primary_expression(ast, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-    returner = ret->object;
-    break;
+  case FN_CALL_PRIMARY_NODE:
+    return eval_fn_call_primary_expression(ast, state, return_code);
+  case METHOD_CALL_PRIMARY_NODE:
+    return eval_method_call_primary_expression(ast, state, return_code);
+  case ARRAY_CREATION_PRIMARY_NODE:
+    return eval_array_creation_primary_expression(ast, state, return_code);
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    return eval_array_access_primary_expression(ast, state, return_code);
+  case INVARIANT_PRIMARY_NODE:
+    return eval_invariant_primary_expression(ast, state, return_code);
+  case SAVED_PRIMARY_NODE:
+    ast->saved.value =
+        eval_expression(ast->saved.expr->node, state, return_code);
+    return ast->saved.value;
+  case REUSED_PRIMARY_NODE:
+    return ast->reused->saved.value;
+  default:
+    interpreter_raise(state, strdup("Unimplemented primary expression"));
   }
-  case ARRAY_ACCESS_PRIMARY_NODE: {
-    struct result *ret =
-        eval_array_access_primary_expression(ast, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-    returner = ret->object;
-    break;
+}
+
+struct object *
+eval_invariant_primary_expression(struct ast_node *ast,
+                                  struct interpreter_state *state,
+                                  struct return_value *return_code) {
+  if (!ast->invariant.value) {
+    ast->invariant.value =
+        eval_expression(ast->invariant.expr->node, state, return_code);
   }
-  default: {
-    char *error_message = strdup("Unimplemented primary expression");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+  return ast->invariant.value;
+}
+
+void reset_loop_invariants(struct vector *invariants) {
+  if (!invariants) {
+    return;
   }
+  for (size_t i = 0; i < invariants->size; i++) {
+    struct ast_node *invariant = vector_at(invariants, i);
+    invariant->invariant.value = NULL;
   }
-  return result_ok_object(returner);
 }
 
-struct result *
+struct object *
 eval_fn_call_primary_expression(struct ast_node *ast,
                                 struct interpreter_state *state,
                                 struct return_value *return_code) {
-  struct result *primary_eval =
+  struct object *fn_call_primary_eval =
       eval_primary_expression(ast->fn_call.primary->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(primary_eval);
-  struct object *fn_call_primary_eval = primary_eval->object;
-  char *error_message;
   if (fn_call_primary_eval->data_type != FUNCTION_VALUE) {
-    error_message = strdup("Function calls can only be performed on callable");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    interpreter_raise(
+        state, strdup("Function calls can only be performed on callable"));
+  }
+  if (ast->profile_site) {
+    ast->profile_site->count++;
   }
 
   /* Handle builtin functions */
-  if (fn_call_primary_eval->function_value.is_builtin) {
+  if (fn_call_primary_eval->is_builtin) {
     return eval_builtin_fn_call_primary_expression(ast, fn_call_primary_eval,
                                                    state, return_code);
   }
 
   /* Handle user-define functions */
-  struct environment *parent_env = state->env;
-  struct environment *fn_call_env = environment_init_enclosed(parent_env);
+  struct function *function =
+      fn_call_primary_eval->function_value.function_value;
+  check_arity(function, ast->fn_call.parameters->size, state);
+  struct call_stack_mark mark = call_stack_mark(state);
+  struct environment *fn_call_env =
+      environment_init_frame(state, function);
+  struct memo_key memo_key;
+  bool is_memoized = function->memo != NULL;
+  memo_key_init(&memo_key);
   for (size_t i = 0; i < ast->fn_call.parameters->size; i++) {
     struct result *val = vector_at(ast->fn_call.parameters, i);
-    struct result *parameter_eval =
+    struct object *parameter_eval =
         eval_expression(val->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(parameter_eval);
-    char *parameter_id = vector_at(
-        fn_call_primary_eval->function_value.function_value->parameters, i);
-    environment_insert_symbol(fn_call_env, parameter_id,
-                              parameter_eval->object);
-  }
-  state->env = fn_call_env;
-  struct result *ret = interpret_block_statement(
-      fn_call_primary_eval->function_value.function_value->body, state,
-      return_code);
-  RETURN_RESULT_IF_ERROR(ret);
+    fn_call_env->arguments[i] = parameter_eval;
+    is_memoized = is_memoized && memo_key_add(&memo_key, parameter_eval);
+  }
+  is_memoized =
+      is_memoized && memo_key.num_arguments == function->parameters->size;
+  struct object *cached = is_memoized ? memo_lookup(function, &memo_key) : NULL;
+  if (cached) {
+    call_stack_release(state, mark);
+    return cached;
+  }
+  struct object *ret =
+      eval_user_fn_call(function, fn_call_env, state, return_code);
+  call_stack_release(state, mark);
+  if (is_memoized) {
+    memo_store(function, &memo_key, ret);
+  }
+  return ret;
+}
+
+struct object *eval_user_fn_call(struct function *function,
+                                 struct environment *fn_call_env,
+                                 struct interpreter_state *state,
+                                 struct return_value *return_code) {
+  struct environment *parent_env = state->env;
+  state->call_depth++;
+  for (;;) {
+    if (function->body->profile_site) {
+      function->body->profile_site->count++;
+    }
+    state->env = fn_call_env;
+    interpret_block_statement(function->body, state, return_code);
+    if (!return_code->tail_call.is_pending) {
+      break;
+    }
+    /* The body ended with `return f(...)`. Run `f` in this frame rather than
+     * recursing, so that tail-recursive functions use constant stack. A
+     * function calling itself also keeps its environment, with the parameters
+     * rebound in place. */
+    return_code->tail_call.is_pending = false;
+    return_code->is_set = false;
+    struct function *callee = return_code->tail_call.function;
+    struct vector *arguments = return_code->tail_call.arguments;
+    if (callee != function) {
+      /* Pushed above the current frame, and released with it by the
+       * caller */
+      fn_call_env = environment_init_frame(state, callee);
+    }
+    for (size_t i = 0; i < arguments->size; i++) {
+      fn_call_env->arguments[i] = vector_at(arguments, i);
+    }
+    vector_free(arguments);
+    function = callee;
+  }
+  state->call_depth--;
   struct object *returner = NULL;
   if (return_code->is_set) {
     return_code->is_set = false;
-    returner = return_code->value->object;
+    returner = return_code->value;
   }
   state->env = parent_env;
-  return result_ok_object(returner);
+  return returner;
 }
 
-struct result *eval_builtin_fn_call_primary_expression(
+struct object *eval_builtin_fn_call_primary_expression(
     struct ast_node *ast, struct object *fn_call_primary,
     struct interpreter_state *state, struct return_value *return_code) {
   /* Check builtin function's arity */
   size_t builtin_fn_arity =
       fn_call_primary->function_value.builtin_function->num_parameters;
   if (ast->fn_call.parameters->size != builtin_fn_arity) {
-    char *error_message =
+    interpreter_raise(
+        state,
         format_string("Function '%s' takes %ld, gut given %ld",
                       fn_call_primary->function_value.builtin_function->fn_name,
-                      builtin_fn_arity, ast->fn_call.parameters->size);
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+                      builtin_fn_arity, ast->fn_call.parameters->size));
   }
   /* Invoke the builtin function based on arity */
   if (builtin_fn_arity == 1) {
     void *(*fn_ptr)(void *) =
         fn_call_primary->function_value.builtin_function->fn_ptr;
     struct result *val_1 = vector_at(ast->fn_call.parameters, 0);
-    struct result *expr_eval = eval_expression(val_1->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(expr_eval);
-    fn_ptr(expr_eval->object);
+    fn_ptr(eval_expression(val_1->node, state, return_code));
   } else if (builtin_fn_arity == 2) {
     void *(*fn_ptr)(void *, void *) =
         fn_call_primary->function_value.builtin_function->fn_ptr;
     struct result *val_1 = vector_at(ast->fn_call.parameters, 0);
     struct result *val_2 = vector_at(ast->fn_call.parameters, 1);
-    struct result *expr_eval_1 =
+    struct object *expr_eval_1 =
         eval_expression(val_1->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(expr_eval_1);
-    struct result *expr_eval_2 =
+    struct object *expr_eval_2 =
         eval_expression(val_2->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(expr_eval_2);
     fn_ptr(expr_eval_1, expr_eval_2);
   } else {
-    char *error_message =
-        strdup("Unsupported number of parameters to bulitn function");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    interpreter_raise(
+        state, strdup("Unsupported number of parameters to bulitn function"));
   }
   return_code->is_set = false;
-  return result_ok_object(NULL);
+  return NULL;
 }
 
-struct result *
+struct object *
 eval_method_call_primary_expression(struct ast_node *ast,
                                     struct interpreter_state *state,
                                     struct return_value *return_code) {
   /* Method calls are currently only supported for arrays. This will
    * change once we add support for user-defined types. */
-  struct object *returner = NULL;
-  struct result *array_obj = eval_primary_expression(
+  struct object *array_obj = eval_primary_expression(
       ast->array_access.primary->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(array_obj);
-  if (array_obj->object->data_type == ARRAY_VALUE) {
-    if (ast->method_call.member->node->primary_node_type !=
-        FN_CALL_PRIMARY_NODE) {
-      char *error_message = strdup("Array methods can only be function calls");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
-    }
-    struct result *array_method_call_primary =
-        ast->method_call.member->node->fn_call.primary;
-    if (array_method_call_primary->node->primary_node_type !=
-        IDENTIFIER_PRIMARY_NODE) {
-      char *error_message =
-          strdup("Method calls to array should must be an identifier type");
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
-    }
-    if (strcmp(array_method_call_primary->node->id, "add") == 0) {
-      for (size_t i = 0;
-           i < ast->method_call.member->node->fn_call.parameters->size; i++) {
-        struct result *val =
-            vector_at(ast->method_call.member->node->fn_call.parameters, i);
-        struct result *ret = eval_expression(val->node, state, return_code);
-        RETURN_RESULT_IF_ERROR(ret);
-        vector_push_back(array_obj->object->array_value, ret->object);
-      }
-    } else if (strcmp(array_method_call_primary->node->id, "len") == 0) {
-      returner = malloc(sizeof(struct object));
-      returner->data_type = INT_VALUE;
-      returner->int_value = array_obj->object->array_value->size;
-    } else if (strcmp(array_method_call_primary->node->id, "pop") == 0) {
-      if (array_obj->object->array_value->size <= 0) {
-        char *error_message = strdup("Calling .pop() on an empty array");
-        return result_error_runtime(runtime_error_init(
-            error_message, state->current_stmt_lines.start_line,
-            state->current_stmt_lines.end_line));
-      }
-      struct vector *member_parameter =
-          ast->method_call.member->node->fn_call.parameters;
-      if (member_parameter->size > 1) {
-        char *error_message =
-            strdup(".pop() only supports one optional argument");
-        return result_error_runtime(runtime_error_init(
-            error_message, state->current_stmt_lines.start_line,
-            state->current_stmt_lines.end_line));
-      }
-      if (member_parameter->size == 1) {
-        struct result *val = vector_at(member_parameter, 0);
-        struct result *ret = eval_expression(val->node, state, return_code);
-        RETURN_RESULT_IF_ERROR(ret);
-        struct object *index = ret->object;
-        if (index->data_type != INT_VALUE) {
-          char *error_message =
-              strdup("The `pos` in .pop(pos) must be an integer");
-          return result_error_runtime(runtime_error_init(
-              error_message, state->current_stmt_lines.start_line,
-              state->current_stmt_lines.end_line));
-        }
-        /* Positive index */
-        if (index->int_value >= 0) {
-          if (index->int_value >= array_obj->object->array_value->size) {
-            char *error_message = strdup("Index out of bound in .pop(pos)");
-            return result_error_runtime(runtime_error_init(
-                error_message, state->current_stmt_lines.start_line,
-                state->current_stmt_lines.end_line));
-          }
-          returner = vector_remove_at(array_obj->object->array_value,
-                                      index->int_value);
-        } else {
-          /* Negative index */
-          long index_calc =
-              array_obj->object->array_value->size + index->int_value;
-          if (index_calc < 0) {
-            char *error_message = strdup("Index out of bound in .pop(pos)");
-            return result_error_runtime(runtime_error_init(
-                error_message, state->current_stmt_lines.start_line,
-                state->current_stmt_lines.end_line));
-          }
-          returner =
-              vector_remove_at(array_obj->object->array_value, index_calc);
-        }
-      } else {
-        /* the `pos` in .pop(pos) is optional. If `pos` is not given, we
-         * remove the last item */
-        returner = vector_remove_at(array_obj->object->array_value,
-                                    array_obj->object->array_value->size - 1);
-      }
-    } else {
-      char *error_message =
-          format_string("Invalid method '%s' for array operation",
-                        array_method_call_primary->node->id);
-      return result_error_runtime(runtime_error_init(
-          error_message, state->current_stmt_lines.start_line,
-          state->current_stmt_lines.end_line));
+  if (array_obj->data_type != ARRAY_VALUE) {
+    interpreter_raise(
+        state, strdup("Method calls are only supported for arrays for now"));
+  }
+  if (ast->method_call.member->node->primary_node_type !=
+      FN_CALL_PRIMARY_NODE) {
+    interpreter_raise(state,
+                      strdup("Array methods can only be function calls"));
+  }
+  struct result *array_method_call_primary =
+      ast->method_call.member->node->fn_call.primary;
+  if (array_method_call_primary->node->primary_node_type !=
+      IDENTIFIER_PRIMARY_NODE) {
+    interpreter_raise(
+        state,
+        strdup("Method calls to array should must be an identifier type"));
+  }
+  if (strcmp(array_method_call_primary->node->id, "add") == 0) {
+    for (size_t i = 0;
+         i < ast->method_call.member->node->fn_call.parameters->size; i++) {
+      struct result *val =
+          vector_at(ast->method_call.member->node->fn_call.parameters, i);
+      array_push(array_obj, eval_expression(val->node, state, return_code));
     }
-  } else {
-    char *error_message =
-        strdup("Method calls are only supported for arrays for now");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    return NULL;
+  }
+  if (strcmp(array_method_call_primary->node->id, "len") == 0) {
+    return object_int(array_obj->array_value->size);
   }
-  return result_ok_object(returner);
+  if (strcmp(array_method_call_primary->node->id, "pop") == 0) {
+    if (array_obj->array_value->size <= 0) {
+      interpreter_raise(state, strdup("Calling .pop() on an empty array"));
+    }
+    struct vector *member_parameter =
+        ast->method_call.member->node->fn_call.parameters;
+    if (member_parameter->size > 1) {
+      interpreter_raise(state,
+                        strdup(".pop() only supports one optional argument"));
+    }
+    struct object *index = NULL;
+    if (member_parameter->size == 1) {
+      struct result *val = vector_at(member_parameter, 0);
+      index = eval_expression(val->node, state, return_code);
+    }
+    return eval_array_pop_operation(array_obj, index, state);
+  }
+  interpreter_raise(state,
+                    format_string("Invalid method '%s' for array operation",
+                                  array_method_call_primary->node->id));
 }
 
-struct result *
+struct object *
 eval_array_creation_primary_expression(struct ast_node *ast,
                                        struct interpreter_state *state,
                                        struct return_value *return_code) {
-  struct object *array_obj = malloc(sizeof(struct object));
+  struct object *array_obj = pool_alloc(POOL_OBJECT);
   array_obj->data_type = ARRAY_VALUE;
-  array_obj->array_value = vector_init();
+  array_obj->array_value = array_init(ast->array->size);
+  array_obj->is_in_image = false;
   for (size_t i = 0; i < ast->array->size; i++) {
     struct result *val = vector_at(ast->array, i);
-    struct result *ret = eval_expression(val->node, state, return_code);
-    RETURN_RESULT_IF_ERROR(ret);
-    vector_push_back(array_obj->array_value, ret->object);
+    array_push(array_obj, eval_expression(val->node, state, return_code));
   }
-  return result_ok_object(array_obj);
+  return array_obj;
 }
 
-struct result *
+struct object *
 eval_array_access_primary_expression(struct ast_node *ast,
                                      struct interpreter_state *state,
                                      struct return_value *return_code) {
-  struct result *primary_eval = eval_primary_expression(
+  struct object *array_obj = eval_primary_expression(
       ast->array_access.primary->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(primary_eval);
-  struct object *array_obj = primary_eval->object;
+  if (ast->array_access.is_in_bounds) {
+    struct object *index =
+        eval_expression(ast->array_access.index->node, state, return_code);
+    return array_obj->array_value->items[index->int_value];
+  }
   if (array_obj->data_type != ARRAY_VALUE) {
-    char *error_message = strdup("Array access can only be used for arrays");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    interpreter_raise(state,
+                      strdup("Array access can only be used for arrays"));
   }
-  struct result *index_eval =
+  struct object *index =
       eval_expression(ast->array_access.index->node, state, return_code);
-  RETURN_RESULT_IF_ERROR(index_eval);
-  struct object *array_index = index_eval->object;
+  return eval_array_index_operation(array_obj, index, state);
+}
+
+struct object *eval_array_pop_operation(struct object *array_obj,
+                                        struct object *index,
+                                        struct interpreter_state *state) {
+  /* the `pos` in .pop(pos) is optional. If `pos` is not given, we remove the
+   * last item */
+  if (index == NULL) {
+    return array_remove_at(array_obj->array_value,
+                           array_obj->array_value->size - 1);
+  }
+  if (index->data_type != INT_VALUE) {
+    interpreter_raise(state,
+                      strdup("The `pos` in .pop(pos) must be an integer"));
+  }
+  /* Negative index counts from the end */
+  long index_calc = index->int_value >= 0
+                        ? index->int_value
+                        : (long)array_obj->array_value->size + index->int_value;
+  if (index_calc < 0 || index_calc >= array_obj->array_value->size) {
+    interpreter_raise(state, strdup("Index out of bound in .pop(pos)"));
+  }
+  return array_remove_at(array_obj->array_value, index_calc);
+}
+
+struct object *eval_array_index_operation(struct object *array_obj,
+                                          struct object *array_index,
+                                          struct interpreter_state *state) {
   if (array_index->data_type != INT_VALUE) {
-    char *error_message = strdup("Array index must be an integer");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+    interpreter_raise(state, strdup("Array index must be an integer"));
   }
-  if (array_index->int_value >= array_obj->array_value->size) {
-    char *error_message = strdup("Index out of bound");
-    return result_error_runtime(
-        runtime_error_init(error_message, state->current_stmt_lines.start_line,
-                           state->current_stmt_lines.end_line));
+  if (array_index->int_value < 0 ||
+      array_index->int_value >= array_obj->array_value->size) {
+    interpreter_raise(state, strdup("Index out of bound"));
   }
-  return result_ok_object(
-      vector_at(array_obj->array_value, array_index->int_value));
+  return array_obj->array_value->items[array_index->int_value];
 }
 
 struct environment *environment_init() {
-  struct environment *env = malloc(sizeof(struct environment));
+  struct environment *env = pool_alloc(POOL_ENVIRONMENT);
   env->symbols = hash_table_init();
   env->parent_environment = NULL;
+  env->function = NULL;
+  env->arguments = NULL;
+  env->captured = NULL;
   return env;
 }
 
 struct environment *
 environment_init_enclosed(struct environment *enclosed_env) {
-  struct environment *env = malloc(sizeof(struct environment));
-  env->symbols = hash_table_init();
+  struct environment *env = pool_alloc(POOL_ENVIRONMENT);
+  env->symbols = NULL; /* Most blocks declare nothing */
   env->parent_environment = enclosed_env;
+  env->function = NULL;
+  env->arguments = NULL;
+  env->captured = NULL;
   return env;
 }
 
-struct object *environment_lookup_symbol(struct environment *env, char *key) {
-  struct object *cur_env_value = hash_table_lookup(env->symbols, key);
-  if (cur_env_value != NULL) {
-    return cur_env_value;
+/* Returns the argument slot of `key` in a call frame, or NULL. Slots holding
+ * NULL are skipped, like symbols bound to NULL in a hash table. */
+static struct object **environment_argument(struct environment *env,
+                                            char *key) {
+  if (!env->function) {
+    return NULL;
+  }
+  struct vector *parameters = env->function->parameters;
+  for (size_t i = 0; i < parameters->size; i++) {
+    if (env->arguments[i] && strcmp(vector_at(parameters, i), key) == 0) {
+      return &env->arguments[i];
+    }
   }
-  if (env->parent_environment != NULL) {
-    return environment_lookup_symbol(env->parent_environment, key);
+  return NULL;
+}
+
+/* Returns the upvalue of `key` captured by the function of a call frame, or
+ * NULL. Upvalues bound to nothing are skipped too. */
+static struct upvalue *environment_upvalue(struct environment *env,
+                                           char *key) {
+  if (!env->function || !env->function->upvalues) {
+    return NULL;
+  }
+  struct vector *upvalues = env->function->upvalues;
+  for (size_t i = 0; i < upvalues->size; i++) {
+    struct upvalue *upvalue = vector_at(upvalues, i);
+    if (strcmp(upvalue->id, key) == 0 && upvalue_get(upvalue)) {
+      return upvalue;
+    }
+  }
+  return NULL;
+}
+
+struct object *environment_lookup_symbol(struct environment *env, char *key) {
+  for (; env; env = env->parent_environment) {
+    struct object *value = environment_lookup_symbol_current_env(env, key);
+    if (value != NULL) {
+      return value;
+    }
   }
   return NULL;
 }
 
 struct object *environment_lookup_symbol_current_env(struct environment *env,
                                                      char *key) {
-  return hash_table_lookup(env->symbols, key);
+  struct object **argument = environment_argument(env, key);
+  if (argument) {
+    return *argument;
+  }
+  struct upvalue *upvalue = environment_upvalue(env, key);
+  if (upvalue) {
+    return upvalue_get(upvalue);
+  }
+  return env->symbols ? hash_table_lookup(env->symbols, key) : NULL;
 }
 
 void environment_insert_symbol(struct environment *env, char *key,
                                struct object *value) {
+  struct object **argument = environment_argument(env, key);
+  if (argument) {
+    *argument = value;
+    return;
+  }
+  if (!env->symbols) {
+    env->symbols = hash_table_init();
+  }
   hash_table_insert(env->symbols, key, value);
 }
 
 void environment_reassign_symbol(struct environment *env, char *key,
                                  struct object *value) {
-  struct object *scope = hash_table_lookup(env->symbols, key);
-  if (scope != NULL) {
-    hash_table_update(env->symbols, key, value);
-  } else {
-    if (env->parent_environment != NULL) {
-      environment_reassign_symbol(env->parent_environment, key, value);
+  for (; env; env = env->parent_environment) {
+    struct object **argument = environment_argument(env, key);
+    if (argument) {
+      *argument = value;
+      return;
+    }
+    struct upvalue *upvalue = environment_upvalue(env, key);
+    if (upvalue) {
+      upvalue_set(upvalue, value);
+      return;
+    }
+    if (env->symbols && hash_table_lookup(env->symbols, key) != NULL) {
+      hash_table_update(env->symbols, key, value);
+      return;
     }
   }
 }
 
 void environment_free(struct environment *env) {
-  if (env->parent_environment != NULL) {
-    environment_free(env->parent_environment);
+  closure_close(env);
+  if (env->symbols) {
+    hash_table_free(env->symbols);
+  }
+  /* Call frames are released with the call stack */
+  if (!env->function) {
+    pool_free(POOL_ENVIRONMENT, env);
+  }
+}
+
+void environment_leave_scopes(struct interpreter_state *state,
+                              struct environment *env) {
+  while (state->env != env && !state->env->function &&
+         state->env != state->globals) {
+    struct environment *scope = state->env;
+    state->env = scope->parent_environment;
+    environment_free(scope);
+  }
+}
+
+static unsigned long string_hash(const char *chars, size_t length) {
+  unsigned long hash = 14695981039346656037UL;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)chars[i]) * 1099511628211UL;
   }
-  hash_table_free(env->symbols);
-  free(env);
+  return hash;
+}
+
+static struct string *string_alloc(size_t length) {
+  struct string *string = malloc(sizeof(struct string) + length + 1);
+  if (!string) {
+    perror("String allocation memory error\n");
+    exit(1);
+  }
+  string->length = length;
+  string->chars[length] = '\0';
+  return string;
+}
+
+struct string *string_init(const char *chars, size_t length) {
+  struct string *string = string_alloc(length);
+  memcpy(string->chars, chars, length);
+  string->hash = string_hash(string->chars, length);
+  return string;
+}
+
+struct string *string_concat(const char *lhs, size_t lhs_length,
+                             const char *rhs, size_t rhs_length) {
+  struct string *string = string_alloc(lhs_length + rhs_length);
+  memcpy(string->chars, lhs, lhs_length);
+  memcpy(string->chars + lhs_length, rhs, rhs_length);
+  string->hash = string_hash(string->chars, string->length);
+  return string;
+}
+
+bool string_equals(struct string *lhs, struct string *rhs) {
+  return lhs == rhs ||
+         (lhs->length == rhs->length && lhs->hash == rhs->hash &&
+          memcmp(lhs->chars, rhs->chars, lhs->length) == 0);
+}
+
+static struct object true_object = {.data_type = BOOLEAN_VALUE,
+                                    .bool_value = true};
+static struct object false_object = {.data_type = BOOLEAN_VALUE,
+                                     .bool_value = false};
+static struct object nil_object = {.data_type = NIL_VALUE};
+static struct object small_ints[SMALL_INT_MAX - SMALL_INT_MIN + 1];
+static bool is_small_ints_init;
+
+struct object *object_int(long value) {
+  if (value < SMALL_INT_MIN || value > SMALL_INT_MAX) {
+    struct object *returner = pool_alloc(POOL_OBJECT);
+    returner->data_type = INT_VALUE;
+    returner->int_value = value;
+    return returner;
+  }
+  if (!is_small_ints_init) {
+    for (long i = SMALL_INT_MIN; i <= SMALL_INT_MAX; i++) {
+      small_ints[i - SMALL_INT_MIN].data_type = INT_VALUE;
+      small_ints[i - SMALL_INT_MIN].int_value = i;
+    }
+    is_small_ints_init = true;
+  }
+  return &small_ints[value - SMALL_INT_MIN];
+}
+
+struct object *object_bool(bool value) {
+  return value ? &true_object : &false_object;
+}
+
+struct object *object_nil() { return &nil_object; }
+
+void literal_init_value(struct ast_node *literal) {
+  switch (literal->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+    literal->literal = object_int(literal->number);
+    break;
+  case STRING_PRIMARY_NODE:
+    literal->literal = pool_alloc(POOL_OBJECT);
+    literal->literal->data_type = STRING_VALUE;
+    literal->literal->string_value = literal->string;
+    break;
+  case BOOLEAN_PRIMARY_NODE:
+    literal->literal = object_bool(literal->boolean);
+    break;
+  case NIL_PRIMARY_NODE:
+    literal->literal = object_nil();
+    break;
+  default:
+    literal->literal = NULL;
+  }
+}
+
+struct array *array_init(size_t capacity) {
+  struct array *array =
+      malloc(sizeof(struct array) + capacity * sizeof(struct object *));
+  if (!array) {
+    perror("Array allocation memory error\n");
+    exit(1);
+  }
+  array->size = 0;
+  array->capacity = capacity;
+  return array;
+}
+
+void array_push(struct object *array_obj, struct object *value) {
+  struct array *array = array_obj->array_value;
+  if (array->size == array->capacity) {
+    size_t capacity = array->capacity ? array->capacity * 2 : 4;
+    size_t size = sizeof(struct array) + capacity * sizeof(struct object *);
+    if (array_obj->is_in_image) {
+      /* Not from malloc, it moves to the heap */
+      struct array *image_array = array;
+      array = malloc(size);
+      if (array) {
+        memcpy(array, image_array, sizeof(struct array) +
+                                       image_array->size *
+                                           sizeof(struct object *));
+      }
+      array_obj->is_in_image = false;
+    } else {
+      array = realloc(array, size);
+    }
+    if (!array) {
+      perror("Array allocation memory error\n");
+      exit(1);
+    }
+    array->capacity = capacity;
+    array_obj->array_value = array;
+  }
+  array->items[array->size++] = value;
+}
+
+struct object *array_remove_at(struct array *array, size_t index) {
+  struct object *removed = array->items[index];
+  memmove(&array->items[index], &array->items[index + 1],
+          (array->size - index - 1) * sizeof(struct object *));
+  array->size--;
+  return removed;
+}
+
+struct call_stack_mark call_stack_mark(struct interpreter_state *state) {
+  return (struct call_stack_mark){
+      .chunk = state->call_stack,
+      .used = state->call_stack ? state->call_stack->used : 0};
+}
+
+void call_stack_release(struct interpreter_state *state,
+                        struct call_stack_mark mark) {
+  /* Frames which inserted something else than their arguments own a table,
+   * and the variables of the others may be captured */
+  for (struct call_stack_chunk *chunk = state->call_stack; chunk;
+       chunk = chunk == mark.chunk ? NULL : chunk->previous) {
+    size_t used = chunk == mark.chunk ? mark.used : 0;
+    for (size_t offset = used; offset < chunk->used;) {
+      struct environment *env = (struct environment *)(chunk->data + offset);
+      closure_close(env);
+      if (env->symbols) {
+        hash_table_free(env->symbols);
+      }
+      offset += sizeof(struct environment) +
+                env->function->parameters->size * sizeof(struct object *);
+    }
+    chunk->used = used;
+  }
+  if (mark.chunk) {
+    state->call_stack = mark.chunk;
+  } else if (state->call_stack) {
+    while (state->call_stack->previous) {
+      state->call_stack = state->call_stack->previous;
+    }
+  }
+}
+
+/* Returns `size` bytes on top of the call stack */
+static void *call_stack_push(struct interpreter_state *state, size_t size) {
+  struct call_stack_chunk *chunk = state->call_stack;
+  if (chunk && chunk->used + size > chunk->capacity && chunk->next &&
+      size <= chunk->next->capacity) {
+    chunk = state->call_stack = chunk->next;
+  }
+  if (!chunk || chunk->used + size > chunk->capacity) {
+    size_t capacity =
+        size > CALL_STACK_CHUNK_SIZE ? size : CALL_STACK_CHUNK_SIZE;
+    struct call_stack_chunk *next =
+        malloc(sizeof(struct call_stack_chunk) + capacity);
+    if (!next) {
+      perror("Call stack allocation memory error\n");
+      exit(1);
+    }
+    next->previous = chunk;
+    next->next = NULL;
+    next->used = 0;
+    next->capacity = capacity;
+    if (chunk) {
+      /* The chunks kept for reuse were too small: drop them */
+      while (chunk->next) {
+        struct call_stack_chunk *unused = chunk->next;
+        chunk->next = unused->next;
+        free(unused);
+      }
+      chunk->next = next;
+    }
+    chunk = state->call_stack = next;
+  }
+  void *top = chunk->data + chunk->used;
+  chunk->used += size;
+  return top;
+}
+
+struct environment *environment_init_frame(struct interpreter_state *state,
+                                           struct function *function) {
+  size_t num_parameters = function->parameters->size;
+  struct environment *env = call_stack_push(
+      state,
+      sizeof(struct environment) + num_parameters * sizeof(struct object *));
+  env->symbols = NULL;
+  env->parent_environment = state->globals;
+  env->function = function;
+  env->arguments = (struct object **)(env + 1);
+  env->captured = NULL;
+  memset(env->arguments, 0, num_parameters * sizeof(struct object *));
+  return env;
+}
+
+void check_arity(struct function *function, size_t num_arguments,
+                 struct interpreter_state *state) {
+  if (num_arguments != function->parameters->size) {
+    interpreter_raise(
+        state,
+        format_string("Function '%s' takes %zu arguments, but got %zu",
+                      function->id, function->parameters->size,
+                      num_arguments));
+  }
+}
+
+void interpreter_push_handler(struct interpreter_state *state,
+                              struct error_handler *handler) {
+  handler->error = NULL;
+  handler->previous = state->error_handler;
+  state->error_handler = handler;
+}
+
+void interpreter_pop_handler(struct interpreter_state *state) {
+  state->error_handler = state->error_handler->previous;
+}
+
+_Noreturn void interpreter_raise_error(struct interpreter_state *state,
+                                       struct runtime_error *error) {
+  struct error_handler *handler = state->error_handler;
+  if (!handler) {
+    print_interpreter_error(error);
+    exit(1);
+  }
+  interpreter_pop_handler(state);
+  handler->error = error;
+  longjmp(handler->jump, 1);
+}
+
+_Noreturn void interpreter_raise(struct interpreter_state *state,
+                                 char *error_message) {
+  interpreter_raise_error(
+      state,
+      runtime_error_init(error_message, state->current_stmt_lines.start_line,
+                         state->current_stmt_lines.end_line));
 }
@@ -0,0 +1,924 @@
+#include "ir.h"
+#include "ast.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "utils.h"
+#include "vector.h"
+#include <string.h>
+
+/* Value of the names in `ir_builder.owners` mentioned by several functions */
+static int shared_name;
+/* Value of the names in the hash tables of `ir_scan` and `ir_builder` */
+static int marked;
+
+/* Names declared and pinned by the body of a function. Pinned names are
+ * defined as functions, or used where their declaration is not in scope: they
+ * may then refer to the one of an enclosing call of the same function. */
+struct ir_scan {
+  void *owner;
+  struct hash_table *declared_names;
+  struct hash_table *redeclared_names;
+  struct hash_table *pinned_names;
+  struct vector *scopes; /* Vector of hash tables, declared names in scope */
+};
+
+static void lower_statement(struct ir_builder *builder, struct ast_node *stmt);
+static struct ir_value *lower_expression(struct ir_builder *builder,
+                                         struct ast_node *expr);
+static struct ir_value *read_variable(struct ir_block *block, char *name);
+
+bool ir_is_terminator(enum ir_opcode opcode) {
+  return opcode == IR_JUMP || opcode == IR_BRANCH || opcode == IR_RETURN;
+}
+
+bool ir_has_result(enum ir_opcode opcode) {
+  switch (opcode) {
+  case IR_DECLARE:
+  case IR_STORE:
+  case IR_STORE_INDEX:
+  case IR_PUSH_SCOPE:
+  case IR_POP_SCOPE:
+  case IR_JUMP:
+  case IR_BRANCH:
+  case IR_RETURN:
+    return false;
+  default:
+    return true;
+  }
+}
+
+const char *get_string_from_ir_type(enum ir_type type) {
+  switch (type) {
+  case IR_TYPE_UNKNOWN:
+    return "?";
+  case IR_TYPE_INT:
+    return "int";
+  case IR_TYPE_BOOL:
+    return "bool";
+  case IR_TYPE_STRING:
+    return "string";
+  case IR_TYPE_NIL:
+    return "nil";
+  case IR_TYPE_ARRAY:
+    return "array";
+  case IR_TYPE_FUNCTION:
+    return "function";
+  }
+  return "?";
+}
+
+static void mark(struct hash_table *table, char *name) {
+  if (!hash_table_lookup(table, name)) {
+    hash_table_insert(table, name, &marked);
+  }
+}
+
+static void mention(struct ir_builder *builder, void *owner, char *name) {
+  void *current_owner = hash_table_lookup(builder->owners, name);
+  if (!current_owner) {
+    hash_table_insert(builder->owners, name, owner);
+  } else if (current_owner != owner) {
+    hash_table_update(builder->owners, name, &shared_name);
+  }
+}
+
+static void declare(struct ir_scan *scan, char *name) {
+  if (hash_table_lookup(scan->declared_names, name)) {
+    mark(scan->redeclared_names, name);
+  } else {
+    mark(scan->declared_names, name);
+  }
+  mark(vector_at(scan->scopes, scan->scopes->size - 1), name);
+}
+
+static void reference(struct ir_scan *scan, char *name) {
+  for (size_t i = 0; i < scan->scopes->size; i++) {
+    if (hash_table_lookup(vector_at(scan->scopes, i), name)) {
+      return;
+    }
+  }
+  mark(scan->pinned_names, name);
+}
+
+static void enter_scan_scope(struct ir_scan *scan) {
+  if (scan->scopes) {
+    vector_push_back(scan->scopes, hash_table_init());
+  }
+}
+
+static void leave_scan_scope(struct ir_scan *scan) {
+  if (scan->scopes) {
+    hash_table_free(vector_at(scan->scopes, scan->scopes->size - 1));
+    scan->scopes->size--;
+  }
+}
+
+static void scan_node(struct ir_builder *builder, struct ir_scan *scan,
+                      struct ast_node *node);
+
+static void scan_nodes(struct ir_builder *builder, struct ir_scan *scan,
+                       struct vector *nodes) {
+  for (size_t i = 0; i < nodes->size; i++) {
+    struct result *val = vector_at(nodes, i);
+    scan_node(builder, scan, val->node);
+  }
+}
+
+static void scan_statements(struct ir_builder *builder, struct ir_scan *scan,
+                            struct vector *stmts) {
+  for (size_t i = 0; i < stmts->size; i++) {
+    scan_node(builder, scan, vector_at(stmts, i));
+  }
+}
+
+/* Gathers the owners of every name when `scan->declared_names` is NULL, and
+ * the names of the body of `scan->owner` otherwise */
+static void scan_node(struct ir_builder *builder, struct ir_scan *scan,
+                      struct ast_node *node) {
+  bool is_owner_scan = !scan->declared_names;
+  switch (node->node_type) {
+  case FN_DEF_STMT:
+    if (is_owner_scan) {
+      mention(builder, scan->owner, node->fn_def_stmt.id);
+      struct ir_scan body_scan = {.owner = node,
+                                  .declared_names = NULL,
+                                  .redeclared_names = NULL,
+                                  .pinned_names = NULL,
+                                  .scopes = NULL};
+      for (size_t i = 0; i < node->fn_def_stmt.parameters->size; i++) {
+        mention(builder, node, vector_at(node->fn_def_stmt.parameters, i));
+      }
+      scan_node(builder, &body_scan, node->fn_def_stmt.block->node);
+    } else {
+      declare(scan, node->fn_def_stmt.id);
+      mark(scan->pinned_names, node->fn_def_stmt.id);
+    }
+    return;
+  case VARIABLE_DECL_STMT:
+    scan_node(builder, scan, node->var_decl_stmt.expr->node);
+    if (is_owner_scan) {
+      mention(builder, scan->owner, node->var_decl_stmt.id);
+    } else {
+      declare(scan, node->var_decl_stmt.id);
+    }
+    return;
+  case VARIABLE_ASSIGN_STMT:
+    scan_node(builder, scan, node->var_assign_stmt.primary->node);
+    scan_node(builder, scan, node->var_assign_stmt.expr->node);
+    return;
+  case IF_STMT:
+    scan_node(builder, scan, node->if_else_stmt.expr->node);
+    scan_node(builder, scan, node->if_else_stmt.if_block->node);
+    if (node->if_else_stmt.else_block) {
+      scan_node(builder, scan, node->if_else_stmt.else_block->node);
+    }
+    return;
+  case WHILE_STMT:
+    scan_node(builder, scan, node->while_stmt.expr->node);
+    scan_node(builder, scan, node->while_stmt.block->node);
+    return;
+  case FOR_STMT:
+    enter_scan_scope(scan);
+    scan_node(builder, scan, node->for_stmt.init_stmt->node);
+    scan_node(builder, scan, node->for_stmt.expr_stmt->node);
+    scan_node(builder, scan, node->for_stmt.update_stmt->node);
+    scan_node(builder, scan, node->for_stmt.block->node);
+    leave_scan_scope(scan);
+    return;
+  case RETURN_STMT:
+    if (node->return_stmt_expr) {
+      scan_node(builder, scan, node->return_stmt_expr->node);
+    }
+    return;
+  case BLOCK_STMT:
+    enter_scan_scope(scan);
+    scan_statements(builder, scan, node->block_stmt_stmts);
+    leave_scan_scope(scan);
+    return;
+  case EXPR_STMT:
+    scan_node(builder, scan, node->expr_stmt_expr->node);
+    return;
+  case BINARY_NODE:
+    scan_node(builder, scan, node->binary.left->node);
+    scan_node(builder, scan, node->binary.right->node);
+    return;
+  case UNARY_NODE:
+    scan_node(builder, scan, node->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (node->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE:
+    if (is_owner_scan) {
+      mention(builder, scan->owner, node->id);
+    } else {
+      reference(scan, node->id);
+    }
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    scan_node(builder, scan, node->fn_call.primary->node);
+    scan_nodes(builder, scan, node->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    scan_node(builder, scan, node->method_call.object->node);
+    if (node->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      scan_nodes(builder, scan,
+                 node->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    scan_nodes(builder, scan, node->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    scan_node(builder, scan, node->array_access.primary->node);
+    scan_node(builder, scan, node->array_access.index->node);
+    break;
+  case INVARIANT_PRIMARY_NODE:
+    scan_node(builder, scan, node->invariant.expr->node);
+    break;
+  case SAVED_PRIMARY_NODE:
+    scan_node(builder, scan, node->saved.expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Names of the body of `owner` which can be SSA values */
+static struct hash_table *promotable_names(struct ir_builder *builder,
+                                           void *owner,
+                                           struct vector *parameters,
+                                           struct vector *stmts) {
+  struct ir_scan scan = {.owner = owner,
+                         .declared_names = hash_table_init(),
+                         .redeclared_names = hash_table_init(),
+                         .pinned_names = hash_table_init(),
+                         .scopes = vector_init()};
+  enter_scan_scope(&scan);
+  for (size_t i = 0; i < parameters->size; i++) {
+    declare(&scan, vector_at(parameters, i));
+  }
+  scan_statements(builder, &scan, stmts);
+  leave_scan_scope(&scan);
+  vector_free(scan.scopes);
+  struct hash_table *promoted = hash_table_init();
+  size_t index = 0;
+  const char *key;
+  void *value;
+  while (hash_table_next(scan.declared_names, &index, &key, &value)) {
+    char *name = (char *)key;
+    if (hash_table_lookup(builder->owners, name) == owner &&
+        !hash_table_lookup(scan.redeclared_names, name) &&
+        !hash_table_lookup(scan.pinned_names, name)) {
+      mark(promoted, name);
+    }
+  }
+  hash_table_free(scan.declared_names);
+  hash_table_free(scan.redeclared_names);
+  hash_table_free(scan.pinned_names);
+  return promoted;
+}
+
+static struct ir_block *new_block(struct ir_function *function) {
+  struct ir_block *block = malloc(sizeof(struct ir_block));
+  block->id = function->blocks->size;
+  block->function = function;
+  block->phis = vector_init();
+  block->instructions = vector_init();
+  block->predecessors = vector_init();
+  block->is_sealed = false;
+  block->definitions = hash_table_init();
+  block->incomplete_phis = vector_init();
+  vector_push_back(function->blocks, block);
+  return block;
+}
+
+static struct ir_value *new_value(struct ir_function *function,
+                                  enum ir_opcode opcode, enum ir_type type) {
+  struct ir_value *value = malloc(sizeof(struct ir_value));
+  value->id = function->num_values++;
+  value->opcode = opcode;
+  value->type = type;
+  value->block = NULL;
+  value->operands = vector_init();
+  value->targets[0] = NULL;
+  value->targets[1] = NULL;
+  value->node = NULL;
+  value->function = NULL;
+  return value;
+}
+
+static struct ir_value *emit(struct ir_builder *builder, enum ir_opcode opcode,
+                             enum ir_type type, struct ast_node *node) {
+  struct ir_value *value = new_value(builder->function, opcode, type);
+  value->block = builder->block;
+  value->node = node;
+  vector_push_back(builder->block->instructions, value);
+  return value;
+}
+
+static void jump(struct ir_builder *builder, struct ir_block *target) {
+  emit(builder, IR_JUMP, IR_TYPE_UNKNOWN, NULL)->targets[0] = target;
+  vector_push_back(target->predecessors, builder->block);
+  builder->block = NULL;
+}
+
+static void branch(struct ir_builder *builder, struct ir_value *condition,
+                   struct ir_block *then_block, struct ir_block *else_block,
+                   struct ast_node *node) {
+  struct ir_value *value = emit(builder, IR_BRANCH, IR_TYPE_UNKNOWN, node);
+  vector_push_back(value->operands, condition);
+  value->targets[0] = then_block;
+  value->targets[1] = else_block;
+  vector_push_back(then_block->predecessors, builder->block);
+  vector_push_back(else_block->predecessors, builder->block);
+  builder->block = NULL;
+}
+
+/* SSA construction follows Braun et al., "Simple and Efficient Construction
+ * of Static Single Assignment Form" */
+
+static void write_variable(struct ir_block *block, char *name,
+                           struct ir_value *value) {
+  if (hash_table_lookup(block->definitions, name)) {
+    hash_table_update(block->definitions, name, value);
+  } else {
+    hash_table_insert(block->definitions, name, value);
+  }
+}
+
+static struct ir_value *new_phi(struct ir_block *block, char *name) {
+  struct ir_value *phi =
+      new_value(block->function, IR_PHI, IR_TYPE_UNKNOWN);
+  phi->block = block;
+  phi->name = name;
+  vector_push_back(block->phis, phi);
+  return phi;
+}
+
+static void add_phi_operands(struct ir_value *phi) {
+  struct vector *predecessors = phi->block->predecessors;
+  for (size_t i = 0; i < predecessors->size; i++) {
+    vector_push_back(phi->operands,
+                     read_variable(vector_at(predecessors, i), phi->name));
+  }
+}
+
+static struct ir_value *read_variable_recursive(struct ir_block *block,
+                                                char *name) {
+  struct ir_value *value;
+  if (!block->is_sealed) {
+    value = new_phi(block, name);
+    vector_push_back(block->incomplete_phis, value);
+  } else if (block->predecessors->size == 1) {
+    value = read_variable(vector_at(block->predecessors, 0), name);
+  } else if (block->predecessors->size == 0) {
+    /* Not reached: a promoted name is only read after its declaration */
+    value = new_value(block->function, IR_CONST_NIL, IR_TYPE_NIL);
+    value->block = block;
+    vector_push_back(block->instructions, value);
+    for (size_t i = block->instructions->size - 1; i > 0; i--) {
+      vector_replace_at(block->instructions, i,
+                        vector_at(block->instructions, i - 1));
+    }
+    vector_replace_at(block->instructions, 0, value);
+  } else {
+    /* Breaks cycles through loops */
+    value = new_phi(block, name);
+    write_variable(block, name, value);
+    add_phi_operands(value);
+  }
+  write_variable(block, name, value);
+  return value;
+}
+
+static struct ir_value *read_variable(struct ir_block *block, char *name) {
+  struct ir_value *value = hash_table_lookup(block->definitions, name);
+  return value ? value : read_variable_recursive(block, name);
+}
+
+static void seal_block(struct ir_block *block) {
+  for (size_t i = 0; i < block->incomplete_phis->size; i++) {
+    add_phi_operands(vector_at(block->incomplete_phis, i));
+  }
+  block->incomplete_phis->size = 0;
+  block->is_sealed = true;
+}
+
+static void replace_uses(struct ir_function *function, struct ir_value *old,
+                         struct ir_value *replacement) {
+  for (size_t i = 0; i < function->blocks->size; i++) {
+    struct ir_block *block = vector_at(function->blocks, i);
+    struct vector *lists[] = {block->phis, block->instructions};
+    for (size_t l = 0; l < 2; l++) {
+      for (size_t j = 0; j < lists[l]->size; j++) {
+        struct ir_value *value = vector_at(lists[l], j);
+        for (size_t k = 0; k < value->operands->size; k++) {
+          if (vector_at(value->operands, k) == old) {
+            vector_replace_at(value->operands, k, replacement);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* Removes the phis whose operands are all the same value, or the phi itself,
+ * until there are none left */
+static void remove_trivial_phis(struct ir_function *function) {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < function->blocks->size; i++) {
+      struct ir_block *block = vector_at(function->blocks, i);
+      for (size_t j = 0; j < block->phis->size; j++) {
+        struct ir_value *phi = vector_at(block->phis, j);
+        struct ir_value *same = NULL;
+        bool is_trivial = true;
+        for (size_t k = 0; k < phi->operands->size; k++) {
+          struct ir_value *operand = vector_at(phi->operands, k);
+          if (operand == same || operand == phi) {
+            continue;
+          }
+          if (same) {
+            is_trivial = false;
+            break;
+          }
+          same = operand;
+        }
+        if (is_trivial && same) {
+          replace_uses(function, phi, same);
+          vector_remove_at(block->phis, j--);
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+static void number_values(struct ir_function *function) {
+  function->num_values = 0;
+  for (size_t i = 0; i < function->blocks->size; i++) {
+    struct ir_block *block = vector_at(function->blocks, i);
+    for (size_t j = 0; j < block->phis->size; j++) {
+      ((struct ir_value *)vector_at(block->phis, j))->id =
+          function->num_values++;
+    }
+    for (size_t j = 0; j < block->instructions->size; j++) {
+      ((struct ir_value *)vector_at(block->instructions, j))->id =
+          function->num_values++;
+    }
+  }
+}
+
+static bool is_promoted(struct ir_builder *builder, char *name) {
+  for (size_t i = builder->scopes->size; i > 0; i--) {
+    if (hash_table_lookup(vector_at(builder->scopes, i - 1), name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void push_scope(struct ir_builder *builder) {
+  vector_push_back(builder->scopes, hash_table_init());
+}
+
+static void pop_scope(struct ir_builder *builder) {
+  hash_table_free(vector_at(builder->scopes, builder->scopes->size - 1));
+  builder->scopes->size--;
+}
+
+/* Binds `name` to `value`, in SSA form or in the environment */
+static void lower_declaration(struct ir_builder *builder, char *name,
+                              struct ir_value *value, struct ast_node *node) {
+  if (hash_table_lookup(builder->promoted, name)) {
+    mark(vector_at(builder->scopes, builder->scopes->size - 1), name);
+    write_variable(builder->block, name, value);
+    return;
+  }
+  struct ir_value *declaration =
+      emit(builder, IR_DECLARE, IR_TYPE_UNKNOWN, node);
+  declaration->name = name;
+  vector_push_back(declaration->operands, value);
+}
+
+/* Appends the values of `expressions`, a vector of result(`ast_node`), to
+ * `operands` */
+static void lower_operands(struct ir_builder *builder, struct vector *operands,
+                           struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    vector_push_back(operands, lower_expression(builder, val->node));
+  }
+}
+
+/* Emits an instruction whose operands were lowered before it */
+static struct ir_value *emit_with_operands(struct ir_builder *builder,
+                                           enum ir_opcode opcode,
+                                           enum ir_type type,
+                                           struct ast_node *node,
+                                           struct vector *operands) {
+  struct ir_value *value = emit(builder, opcode, type, node);
+  vector_free(value->operands);
+  value->operands = operands;
+  return value;
+}
+
+static struct ir_value *lower_method_call(struct ir_builder *builder,
+                                          struct ast_node *expr) {
+  struct vector *operands = vector_init();
+  vector_push_back(operands,
+                   lower_expression(builder, expr->method_call.object->node));
+  struct ast_node *member = expr->method_call.member->node;
+  char *method = NULL;
+  if (member->primary_node_type == FN_CALL_PRIMARY_NODE &&
+      member->fn_call.primary->node->primary_node_type ==
+          IDENTIFIER_PRIMARY_NODE) {
+    method = member->fn_call.primary->node->id;
+    lower_operands(builder, operands, member->fn_call.parameters);
+  }
+  struct ir_value *value =
+      emit_with_operands(builder, IR_CALL_METHOD,
+                         method && strcmp(method, "len") == 0 ? IR_TYPE_INT
+                                                              : IR_TYPE_UNKNOWN,
+                         expr, operands);
+  value->name = method;
+  return value;
+}
+
+static struct ir_value *lower_expression(struct ir_builder *builder,
+                                         struct ast_node *expr) {
+  struct ir_value *value;
+  switch (expr->node_type) {
+  case BINARY_NODE: {
+    struct ir_value *left = lower_expression(builder, expr->binary.left->node);
+    struct ir_value *right =
+        lower_expression(builder, expr->binary.right->node);
+    value = emit(builder, IR_BINARY, IR_TYPE_UNKNOWN, expr);
+    value->op = expr->binary.op;
+    vector_push_back(value->operands, left);
+    vector_push_back(value->operands, right);
+    return value;
+  }
+  case UNARY_NODE: {
+    struct ir_value *operand =
+        lower_expression(builder, expr->unary.primary->node);
+    value = emit(builder, IR_UNARY, IR_TYPE_UNKNOWN, expr);
+    value->op = expr->unary.op;
+    vector_push_back(value->operands, operand);
+    return value;
+  }
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+    value = emit(builder, IR_CONST_INT, IR_TYPE_INT, expr);
+    value->number = expr->number;
+    return value;
+  case STRING_PRIMARY_NODE:
+    value = emit(builder, IR_CONST_STRING, IR_TYPE_STRING, expr);
+    value->string = expr->string->chars;
+    return value;
+  case BOOLEAN_PRIMARY_NODE:
+    value = emit(builder, IR_CONST_BOOL, IR_TYPE_BOOL, expr);
+    value->boolean = expr->boolean;
+    return value;
+  case NIL_PRIMARY_NODE:
+    return emit(builder, IR_CONST_NIL, IR_TYPE_NIL, expr);
+  case IDENTIFIER_PRIMARY_NODE:
+    if (is_promoted(builder, expr->id)) {
+      return read_variable(builder->block, expr->id);
+    }
+    value = emit(builder, IR_LOAD, IR_TYPE_UNKNOWN, expr);
+    value->name = expr->id;
+    return value;
+  case FN_CALL_PRIMARY_NODE: {
+    struct vector *operands = vector_init();
+    vector_push_back(operands,
+                     lower_expression(builder, expr->fn_call.primary->node));
+    lower_operands(builder, operands, expr->fn_call.parameters);
+    return emit_with_operands(builder, IR_CALL, IR_TYPE_UNKNOWN, expr,
+                              operands);
+  }
+  case METHOD_CALL_PRIMARY_NODE:
+    return lower_method_call(builder, expr);
+  case ARRAY_CREATION_PRIMARY_NODE: {
+    struct vector *operands = vector_init();
+    lower_operands(builder, operands, expr->array);
+    return emit_with_operands(builder, IR_ARRAY, IR_TYPE_ARRAY, expr,
+                              operands);
+  }
+  case ARRAY_ACCESS_PRIMARY_NODE: {
+    struct ir_value *array =
+        lower_expression(builder, expr->array_access.primary->node);
+    struct ir_value *index =
+        lower_expression(builder, expr->array_access.index->node);
+    value = emit(builder, IR_INDEX, IR_TYPE_UNKNOWN, expr);
+    vector_push_back(value->operands, array);
+    vector_push_back(value->operands, index);
+    return value;
+  }
+  case INVARIANT_PRIMARY_NODE:
+    /* Recomputed, hoisting it is left to passes over the IR */
+    return lower_expression(builder, expr->invariant.expr->node);
+  case SAVED_PRIMARY_NODE:
+    value = lower_expression(builder, expr->saved.expr->node);
+    hash_table_insert(builder->saved, format_string("%zu", expr->saved.id),
+                      value);
+    return value;
+  case REUSED_PRIMARY_NODE:
+    return hash_table_lookup(builder->saved,
+                             format_string("%zu", expr->reused->saved.id));
+  }
+  return NULL;
+}
+
+static void lower_statements(struct ir_builder *builder, struct vector *stmts) {
+  for (size_t i = 0; i < stmts->size && builder->block; i++) {
+    lower_statement(builder, vector_at(stmts, i));
+  }
+}
+
+static void enter_scope(struct ir_builder *builder) {
+  emit(builder, IR_PUSH_SCOPE, IR_TYPE_UNKNOWN, NULL);
+  builder->scope_depth++;
+  push_scope(builder);
+}
+
+static void leave_scope(struct ir_builder *builder) {
+  pop_scope(builder);
+  builder->scope_depth--;
+  if (builder->block) {
+    emit(builder, IR_POP_SCOPE, IR_TYPE_UNKNOWN, NULL);
+  }
+}
+
+static void lower_block(struct ir_builder *builder, struct ast_node *block) {
+  enter_scope(builder);
+  lower_statements(builder, block->block_stmt_stmts);
+  leave_scope(builder);
+}
+
+static struct ir_function *lower_function(struct ir_builder *builder,
+                                          void *owner, char *name,
+                                          struct vector *parameters,
+                                          struct ast_node *body,
+                                          struct vector *stmts);
+
+static void lower_if_statement(struct ir_builder *builder,
+                               struct ast_node *stmt) {
+  struct ir_value *condition =
+      lower_expression(builder, stmt->if_else_stmt.expr->node);
+  struct ir_function *function = builder->function;
+  struct ir_block *then_block = new_block(function);
+  struct ir_block *else_block = NULL;
+  struct ir_block *join_block = NULL;
+  if (stmt->if_else_stmt.else_block) {
+    else_block = new_block(function);
+  } else {
+    join_block = new_block(function);
+  }
+  branch(builder, condition, then_block,
+         else_block ? else_block : join_block, stmt);
+  seal_block(then_block);
+  builder->block = then_block;
+  lower_block(builder, stmt->if_else_stmt.if_block->node);
+  struct ir_block *then_end = builder->block;
+  if (else_block) {
+    seal_block(else_block);
+    builder->block = else_block;
+    lower_block(builder, stmt->if_else_stmt.else_block->node);
+    struct ir_block *else_end = builder->block;
+    if (then_end || else_end) {
+      join_block = new_block(function);
+    }
+    if (else_end) {
+      builder->block = else_end;
+      jump(builder, join_block);
+    }
+  }
+  if (then_end) {
+    builder->block = then_end;
+    jump(builder, join_block);
+  }
+  if (join_block) {
+    seal_block(join_block);
+  }
+  builder->block = join_block;
+}
+
+/* Lowers what follows the condition of a loop, whose value was computed in
+ * `header` */
+static void lower_loop(struct ir_builder *builder, struct ir_block *header,
+                       struct ir_value *condition, struct ast_node *stmt,
+                       struct ast_node *block, struct ast_node *update_stmt) {
+  struct ir_block *body = new_block(builder->function);
+  struct ir_block *exit = new_block(builder->function);
+  branch(builder, condition, body, exit, stmt);
+  seal_block(body);
+  struct ir_loop *enclosing_loop = builder->loop;
+  struct ir_loop loop = {.exit = exit, .scope_depth = builder->scope_depth};
+  builder->loop = &loop;
+  builder->block = body;
+  lower_block(builder, block);
+  if (builder->block && update_stmt) {
+    lower_statement(builder, update_stmt);
+  }
+  if (builder->block) {
+    jump(builder, header);
+  }
+  builder->loop = enclosing_loop;
+  seal_block(header);
+  seal_block(exit);
+  builder->block = exit;
+}
+
+static void lower_statement(struct ir_builder *builder, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT: {
+    struct ir_function *function = lower_function(
+        builder, stmt, stmt->fn_def_stmt.id, stmt->fn_def_stmt.parameters,
+        stmt->fn_def_stmt.block->node, NULL);
+    struct ir_value *value =
+        emit(builder, IR_FUNCTION, IR_TYPE_FUNCTION, stmt);
+    value->function = function;
+    break;
+  }
+  case VARIABLE_DECL_STMT:
+    lower_declaration(builder, stmt->var_decl_stmt.id,
+                      lower_expression(builder, stmt->var_decl_stmt.expr->node),
+                      stmt);
+    break;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+      struct ir_value *value =
+          lower_expression(builder, stmt->var_assign_stmt.expr->node);
+      if (is_promoted(builder, target->id)) {
+        write_variable(builder->block, target->id, value);
+        break;
+      }
+      struct ir_value *store =
+          emit(builder, IR_STORE, IR_TYPE_UNKNOWN, stmt);
+      store->name = target->id;
+      vector_push_back(store->operands, value);
+      break;
+    }
+    struct ir_value *array =
+        lower_expression(builder, target->array_access.primary->node);
+    struct ir_value *index =
+        lower_expression(builder, target->array_access.index->node);
+    struct ir_value *value =
+        lower_expression(builder, stmt->var_assign_stmt.expr->node);
+    struct ir_value *store =
+        emit(builder, IR_STORE_INDEX, IR_TYPE_UNKNOWN, stmt);
+    vector_push_back(store->operands, array);
+    vector_push_back(store->operands, index);
+    vector_push_back(store->operands, value);
+    break;
+  }
+  case IF_STMT:
+    lower_if_statement(builder, stmt);
+    break;
+  case WHILE_STMT: {
+    struct ir_block *header = new_block(builder->function);
+    jump(builder, header);
+    builder->block = header;
+    struct ir_value *condition =
+        lower_expression(builder, stmt->while_stmt.expr->node);
+    lower_loop(builder, header, condition, stmt,
+               stmt->while_stmt.block->node, NULL);
+    break;
+  }
+  case FOR_STMT: {
+    /* The initializer is declared in the loop's own scope */
+    enter_scope(builder);
+    lower_statement(builder, stmt->for_stmt.init_stmt->node);
+    struct ir_block *header = new_block(builder->function);
+    jump(builder, header);
+    builder->block = header;
+    struct ir_value *condition = lower_expression(
+        builder, stmt->for_stmt.expr_stmt->node->expr_stmt_expr->node);
+    lower_loop(builder, header, condition, stmt, stmt->for_stmt.block->node,
+               stmt->for_stmt.update_stmt->node);
+    leave_scope(builder);
+    break;
+  }
+  case BREAK_STMT:
+    /* Outside of a loop, 'break' does nothing, like in the stack VM */
+    if (builder->loop) {
+      for (size_t i = builder->loop->scope_depth; i < builder->scope_depth;
+           i++) {
+        emit(builder, IR_POP_SCOPE, IR_TYPE_UNKNOWN, NULL);
+      }
+      jump(builder, builder->loop->exit);
+    } else {
+      builder->program->has_stray_break = true;
+    }
+    break;
+  case RETURN_STMT: {
+    struct ir_value *value =
+        stmt->return_stmt_expr
+            ? lower_expression(builder, stmt->return_stmt_expr->node)
+            : NULL;
+    struct ir_value *ret = emit(builder, IR_RETURN, IR_TYPE_UNKNOWN, stmt);
+    if (value) {
+      vector_push_back(ret->operands, value);
+    }
+    builder->block = NULL;
+    break;
+  }
+  case BLOCK_STMT:
+    lower_block(builder, stmt);
+    break;
+  case EXPR_STMT:
+    lower_expression(builder, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Lowers a function definition, with `body`, or the program, with `stmts` */
+static struct ir_function *lower_function(struct ir_builder *builder,
+                                          void *owner, char *name,
+                                          struct vector *parameters,
+                                          struct ast_node *body,
+                                          struct vector *stmts) {
+  struct ir_function *function = malloc(sizeof(struct ir_function));
+  function->name = name;
+  function->parameters = parameters;
+  function->blocks = vector_init();
+  function->num_values = 0;
+  vector_push_back(builder->program->functions, function);
+
+  struct ir_builder enclosing = *builder;
+  builder->function = function;
+  builder->loop = NULL;
+  builder->scope_depth = 0;
+  builder->scopes = vector_init();
+  builder->promoted = promotable_names(
+      builder, owner, parameters, body ? body->block_stmt_stmts : stmts);
+  builder->block = new_block(function);
+  seal_block(builder->block);
+  push_scope(builder);
+  for (size_t i = 0; i < parameters->size; i++) {
+    char *parameter = vector_at(parameters, i);
+    struct ir_value *value =
+        emit(builder, IR_PARAM, IR_TYPE_UNKNOWN, NULL);
+    value->name = parameter;
+    if (hash_table_lookup(builder->promoted, parameter)) {
+      lower_declaration(builder, parameter, value, NULL);
+    }
+  }
+  if (body) {
+    lower_block(builder, body);
+  } else {
+    lower_statements(builder, stmts);
+  }
+  if (builder->block) {
+    emit(builder, IR_RETURN, IR_TYPE_UNKNOWN, NULL);
+  }
+  pop_scope(builder);
+  vector_free(builder->scopes);
+  hash_table_free(builder->promoted);
+  remove_trivial_phis(function);
+  number_values(function);
+
+  builder->function = enclosing.function;
+  builder->block = enclosing.block;
+  builder->loop = enclosing.loop;
+  builder->scope_depth = enclosing.scope_depth;
+  builder->scopes = enclosing.scopes;
+  builder->promoted = enclosing.promoted;
+  return function;
+}
+
+struct ir_program *lower_program_to_ir(struct vector *program) {
+  struct ir_program *ir = malloc(sizeof(struct ir_program));
+  ir->functions = vector_init();
+  ir->has_stray_break = false;
+  struct ir_builder builder = {.program = ir,
+                               .function = NULL,
+                               .block = NULL,
+                               .loop = NULL,
+                               .scope_depth = 0,
+                               .owners = hash_table_init(),
+                               .promoted = NULL,
+                               .scopes = NULL,
+                               .saved = hash_table_init()};
+  struct ir_scan scan = {.owner = ir,
+                         .declared_names = NULL,
+                         .redeclared_names = NULL,
+                         .pinned_names = NULL,
+                         .scopes = NULL};
+  scan_statements(&builder, &scan, program);
+  ir->main = lower_function(&builder, ir, NULL, vector_init(), NULL, program);
+  hash_table_free(builder.owners);
+  hash_table_free(builder.saved);
+  return ir;
+}
@@ -0,0 +1,193 @@
+#include "c_emitter.h"
+#include "ir.h"
+#include "string_builder.h"
+#include "tokens.h"
+#include "utils.h"
+#include "vector.h"
+
+static char *value_name(struct ir_value *value) {
+  return format_string("%%%zu", value->id);
+}
+
+static void print_operands(struct string_builder *str, struct vector *operands,
+                           size_t start) {
+  for (size_t i = start; i < operands->size; i++) {
+    string_builder_append(str, value_name(vector_at(operands, i)));
+    if (i + 1 != operands->size) {
+      string_builder_append(str, ", ");
+    }
+  }
+}
+
+static struct ir_value *operand(struct ir_value *value, size_t index) {
+  return vector_at(value->operands, index);
+}
+
+static void print_instruction(struct string_builder *str,
+                              struct ir_value *value) {
+  string_builder_append(str, "  ");
+  if (ir_has_result(value->opcode)) {
+    string_builder_append(str, value_name(value));
+    if (value->type != IR_TYPE_UNKNOWN) {
+      string_builder_append(
+          str, format_string(": %s", get_string_from_ir_type(value->type)));
+    }
+    string_builder_append(str, " = ");
+  }
+  switch (value->opcode) {
+  case IR_CONST_INT:
+    string_builder_append(str, format_string("const %ld", value->number));
+    break;
+  case IR_CONST_BOOL:
+    string_builder_append(str, value->boolean ? "const true" : "const false");
+    break;
+  case IR_CONST_STRING:
+    string_builder_append(
+        str, format_string("const %s", emit_c_string_literal(value->string)));
+    break;
+  case IR_CONST_NIL:
+    string_builder_append(str, "const nil");
+    break;
+  case IR_PARAM:
+    string_builder_append(str, format_string("param %s", value->name));
+    break;
+  case IR_PHI: {
+    string_builder_append(str, format_string("phi %s", value->name));
+    struct vector *predecessors = value->block->predecessors;
+    for (size_t i = 0; i < value->operands->size; i++) {
+      struct ir_block *predecessor = vector_at(predecessors, i);
+      string_builder_append(
+          str, format_string("%s [%s, b%zu]", i ? "," : "",
+                             value_name(operand(value, i)), predecessor->id));
+    }
+    break;
+  }
+  case IR_BINARY:
+    string_builder_append(
+        str, format_string("binary %s %s, %s",
+                           get_string_from_token_atom(value->op),
+                           value_name(operand(value, 0)),
+                           value_name(operand(value, 1))));
+    break;
+  case IR_UNARY:
+    string_builder_append(
+        str,
+        format_string("unary %s %s", get_string_from_token_atom(value->op),
+                      value_name(operand(value, 0))));
+    break;
+  case IR_LOAD:
+    string_builder_append(str, format_string("load %s", value->name));
+    break;
+  case IR_DECLARE:
+  case IR_STORE:
+    string_builder_append(
+        str, format_string("%s %s, %s",
+                           value->opcode == IR_DECLARE ? "declare" : "store",
+                           value->name, value_name(operand(value, 0))));
+    break;
+  case IR_CALL:
+    string_builder_append(
+        str, format_string("call %s(", value_name(operand(value, 0))));
+    print_operands(str, value->operands, 1);
+    string_builder_append(str, ")");
+    break;
+  case IR_CALL_METHOD:
+    string_builder_append(
+        str, format_string("method %s.%s(", value_name(operand(value, 0)),
+                           value->name ? value->name : "<invalid>"));
+    print_operands(str, value->operands, 1);
+    string_builder_append(str, ")");
+    break;
+  case IR_ARRAY:
+    string_builder_append(str, "array [");
+    print_operands(str, value->operands, 0);
+    string_builder_append(str, "]");
+    break;
+  case IR_INDEX:
+    string_builder_append(str,
+                          format_string("index %s[%s]",
+                                        value_name(operand(value, 0)),
+                                        value_name(operand(value, 1))));
+    break;
+  case IR_STORE_INDEX:
+    string_builder_append(
+        str, format_string("store_index %s[%s], %s",
+                           value_name(operand(value, 0)),
+                           value_name(operand(value, 1)),
+                           value_name(operand(value, 2))));
+    break;
+  case IR_FUNCTION:
+    string_builder_append(str,
+                          format_string("function %s", value->function->name));
+    break;
+  case IR_PUSH_SCOPE:
+    string_builder_append(str, "push_scope");
+    break;
+  case IR_POP_SCOPE:
+    string_builder_append(str, "pop_scope");
+    break;
+  case IR_JUMP:
+    string_builder_append(str,
+                          format_string("jump b%zu", value->targets[0]->id));
+    break;
+  case IR_BRANCH:
+    string_builder_append(
+        str, format_string("branch %s, b%zu, b%zu",
+                           value_name(operand(value, 0)),
+                           value->targets[0]->id, value->targets[1]->id));
+    break;
+  case IR_RETURN:
+    string_builder_append(str, "return");
+    if (value->operands->size > 0) {
+      string_builder_append(str, " ");
+      string_builder_append(str, value_name(operand(value, 0)));
+    }
+    break;
+  }
+  string_builder_append(str, "\n");
+}
+
+static void print_block(struct string_builder *str, struct ir_block *block) {
+  string_builder_append(str, format_string("b%zu:", block->id));
+  for (size_t i = 0; i < block->predecessors->size; i++) {
+    struct ir_block *predecessor = vector_at(block->predecessors, i);
+    string_builder_append(str, format_string("%s b%zu", i ? "," : " ; from",
+                                             predecessor->id));
+  }
+  string_builder_append(str, "\n");
+  for (size_t i = 0; i < block->phis->size; i++) {
+    print_instruction(str, vector_at(block->phis, i));
+  }
+  for (size_t i = 0; i < block->instructions->size; i++) {
+    print_instruction(str, vector_at(block->instructions, i));
+  }
+}
+
+/* fn f(a, b) {
+ * b0:
+ *   %0 = param a
+ *   ...
+ * } */
+struct string_builder *print_ir(struct ir_program *program) {
+  struct string_builder *str = string_builder_init();
+  for (size_t i = 0; i < program->functions->size; i++) {
+    struct ir_function *function = vector_at(program->functions, i);
+    string_builder_append(
+        str, format_string("fn %s(", function->name ? function->name : "main"));
+    for (size_t j = 0; j < function->parameters->size; j++) {
+      string_builder_append(str, vector_at(function->parameters, j));
+      if (j + 1 != function->parameters->size) {
+        string_builder_append(str, ", ");
+      }
+    }
+    string_builder_append(str, ") {\n");
+    for (size_t j = 0; j < function->blocks->size; j++) {
+      print_block(str, vector_at(function->blocks, j));
+    }
+    string_builder_append(str, "}\n");
+    if (i + 1 != program->functions->size) {
+      string_builder_append(str, "\n");
+    }
+  }
+  return str;
+}
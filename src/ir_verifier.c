@@ -0,0 +1,319 @@
+#include "errors.h"
+#include "ir.h"
+#include "utils.h"
+#include "vector.h"
+
+/* Returns the first error found by a check */
+#define RETURN_RESULT_IF_ERROR(return_value)                                   \
+  do {                                                                         \
+    if (return_value->type == RESULT_ERROR) {                                  \
+      return return_value;                                                     \
+    }                                                                          \
+  } while (0)
+
+static struct result *ir_error(struct ir_function *function,
+                               struct ir_block *block, char *message) {
+  char *error_message =
+      format_string("Invalid IR in %s, b%zu: %s",
+                    function->name ? function->name : "the program",
+                    block ? block->id : 0, message);
+  return result_error_runtime(runtime_error_init(error_message, 0, 0));
+}
+
+static size_t num_targets(struct ir_value *terminator) {
+  switch (terminator->opcode) {
+  case IR_JUMP:
+    return 1;
+  case IR_BRANCH:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+static struct ir_value *terminator_of(struct ir_block *block) {
+  return vector_at(block->instructions, block->instructions->size - 1);
+}
+
+static size_t count_edges(struct ir_block *from, struct ir_block *to) {
+  struct ir_value *terminator = terminator_of(from);
+  size_t count = 0;
+  for (size_t i = 0; i < num_targets(terminator); i++) {
+    count += terminator->targets[i] == to;
+  }
+  return count;
+}
+
+static size_t count_predecessor(struct ir_block *block,
+                                struct ir_block *predecessor) {
+  size_t count = 0;
+  for (size_t i = 0; i < block->predecessors->size; i++) {
+    count += vector_at(block->predecessors, i) == predecessor;
+  }
+  return count;
+}
+
+/* Number of operands each opcode takes, -1 when it varies */
+static int expected_operands(enum ir_opcode opcode) {
+  switch (opcode) {
+  case IR_CONST_INT:
+  case IR_CONST_BOOL:
+  case IR_CONST_STRING:
+  case IR_CONST_NIL:
+  case IR_PARAM:
+  case IR_LOAD:
+  case IR_FUNCTION:
+  case IR_PUSH_SCOPE:
+  case IR_POP_SCOPE:
+  case IR_JUMP:
+    return 0;
+  case IR_UNARY:
+  case IR_DECLARE:
+  case IR_STORE:
+  case IR_BRANCH:
+    return 1;
+  case IR_BINARY:
+  case IR_INDEX:
+    return 2;
+  case IR_STORE_INDEX:
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+/* Checks the shape of a block: phis, then instructions ending with the only
+ * terminator, and that its edges agree with its predecessors */
+static struct result *verify_block(struct ir_function *function,
+                                   struct ir_block *block) {
+  if (block->function != function || vector_at(function->blocks, block->id) !=
+                                         block) {
+    return ir_error(function, block, strdup("block is not in its function"));
+  }
+  if (block->id != 0 && block->predecessors->size == 0) {
+    return ir_error(function, block, strdup("block is unreachable"));
+  }
+  if (block->id == 0 && block->predecessors->size != 0) {
+    return ir_error(function, block, strdup("entry block has predecessors"));
+  }
+  for (size_t i = 0; i < block->phis->size; i++) {
+    struct ir_value *phi = vector_at(block->phis, i);
+    if (phi->opcode != IR_PHI || phi->block != block) {
+      return ir_error(function, block,
+                      format_string("%%%zu is not a phi of the block",
+                                    phi->id));
+    }
+    if (phi->operands->size != block->predecessors->size) {
+      return ir_error(
+          function, block,
+          format_string("phi %%%zu has %zu operands for %zu predecessors",
+                        phi->id, phi->operands->size,
+                        block->predecessors->size));
+    }
+  }
+  if (block->instructions->size == 0) {
+    return ir_error(function, block, strdup("block has no terminator"));
+  }
+  for (size_t i = 0; i < block->instructions->size; i++) {
+    struct ir_value *value = vector_at(block->instructions, i);
+    bool is_last = i + 1 == block->instructions->size;
+    if (value->block != block || value->opcode == IR_PHI) {
+      return ir_error(function, block,
+                      format_string("%%%zu is misplaced", value->id));
+    }
+    if (ir_is_terminator(value->opcode) != is_last) {
+      return ir_error(
+          function, block,
+          format_string(is_last ? "block ends with %%%zu, not a terminator"
+                                : "terminator %%%zu is not last",
+                        value->id));
+    }
+    int num_operands = expected_operands(value->opcode);
+    if ((num_operands >= 0 && value->operands->size != (size_t)num_operands) ||
+        (value->opcode == IR_CALL && value->operands->size == 0) ||
+        (value->opcode == IR_RETURN && value->operands->size > 1)) {
+      return ir_error(function, block,
+                      format_string("%%%zu has %zu operands", value->id,
+                                    value->operands->size));
+    }
+  }
+  struct ir_value *terminator = terminator_of(block);
+  for (size_t i = 0; i < num_targets(terminator); i++) {
+    struct ir_block *target = terminator->targets[i];
+    if (!target || target->function != function ||
+        count_predecessor(target, block) != count_edges(block, target)) {
+      return ir_error(function, block,
+                      format_string("edge to b%zu is not a predecessor",
+                                    target ? target->id : 0));
+    }
+  }
+  for (size_t i = 0; i < block->predecessors->size; i++) {
+    struct ir_block *predecessor = vector_at(block->predecessors, i);
+    if (predecessor->function != function ||
+        count_edges(predecessor, block) !=
+            count_predecessor(block, predecessor)) {
+      return ir_error(function, block,
+                      format_string("predecessor b%zu has no edge to it",
+                                    predecessor->id));
+    }
+  }
+  return result_ok_node(NULL);
+}
+
+/* `dominators[b * n + d]` is set when block `d` dominates block `b` */
+static bool *compute_dominators(struct ir_function *function) {
+  size_t n = function->blocks->size;
+  bool *dominators = malloc(sizeof(bool) * n * n);
+  for (size_t b = 0; b < n; b++) {
+    for (size_t d = 0; d < n; d++) {
+      dominators[b * n + d] = b != 0 || d == 0;
+    }
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t b = 1; b < n; b++) {
+      struct ir_block *block = vector_at(function->blocks, b);
+      for (size_t d = 0; d < n; d++) {
+        bool dominates = d == b;
+        if (!dominates) {
+          dominates = true;
+          for (size_t p = 0; p < block->predecessors->size; p++) {
+            struct ir_block *predecessor =
+                vector_at(block->predecessors, p);
+            dominates = dominates && dominators[predecessor->id * n + d];
+          }
+        }
+        if (dominators[b * n + d] != dominates) {
+          dominators[b * n + d] = dominates;
+          changed = true;
+        }
+      }
+    }
+  }
+  return dominators;
+}
+
+/* Checks that `operand` is defined before `use`, which is a phi reading it
+ * at the end of `from` when `from` is set */
+static struct result *verify_operand(struct ir_function *function,
+                                     bool *dominators, struct ir_value *use,
+                                     struct ir_value *operand,
+                                     struct ir_block *from) {
+  if (!operand || !operand->block || operand->block->function != function ||
+      !ir_has_result(operand->opcode)) {
+    return ir_error(function, use->block,
+                    format_string("%%%zu uses a value which is not defined "
+                                  "in the function",
+                                  use->id));
+  }
+  size_t n = function->blocks->size;
+  struct ir_block *use_block = from ? from : use->block;
+  bool is_defined =
+      operand->block == use_block
+          ? from || operand->id < use->id
+          : dominators[use_block->id * n + operand->block->id];
+  if (!is_defined) {
+    return ir_error(function, use->block,
+                    format_string("%%%zu does not dominate its use by %%%zu",
+                                  operand->id, use->id));
+  }
+  return result_ok_node(NULL);
+}
+
+static struct result *verify_types(struct ir_function *function,
+                                   struct ir_value *value) {
+  enum ir_type expected;
+  switch (value->opcode) {
+  case IR_CONST_INT:
+    expected = IR_TYPE_INT;
+    break;
+  case IR_CONST_BOOL:
+    expected = IR_TYPE_BOOL;
+    break;
+  case IR_CONST_STRING:
+    expected = IR_TYPE_STRING;
+    break;
+  case IR_CONST_NIL:
+    expected = IR_TYPE_NIL;
+    break;
+  case IR_ARRAY:
+    expected = IR_TYPE_ARRAY;
+    break;
+  case IR_FUNCTION:
+    expected = IR_TYPE_FUNCTION;
+    break;
+  default:
+    return result_ok_node(NULL);
+  }
+  if (value->type != expected) {
+    return ir_error(function, value->block,
+                    format_string("%%%zu has type %s", value->id,
+                                  get_string_from_ir_type(value->type)));
+  }
+  return result_ok_node(NULL);
+}
+
+static struct result *verify_function(struct ir_function *function) {
+  if (function->blocks->size == 0) {
+    return ir_error(function, NULL, strdup("function has no blocks"));
+  }
+  /* Values are numbered in order, which orders them within a block */
+  size_t next_id = 0;
+  for (size_t i = 0; i < function->blocks->size; i++) {
+    struct ir_block *block = vector_at(function->blocks, i);
+    struct result *ret = verify_block(function, block);
+    RETURN_RESULT_IF_ERROR(ret);
+    struct vector *lists[] = {block->phis, block->instructions};
+    for (size_t l = 0; l < 2; l++) {
+      for (size_t j = 0; j < lists[l]->size; j++) {
+        struct ir_value *value = vector_at(lists[l], j);
+        if (value->id != next_id++) {
+          return ir_error(function, block,
+                          format_string("%%%zu is numbered out of order",
+                                        value->id));
+        }
+        ret = verify_types(function, value);
+        RETURN_RESULT_IF_ERROR(ret);
+      }
+    }
+  }
+  if (next_id != function->num_values) {
+    return ir_error(function, NULL,
+                    strdup("number of values does not match the function"));
+  }
+  bool *dominators = compute_dominators(function);
+  struct result *ret = result_ok_node(NULL);
+  for (size_t i = 0; i < function->blocks->size && ret->type == RESULT_OK;
+       i++) {
+    struct ir_block *block = vector_at(function->blocks, i);
+    for (size_t j = 0; j < block->phis->size && ret->type == RESULT_OK; j++) {
+      struct ir_value *phi = vector_at(block->phis, j);
+      for (size_t k = 0; k < phi->operands->size && ret->type == RESULT_OK;
+           k++) {
+        ret = verify_operand(function, dominators, phi,
+                             vector_at(phi->operands, k),
+                             vector_at(block->predecessors, k));
+      }
+    }
+    for (size_t j = 0;
+         j < block->instructions->size && ret->type == RESULT_OK; j++) {
+      struct ir_value *value = vector_at(block->instructions, j);
+      for (size_t k = 0; k < value->operands->size && ret->type == RESULT_OK;
+           k++) {
+        ret = verify_operand(function, dominators, value,
+                             vector_at(value->operands, k), NULL);
+      }
+    }
+  }
+  free(dominators);
+  return ret;
+}
+
+struct result *verify_ir(struct ir_program *program) {
+  for (size_t i = 0; i < program->functions->size; i++) {
+    struct result *ret = verify_function(vector_at(program->functions, i));
+    RETURN_RESULT_IF_ERROR(ret);
+  }
+  return result_ok_node(NULL);
+}
@@ -0,0 +1,394 @@
+#include "licm.h"
+#include "ast.h"
+#include "builtin_functions.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "optimizer.h"
+#include "vector.h"
+#include <string.h>
+
+/* Value of the names in `licm_loop.written_names` */
+static int written;
+
+static void scan_statement(struct licm *licm, struct licm_loop *loop,
+                           struct ast_node *stmt);
+static void hoist_statement(struct licm *licm, struct ast_node *stmt);
+static void hoist_expression(struct licm *licm, struct ast_node *expr);
+
+bool is_builtin_callee(struct hash_table *declared_names,
+                       struct ast_node *callee) {
+  if (callee->node_type != PRIMARY_NODE ||
+      callee->primary_node_type != IDENTIFIER_PRIMARY_NODE ||
+      hash_table_lookup(declared_names, callee->id)) {
+    return false;
+  }
+  for (size_t i = 0; i < NUM_BUILTIN_FNS; i++) {
+    if (strcmp(callee->id, builtin_fn_names[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void scan_expressions(struct licm *licm, struct licm_loop *loop,
+                             struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    scan_statement(licm, loop, val->node);
+  }
+}
+
+static void scan_block(struct licm *licm, struct licm_loop *loop,
+                       struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    scan_statement(licm, loop, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+static void mark_written(struct licm_loop *loop, char *id) {
+  if (!hash_table_lookup(loop->written_names, id)) {
+    hash_table_insert(loop->written_names, id, &written);
+  }
+}
+
+/* Records what the statements and expressions of a loop may change */
+static void scan_statement(struct licm *licm, struct licm_loop *loop,
+                           struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    /* The body only runs when called, which is a side effect itself */
+    mark_written(loop, stmt->fn_def_stmt.id);
+    return;
+  case VARIABLE_DECL_STMT:
+    mark_written(loop, stmt->var_decl_stmt.id);
+    scan_statement(licm, loop, stmt->var_decl_stmt.expr->node);
+    return;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+      mark_written(loop, target->id);
+    } else {
+      loop->stores_elements = true;
+      scan_statement(licm, loop, target);
+    }
+    scan_statement(licm, loop, stmt->var_assign_stmt.expr->node);
+    return;
+  }
+  case IF_STMT:
+    scan_statement(licm, loop, stmt->if_else_stmt.expr->node);
+    scan_block(licm, loop, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      scan_block(licm, loop, stmt->if_else_stmt.else_block->node);
+    }
+    return;
+  case WHILE_STMT:
+    scan_statement(licm, loop, stmt->while_stmt.expr->node);
+    scan_block(licm, loop, stmt->while_stmt.block->node);
+    return;
+  case FOR_STMT:
+    scan_statement(licm, loop, stmt->for_stmt.init_stmt->node);
+    scan_statement(licm, loop, stmt->for_stmt.expr_stmt->node);
+    scan_statement(licm, loop, stmt->for_stmt.update_stmt->node);
+    scan_block(licm, loop, stmt->for_stmt.block->node);
+    return;
+  case RETURN_STMT:
+    scan_statement(licm, loop, stmt->return_stmt_expr->node);
+    return;
+  case BLOCK_STMT:
+    scan_block(licm, loop, stmt);
+    return;
+  case EXPR_STMT:
+    scan_statement(licm, loop, stmt->expr_stmt_expr->node);
+    return;
+  case BINARY_NODE:
+    scan_statement(licm, loop, stmt->binary.left->node);
+    scan_statement(licm, loop, stmt->binary.right->node);
+    return;
+  case UNARY_NODE:
+    scan_statement(licm, loop, stmt->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (stmt->primary_node_type) {
+  case FN_CALL_PRIMARY_NODE:
+    if (!is_builtin_callee(licm->declared_names,
+                           stmt->fn_call.primary->node)) {
+      loop->has_side_effects = true;
+    }
+    scan_statement(licm, loop, stmt->fn_call.primary->node);
+    scan_expressions(licm, loop, stmt->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE: {
+    struct ast_node *member = stmt->method_call.member->node;
+    if (member->primary_node_type != FN_CALL_PRIMARY_NODE ||
+        member->fn_call.primary->node->primary_node_type !=
+            IDENTIFIER_PRIMARY_NODE ||
+        strcmp(member->fn_call.primary->node->id, "len") != 0) {
+      loop->resizes_arrays = true;
+    }
+    scan_statement(licm, loop, stmt->method_call.object->node);
+    if (member->primary_node_type == FN_CALL_PRIMARY_NODE) {
+      scan_expressions(licm, loop, member->fn_call.parameters);
+    }
+    break;
+  }
+  case ARRAY_CREATION_PRIMARY_NODE:
+    scan_expressions(licm, loop, stmt->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    scan_statement(licm, loop, stmt->array_access.primary->node);
+    scan_statement(licm, loop, stmt->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+void scan_loop_statement(struct hash_table *declared_names,
+                         struct licm_loop *loop, struct ast_node *stmt) {
+  struct licm licm = {
+      .declared_names = declared_names, .loops = NULL, .num_invariants = 0};
+  scan_statement(&licm, loop, stmt);
+}
+
+bool is_len_call(struct ast_node *expr) {
+  struct ast_node *member = expr->method_call.member->node;
+  return member->primary_node_type == FN_CALL_PRIMARY_NODE &&
+         member->fn_call.primary->node->primary_node_type ==
+             IDENTIFIER_PRIMARY_NODE &&
+         strcmp(member->fn_call.primary->node->id, "len") == 0 &&
+         member->fn_call.parameters->size == 0;
+}
+
+/* Returns true if every evaluation of `expr` while `loop` runs gives the same
+ * value */
+static bool is_invariant(struct licm_loop *loop, struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    return is_invariant(loop, expr->binary.left->node) &&
+           is_invariant(loop, expr->binary.right->node);
+  case PRIMARY_NODE:
+    break;
+  default:
+    return false;
+  }
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+  case STRING_PRIMARY_NODE:
+  case BOOLEAN_PRIMARY_NODE:
+  case NIL_PRIMARY_NODE:
+    return true;
+  case IDENTIFIER_PRIMARY_NODE:
+    return !hash_table_lookup(loop->written_names, expr->id);
+  case METHOD_CALL_PRIMARY_NODE:
+    return is_len_call(expr) && !loop->resizes_arrays &&
+           is_invariant(loop, expr->method_call.object->node);
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    return !loop->resizes_arrays && !loop->stores_elements &&
+           is_invariant(loop, expr->array_access.primary->node) &&
+           is_invariant(loop, expr->array_access.index->node);
+  default:
+    return false;
+  }
+}
+
+/* Expressions worth caching: not plain names nor literals */
+static bool is_hoistable(struct ast_node *expr) {
+  return expr->node_type == BINARY_NODE ||
+         (expr->node_type == PRIMARY_NODE &&
+          ((expr->primary_node_type == METHOD_CALL_PRIMARY_NODE &&
+            is_len_call(expr)) ||
+           expr->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE));
+}
+
+/* Outermost enclosing loop `expr` can be hoisted from, or NULL */
+static struct licm_loop *hoisting_loop(struct licm *licm,
+                                       struct ast_node *expr) {
+  if (!is_hoistable(expr)) {
+    return NULL;
+  }
+  /* Inner loops change less than the loops around them */
+  for (size_t i = 0; i < licm->loops->size; i++) {
+    struct licm_loop *loop = vector_at(licm->loops, i);
+    if (!loop->has_side_effects && is_invariant(loop, expr)) {
+      return loop;
+    }
+  }
+  return NULL;
+}
+
+static void hoist(struct licm *licm, struct licm_loop *loop,
+                  struct ast_node *expr) {
+  struct ast_node *inner = malloc(sizeof(struct ast_node));
+  *inner = *expr;
+  expr->node_type = PRIMARY_NODE;
+  expr->primary_node_type = INVARIANT_PRIMARY_NODE;
+  expr->profile_site = NULL;
+  expr->invariant.expr = result_ok_node(inner);
+  expr->invariant.value = NULL;
+  expr->invariant.id = licm->num_invariants++;
+  struct vector **invariants = loop->node->node_type == WHILE_STMT
+                                   ? &loop->node->while_stmt.invariants
+                                   : &loop->node->for_stmt.invariants;
+  if (!*invariants) {
+    *invariants = vector_init();
+  }
+  vector_push_back(*invariants, expr);
+}
+
+static void hoist_expressions(struct licm *licm, struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    hoist_expression(licm, val->node);
+  }
+}
+
+static void hoist_expression(struct licm *licm, struct ast_node *expr) {
+  struct licm_loop *loop = hoisting_loop(licm, expr);
+  if (loop) {
+    hoist(licm, loop, expr);
+    return;
+  }
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    hoist_expression(licm, expr->binary.left->node);
+    hoist_expression(licm, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    hoist_expression(licm, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case FN_CALL_PRIMARY_NODE:
+    hoist_expressions(licm, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    hoist_expression(licm, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      hoist_expressions(licm,
+                        expr->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    hoist_expressions(licm, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    hoist_expression(licm, expr->array_access.primary->node);
+    hoist_expression(licm, expr->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void hoist_block(struct licm *licm, struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    hoist_statement(licm, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+static struct licm_loop *push_loop(struct licm *licm, struct ast_node *node) {
+  struct licm_loop *loop = malloc(sizeof(struct licm_loop));
+  loop->node = node;
+  loop->written_names = hash_table_init();
+  loop->has_side_effects = false;
+  loop->resizes_arrays = false;
+  loop->stores_elements = false;
+  vector_push_back(licm->loops, loop);
+  return loop;
+}
+
+static void pop_loop(struct licm *licm) {
+  struct licm_loop *loop = vector_at(licm->loops, licm->loops->size - 1);
+  hash_table_free(loop->written_names);
+  free(loop);
+  licm->loops->size--;
+}
+
+static void hoist_statement(struct licm *licm, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT: {
+    /* Loops around a definition do not run its body */
+    struct vector *loops = licm->loops;
+    licm->loops = vector_init();
+    hoist_block(licm, stmt->fn_def_stmt.block->node);
+    vector_free(licm->loops);
+    licm->loops = loops;
+    break;
+  }
+  case VARIABLE_DECL_STMT:
+    hoist_expression(licm, stmt->var_decl_stmt.expr->node);
+    break;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE) {
+      hoist_expression(licm, target->array_access.index->node);
+    }
+    hoist_expression(licm, stmt->var_assign_stmt.expr->node);
+    break;
+  }
+  case IF_STMT:
+    hoist_expression(licm, stmt->if_else_stmt.expr->node);
+    hoist_block(licm, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      hoist_block(licm, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT: {
+    struct licm_loop *loop = push_loop(licm, stmt);
+    scan_statement(licm, loop, stmt->while_stmt.expr->node);
+    scan_block(licm, loop, stmt->while_stmt.block->node);
+    hoist_expression(licm, stmt->while_stmt.expr->node);
+    hoist_block(licm, stmt->while_stmt.block->node);
+    pop_loop(licm);
+    break;
+  }
+  case FOR_STMT: {
+    /* The initializer runs once, before the loop starts */
+    hoist_statement(licm, stmt->for_stmt.init_stmt->node);
+    struct licm_loop *loop = push_loop(licm, stmt);
+    mark_written(loop, stmt->for_stmt.init_stmt->node->var_decl_stmt.id);
+    scan_statement(licm, loop, stmt->for_stmt.expr_stmt->node);
+    scan_statement(licm, loop, stmt->for_stmt.update_stmt->node);
+    scan_block(licm, loop, stmt->for_stmt.block->node);
+    hoist_statement(licm, stmt->for_stmt.expr_stmt->node);
+    hoist_statement(licm, stmt->for_stmt.update_stmt->node);
+    hoist_block(licm, stmt->for_stmt.block->node);
+    pop_loop(licm);
+    break;
+  }
+  case RETURN_STMT:
+    hoist_expression(licm, stmt->return_stmt_expr->node);
+    break;
+  case BLOCK_STMT:
+    hoist_block(licm, stmt);
+    break;
+  case EXPR_STMT:
+    hoist_expression(licm, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+void hoist_loop_invariants(struct vector *program) {
+  struct name_collector collector = {.names = hash_table_init(),
+                                     .declared_names = hash_table_init(),
+                                     .redeclared_names = hash_table_init(),
+                                     .fn_defs = NULL};
+  collect_names(&collector, program);
+  struct licm licm = {.declared_names = collector.declared_names,
+                      .loops = vector_init(),
+                      .num_invariants = 0};
+  for (size_t i = 0; i < program->size; i++) {
+    hoist_statement(&licm, vector_at(program, i));
+  }
+  vector_free(licm.loops);
+  hash_table_free(collector.names);
+  hash_table_free(collector.declared_names);
+  hash_table_free(collector.redeclared_names);
+}
@@ -1,19 +1,137 @@
 #include "interpreter.h"
+#include "ir.h"
+#include "memo.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "pool.h"
 #include "scanner.h"
 #include "tokens.h"
+#include "trace.h"
 #include "utils.h"
+#include "vm.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+
+static void print_usage() {
+  printf("Usage: ./jix [-O0|-O1] [--emit-c] [--dump-ir] [--profile] "
+         "[--stackless] [--stack-limit=<MiB>] [--no-memoize] [--memo-stats] "
+         "[--trace-stats] [--pool-stats] [--image <image>] "
+         "[--snapshot -o <image>] [script]\n");
+}
+
+/* Reads a positive number of MiB into `limit`, in bytes. Returns false for
+ * anything else, or a size that does not fit. */
+static bool parse_stack_limit(const char *text, size_t *limit) {
+  if (!isdigit((unsigned char)text[0])) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  unsigned long mib = strtoul(text, &end, 10);
+  if (*end != '\0' || errno == ERANGE || mib == 0 ||
+      mib > SIZE_MAX / (1024 * 1024)) {
+    return false;
+  }
+  *limit = mib * 1024 * 1024;
+  return true;
+}
 
 int main(int argc, const char *argv[]) {
-  if (argc < 2) {
-    printf("Usage: ./jix [script]\n");
+  const char *file_name = NULL;
+  bool emit_c = false;
+  bool dump_ir = false;
+  bool memo_stats = false;
+  bool trace_stats = false;
+  bool pool_stats = false;
+  bool snapshot = false;
+  const char *image_name = NULL;
+  struct pipeline_options options = {
+      .use_profile = false,
+      .stackless = false,
+      .stack_limit = VM_DEFAULT_STACK_LIMIT,
+      .optimization_level = OPTIMIZATION_LEVEL_DEFAULT,
+      .no_memoize = false,
+      .image = NULL};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--emit-c") == 0) {
+      /* Print the script as a C program, see "c_emitter.h" */
+      emit_c = true;
+    } else if (strcmp(argv[i], "--dump-ir") == 0) {
+      /* Print the script in SSA form, see "ir.h" */
+      dump_ir = true;
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      /* Load and update `script.jix.prof`, see "profile.h" */
+      options.use_profile = true;
+    } else if (strcmp(argv[i], "--stackless") == 0) {
+      /* Keep Jix calls off the C stack, see "vm.h" */
+      options.stackless = true;
+    } else if (strncmp(argv[i], "--stack-limit=", 14) == 0) {
+      if (!parse_stack_limit(argv[i] + 14, &options.stack_limit)) {
+        print_usage();
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--no-memoize") == 0) {
+      /* Call pure functions every time, see "memo.h" */
+      options.no_memoize = true;
+    } else if (strcmp(argv[i], "--memo-stats") == 0) {
+      memo_stats = true;
+    } else if (strcmp(argv[i], "--trace-stats") == 0) {
+      /* Loops compiled by the trace JIT, see "trace.h" */
+      trace_stats = true;
+    } else if (strcmp(argv[i], "--pool-stats") == 0) {
+      /* Allocations of the runtime's structures, see "pool.h" */
+      pool_stats = true;
+    } else if (strcmp(argv[i], "--snapshot") == 0) {
+      /* Write the environment the script leaves to an image, see "image.h" */
+      snapshot = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      image_name = argv[++i];
+    } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+      /* Start out from the environment of an image */
+      options.image = argv[++i];
+    } else if (strcmp(argv[i], "-O0") == 0 || strcmp(argv[i], "-O1") == 0) {
+      /* AST optimizations, see "optimizer.h" */
+      options.optimization_level = argv[i][2] - '0';
+    } else if (argv[i][0] == '-' || file_name) {
+      print_usage();
+      return -1;
+    } else {
+      file_name = argv[i];
+    }
+  }
+  if (!file_name || snapshot != (image_name != NULL) ||
+      (options.image && emit_c)) {
+    print_usage();
     return -1;
   }
-  const char *file_name = argv[1];
+
+  if (snapshot) {
+    return snapshot_pipeline(file_name, image_name, &options) ? 0 : -1;
+  }
+
+  if (emit_c) {
+    char *c_source = emit_c_pipeline(file_name, &options);
+    if (!c_source) {
+      return -1;
+    }
+    printf("%s", c_source);
+    return 0;
+  }
+
+  if (dump_ir) {
+    struct ir_program *ir = ir_pipeline(file_name, &options);
+    if (!ir) {
+      return -1;
+    }
+    printf("%s", print_ir(ir)->str);
+    return 0;
+  }
 
   /* print_ast_pipeline(file_name);  */
 
-  struct object *interpreter_value = interpreter_pipeline(file_name);
+  struct object *interpreter_value =
+      interpreter_pipeline_with_options(file_name, &options);
 
   if (!interpreter_value) {
     printf("Interpreter doesn't return a value.\n");
@@ -21,6 +139,20 @@ int main(int argc, const char *argv[]) {
     // Interpreter can also return string_value or bool_value
     printf("Return: %li\n", interpreter_value->int_value);
   }
+  if (memo_stats) {
+    struct memo_stats stats = memo_get_stats();
+    printf("Memoized calls: %zu hits, %zu misses\n", stats.hits,
+           stats.misses);
+  }
+  if (trace_stats) {
+    struct trace_stats stats = trace_get_stats();
+    printf("Traces: %zu compiled, %zu blacklisted, %zu counted, %zu products "
+           "reduced\n",
+           stats.compiled, stats.blacklisted, stats.counted, stats.reduced);
+  }
+  if (pool_stats) {
+    pool_print_stats(stdout);
+  }
 
   return 0;
 }
@@ -0,0 +1,313 @@
+#include "memo.h"
+#include "ast.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "licm.h"
+#include "optimizer.h"
+#include "pool.h"
+#include "vector.h"
+#include <string.h>
+
+static struct memo_stats stats;
+static bool is_declared;
+
+static void check_statement(struct purity *purity, struct ast_node *stmt);
+static void check_expression(struct purity *purity, struct ast_node *expr);
+
+static void push_scope(struct purity *purity) {
+  vector_push_back(purity->scopes, hash_table_init());
+}
+
+static void pop_scope(struct purity *purity) {
+  hash_table_free(vector_remove_at(purity->scopes, purity->scopes->size - 1));
+}
+
+static void declare(struct purity *purity, char *id) {
+  struct hash_table *scope =
+      vector_at(purity->scopes, purity->scopes->size - 1);
+  if (!hash_table_lookup(scope, id)) {
+    hash_table_insert(scope, id, &is_declared);
+  }
+}
+
+/* Returns true if `id` resolves to a name of the function being checked */
+static bool is_local(struct purity *purity, char *id) {
+  for (size_t i = 0; i < purity->scopes->size; i++) {
+    if (hash_table_lookup(vector_at(purity->scopes, i), id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void check_expressions(struct purity *purity,
+                              struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    check_expression(purity, val->node);
+  }
+}
+
+static void check_call(struct purity *purity, struct ast_node *expr) {
+  struct ast_node *callee = expr->fn_call.primary->node;
+  struct ast_node *fn_def =
+      callee->node_type == PRIMARY_NODE &&
+              callee->primary_node_type == IDENTIFIER_PRIMARY_NODE &&
+              !is_local(purity, callee->id)
+          ? hash_table_lookup(purity->functions, callee->id)
+          : NULL;
+  if (!fn_def || !fn_def->fn_def_stmt.is_pure) {
+    purity->is_pure = false;
+    return;
+  }
+  check_expressions(purity, expr->fn_call.parameters);
+}
+
+static void check_expression(struct purity *purity, struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    check_expression(purity, expr->binary.left->node);
+    check_expression(purity, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    check_expression(purity, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+  case STRING_PRIMARY_NODE:
+  case BOOLEAN_PRIMARY_NODE:
+  case NIL_PRIMARY_NODE:
+    break;
+  case IDENTIFIER_PRIMARY_NODE:
+    if (!is_local(purity, expr->id) &&
+        !hash_table_lookup(purity->functions, expr->id)) {
+      purity->is_pure = false;
+    }
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    check_call(purity, expr);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    if (!is_len_call(expr)) {
+      purity->is_pure = false;
+      break;
+    }
+    check_expression(purity, expr->method_call.object->node);
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    check_expressions(purity, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    check_expression(purity, expr->array_access.primary->node);
+    check_expression(purity, expr->array_access.index->node);
+    break;
+  case INVARIANT_PRIMARY_NODE:
+    check_expression(purity, expr->invariant.expr->node);
+    break;
+  case SAVED_PRIMARY_NODE:
+    check_expression(purity, expr->saved.expr->node);
+    break;
+  case REUSED_PRIMARY_NODE:
+    check_expression(purity, expr->reused->saved.expr->node);
+    break;
+  default:
+    purity->is_pure = false;
+    break;
+  }
+}
+
+static void check_block(struct purity *purity, struct ast_node *block) {
+  push_scope(purity);
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    check_statement(purity, vector_at(block->block_stmt_stmts, i));
+  }
+  pop_scope(purity);
+}
+
+static void check_loop_body(struct purity *purity, struct ast_node *block) {
+  purity->loop_depth++;
+  check_block(purity, block);
+  purity->loop_depth--;
+}
+
+static void check_statement(struct purity *purity, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case VARIABLE_DECL_STMT:
+    check_expression(purity, stmt->var_decl_stmt.expr->node);
+    declare(purity, stmt->var_decl_stmt.id);
+    break;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type != IDENTIFIER_PRIMARY_NODE ||
+        !is_local(purity, target->id)) {
+      purity->is_pure = false;
+      break;
+    }
+    check_expression(purity, stmt->var_assign_stmt.expr->node);
+    break;
+  }
+  case IF_STMT:
+    check_expression(purity, stmt->if_else_stmt.expr->node);
+    check_block(purity, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      check_block(purity, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    check_expression(purity, stmt->while_stmt.expr->node);
+    check_loop_body(purity, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    push_scope(purity);
+    check_statement(purity, stmt->for_stmt.init_stmt->node);
+    check_statement(purity, stmt->for_stmt.expr_stmt->node);
+    check_loop_body(purity, stmt->for_stmt.block->node);
+    check_statement(purity, stmt->for_stmt.update_stmt->node);
+    pop_scope(purity);
+    break;
+  case BREAK_STMT:
+    if (purity->loop_depth == 0) {
+      purity->is_pure = false;
+    }
+    break;
+  case RETURN_STMT:
+    if (stmt->return_stmt_expr) {
+      check_expression(purity, stmt->return_stmt_expr->node);
+    }
+    break;
+  case BLOCK_STMT:
+    check_block(purity, stmt);
+    break;
+  case EXPR_STMT:
+    check_expression(purity, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    purity->is_pure = false;
+    break;
+  }
+}
+
+static bool check_function(struct purity *purity, struct ast_node *fn_def) {
+  purity->is_pure = true;
+  purity->loop_depth = 0;
+  push_scope(purity);
+  for (size_t i = 0; i < fn_def->fn_def_stmt.parameters->size; i++) {
+    declare(purity, vector_at(fn_def->fn_def_stmt.parameters, i));
+  }
+  check_block(purity, fn_def->fn_def_stmt.block->node);
+  pop_scope(purity);
+  return purity->is_pure;
+}
+
+void mark_pure_functions(struct vector *program) {
+  struct name_collector collector = {.names = hash_table_init(),
+                                     .declared_names = hash_table_init(),
+                                     .redeclared_names = hash_table_init(),
+                                     .fn_defs = NULL};
+  collect_names(&collector, program);
+  struct purity purity = {.assigned_names = collector.names,
+                          .redeclared_names = collector.redeclared_names,
+                          .functions = hash_table_init(),
+                          .scopes = vector_init()};
+  struct vector *fn_defs = vector_init();
+  for (size_t i = 0; i < program->size; i++) {
+    struct ast_node *stmt = vector_at(program, i);
+    if (stmt->node_type != FN_DEF_STMT) {
+      continue;
+    }
+    char *id = stmt->fn_def_stmt.id;
+    if (!hash_table_lookup(purity.assigned_names, id) &&
+        !hash_table_lookup(purity.redeclared_names, id)) {
+      stmt->fn_def_stmt.is_pure = true;
+      hash_table_insert(purity.functions, id, stmt);
+      vector_push_back(fn_defs, stmt);
+    }
+  }
+  /* Drop the functions which are not pure, or call one which is not, until
+   * none is left to drop */
+  for (bool is_changed = true; is_changed;) {
+    is_changed = false;
+    for (size_t i = 0; i < fn_defs->size; i++) {
+      struct ast_node *fn_def = vector_at(fn_defs, i);
+      if (fn_def->fn_def_stmt.is_pure && !check_function(&purity, fn_def)) {
+        fn_def->fn_def_stmt.is_pure = false;
+        is_changed = true;
+      }
+    }
+  }
+  vector_free(fn_defs);
+  vector_free(purity.scopes);
+  hash_table_free(purity.functions);
+  hash_table_free(collector.names);
+  hash_table_free(collector.declared_names);
+  hash_table_free(collector.redeclared_names);
+}
+
+struct memo_cache *memo_cache_init() {
+  return calloc(1, sizeof(struct memo_cache));
+}
+
+void memo_key_init(struct memo_key *key) {
+  key->num_arguments = 0;
+  key->hash = 17;
+}
+
+bool memo_key_add(struct memo_key *key, struct object *argument) {
+  if (key->num_arguments == MEMO_MAX_ARGUMENTS || !argument ||
+      (argument->data_type != INT_VALUE &&
+       argument->data_type != BOOLEAN_VALUE)) {
+    return false;
+  }
+  long value = argument->data_type == INT_VALUE ? argument->int_value
+                                                : argument->bool_value;
+  key->types[key->num_arguments] = argument->data_type;
+  key->values[key->num_arguments++] = value;
+  key->hash = (key->hash * 31 + argument->data_type) * 1000003 ^ value;
+  return true;
+}
+
+static bool memo_key_equal(struct memo_key *lhs, struct memo_key *rhs) {
+  if (lhs->num_arguments != rhs->num_arguments) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs->num_arguments; i++) {
+    if (lhs->types[i] != rhs->types[i] || lhs->values[i] != rhs->values[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static struct memo_entry *memo_slot(struct function *function,
+                                    struct memo_key *key) {
+  return &function->memo->entries[key->hash % MEMO_CACHE_SIZE];
+}
+
+struct object *memo_lookup(struct function *function, struct memo_key *key) {
+  struct memo_entry *entry = memo_slot(function, key);
+  if (!entry->is_used || !memo_key_equal(&entry->key, key)) {
+    stats.misses++;
+    return NULL;
+  }
+  stats.hits++;
+  struct object *result = pool_alloc(POOL_OBJECT);
+  *result = entry->result;
+  return result;
+}
+
+void memo_store(struct function *function, struct memo_key *key,
+                struct object *result) {
+  if (!result ||
+      (result->data_type != INT_VALUE && result->data_type != BOOLEAN_VALUE)) {
+    return;
+  }
+  struct memo_entry *entry = memo_slot(function, key);
+  entry->is_used = true;
+  entry->key = *key;
+  entry->result = *result;
+}
+
+struct memo_stats memo_get_stats() { return stats; }
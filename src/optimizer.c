@@ -0,0 +1,669 @@
+#include "optimizer.h"
+#include "ast.h"
+#include "bce.h"
+#include "cse.h"
+#include "escape.h"
+#include "hash_table.h"
+#include "inliner.h"
+#include "interpreter.h"
+#include "licm.h"
+#include "tokens.h"
+#include "type_inference.h"
+#include "vector.h"
+#include <limits.h>
+#include <string.h>
+
+/* Scope entry of a name which is declared, but not a constant */
+static struct ast_node not_constant;
+
+static void collect_statement(struct name_collector *collector,
+                              struct ast_node *stmt);
+static void collect_expression(struct name_collector *collector,
+                               struct ast_node *expr);
+static bool optimize_statement(struct optimizer *optimizer,
+                               struct ast_node *stmt);
+static void optimize_expression(struct optimizer *optimizer,
+                                struct ast_node *expr);
+
+static void mark_name(struct hash_table *names, char *id) {
+  if (!hash_table_lookup(names, id)) {
+    hash_table_insert(names, id, &not_constant);
+  }
+}
+
+static void mark_declaration(struct name_collector *collector, char *id) {
+  if (hash_table_lookup(collector->declared_names, id)) {
+    mark_name(collector->redeclared_names, id);
+  } else {
+    mark_name(collector->declared_names, id);
+  }
+}
+
+static void collect_expressions(struct name_collector *collector,
+                                struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    collect_expression(collector, val->node);
+  }
+}
+
+static void collect_expression(struct name_collector *collector,
+                               struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    collect_expression(collector, expr->binary.left->node);
+    collect_expression(collector, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    collect_expression(collector, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE:
+    if (collector->fn_defs) {
+      mark_name(collector->names, expr->id);
+    }
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    collect_expression(collector, expr->fn_call.primary->node);
+    collect_expressions(collector, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    collect_expression(collector, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      collect_expression(collector, expr->method_call.member->node);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    collect_expressions(collector, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    collect_expression(collector, expr->array_access.primary->node);
+    collect_expression(collector, expr->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void collect_block(struct name_collector *collector,
+                          struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    collect_statement(collector, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+/* Collects the names which are assigned to, or with `fn_defs` set, every name
+ * which is referenced outside of function bodies */
+static void collect_statement(struct name_collector *collector,
+                              struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    if (collector->fn_defs) {
+      vector_push_back(collector->fn_defs, stmt);
+      break;
+    }
+    mark_declaration(collector, stmt->fn_def_stmt.id);
+    for (size_t i = 0; i < stmt->fn_def_stmt.parameters->size; i++) {
+      mark_declaration(collector,
+                       vector_at(stmt->fn_def_stmt.parameters, i));
+    }
+    collect_block(collector, stmt->fn_def_stmt.block->node);
+    break;
+  case VARIABLE_DECL_STMT:
+    if (!collector->fn_defs) {
+      mark_declaration(collector, stmt->var_decl_stmt.id);
+    }
+    collect_expression(collector, stmt->var_decl_stmt.expr->node);
+    break;
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+      mark_name(collector->names, target->id);
+    } else {
+      collect_expression(collector, target);
+    }
+    collect_expression(collector, stmt->var_assign_stmt.expr->node);
+    break;
+  }
+  case IF_STMT:
+    collect_expression(collector, stmt->if_else_stmt.expr->node);
+    collect_block(collector, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      collect_block(collector, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    collect_expression(collector, stmt->while_stmt.expr->node);
+    collect_block(collector, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    collect_statement(collector, stmt->for_stmt.init_stmt->node);
+    collect_statement(collector, stmt->for_stmt.expr_stmt->node);
+    collect_statement(collector, stmt->for_stmt.update_stmt->node);
+    collect_block(collector, stmt->for_stmt.block->node);
+    break;
+  case RETURN_STMT:
+    collect_expression(collector, stmt->return_stmt_expr->node);
+    break;
+  case BLOCK_STMT:
+    collect_block(collector, stmt);
+    break;
+  case EXPR_STMT:
+    collect_expression(collector, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static bool is_literal(struct ast_node *node) {
+  return node->node_type == PRIMARY_NODE &&
+         (node->primary_node_type == NUMBER_PRIMARY_NODE ||
+          node->primary_node_type == STRING_PRIMARY_NODE ||
+          node->primary_node_type == BOOLEAN_PRIMARY_NODE);
+}
+
+/* Turns `node` into a literal. Returns false for values which have no
+ * literal form. */
+static bool replace_with_object(struct ast_node *node, struct object *obj) {
+  switch (obj->data_type) {
+  case INT_VALUE:
+    node->primary_node_type = NUMBER_PRIMARY_NODE;
+    node->number = obj->int_value;
+    break;
+  case STRING_VALUE:
+    node->primary_node_type = STRING_PRIMARY_NODE;
+    node->string = obj->string_value;
+    break;
+  case BOOLEAN_VALUE:
+    node->primary_node_type = BOOLEAN_PRIMARY_NODE;
+    node->boolean = obj->bool_value;
+    break;
+  default:
+    return false;
+  }
+  node->node_type = PRIMARY_NODE;
+  node->literal = obj;
+  return true;
+}
+
+static void replace_with_literal(struct ast_node *node,
+                                 struct ast_node *literal) {
+  node->node_type = PRIMARY_NODE;
+  node->primary_node_type = literal->primary_node_type;
+  switch (literal->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+    node->number = literal->number;
+    break;
+  case STRING_PRIMARY_NODE:
+    node->string = literal->string;
+    break;
+  default:
+    node->boolean = literal->boolean;
+  }
+  node->literal = literal->literal;
+}
+
+static void fold_binary_expression(struct ast_node *expr) {
+  struct ast_node *lhs = expr->binary.left->node;
+  struct ast_node *rhs = expr->binary.right->node;
+  if (!is_literal(lhs) || !is_literal(rhs)) {
+    return;
+  }
+  enum token_type op = expr->binary.op;
+  if ((op == AND || op == OR) &&
+      (lhs->primary_node_type != BOOLEAN_PRIMARY_NODE ||
+       rhs->primary_node_type != BOOLEAN_PRIMARY_NODE)) {
+    return;
+  }
+  if (op == SLASH && rhs->primary_node_type == NUMBER_PRIMARY_NODE &&
+      (rhs->number == 0 ||
+       (rhs->number == -1 && lhs->primary_node_type == NUMBER_PRIMARY_NODE &&
+        lhs->number == LONG_MIN))) {
+    return;
+  }
+  /* Operations which fail at run time are left for the program to raise */
+  struct interpreter_state state = {.env = NULL};
+  struct error_handler handler;
+  interpreter_push_handler(&state, &handler);
+  if (setjmp(handler.jump) == 0) {
+    struct object *folded =
+        eval_binary_operation(op, lhs->literal, rhs->literal, &state);
+    interpreter_pop_handler(&state);
+    replace_with_object(expr, folded);
+  }
+}
+
+static void fold_unary_expression(struct ast_node *expr) {
+  struct ast_node *operand = expr->unary.primary->node;
+  if (!is_literal(operand)) {
+    return;
+  }
+  if (expr->unary.op == MINUS &&
+      operand->primary_node_type == NUMBER_PRIMARY_NODE &&
+      operand->number != LONG_MIN) {
+    long value = -operand->number;
+    expr->node_type = PRIMARY_NODE;
+    expr->primary_node_type = NUMBER_PRIMARY_NODE;
+    expr->number = value;
+    literal_init_value(expr);
+  } else if (expr->unary.op == BANG &&
+             operand->primary_node_type == BOOLEAN_PRIMARY_NODE) {
+    bool value = !operand->boolean;
+    expr->node_type = PRIMARY_NODE;
+    expr->primary_node_type = BOOLEAN_PRIMARY_NODE;
+    expr->boolean = value;
+    literal_init_value(expr);
+  }
+}
+
+static struct ast_node *lookup_constant(struct optimizer *optimizer,
+                                        char *id) {
+  for (size_t i = optimizer->scopes->size; i > 0; i--) {
+    struct ast_node *literal =
+        hash_table_lookup(vector_at(optimizer->scopes, i - 1), id);
+    if (literal) {
+      return literal == &not_constant ? NULL : literal;
+    }
+  }
+  return NULL;
+}
+
+/* Returns true if `id` is declared in a lexically enclosing scope of the
+ * current function body, or of the program */
+static bool is_declared(struct optimizer *optimizer, char *id) {
+  for (size_t i = optimizer->scopes->size; i > 0; i--) {
+    if (hash_table_lookup(vector_at(optimizer->scopes, i - 1), id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void declare_name(struct optimizer *optimizer, char *id,
+                         struct ast_node *literal) {
+  struct hash_table *scope =
+      vector_at(optimizer->scopes, optimizer->scopes->size - 1);
+  hash_table_insert(scope, id, literal ? literal : &not_constant);
+}
+
+static void push_scope(struct optimizer *optimizer) {
+  vector_push_back(optimizer->scopes, hash_table_init());
+}
+
+static void pop_scope(struct optimizer *optimizer) {
+  hash_table_free(vector_at(optimizer->scopes, optimizer->scopes->size - 1));
+  optimizer->scopes->size--;
+}
+
+static void optimize_expressions(struct optimizer *optimizer,
+                                 struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    optimize_expression(optimizer, val->node);
+  }
+}
+
+static void optimize_expression(struct optimizer *optimizer,
+                                struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    optimize_expression(optimizer, expr->binary.left->node);
+    optimize_expression(optimizer, expr->binary.right->node);
+    fold_binary_expression(expr);
+    return;
+  case UNARY_NODE:
+    optimize_expression(optimizer, expr->unary.primary->node);
+    fold_unary_expression(expr);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case IDENTIFIER_PRIMARY_NODE: {
+    struct ast_node *literal = lookup_constant(optimizer, expr->id);
+    if (literal) {
+      replace_with_literal(expr, literal);
+    }
+    break;
+  }
+  case FN_CALL_PRIMARY_NODE:
+    optimize_expression(optimizer, expr->fn_call.primary->node);
+    optimize_expressions(optimizer, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    optimize_expression(optimizer, expr->method_call.object->node);
+    if (expr->method_call.member->node->primary_node_type ==
+        FN_CALL_PRIMARY_NODE) {
+      optimize_expressions(
+          optimizer, expr->method_call.member->node->fn_call.parameters);
+    }
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    optimize_expressions(optimizer, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    optimize_expression(optimizer, expr->array_access.primary->node);
+    optimize_expression(optimizer, expr->array_access.index->node);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Returns true if nothing after `stmt` runs in the list of statements it is
+ * part of. A 'break' outside of a loop does not stop anything on every
+ * evaluator, so it only counts inside of one. */
+static bool is_terminating(struct optimizer *optimizer, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case RETURN_STMT:
+    return true;
+  case BREAK_STMT:
+    return optimizer->loop_depth > 0;
+  case BLOCK_STMT: {
+    struct vector *stmts = stmt->block_stmt_stmts;
+    return stmts->size > 0 &&
+           is_terminating(optimizer, vector_at(stmts, stmts->size - 1));
+  }
+  case IF_STMT:
+    return stmt->if_else_stmt.else_block &&
+           is_terminating(optimizer, stmt->if_else_stmt.if_block->node) &&
+           is_terminating(optimizer, stmt->if_else_stmt.else_block->node);
+  default:
+    return false;
+  }
+}
+
+/* Returns true if evaluating `expr` can neither fail nor change anything */
+static bool is_pure(struct optimizer *optimizer, struct ast_node *expr) {
+  if (expr->node_type != PRIMARY_NODE) {
+    return false;
+  }
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+  case STRING_PRIMARY_NODE:
+  case BOOLEAN_PRIMARY_NODE:
+  case NIL_PRIMARY_NODE:
+    return true;
+  case IDENTIFIER_PRIMARY_NODE:
+    return is_declared(optimizer, expr->id);
+  case ARRAY_CREATION_PRIMARY_NODE:
+    for (size_t i = 0; i < expr->array->size; i++) {
+      struct result *val = vector_at(expr->array, i);
+      if (!is_pure(optimizer, val->node)) {
+        return false;
+      }
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* Optimizes a list of statements in place, dropping the ones which have no
+ * effect or can not be reached */
+static void optimize_statements(struct optimizer *optimizer,
+                                struct vector *stmts) {
+  size_t kept = 0;
+  for (size_t i = 0; i < stmts->size; i++) {
+    struct ast_node *stmt = vector_at(stmts, i);
+    if (optimize_statement(optimizer, stmt)) {
+      vector_replace_at(stmts, kept++, stmt);
+      if (is_terminating(optimizer, stmt)) {
+        break;
+      }
+    }
+  }
+  stmts->size = kept;
+}
+
+static void optimize_block(struct optimizer *optimizer,
+                           struct ast_node *block) {
+  push_scope(optimizer);
+  optimize_statements(optimizer, block->block_stmt_stmts);
+  pop_scope(optimizer);
+}
+
+/* Replaces `stmt` with a block, keeping the statement's source lines */
+static void replace_with_block(struct ast_node *stmt, struct ast_node *block) {
+  size_t start_line = stmt->source_position.start_line;
+  size_t end_line = stmt->source_position.end_line;
+  *stmt = *block;
+  stmt->source_position.start_line = start_line;
+  stmt->source_position.end_line = end_line;
+}
+
+/* Returns false if the statement can be removed */
+static bool optimize_statement(struct optimizer *optimizer,
+                               struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT: {
+    declare_name(optimizer, stmt->fn_def_stmt.id, NULL);
+    /* Free names in a function body belong to the caller's scope */
+    struct vector *scopes = optimizer->scopes;
+    size_t loop_depth = optimizer->loop_depth;
+    optimizer->scopes = vector_init();
+    optimizer->loop_depth = 0;
+    optimize_block(optimizer, stmt->fn_def_stmt.block->node);
+    vector_free(optimizer->scopes);
+    optimizer->scopes = scopes;
+    optimizer->loop_depth = loop_depth;
+    break;
+  }
+  case VARIABLE_DECL_STMT: {
+    struct ast_node *expr = stmt->var_decl_stmt.expr->node;
+    optimize_expression(optimizer, expr);
+    bool is_constant =
+        is_literal(expr) &&
+        !hash_table_lookup(optimizer->assigned_names, stmt->var_decl_stmt.id);
+    declare_name(optimizer, stmt->var_decl_stmt.id, is_constant ? expr : NULL);
+    break;
+  }
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE) {
+      optimize_expression(optimizer, target);
+    }
+    optimize_expression(optimizer, stmt->var_assign_stmt.expr->node);
+    break;
+  }
+  case IF_STMT: {
+    struct ast_node *expr = stmt->if_else_stmt.expr->node;
+    optimize_expression(optimizer, expr);
+    optimize_block(optimizer, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      optimize_block(optimizer, stmt->if_else_stmt.else_block->node);
+    }
+    if (expr->node_type != PRIMARY_NODE ||
+        expr->primary_node_type != BOOLEAN_PRIMARY_NODE) {
+      break;
+    }
+    if (expr->boolean) {
+      replace_with_block(stmt, stmt->if_else_stmt.if_block->node);
+    } else if (stmt->if_else_stmt.else_block) {
+      replace_with_block(stmt, stmt->if_else_stmt.else_block->node);
+    } else {
+      return false;
+    }
+    break;
+  }
+  case WHILE_STMT:
+    optimize_expression(optimizer, stmt->while_stmt.expr->node);
+    optimizer->loop_depth++;
+    optimize_block(optimizer, stmt->while_stmt.block->node);
+    optimizer->loop_depth--;
+    break;
+  case FOR_STMT:
+    push_scope(optimizer);
+    optimize_statement(optimizer, stmt->for_stmt.init_stmt->node);
+    optimize_statement(optimizer, stmt->for_stmt.expr_stmt->node);
+    optimizer->loop_depth++;
+    optimize_block(optimizer, stmt->for_stmt.block->node);
+    optimizer->loop_depth--;
+    optimize_statement(optimizer, stmt->for_stmt.update_stmt->node);
+    pop_scope(optimizer);
+    break;
+  case RETURN_STMT:
+    optimize_expression(optimizer, stmt->return_stmt_expr->node);
+    break;
+  case BLOCK_STMT:
+    optimize_block(optimizer, stmt);
+    break;
+  case EXPR_STMT:
+    optimize_expression(optimizer, stmt->expr_stmt_expr->node);
+    return !is_pure(optimizer, stmt->expr_stmt_expr->node);
+  default:
+    break;
+  }
+  return true;
+}
+
+static void remove_dead_functions(struct optimizer *optimizer,
+                                  struct vector *stmts);
+
+static void remove_dead_functions_in_block(struct optimizer *optimizer,
+                                           struct result *block) {
+  if (block) {
+    remove_dead_functions(optimizer, block->node->block_stmt_stmts);
+  }
+}
+
+/* Drops the definitions of functions which are never referenced. A name
+ * which is declared more than once is kept, since redeclaring it may be an
+ * error at runtime. */
+static void remove_dead_functions(struct optimizer *optimizer,
+                                  struct vector *stmts) {
+  size_t kept = 0;
+  for (size_t i = 0; i < stmts->size; i++) {
+    struct ast_node *stmt = vector_at(stmts, i);
+    switch (stmt->node_type) {
+    case FN_DEF_STMT:
+      if (!hash_table_lookup(optimizer->live_names, stmt->fn_def_stmt.id) &&
+          !hash_table_lookup(optimizer->redeclared_names,
+                             stmt->fn_def_stmt.id)) {
+        continue;
+      }
+      remove_dead_functions_in_block(optimizer, stmt->fn_def_stmt.block);
+      break;
+    case IF_STMT:
+      remove_dead_functions_in_block(optimizer, stmt->if_else_stmt.if_block);
+      remove_dead_functions_in_block(optimizer,
+                                     stmt->if_else_stmt.else_block);
+      break;
+    case WHILE_STMT:
+      remove_dead_functions_in_block(optimizer, stmt->while_stmt.block);
+      break;
+    case FOR_STMT:
+      remove_dead_functions_in_block(optimizer, stmt->for_stmt.block);
+      break;
+    case BLOCK_STMT:
+      remove_dead_functions(optimizer, stmt->block_stmt_stmts);
+      break;
+    default:
+      break;
+    }
+    vector_replace_at(stmts, kept++, stmt);
+  }
+  stmts->size = kept;
+}
+
+/* Collects the names referenced by the program and, transitively, by the
+ * bodies of the functions those names may refer to */
+static void collect_live_names(struct optimizer *optimizer,
+                               struct vector *program) {
+  struct name_collector collector = {.names = optimizer->live_names,
+                                     .fn_defs = vector_init()};
+  for (size_t i = 0; i < program->size; i++) {
+    collect_statement(&collector, vector_at(program, i));
+  }
+  /* Functions are looked up by name at runtime, so every definition of a
+   * live name is live */
+  bool is_changed = true;
+  struct hash_table *visited = hash_table_init();
+  while (is_changed) {
+    is_changed = false;
+    for (size_t i = 0; i < collector.fn_defs->size; i++) {
+      struct ast_node *fn_def = vector_at(collector.fn_defs, i);
+      char *id = fn_def->fn_def_stmt.id;
+      if (!hash_table_lookup(optimizer->live_names, id) ||
+          hash_table_lookup(visited, id)) {
+        continue;
+      }
+      hash_table_insert(visited, id, fn_def);
+      is_changed = true;
+      /* Visits every definition of the name, including ones found later */
+      for (size_t j = 0; j < collector.fn_defs->size; j++) {
+        struct ast_node *other = vector_at(collector.fn_defs, j);
+        if (strcmp(other->fn_def_stmt.id, id) == 0) {
+          collect_block(&collector, other->fn_def_stmt.block->node);
+        }
+      }
+    }
+  }
+  hash_table_free(visited);
+  vector_free(collector.fn_defs);
+}
+
+void collect_names(struct name_collector *collector, struct vector *program) {
+  for (size_t i = 0; i < program->size; i++) {
+    collect_statement(collector, vector_at(program, i));
+  }
+}
+
+static void optimize(struct vector *program, int optimization_level,
+                     bool is_open) {
+  if (!program || optimization_level < 1) {
+    return;
+  }
+  if (!is_open) {
+    inline_functions(program);
+    replace_scalar_arrays(program);
+  }
+  struct optimizer optimizer = {.assigned_names = hash_table_init(),
+                                .redeclared_names = hash_table_init(),
+                                .live_names = hash_table_init(),
+                                .scopes = vector_init(),
+                                .loop_depth = 0};
+  struct hash_table *declared_names = hash_table_init();
+  struct name_collector collector = {
+      .names = optimizer.assigned_names,
+      .declared_names = declared_names,
+      .redeclared_names = optimizer.redeclared_names,
+      .fn_defs = NULL};
+  collect_names(&collector, program);
+  push_scope(&optimizer);
+  optimize_statements(&optimizer, program);
+  pop_scope(&optimizer);
+  if (is_open) {
+    /* The program's functions are live, and so is what they reference */
+    for (size_t i = 0; i < program->size; i++) {
+      struct ast_node *stmt = vector_at(program, i);
+      if (stmt->node_type == FN_DEF_STMT) {
+        hash_table_insert(optimizer.live_names, stmt->fn_def_stmt.id, stmt);
+      }
+    }
+  }
+  collect_live_names(&optimizer, program);
+  remove_dead_functions(&optimizer, program);
+  eliminate_bounds_checks(program);
+  hoist_loop_invariants(program);
+  eliminate_common_subexpressions(program);
+  infer_program_types(program);
+  vector_free(optimizer.scopes);
+  hash_table_free(declared_names);
+  hash_table_free(optimizer.assigned_names);
+  hash_table_free(optimizer.redeclared_names);
+  hash_table_free(optimizer.live_names);
+}
+
+void optimize_program(struct vector *program, int optimization_level) {
+  optimize(program, optimization_level, false);
+}
+
+void optimize_open_program(struct vector *program, int optimization_level) {
+  optimize(program, optimization_level, true);
+}
@@ -66,7 +66,7 @@ struct result *parse_statement(struct parser_state *parser) {
 
 struct result *
 parse_function_definition_statement(struct parser_state *parser) {
-  struct ast_node *fn_def_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *fn_def_stmt = calloc(1, sizeof(struct ast_node));
   fn_def_stmt->source_position.start_line =
       get_current_token(parser)->token_line;
   increment_token_index(parser);
@@ -117,7 +117,7 @@ parse_function_definition_parameters(struct vector *parameters,
 
 struct result *
 parse_variable_declaration_statement(struct parser_state *parser) {
-  struct ast_node *var_decl_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *var_decl_stmt = calloc(1, sizeof(struct ast_node));
   var_decl_stmt->source_position.start_line =
       get_current_token(parser)->token_line;
   increment_token_index(parser);
@@ -149,7 +149,7 @@ struct result *parse_variable_assignment_statement(struct parser_state *parser,
         parser_error_init(error_message, get_current_token(parser)->token_line);
     return result_error_parser(err);
   }
-  struct ast_node *var_assign_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *var_assign_stmt = calloc(1, sizeof(struct ast_node));
   var_assign_stmt->source_position.start_line = start_line;
   var_assign_stmt->node_type = VARIABLE_ASSIGN_STMT;
   var_assign_stmt->var_assign_stmt.primary = primary;
@@ -163,7 +163,7 @@ struct result *parse_variable_assignment_statement(struct parser_state *parser,
 }
 
 struct result *parse_if_else_statement(struct parser_state *parser) {
-  struct ast_node *if_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *if_stmt = calloc(1, sizeof(struct ast_node));
   if_stmt->source_position.start_line = get_current_token(parser)->token_line;
   increment_token_index(parser);
   if_stmt->node_type = IF_STMT;
@@ -184,7 +184,7 @@ struct result *parse_if_else_statement(struct parser_state *parser) {
 }
 
 struct result *parse_while_statement(struct parser_state *parser) {
-  struct ast_node *while_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *while_stmt = calloc(1, sizeof(struct ast_node));
   while_stmt->source_position.start_line =
       get_current_token(parser)->token_line;
   increment_token_index(parser);
@@ -200,7 +200,7 @@ struct result *parse_while_statement(struct parser_state *parser) {
 }
 
 struct result *parse_for_statement(struct parser_state *parser) {
-  struct ast_node *for_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *for_stmt = calloc(1, sizeof(struct ast_node));
   for_stmt->source_position.start_line = get_current_token(parser)->token_line;
   increment_token_index(parser);
   for_stmt->node_type = FOR_STMT;
@@ -224,7 +224,7 @@ struct result *parse_for_statement(struct parser_state *parser) {
 }
 
 struct result *parse_break_statement(struct parser_state *parser) {
-  struct ast_node *break_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *break_stmt = calloc(1, sizeof(struct ast_node));
   break_stmt->source_position.start_line =
       get_current_token(parser)->token_line;
   increment_token_index(parser);
@@ -235,7 +235,7 @@ struct result *parse_break_statement(struct parser_state *parser) {
 }
 
 struct result *parse_return_statement(struct parser_state *parser) {
-  struct ast_node *return_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *return_stmt = calloc(1, sizeof(struct ast_node));
   return_stmt->source_position.start_line =
       get_current_token(parser)->token_line;
   increment_token_index(parser);
@@ -255,7 +255,7 @@ struct result *parse_expression_statement(struct parser_state *parser) {
   if (get_current_token(parser)->type == EQUAL) {
     return parse_variable_assignment_statement(parser, start_line, primary);
   }
-  struct ast_node *expr_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *expr_stmt = calloc(1, sizeof(struct ast_node));
   expr_stmt->source_position.start_line = start_line;
   expr_stmt->node_type = EXPR_STMT;
   expr_stmt->expr_stmt_expr = primary;
@@ -266,7 +266,7 @@ struct result *parse_expression_statement(struct parser_state *parser) {
 
 struct result *parse_block_statement(struct parser_state *parser) {
   increment_token_index(parser);
-  struct ast_node *block_stmt = malloc(sizeof(struct ast_node));
+  struct ast_node *block_stmt = calloc(1, sizeof(struct ast_node));
   block_stmt->node_type = BLOCK_STMT;
   block_stmt->block_stmt_stmts = vector_init();
   while (check_index_bound(parser) &&
@@ -291,7 +291,7 @@ struct result *logical_or(struct parser_state *parser) {
     increment_token_index(parser);
     struct result *right = logical_and(parser);
     CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(right);
-    struct ast_node *new_left = malloc(sizeof(struct ast_node));
+    struct ast_node *new_left = calloc(1, sizeof(struct ast_node));
     new_left->node_type = BINARY_NODE;
     new_left->binary.left = left;
     new_left->binary.right = right;
@@ -311,7 +311,7 @@ struct result *logical_and(struct parser_state *parser) {
     increment_token_index(parser);
     struct result *right = equality(parser);
     CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(right);
-    struct ast_node *new_left = malloc(sizeof(struct ast_node));
+    struct ast_node *new_left = calloc(1, sizeof(struct ast_node));
     new_left->node_type = BINARY_NODE;
     new_left->binary.left = left;
     new_left->binary.right = right;
@@ -332,7 +332,7 @@ struct result *equality(struct parser_state *parser) {
     increment_token_index(parser);
     struct result *right = comparitive(parser);
     CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(right);
-    struct ast_node *new_left = malloc(sizeof(struct ast_node));
+    struct ast_node *new_left = calloc(1, sizeof(struct ast_node));
     new_left->node_type = BINARY_NODE;
     new_left->binary.left = left;
     new_left->binary.right = right;
@@ -354,7 +354,7 @@ struct result *comparitive(struct parser_state *parser) {
     increment_token_index(parser);
     struct result *right = additive(parser);
     CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(right);
-    struct ast_node *new_left = malloc(sizeof(struct ast_node));
+    struct ast_node *new_left = calloc(1, sizeof(struct ast_node));
     new_left->node_type = BINARY_NODE;
     new_left->binary.left = left;
     new_left->binary.right = right;
@@ -375,7 +375,7 @@ struct result *additive(struct parser_state *parser) {
     increment_token_index(parser);
     struct result *right = multiplicative(parser);
     CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(right);
-    struct ast_node *new_left = malloc(sizeof(struct ast_node));
+    struct ast_node *new_left = calloc(1, sizeof(struct ast_node));
     new_left->node_type = BINARY_NODE;
     new_left->binary.left = left;
     new_left->binary.right = right;
@@ -396,7 +396,7 @@ struct result *multiplicative(struct parser_state *parser) {
     increment_token_index(parser);
     struct result *right = parse_unary(parser);
     CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(right);
-    struct ast_node *new_left = malloc(sizeof(struct ast_node));
+    struct ast_node *new_left = calloc(1, sizeof(struct ast_node));
     new_left->node_type = BINARY_NODE;
     new_left->binary.left = left;
     new_left->binary.right = right;
@@ -412,7 +412,7 @@ struct result *parse_unary(struct parser_state *parser) {
   enum token_type current_token_type = get_current_token(parser)->type;
   if (current_token_type == MINUS || current_token_type == BANG) {
     increment_token_index(parser);
-    struct ast_node *unary = malloc(sizeof(struct ast_node));
+    struct ast_node *unary = calloc(1, sizeof(struct ast_node));
     unary->unary.op = current_token_type;
     unary->node_type = UNARY_NODE;
     unary->unary.op = current_token_type;
@@ -434,7 +434,8 @@ struct result *parse_extended_primary(struct parser_state *parser) {
       struct result *index = parse_expression(parser);
       CHECK_AND_RETURN_IF_ERROR_RESULT_NODE(index);
       CHECK_AND_RETURN_IF_ERROR_EXISTS(consume_token(RIGHT_BRACKET, parser));
-      struct ast_node *array_access_primary = malloc(sizeof(struct ast_node));
+      struct ast_node *array_access_primary =
+          calloc(1, sizeof(struct ast_node));
       array_access_primary->node_type = PRIMARY_NODE;
       array_access_primary->primary_node_type = ARRAY_ACCESS_PRIMARY_NODE;
       array_access_primary->array_access.primary = primary;
@@ -443,7 +444,7 @@ struct result *parse_extended_primary(struct parser_state *parser) {
       primary = new_left_result;
     } else {
       increment_token_index(parser);
-      struct ast_node *fn_call = malloc(sizeof(struct ast_node));
+      struct ast_node *fn_call = calloc(1, sizeof(struct ast_node));
       fn_call->node_type = PRIMARY_NODE;
       fn_call->primary_node_type = FN_CALL_PRIMARY_NODE;
       fn_call->fn_call.primary = primary;
@@ -460,7 +461,7 @@ struct result *parse_extended_primary(struct parser_state *parser) {
   }
   if (check_index_bound(parser) && get_current_token(parser)->type == DOT) {
     increment_token_index(parser);
-    struct ast_node *method_call_primary = malloc(sizeof(struct ast_node));
+    struct ast_node *method_call_primary = calloc(1, sizeof(struct ast_node));
     method_call_primary->node_type = PRIMARY_NODE;
     method_call_primary->primary_node_type = METHOD_CALL_PRIMARY_NODE;
     method_call_primary->method_call.object = primary;
@@ -477,27 +478,29 @@ struct result *parse_primary(struct parser_state *parser) {
   struct token *cur_tok = get_current_token(parser);
   switch (cur_tok->type) {
   case NUMBER: {
-    struct ast_node *num_node = malloc(sizeof(struct ast_node));
+    struct ast_node *num_node = calloc(1, sizeof(struct ast_node));
     num_node->node_type = PRIMARY_NODE;
     num_node->primary_node_type = NUMBER_PRIMARY_NODE;
     char temp_value[100] = {0};
     memcpy(temp_value, cur_tok->token_char, cur_tok->token_char_len);
     char *end_ptr;
     num_node->number = strtol(temp_value, &end_ptr, 10);
+    literal_init_value(num_node);
     increment_token_index(parser);
     return result_ok_node(num_node);
   }
   case STRING: {
-    struct ast_node *string_node = malloc(sizeof(struct ast_node));
+    struct ast_node *string_node = calloc(1, sizeof(struct ast_node));
     string_node->node_type = PRIMARY_NODE;
     string_node->primary_node_type = STRING_PRIMARY_NODE;
-    string_node->string = create_token_string_copy(cur_tok->token_char, 0,
-                                                   cur_tok->token_char_len);
+    string_node->string =
+        string_init(cur_tok->token_char, cur_tok->token_char_len);
+    literal_init_value(string_node);
     increment_token_index(parser);
     return result_ok_node(string_node);
   }
   case IDENTIFIER: {
-    struct ast_node *identifier_node = malloc(sizeof(struct ast_node));
+    struct ast_node *identifier_node = calloc(1, sizeof(struct ast_node));
     identifier_node->node_type = PRIMARY_NODE;
     identifier_node->primary_node_type = IDENTIFIER_PRIMARY_NODE;
     identifier_node->id = create_token_string_copy(cur_tok->token_char, 0,
@@ -507,17 +510,19 @@ struct result *parse_primary(struct parser_state *parser) {
   }
   case TRUE:
   case FALSE: {
-    struct ast_node *bool_node = malloc(sizeof(struct ast_node));
+    struct ast_node *bool_node = calloc(1, sizeof(struct ast_node));
     bool_node->node_type = PRIMARY_NODE;
     bool_node->primary_node_type = BOOLEAN_PRIMARY_NODE;
     bool_node->boolean = cur_tok->type == TRUE ? true : false;
+    literal_init_value(bool_node);
     increment_token_index(parser);
     return result_ok_node(bool_node);
   }
   case NIL: {
-    struct ast_node *nil_node = malloc(sizeof(struct ast_node));
+    struct ast_node *nil_node = calloc(1, sizeof(struct ast_node));
     nil_node->node_type = PRIMARY_NODE;
     nil_node->primary_node_type = NIL_PRIMARY_NODE;
+    literal_init_value(nil_node);
     increment_token_index(parser);
     return result_ok_node(nil_node);
   }
@@ -568,7 +573,7 @@ struct result *parse_array_creation(struct parser_state *parser) {
     }
   }
   increment_token_index(parser);
-  struct ast_node *array_node = malloc(sizeof(struct ast_node));
+  struct ast_node *array_node = calloc(1, sizeof(struct ast_node));
   array_node->node_type = PRIMARY_NODE;
   array_node->primary_node_type = ARRAY_CREATION_PRIMARY_NODE;
   array_node->array = array;
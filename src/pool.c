@@ -0,0 +1,87 @@
+#include "pool.h"
+#include "errors.h"
+#include "hash_table.h"
+#include "interpreter.h"
+#include "vector.h"
+
+#define SIZE_CLASS(size) (((size) + POOL_ALIGNMENT - 1) & ~(POOL_ALIGNMENT - 1))
+#define POOL(type, struct_name)                                                \
+  [type] = {.name = #struct_name,                                              \
+            .object_size = sizeof(struct struct_name),                         \
+            .slot_size = SIZE_CLASS(sizeof(struct struct_name))}
+
+static _Thread_local struct pool pools[NUM_POOLS] = {
+    POOL(POOL_OBJECT, object),
+    POOL(POOL_RESULT, result),
+    POOL(POOL_ENVIRONMENT, environment),
+    POOL(POOL_HASH_TABLE, hash_table),
+    POOL(POOL_VECTOR, vector),
+};
+
+/* Slabs start at an aligned offset, past their header */
+static size_t slab_header_size() {
+  return SIZE_CLASS(sizeof(struct pool_slab));
+}
+
+static void pool_add_slab(struct pool *pool) {
+  struct pool_slab *slab = malloc(POOL_SLAB_SIZE);
+  if (!slab) {
+    perror("Pool slab allocation memory error\n");
+    exit(1);
+  }
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->num_slabs++;
+  pool->bump = (char *)slab + slab_header_size();
+  pool->bump_end =
+      pool->bump +
+      (POOL_SLAB_SIZE - slab_header_size()) / pool->slot_size * pool->slot_size;
+}
+
+void *pool_alloc(enum pool_type type) {
+  struct pool *pool = &pools[type];
+  void *slot = pool->free_list;
+  if (slot) {
+    pool->free_list = pool->free_list->next;
+  } else {
+    if (pool->bump == pool->bump_end) {
+      pool_add_slab(pool);
+    }
+    slot = pool->bump;
+    pool->bump += pool->slot_size;
+  }
+  if (++pool->live > pool->high_water) {
+    pool->high_water = pool->live;
+  }
+  return slot;
+}
+
+void pool_free(enum pool_type type, void *ptr) {
+  struct pool *pool = &pools[type];
+  struct pool_slot *slot = ptr;
+  slot->next = pool->free_list;
+  pool->free_list = slot;
+  pool->live--;
+}
+
+struct pool_stats pool_get_stats(enum pool_type type) {
+  struct pool *pool = &pools[type];
+  size_t reserved_bytes = pool->num_slabs * POOL_SLAB_SIZE;
+  return (struct pool_stats){
+      .name = pool->name,
+      .live = pool->live,
+      .high_water = pool->high_water,
+      .reserved_bytes = reserved_bytes,
+      .wasted_bytes = reserved_bytes - pool->live * pool->object_size};
+}
+
+void pool_print_stats(FILE *out) {
+  for (size_t type = 0; type < NUM_POOLS; type++) {
+    struct pool_stats stats = pool_get_stats(type);
+    fprintf(out,
+            "Pool %-11s %zu live, %zu high water, %zu bytes reserved, %zu "
+            "wasted\n",
+            stats.name, stats.live, stats.high_water, stats.reserved_bytes,
+            stats.wasted_bytes);
+  }
+}
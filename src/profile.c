@@ -0,0 +1,267 @@
+#include "profile.h"
+#include "ast.h"
+#include "interpreter.h"
+#include "trace.h"
+#include "utils.h"
+#include "vector.h"
+#include <stdio.h>
+
+static void attach_statement(struct profile *profile, struct ast_node *stmt);
+static void attach_expression(struct profile *profile, struct ast_node *expr);
+
+static void attach_site(struct profile *profile, struct ast_node *node,
+                        enum profile_site_kind kind) {
+  struct profile_site *site = calloc(1, sizeof(struct profile_site));
+  site->kind = kind;
+  site->node = node;
+  site->trace_status = TRACE_UNRECORDED;
+  node->profile_site = site;
+  vector_push_back(profile->sites, site);
+}
+
+static void attach_expressions(struct profile *profile,
+                               struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    attach_expression(profile, val->node);
+  }
+}
+
+static void attach_expression(struct profile *profile, struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    attach_site(profile, expr, PROFILE_SITE_BINARY_OP);
+    attach_expression(profile, expr->binary.left->node);
+    attach_expression(profile, expr->binary.right->node);
+    return;
+  case UNARY_NODE:
+    attach_expression(profile, expr->unary.primary->node);
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case FN_CALL_PRIMARY_NODE:
+    attach_site(profile, expr, PROFILE_SITE_CALL);
+    attach_expression(profile, expr->fn_call.primary->node);
+    attach_expressions(profile, expr->fn_call.parameters);
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    attach_expression(profile, expr->method_call.object->node);
+    attach_expressions(profile,
+                       expr->method_call.member->node->fn_call.parameters);
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    attach_expressions(profile, expr->array);
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    attach_expression(profile, expr->array_access.primary->node);
+    attach_expression(profile, expr->array_access.index->node);
+    break;
+  case INVARIANT_PRIMARY_NODE:
+    attach_expression(profile, expr->invariant.expr->node);
+    break;
+  case SAVED_PRIMARY_NODE:
+    attach_expression(profile, expr->saved.expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static void attach_block(struct profile *profile, struct ast_node *block) {
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    attach_statement(profile, vector_at(block->block_stmt_stmts, i));
+  }
+}
+
+static void attach_statement(struct profile *profile, struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case FN_DEF_STMT:
+    attach_site(profile, stmt->fn_def_stmt.block->node,
+                PROFILE_SITE_FUNCTION);
+    attach_block(profile, stmt->fn_def_stmt.block->node);
+    break;
+  case VARIABLE_DECL_STMT:
+    attach_expression(profile, stmt->var_decl_stmt.expr->node);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    attach_expression(profile, stmt->var_assign_stmt.primary->node);
+    attach_expression(profile, stmt->var_assign_stmt.expr->node);
+    break;
+  case IF_STMT:
+    attach_site(profile, stmt, PROFILE_SITE_BRANCH);
+    attach_expression(profile, stmt->if_else_stmt.expr->node);
+    attach_block(profile, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      attach_block(profile, stmt->if_else_stmt.else_block->node);
+    }
+    break;
+  case WHILE_STMT:
+    attach_site(profile, stmt, PROFILE_SITE_LOOP);
+    attach_expression(profile, stmt->while_stmt.expr->node);
+    attach_block(profile, stmt->while_stmt.block->node);
+    break;
+  case FOR_STMT:
+    attach_site(profile, stmt, PROFILE_SITE_LOOP);
+    attach_statement(profile, stmt->for_stmt.init_stmt->node);
+    attach_statement(profile, stmt->for_stmt.expr_stmt->node);
+    attach_statement(profile, stmt->for_stmt.update_stmt->node);
+    attach_block(profile, stmt->for_stmt.block->node);
+    break;
+  case RETURN_STMT:
+    attach_expression(profile, stmt->return_stmt_expr->node);
+    break;
+  case BLOCK_STMT:
+    attach_block(profile, stmt);
+    break;
+  case EXPR_STMT:
+    attach_expression(profile, stmt->expr_stmt_expr->node);
+    break;
+  default:
+    break;
+  }
+}
+
+static unsigned long hash_source(const char *source) {
+  /* FNV-1a */
+  unsigned long hash = 14695981039346656037UL;
+  for (size_t i = 0; source[i] != '\0'; i++) {
+    hash ^= (unsigned char)source[i];
+    hash *= 1099511628211UL;
+  }
+  return hash;
+}
+
+static struct trace **get_trace_slot(struct ast_node *loop_node) {
+  return loop_node->node_type == WHILE_STMT ? &loop_node->while_stmt.trace
+                                            : &loop_node->for_stmt.trace;
+}
+
+/* Reads the counters of a previous run. Returns false if the file does not
+ * match the current source, in which case the profile starts out empty. */
+static bool read_profile_file(struct profile *profile) {
+  FILE *file = fopen(profile->file_path, "r");
+  if (!file) {
+    return false;
+  }
+  int version;
+  unsigned long source_hash;
+  size_t num_sites;
+  if (fscanf(file, "jix-profile %d %lx %zu\n", &version, &source_hash,
+             &num_sites) != 3 ||
+      version != PROFILE_FORMAT_VERSION ||
+      source_hash != profile->source_hash ||
+      num_sites != profile->sites->size) {
+    fclose(file);
+    return false;
+  }
+  for (size_t i = 0; i < num_sites; i++) {
+    struct profile_site *site = vector_at(profile->sites, i);
+    int kind;
+    int trace_status;
+    if (fscanf(file, "%d %zu %zu %x %x %d\n", &kind, &site->count,
+               &site->taken, &site->lhs_types, &site->rhs_types,
+               &trace_status) != 6 ||
+        kind != site->kind) {
+      fclose(file);
+      return false;
+    }
+    site->trace_status = trace_status;
+  }
+  fclose(file);
+  return true;
+}
+
+static void reset_sites(struct profile *profile) {
+  for (size_t i = 0; i < profile->sites->size; i++) {
+    struct profile_site *site = vector_at(profile->sites, i);
+    site->count = 0;
+    site->taken = 0;
+    site->lhs_types = 0;
+    site->rhs_types = 0;
+    site->trace_status = TRACE_UNRECORDED;
+  }
+}
+
+static bool is_int_specializable(enum token_type op) {
+  switch (op) {
+  case PLUS:
+  case MINUS:
+  case STAR:
+  case SLASH:
+  case EQUAL_EQUAL:
+  case BANG_EQUAL:
+  case GREATER:
+  case GREATER_EQUAL:
+  case LESS:
+  case LESS_EQUAL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void apply_profile(struct profile *profile) {
+  for (size_t i = 0; i < profile->sites->size; i++) {
+    struct profile_site *site = vector_at(profile->sites, i);
+    switch (site->kind) {
+    case PROFILE_SITE_LOOP:
+      trace_prewarm(get_trace_slot(site->node), site->trace_status);
+      break;
+    case PROFILE_SITE_BINARY_OP:
+      site->is_int_specialized = site->lhs_types == (1u << INT_VALUE) &&
+                                 site->rhs_types == (1u << INT_VALUE) &&
+                                 is_int_specializable(site->node->binary.op);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+struct profile *profile_load(struct vector *program, const char *script_path,
+                             const char *source) {
+  struct profile *profile = malloc(sizeof(struct profile));
+  profile->file_path =
+      format_string("%s%s", script_path, PROFILE_FILE_EXTENSION);
+  profile->source_hash = hash_source(source);
+  profile->sites = vector_init();
+  for (size_t i = 0; i < program->size; i++) {
+    attach_statement(profile, vector_at(program, i));
+  }
+  if (!read_profile_file(profile)) {
+    reset_sites(profile);
+  }
+  apply_profile(profile);
+  return profile;
+}
+
+void profile_save(struct profile *profile) {
+  FILE *file = fopen(profile->file_path, "w");
+  if (!file) {
+    return;
+  }
+  fprintf(file, "jix-profile %d %lx %zu\n", PROFILE_FORMAT_VERSION,
+          profile->source_hash, profile->sites->size);
+  for (size_t i = 0; i < profile->sites->size; i++) {
+    struct profile_site *site = vector_at(profile->sites, i);
+    if (site->kind == PROFILE_SITE_LOOP) {
+      struct trace *trace = *get_trace_slot(site->node);
+      if (trace && trace->status != TRACE_UNRECORDED) {
+        site->trace_status = trace->status;
+      }
+    }
+    fprintf(file, "%d %zu %zu %x %x %d\n", site->kind, site->count,
+            site->taken, site->lhs_types, site->rhs_types,
+            site->trace_status);
+  }
+  fclose(file);
+}
+
+void profile_record_binary_op(struct profile_site *site, struct object *lhs,
+                              struct object *rhs) {
+  site->count++;
+  site->lhs_types |= 1u << lhs->data_type;
+  site->rhs_types |= 1u << rhs->data_type;
+}
@@ -0,0 +1,933 @@
+#include "trace.h"
+#include "ast.h"
+#include "errors.h"
+#include "interpreter.h"
+#include "vector.h"
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+static struct trace_stats stats;
+
+struct trace_scope_entry {
+  char *id;
+  size_t reg;
+  enum object_type type;
+};
+
+struct trace_recorder {
+  struct trace *trace;
+  struct interpreter_state *state;
+  struct vector *scopes; /* Vector of vectors of `trace_scope_entry` */
+  bool has_break;
+};
+
+static bool record_statement(struct trace_recorder *rec, struct ast_node *stmt);
+static bool record_expression(struct trace_recorder *rec, struct ast_node *expr,
+                              size_t *reg, enum object_type *type);
+
+struct trace *trace_init() {
+  struct trace *trace = calloc(1, sizeof(struct trace));
+  trace->status = TRACE_UNRECORDED;
+  trace->ops_capacity = TRACE_INITIAL_CAPACITY;
+  trace->ops = malloc(sizeof(struct trace_op) * trace->ops_capacity);
+  return trace;
+}
+
+void trace_free(struct trace *trace) {
+  free(trace->variables);
+  free(trace->ops);
+  free(trace->registers);
+  free(trace->snapshot);
+  free(trace->prologue);
+  free(trace->unrolled_ops);
+  free(trace);
+}
+
+static void trace_reset(struct trace *trace) {
+  free(trace->variables);
+  free(trace->registers);
+  free(trace->snapshot);
+  free(trace->prologue);
+  free(trace->unrolled_ops);
+  trace->variables = NULL;
+  trace->registers = NULL;
+  trace->snapshot = NULL;
+  trace->prologue = NULL;
+  trace->unrolled_ops = NULL;
+  trace->num_variables = 0;
+  trace->num_registers = 0;
+  trace->num_ops = 0;
+  trace->num_prologue_ops = 0;
+  trace->is_counted = false;
+}
+
+static size_t new_register(struct trace *trace) {
+  trace->registers =
+      realloc(trace->registers, sizeof(long) * (trace->num_registers + 1));
+  trace->registers[trace->num_registers] = 0;
+  return trace->num_registers++;
+}
+
+/* Executes a non control-flow operation. Returns false if a guard failed. */
+static bool trace_apply_op(struct trace_op *op, long *regs) {
+  switch (op->opcode) {
+  case TRACE_LOAD_CONST:
+    regs[op->dst] = op->imm;
+    break;
+  case TRACE_MOVE:
+    regs[op->dst] = regs[op->lhs];
+    break;
+  case TRACE_ADD:
+    regs[op->dst] = regs[op->lhs] + regs[op->rhs];
+    break;
+  case TRACE_SUB:
+    regs[op->dst] = regs[op->lhs] - regs[op->rhs];
+    break;
+  case TRACE_MUL:
+    regs[op->dst] = regs[op->lhs] * regs[op->rhs];
+    break;
+  case TRACE_DIV:
+    regs[op->dst] = regs[op->lhs] / regs[op->rhs];
+    break;
+  case TRACE_LESS:
+    regs[op->dst] = regs[op->lhs] < regs[op->rhs];
+    break;
+  case TRACE_LESS_EQUAL:
+    regs[op->dst] = regs[op->lhs] <= regs[op->rhs];
+    break;
+  case TRACE_GREATER:
+    regs[op->dst] = regs[op->lhs] > regs[op->rhs];
+    break;
+  case TRACE_GREATER_EQUAL:
+    regs[op->dst] = regs[op->lhs] >= regs[op->rhs];
+    break;
+  case TRACE_EQUAL:
+    regs[op->dst] = regs[op->lhs] == regs[op->rhs];
+    break;
+  case TRACE_NOT_EQUAL:
+    regs[op->dst] = regs[op->lhs] != regs[op->rhs];
+    break;
+  case TRACE_AND:
+    regs[op->dst] = regs[op->lhs] && regs[op->rhs];
+    break;
+  case TRACE_OR:
+    regs[op->dst] = regs[op->lhs] || regs[op->rhs];
+    break;
+  case TRACE_NEGATE:
+    regs[op->dst] = -regs[op->lhs];
+    break;
+  case TRACE_NOT:
+    regs[op->dst] = !regs[op->lhs];
+    break;
+  case TRACE_GUARD_TRUE:
+    return regs[op->lhs];
+  case TRACE_GUARD_FALSE:
+    return !regs[op->lhs];
+  case TRACE_GUARD_NONZERO:
+    return regs[op->lhs] != 0;
+  default:
+    break;
+  }
+  return true;
+}
+
+/* Appends an operation to the trace and performs it on the registers, so that
+ * the recorder always sees the values of the iteration being recorded. */
+static void emit(struct trace_recorder *rec, enum trace_opcode opcode,
+                 size_t dst, size_t lhs, size_t rhs, long imm) {
+  struct trace *trace = rec->trace;
+  if (trace->num_ops >= trace->ops_capacity) {
+    trace->ops_capacity *= 2;
+    trace->ops =
+        realloc(trace->ops, sizeof(struct trace_op) * trace->ops_capacity);
+  }
+  struct trace_op *op = &trace->ops[trace->num_ops++];
+  op->opcode = opcode;
+  op->dst = dst;
+  op->lhs = lhs;
+  op->rhs = rhs;
+  op->imm = imm;
+  trace_apply_op(op, trace->registers);
+}
+
+static void emit_prologue(struct trace *trace, enum trace_opcode opcode,
+                          size_t dst, size_t lhs, size_t rhs, long imm) {
+  trace->prologue =
+      realloc(trace->prologue,
+              sizeof(struct trace_op) * (trace->num_prologue_ops + 1));
+  trace->prologue[trace->num_prologue_ops++] = (struct trace_op){
+      .opcode = opcode, .dst = dst, .lhs = lhs, .rhs = rhs, .imm = imm};
+}
+
+static void push_scope(struct trace_recorder *rec) {
+  vector_push_back(rec->scopes, vector_init());
+}
+
+static void pop_scope(struct trace_recorder *rec) {
+  struct vector *scope = vector_remove_at(rec->scopes, rec->scopes->size - 1);
+  for (size_t i = 0; i < scope->size; i++) {
+    free(vector_at(scope, i));
+  }
+  vector_free(scope);
+}
+
+static struct trace_scope_entry *lookup_scope(struct vector *scope, char *id) {
+  for (size_t i = 0; i < scope->size; i++) {
+    struct trace_scope_entry *entry = vector_at(scope, i);
+    if (strcmp(entry->id, id) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* Resolves `id` the same way the environment chain would: variables declared
+ * inside the recorded iteration first, then variables from outside of the
+ * loop. Only integers and booleans can be kept in registers. Sets `variable`
+ * to the index of the outside variable, or -1 for a variable declared inside
+ * the iteration. */
+static bool resolve_identifier(struct trace_recorder *rec, char *id,
+                               size_t *reg, enum object_type *type,
+                               long *variable) {
+  for (size_t i = rec->scopes->size; i > 0; i--) {
+    struct trace_scope_entry *entry =
+        lookup_scope(vector_at(rec->scopes, i - 1), id);
+    if (entry) {
+      *reg = entry->reg;
+      *type = entry->type;
+      *variable = -1;
+      return true;
+    }
+  }
+  struct trace *trace = rec->trace;
+  for (size_t i = 0; i < trace->num_variables; i++) {
+    if (strcmp(trace->variables[i].id, id) == 0) {
+      *reg = trace->variables[i].reg;
+      *type = trace->variables[i].type;
+      *variable = i;
+      return true;
+    }
+  }
+  struct object *value = environment_lookup_symbol(rec->state->env, id);
+  if (!value ||
+      (value->data_type != INT_VALUE && value->data_type != BOOLEAN_VALUE)) {
+    return false;
+  }
+  trace->variables =
+      realloc(trace->variables,
+              sizeof(struct trace_variable) * (trace->num_variables + 1));
+  struct trace_variable *new_variable = &trace->variables[trace->num_variables];
+  new_variable->id = id;
+  new_variable->reg = new_register(trace);
+  new_variable->type = value->data_type;
+  new_variable->is_written = false;
+  trace->registers[new_variable->reg] = value->data_type == INT_VALUE
+                                            ? value->int_value
+                                            : value->bool_value;
+  *reg = new_variable->reg;
+  *type = new_variable->type;
+  *variable = trace->num_variables++;
+  return true;
+}
+
+static bool record_binary_expression(struct trace_recorder *rec,
+                                     struct ast_node *expr, size_t *reg,
+                                     enum object_type *type) {
+  size_t lhs, rhs;
+  enum object_type lhs_type, rhs_type;
+  if (!record_expression(rec, expr->binary.left->node, &lhs, &lhs_type) ||
+      !record_expression(rec, expr->binary.right->node, &rhs, &rhs_type)) {
+    return false;
+  }
+  enum trace_opcode opcode;
+  switch (expr->binary.op) {
+  case OR:
+  case AND: {
+    if (lhs_type != BOOLEAN_VALUE || rhs_type != BOOLEAN_VALUE) {
+      return false;
+    }
+    opcode = expr->binary.op == AND ? TRACE_AND : TRACE_OR;
+    *type = BOOLEAN_VALUE;
+    break;
+  }
+  case EQUAL_EQUAL:
+  case BANG_EQUAL: {
+    if (lhs_type != rhs_type) {
+      return false;
+    }
+    opcode = expr->binary.op == EQUAL_EQUAL ? TRACE_EQUAL : TRACE_NOT_EQUAL;
+    *type = BOOLEAN_VALUE;
+    break;
+  }
+  case GREATER:
+  case GREATER_EQUAL:
+  case LESS:
+  case LESS_EQUAL: {
+    if (lhs_type != INT_VALUE || rhs_type != INT_VALUE) {
+      return false;
+    }
+    opcode = expr->binary.op == GREATER         ? TRACE_GREATER
+             : expr->binary.op == GREATER_EQUAL ? TRACE_GREATER_EQUAL
+             : expr->binary.op == LESS          ? TRACE_LESS
+                                                : TRACE_LESS_EQUAL;
+    *type = BOOLEAN_VALUE;
+    break;
+  }
+  case PLUS:
+  case MINUS:
+  case STAR:
+  case SLASH: {
+    if (lhs_type != INT_VALUE || rhs_type != INT_VALUE) {
+      return false;
+    }
+    if (expr->binary.op == SLASH) {
+      /* Division by zero is left to the interpreter */
+      if (rec->trace->registers[rhs] == 0) {
+        return false;
+      }
+      emit(rec, TRACE_GUARD_NONZERO, 0, rhs, 0, 0);
+    }
+    opcode = expr->binary.op == PLUS    ? TRACE_ADD
+             : expr->binary.op == MINUS ? TRACE_SUB
+             : expr->binary.op == STAR  ? TRACE_MUL
+                                        : TRACE_DIV;
+    *type = INT_VALUE;
+    break;
+  }
+  default:
+    return false;
+  }
+  *reg = new_register(rec->trace);
+  emit(rec, opcode, *reg, lhs, rhs, 0);
+  return true;
+}
+
+static bool record_expression(struct trace_recorder *rec, struct ast_node *expr,
+                              size_t *reg, enum object_type *type) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    return record_binary_expression(rec, expr, reg, type);
+  case UNARY_NODE: {
+    struct ast_node *primary = expr->unary.primary->node;
+    size_t operand;
+    enum object_type operand_type;
+    if (!record_expression(rec, primary, &operand, &operand_type)) {
+      return false;
+    }
+    enum object_type expected_type =
+        expr->unary.op == MINUS ? INT_VALUE : BOOLEAN_VALUE;
+    if (operand_type != expected_type) {
+      return false;
+    }
+    *reg = new_register(rec->trace);
+    *type = operand_type;
+    emit(rec, expr->unary.op == MINUS ? TRACE_NEGATE : TRACE_NOT, *reg, operand,
+         0, 0);
+    return true;
+  }
+  case PRIMARY_NODE: {
+    switch (expr->primary_node_type) {
+    case NUMBER_PRIMARY_NODE:
+    case BOOLEAN_PRIMARY_NODE: {
+      bool is_number = expr->primary_node_type == NUMBER_PRIMARY_NODE;
+      *reg = new_register(rec->trace);
+      *type = is_number ? INT_VALUE : BOOLEAN_VALUE;
+      emit(rec, TRACE_LOAD_CONST, *reg, 0, 0,
+           is_number ? expr->number : expr->boolean);
+      return true;
+    }
+    case IDENTIFIER_PRIMARY_NODE: {
+      long variable;
+      return resolve_identifier(rec, expr->id, reg, type, &variable);
+    }
+    case INVARIANT_PRIMARY_NODE:
+      /* Cheap enough to recompute in the trace, which leaves the cached
+       * value alone */
+      return record_expression(rec, expr->invariant.expr->node, reg, type);
+    case SAVED_PRIMARY_NODE:
+      return record_expression(rec, expr->saved.expr->node, reg, type);
+    case REUSED_PRIMARY_NODE:
+      /* Nothing it depends on changes between the two occurrences */
+      return record_expression(rec, expr->reused->saved.expr->node, reg,
+                               type);
+    default:
+      return false;
+    }
+  }
+  default:
+    return false;
+  }
+}
+
+static bool record_block_statement(struct trace_recorder *rec,
+                                   struct ast_node *stmt) {
+  push_scope(rec);
+  for (size_t i = 0; i < stmt->block_stmt_stmts->size && !rec->has_break;
+       i++) {
+    if (!record_statement(rec, vector_at(stmt->block_stmt_stmts, i))) {
+      pop_scope(rec);
+      return false;
+    }
+  }
+  pop_scope(rec);
+  return true;
+}
+
+static bool record_statement(struct trace_recorder *rec,
+                             struct ast_node *stmt) {
+  switch (stmt->node_type) {
+  case VARIABLE_DECL_STMT: {
+    struct vector *scope = vector_at(rec->scopes, rec->scopes->size - 1);
+    if (lookup_scope(scope, stmt->var_decl_stmt.id)) {
+      return false;
+    }
+    size_t value;
+    enum object_type type;
+    if (!record_expression(rec, stmt->var_decl_stmt.expr->node, &value,
+                           &type)) {
+      return false;
+    }
+    struct trace_scope_entry *entry = malloc(sizeof(struct trace_scope_entry));
+    entry->id = stmt->var_decl_stmt.id;
+    entry->reg = new_register(rec->trace);
+    entry->type = type;
+    emit(rec, TRACE_MOVE, entry->reg, value, 0, 0);
+    vector_push_back(scope, entry);
+    return true;
+  }
+  case VARIABLE_ASSIGN_STMT: {
+    struct ast_node *target = stmt->var_assign_stmt.primary->node;
+    if (target->primary_node_type != IDENTIFIER_PRIMARY_NODE) {
+      return false;
+    }
+    size_t target_reg, value;
+    enum object_type target_type, value_type;
+    long variable;
+    if (!resolve_identifier(rec, target->id, &target_reg, &target_type,
+                            &variable) ||
+        !record_expression(rec, stmt->var_assign_stmt.expr->node, &value,
+                           &value_type)) {
+      return false;
+    }
+    /* Registers keep the type they were guarded with on trace entry */
+    if (target_type != value_type) {
+      return false;
+    }
+    if (variable >= 0) {
+      rec->trace->variables[variable].is_written = true;
+    }
+    emit(rec, TRACE_MOVE, target_reg, value, 0, 0);
+    return true;
+  }
+  case IF_STMT: {
+    size_t cond;
+    enum object_type cond_type;
+    if (!record_expression(rec, stmt->if_else_stmt.expr->node, &cond,
+                           &cond_type) ||
+        cond_type != BOOLEAN_VALUE) {
+      return false;
+    }
+    if (rec->trace->registers[cond]) {
+      emit(rec, TRACE_GUARD_TRUE, 0, cond, 0, 0);
+      return record_block_statement(rec, stmt->if_else_stmt.if_block->node);
+    }
+    emit(rec, TRACE_GUARD_FALSE, 0, cond, 0, 0);
+    if (stmt->if_else_stmt.else_block) {
+      return record_block_statement(rec, stmt->if_else_stmt.else_block->node);
+    }
+    return true;
+  }
+  case BLOCK_STMT:
+    return record_block_statement(rec, stmt);
+  case BREAK_STMT:
+    rec->has_break = true;
+    return true;
+  case EXPR_STMT: {
+    size_t value;
+    enum object_type type;
+    return record_expression(rec, stmt->expr_stmt_expr->node, &value, &type);
+  }
+  default:
+    /* Function definitions, returns and nested loops are not traced */
+    return false;
+  }
+}
+
+static bool trace_record(struct trace *trace, struct ast_node *loop_node,
+                         struct interpreter_state *state) {
+  struct trace_recorder rec = {
+      .trace = trace, .state = state, .scopes = vector_init()};
+  bool is_for = loop_node->node_type == FOR_STMT;
+  struct ast_node *block = is_for ? loop_node->for_stmt.block->node
+                                  : loop_node->while_stmt.block->node;
+  struct ast_node *cond_expr =
+      is_for ? loop_node->for_stmt.expr_stmt->node->expr_stmt_expr->node
+             : loop_node->while_stmt.expr->node;
+  bool recorded = record_block_statement(&rec, block);
+  if (recorded && !rec.has_break) {
+    /* The update statement of a 'for' loop runs in the loop's own scope */
+    push_scope(&rec);
+    if (is_for) {
+      recorded = record_statement(&rec, loop_node->for_stmt.update_stmt->node);
+    }
+    size_t cond;
+    enum object_type cond_type;
+    recorded = recorded &&
+               record_expression(&rec, cond_expr, &cond, &cond_type) &&
+               cond_type == BOOLEAN_VALUE;
+    if (recorded) {
+      emit(&rec, TRACE_LOOP, 0, cond, 0, 0);
+    }
+    pop_scope(&rec);
+  } else if (recorded) {
+    emit(&rec, TRACE_BREAK, 0, 0, 0, 0);
+  }
+  vector_free(rec.scopes);
+  if (!recorded) {
+    return false;
+  }
+  trace->snapshot = malloc(sizeof(long) * (trace->num_variables + 1));
+  return true;
+}
+
+static bool writes_register(enum trace_opcode opcode) {
+  return opcode < TRACE_GUARD_TRUE;
+}
+
+static bool reads_rhs(enum trace_opcode opcode) {
+  return opcode >= TRACE_ADD && opcode <= TRACE_OR;
+}
+
+static bool reads_lhs(enum trace_opcode opcode) {
+  return opcode != TRACE_LOAD_CONST && opcode != TRACE_BREAK;
+}
+
+static bool reads_register(struct trace_op *op, size_t reg) {
+  return (reads_lhs(op->opcode) && op->lhs == reg) ||
+         (reads_rhs(op->opcode) && op->rhs == reg);
+}
+
+/* Returns the number of operations writing `reg`, and the index of the last
+ * one in `pc` */
+static size_t count_writes(struct trace *trace, size_t reg, size_t *pc) {
+  size_t count = 0;
+  for (size_t i = 0; i < trace->num_ops; i++) {
+    if (writes_register(trace->ops[i].opcode) && trace->ops[i].dst == reg) {
+      *pc = i;
+      count++;
+    }
+  }
+  return count;
+}
+
+static bool is_constant(struct trace *trace, size_t reg, long *imm) {
+  size_t pc;
+  if (count_writes(trace, reg, &pc) != 1 ||
+      trace->ops[pc].opcode != TRACE_LOAD_CONST) {
+    return false;
+  }
+  *imm = trace->ops[pc].imm;
+  return true;
+}
+
+/* Returns true if `reg` holds the same value through every iteration: a
+ * constant, which the prologue then loads too, or a variable the trace never
+ * writes */
+static bool is_loop_invariant(struct trace *trace, size_t reg) {
+  size_t pc;
+  long imm;
+  if (is_constant(trace, reg, &imm)) {
+    emit_prologue(trace, TRACE_LOAD_CONST, reg, 0, 0, imm);
+    return true;
+  }
+  return count_writes(trace, reg, &pc) == 0;
+}
+
+/* Returns true if the variable register `reg` is an induction variable, see
+ * "trace.h", setting `update` to the index of its update */
+static bool match_induction(struct trace *trace, size_t reg, size_t *update,
+                            long *step) {
+  size_t def;
+  if (count_writes(trace, reg, update) != 1 ||
+      trace->ops[*update].opcode != TRACE_MOVE ||
+      count_writes(trace, trace->ops[*update].lhs, &def) != 1) {
+    return false;
+  }
+  struct trace_op *op = &trace->ops[def];
+  if (op->opcode == TRACE_ADD && op->lhs == reg) {
+    return is_constant(trace, op->rhs, step);
+  }
+  if (op->opcode == TRACE_ADD && op->rhs == reg) {
+    return is_constant(trace, op->lhs, step);
+  }
+  if (op->opcode == TRACE_SUB && op->lhs == reg &&
+      is_constant(trace, op->rhs, step) && *step != LONG_MIN) {
+    *step = -*step;
+    return true;
+  }
+  return false;
+}
+
+/* Returns the index of the variable register `reg`, or -1 */
+static long find_variable(struct trace *trace, size_t reg) {
+  for (size_t i = 0; i < trace->num_variables; i++) {
+    if (trace->variables[i].reg == reg &&
+        trace->variables[i].type == INT_VALUE) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+struct trace_reduction {
+  size_t mul;     /* Index of `t = i * s` */
+  size_t update;  /* Index of `i = i + c` */
+  size_t derived; /* `i * s` */
+  size_t step;    /* `c * s` */
+  bool is_renamed; /* Readers of `t` read `derived` instead */
+};
+
+/* Returns true if every reader of `t` can read `derived` instead, which is
+ * the case unless `i` is updated in between */
+static bool can_rename(struct trace *trace, struct trace_reduction *r) {
+  size_t product = trace->ops[r->mul].dst;
+  for (size_t pc = r->mul + 1; pc < trace->num_ops; pc++) {
+    if (reads_register(&trace->ops[pc], product) && r->mul < r->update &&
+        r->update < pc) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool match_reduction(struct trace *trace, size_t mul,
+                            struct trace_reduction *r) {
+  struct trace_op *op = &trace->ops[mul];
+  size_t operands[2] = {op->lhs, op->rhs};
+  for (size_t i = 0; i < 2; i++) {
+    size_t induction = operands[i], invariant = operands[1 - i];
+    long step;
+    if (find_variable(trace, induction) < 0 || invariant == induction ||
+        !match_induction(trace, induction, &r->update, &step) ||
+        !is_loop_invariant(trace, invariant)) {
+      continue;
+    }
+    r->mul = mul;
+    r->derived = new_register(trace);
+    r->step = new_register(trace);
+    emit_prologue(trace, TRACE_MUL, r->derived, induction, invariant, 0);
+    emit_prologue(trace, TRACE_LOAD_CONST, r->step, 0, 0, step);
+    emit_prologue(trace, TRACE_MUL, r->step, r->step, invariant, 0);
+    r->is_renamed = can_rename(trace, r);
+    return true;
+  }
+  return false;
+}
+
+static void reduce_strength(struct trace *trace) {
+  struct vector *reductions = vector_init();
+  for (size_t pc = 0; pc < trace->num_ops; pc++) {
+    struct trace_reduction r;
+    if (trace->ops[pc].opcode == TRACE_MUL && match_reduction(trace, pc, &r)) {
+      struct trace_reduction *reduction =
+          malloc(sizeof(struct trace_reduction));
+      *reduction = r;
+      vector_push_back(reductions, reduction);
+    }
+  }
+  if (reductions->size == 0) {
+    vector_free(reductions);
+    return;
+  }
+  stats.reduced += reductions->size;
+  size_t capacity = trace->num_ops + reductions->size;
+  struct trace_op *ops = malloc(sizeof(struct trace_op) * capacity);
+  size_t num_ops = 0;
+  for (size_t pc = 0; pc < trace->num_ops; pc++) {
+    struct trace_op op = trace->ops[pc];
+    bool is_removed = false;
+    for (size_t i = 0; i < reductions->size; i++) {
+      struct trace_reduction *r = vector_at(reductions, i);
+      size_t product = trace->ops[r->mul].dst;
+      if (pc == r->mul) {
+        op = (struct trace_op){
+            .opcode = TRACE_MOVE, .dst = product, .lhs = r->derived};
+        is_removed = r->is_renamed;
+      } else if (r->is_renamed && reads_register(&op, product)) {
+        if (reads_lhs(op.opcode) && op.lhs == product) {
+          op.lhs = r->derived;
+        }
+        if (reads_rhs(op.opcode) && op.rhs == product) {
+          op.rhs = r->derived;
+        }
+      }
+    }
+    if (!is_removed) {
+      ops[num_ops++] = op;
+    }
+    for (size_t i = 0; i < reductions->size; i++) {
+      struct trace_reduction *r = vector_at(reductions, i);
+      if (pc == r->update) {
+        ops[num_ops++] = (struct trace_op){.opcode = TRACE_ADD,
+                                           .dst = r->derived,
+                                           .lhs = r->derived,
+                                           .rhs = r->step};
+      }
+    }
+  }
+  for (size_t i = 0; i < reductions->size; i++) {
+    free(vector_at(reductions, i));
+  }
+  vector_free(reductions);
+  free(trace->ops);
+  trace->ops = ops;
+  trace->num_ops = num_ops;
+  trace->ops_capacity = capacity;
+}
+
+static enum trace_opcode mirror_compare(enum trace_opcode opcode) {
+  switch (opcode) {
+  case TRACE_LESS:
+    return TRACE_GREATER;
+  case TRACE_LESS_EQUAL:
+    return TRACE_GREATER_EQUAL;
+  case TRACE_GREATER:
+    return TRACE_LESS;
+  default:
+    return TRACE_LESS_EQUAL;
+  }
+}
+
+static void match_counted_loop(struct trace *trace) {
+  struct trace_op *loop = &trace->ops[trace->num_ops - 1];
+  if (loop->opcode != TRACE_LOOP) {
+    return;
+  }
+  for (size_t pc = 0; pc + 1 < trace->num_ops; pc++) {
+    if (!writes_register(trace->ops[pc].opcode)) {
+      return;
+    }
+  }
+  size_t compare, update;
+  if (count_writes(trace, loop->lhs, &compare) != 1) {
+    return;
+  }
+  struct trace_op *op = &trace->ops[compare];
+  if (op->opcode < TRACE_LESS || op->opcode > TRACE_GREATER_EQUAL) {
+    return;
+  }
+  enum trace_opcode opcode = op->opcode;
+  size_t counter = op->lhs, bound = op->rhs;
+  if (find_variable(trace, counter) < 0) {
+    opcode = mirror_compare(opcode);
+    counter = op->rhs;
+    bound = op->lhs;
+  }
+  long step;
+  if (find_variable(trace, counter) < 0 || bound == counter ||
+      !match_induction(trace, counter, &update, &step) || update > compare ||
+      !is_loop_invariant(trace, bound)) {
+    return;
+  }
+  bool is_upwards = opcode == TRACE_LESS || opcode == TRACE_LESS_EQUAL;
+  if ((is_upwards && step <= 0) || (!is_upwards && step >= 0)) {
+    return;
+  }
+  trace->is_counted = true;
+  stats.counted++;
+  trace->counter_compare = opcode;
+  trace->counter_reg = counter;
+  trace->bound_reg = bound;
+  trace->counter_step = step;
+  /* The body leaves out the condition, unless something else reads it */
+  trace->num_body_ops = 0;
+  trace->unrolled_ops =
+      malloc(sizeof(struct trace_op) * trace->num_ops * TRACE_UNROLL_FACTOR);
+  bool is_read = false;
+  for (size_t pc = 0; pc + 1 < trace->num_ops; pc++) {
+    is_read = is_read || reads_register(&trace->ops[pc], loop->lhs);
+  }
+  for (size_t pc = 0; pc + 1 < trace->num_ops; pc++) {
+    if (pc != compare || is_read) {
+      trace->unrolled_ops[trace->num_body_ops++] = trace->ops[pc];
+    }
+  }
+  for (size_t i = 1; i < TRACE_UNROLL_FACTOR; i++) {
+    memcpy(&trace->unrolled_ops[i * trace->num_body_ops], trace->unrolled_ops,
+           sizeof(struct trace_op) * trace->num_body_ops);
+  }
+}
+
+void trace_optimize(struct trace *trace) {
+  reduce_strength(trace);
+  match_counted_loop(trace);
+}
+
+/* Returns the number of iterations a counted trace runs before its
+ * condition fails, or 0 if it does not fit in the registers */
+static size_t count_iterations(struct trace *trace) {
+  __int128 start = trace->registers[trace->counter_reg];
+  __int128 bound = trace->registers[trace->bound_reg];
+  __int128 step = trace->counter_step;
+  __int128 gap = bound - start;
+  bool is_strict = trace->counter_compare == TRACE_LESS ||
+                   trace->counter_compare == TRACE_GREATER;
+  if (step < 0) {
+    gap = -gap;
+    step = -step;
+  }
+  /* The condition is first checked after one step */
+  __int128 trips;
+  if (is_strict) {
+    trips = gap <= step ? 1 : (gap + step - 1) / step;
+  } else {
+    trips = gap < step ? 1 : gap / step + 1;
+  }
+  __int128 last = start + trips * trace->counter_step;
+  if (last < LONG_MIN || last > LONG_MAX || trips > SIZE_MAX) {
+    return 0;
+  }
+  return trips;
+}
+
+static void trace_execute_counted(struct trace *trace, size_t trips) {
+  long *regs = trace->registers;
+  size_t num_unrolled_ops = trace->num_body_ops * TRACE_UNROLL_FACTOR;
+  for (size_t i = trips / TRACE_UNROLL_FACTOR; i > 0; i--) {
+    for (size_t pc = 0; pc < num_unrolled_ops; pc++) {
+      trace_apply_op(&trace->unrolled_ops[pc], regs);
+    }
+  }
+  for (size_t i = trips % TRACE_UNROLL_FACTOR; i > 0; i--) {
+    for (size_t pc = 0; pc < trace->num_body_ops; pc++) {
+      trace_apply_op(&trace->unrolled_ops[pc], regs);
+    }
+  }
+  trace->iterations += trips;
+}
+
+static void trace_write_back(struct trace *trace,
+                             struct interpreter_state *state) {
+  for (size_t i = 0; i < trace->num_variables; i++) {
+    struct trace_variable *variable = &trace->variables[i];
+    if (!variable->is_written) {
+      continue;
+    }
+    struct object *value = variable->type == INT_VALUE
+                               ? object_int(trace->registers[variable->reg])
+                               : object_bool(trace->registers[variable->reg]);
+    environment_reassign_symbol(state->env, variable->id, value);
+  }
+}
+
+static enum trace_exit trace_side_exit(struct trace *trace) {
+  if (++trace->side_exits >= TRACE_MAX_SIDE_EXITS &&
+      trace->side_exits > trace->iterations) {
+    trace->status = TRACE_BLACKLISTED;
+    stats.blacklisted++;
+  }
+  return TRACE_EXIT_SIDE;
+}
+
+static enum trace_exit trace_execute(struct trace *trace,
+                                     struct interpreter_state *state) {
+  long *regs = trace->registers;
+  for (size_t i = 0; i < trace->num_variables; i++) {
+    struct trace_variable *variable = &trace->variables[i];
+    struct object *value = environment_lookup_symbol(state->env, variable->id);
+    if (!value || value->data_type != variable->type) {
+      return trace_side_exit(trace);
+    }
+    regs[variable->reg] =
+        variable->type == INT_VALUE ? value->int_value : value->bool_value;
+  }
+  for (size_t pc = 0; pc < trace->num_prologue_ops; pc++) {
+    trace_apply_op(&trace->prologue[pc], regs);
+  }
+  size_t trips = trace->is_counted ? count_iterations(trace) : 0;
+  if (trips > 0) {
+    trace_execute_counted(trace, trips);
+    trace_write_back(trace, state);
+    return TRACE_EXIT_LOOP_END;
+  }
+  for (;;) {
+    for (size_t i = 0; i < trace->num_variables; i++) {
+      trace->snapshot[i] = regs[trace->variables[i].reg];
+    }
+    for (size_t pc = 0; pc < trace->num_ops; pc++) {
+      struct trace_op *op = &trace->ops[pc];
+      switch (op->opcode) {
+      case TRACE_BREAK:
+        trace_write_back(trace, state);
+        return TRACE_EXIT_BREAK;
+      case TRACE_LOOP:
+        trace->iterations++;
+        if (!regs[op->lhs]) {
+          trace_write_back(trace, state);
+          return TRACE_EXIT_LOOP_END;
+        }
+        break;
+      default:
+        if (!trace_apply_op(op, regs)) {
+          /* Roll back to the start of the iteration, which the interpreter
+           * then runs instead */
+          for (size_t i = 0; i < trace->num_variables; i++) {
+            regs[trace->variables[i].reg] = trace->snapshot[i];
+          }
+          trace_write_back(trace, state);
+          return trace_side_exit(trace);
+        }
+      }
+    }
+  }
+}
+
+void trace_prewarm(struct trace **trace_slot, enum trace_status status) {
+  if (status == TRACE_UNRECORDED) {
+    return;
+  }
+  if (*trace_slot == NULL) {
+    *trace_slot = trace_init();
+  }
+  struct trace *trace = *trace_slot;
+  if (status == TRACE_BLACKLISTED) {
+    trace->status = TRACE_BLACKLISTED;
+  } else {
+    /* Record on the first iteration */
+    trace->hot_count = TRACE_HOT_LOOP_THRESHOLD - 1;
+  }
+}
+
+enum trace_exit trace_run_loop(struct trace **trace_slot,
+                               struct ast_node *loop_node,
+                               struct interpreter_state *state) {
+  if (*trace_slot == NULL) {
+    *trace_slot = trace_init();
+  }
+  struct trace *trace = *trace_slot;
+  switch (trace->status) {
+  case TRACE_BLACKLISTED:
+    return TRACE_EXIT_SIDE;
+  case TRACE_UNRECORDED: {
+    if (++trace->hot_count < TRACE_HOT_LOOP_THRESHOLD) {
+      return TRACE_EXIT_SIDE;
+    }
+    if (!trace_record(trace, loop_node, state)) {
+      trace_reset(trace);
+      trace->status = TRACE_BLACKLISTED;
+      stats.blacklisted++;
+      return TRACE_EXIT_SIDE;
+    }
+    trace_optimize(trace);
+    trace->status = TRACE_COMPILED;
+    stats.compiled++;
+    break;
+  }
+  case TRACE_COMPILED:
+    break;
+  }
+  return trace_execute(trace, state);
+}
+
+struct trace_stats trace_get_stats() { return stats; }
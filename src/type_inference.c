@@ -0,0 +1,179 @@
+#include "type_inference.h"
+#include "ast.h"
+#include "ir.h"
+#include "tokens.h"
+#include "vector.h"
+
+bool is_int_binary_operator(enum token_type op) {
+  switch (op) {
+  case PLUS:
+  case MINUS:
+  case STAR:
+  case SLASH:
+  case EQUAL_EQUAL:
+  case BANG_EQUAL:
+  case GREATER:
+  case GREATER_EQUAL:
+  case LESS:
+  case LESS_EQUAL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool is_inferred(struct type_inference *inference,
+                        struct ir_value *value) {
+  return inference->is_inferred[value->id];
+}
+
+/* Type of a binary operation which succeeded, given the types of its operands
+ * when they are inferred */
+static enum ir_type binary_type(enum token_type op, enum ir_type lhs,
+                                enum ir_type rhs) {
+  switch (op) {
+  case AND:
+  case OR:
+  case EQUAL_EQUAL:
+  case BANG_EQUAL:
+  case GREATER:
+  case GREATER_EQUAL:
+  case LESS:
+  case LESS_EQUAL:
+    return IR_TYPE_BOOL;
+  case PLUS:
+    /* Either operand being a string concatenates them */
+    if (lhs == IR_TYPE_STRING || rhs == IR_TYPE_STRING) {
+      return IR_TYPE_STRING;
+    }
+    return lhs == IR_TYPE_INT && rhs == IR_TYPE_INT ? IR_TYPE_INT
+                                                    : IR_TYPE_UNKNOWN;
+  case MINUS:
+  case STAR:
+  case SLASH:
+    return IR_TYPE_INT;
+  default:
+    return IR_TYPE_UNKNOWN;
+  }
+}
+
+/* Computes the type of `value` from its operands, returns false while they
+ * are not inferred yet */
+static bool transfer(struct type_inference *inference, struct ir_value *value,
+                     enum ir_type *type) {
+  switch (value->opcode) {
+  case IR_PHI: {
+    /* Operands which are not inferred yet come from a back edge, and will
+     * be met on a later round */
+    bool is_any_inferred = false;
+    for (size_t i = 0; i < value->operands->size; i++) {
+      struct ir_value *operand = vector_at(value->operands, i);
+      if (!is_inferred(inference, operand)) {
+        continue;
+      }
+      if (!is_any_inferred) {
+        *type = operand->type;
+      } else if (*type != operand->type) {
+        *type = IR_TYPE_UNKNOWN;
+      }
+      is_any_inferred = true;
+    }
+    return is_any_inferred;
+  }
+  case IR_BINARY: {
+    struct ir_value *lhs = vector_at(value->operands, 0);
+    struct ir_value *rhs = vector_at(value->operands, 1);
+    if (!is_inferred(inference, lhs) || !is_inferred(inference, rhs)) {
+      return false;
+    }
+    *type = binary_type(value->op, lhs->type, rhs->type);
+    return true;
+  }
+  case IR_UNARY:
+    *type = value->op == MINUS  ? IR_TYPE_INT
+            : value->op == BANG ? IR_TYPE_BOOL
+                                : IR_TYPE_UNKNOWN;
+    return true;
+  default:
+    /* Literals, arrays, functions and `.len()` are typed when lowered, and
+     * anything else is unknown */
+    *type = value->type;
+    return true;
+  }
+}
+
+/* Types only ever go from not inferred, to a type, to unknown, so this
+ * settles after a few rounds over the blocks */
+static void infer_value(struct type_inference *inference,
+                        struct ir_value *value) {
+  if (!ir_has_result(value->opcode)) {
+    return;
+  }
+  enum ir_type type;
+  if (!transfer(inference, value, &type)) {
+    return;
+  }
+  if (is_inferred(inference, value) && value->type != type) {
+    type = IR_TYPE_UNKNOWN;
+  }
+  if (!is_inferred(inference, value) || value->type != type) {
+    inference->is_inferred[value->id] = true;
+    value->type = type;
+    inference->is_changed = true;
+  }
+}
+
+static void infer_function_types(struct ir_function *function) {
+  struct type_inference inference = {
+      .function = function,
+      .is_inferred = calloc(function->num_values + 1, sizeof(bool)),
+      .is_changed = true};
+  while (inference.is_changed) {
+    inference.is_changed = false;
+    for (size_t i = 0; i < function->blocks->size; i++) {
+      struct ir_block *block = vector_at(function->blocks, i);
+      for (size_t j = 0; j < block->phis->size; j++) {
+        infer_value(&inference, vector_at(block->phis, j));
+      }
+      for (size_t j = 0; j < block->instructions->size; j++) {
+        infer_value(&inference, vector_at(block->instructions, j));
+      }
+    }
+  }
+  free(inference.is_inferred);
+}
+
+void infer_types(struct ir_program *program) {
+  for (size_t i = 0; i < program->functions->size; i++) {
+    infer_function_types(vector_at(program->functions, i));
+  }
+}
+
+static void mark_block(struct ir_block *block) {
+  for (size_t i = 0; i < block->instructions->size; i++) {
+    struct ir_value *value = vector_at(block->instructions, i);
+    if (value->opcode != IR_BINARY || !value->node ||
+        value->node->node_type != BINARY_NODE ||
+        !is_int_binary_operator(value->op)) {
+      continue;
+    }
+    struct ir_value *lhs = vector_at(value->operands, 0);
+    struct ir_value *rhs = vector_at(value->operands, 1);
+    value->node->binary.is_int_typed =
+        lhs->type == IR_TYPE_INT && rhs->type == IR_TYPE_INT;
+  }
+}
+
+void infer_program_types(struct vector *program) {
+  struct ir_program *ir = lower_program_to_ir(program);
+  infer_types(ir);
+  if (ir->has_stray_break) {
+    return;
+  }
+  for (size_t i = 0; i < ir->functions->size; i++) {
+    struct ir_function *function = vector_at(ir->functions, i);
+    for (size_t j = 0; j < function->blocks->size; j++) {
+      mark_block(vector_at(function->blocks, j));
+    }
+  }
+}
@@ -1,12 +1,20 @@
 #include "utils.h"
 #include "ast_printer.h"
+#include "c_emitter.h"
 #include "errors.h"
+#include "image.h"
 #include "interpreter.h"
+#include "ir.h"
+#include "memo.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "profile.h"
 #include "scanner.h"
 #include "string_builder.h"
 #include "tokens.h"
+#include "type_inference.h"
 #include "vector.h"
+#include "vm.h"
 #include <stdio.h>
 
 char *read_file(const char *file_path) {
@@ -48,20 +56,124 @@ char *create_token_string_copy(const char *char_ptr, size_t start_index,
 }
 
 struct object *interpreter_pipeline(const char *file_name) {
+  struct pipeline_options options = {
+      .use_profile = false,
+      .stackless = false,
+      .stack_limit = VM_DEFAULT_STACK_LIMIT,
+      .optimization_level = OPTIMIZATION_LEVEL_DEFAULT};
+  return interpreter_pipeline_with_options(file_name, &options);
+}
+
+/* Runs the script in `globals`, which outlive it when `is_snapshot`.
+ * Returns false if it cannot be read. */
+static bool run_pipeline(const char *file_name,
+                         struct pipeline_options *options,
+                         struct environment *globals, bool is_snapshot,
+                         struct object **return_value) {
   char *input = read_file(file_name);
   if (!input) {
-    return NULL;
+    return false;
   }
   struct vector *tokens = scan_tokens(input);
   struct parser *program = parse_program(tokens);
   if (program->parser_errors) {
     exit(1);
   }
-  struct object *interpreter_return_value = interpret(program->program);
+  if (is_snapshot) {
+    optimize_open_program(program->program, options->optimization_level);
+  } else {
+    optimize_program(program->program, options->optimization_level);
+  }
+  if (!options->no_memoize) {
+    mark_pure_functions(program->program);
+  }
+  struct profile *profile = NULL;
+  if (options->use_profile) {
+    profile = profile_load(program->program, file_name, input);
+  }
+  *return_value =
+      options->stackless
+          ? vm_interpret_in(program->program, globals, options->stack_limit)
+          : interpret_in(program->program, globals);
+  if (profile) {
+    profile_save(profile);
+  }
   vector_free(tokens);
+  return true;
+}
+
+/* Environment the script starts out with, the one of the image if any */
+static struct environment *pipeline_globals(struct pipeline_options *options) {
+  if (!options->image) {
+    return environment_init();
+  }
+  struct environment *globals = image_load(options->image);
+  if (!globals) {
+    exit(1);
+  }
+  return globals;
+}
+
+struct object *
+interpreter_pipeline_with_options(const char *file_name,
+                                  struct pipeline_options *options) {
+  struct object *interpreter_return_value = NULL;
+  run_pipeline(file_name, options, pipeline_globals(options), false,
+               &interpreter_return_value);
   return interpreter_return_value;
 }
 
+bool snapshot_pipeline(const char *file_name, const char *image_name,
+                       struct pipeline_options *options) {
+  struct environment *globals = pipeline_globals(options);
+  struct object *return_value;
+  return run_pipeline(file_name, options, globals, true, &return_value) &&
+         image_write(globals, image_name);
+}
+
+char *emit_c_pipeline(const char *file_name,
+                      struct pipeline_options *options) {
+  char *input = read_file(file_name);
+  if (!input) {
+    return NULL;
+  }
+  struct vector *tokens = scan_tokens(input);
+  struct parser *program = parse_program(tokens);
+  if (program->parser_errors) {
+    exit(1);
+  }
+  optimize_program(program->program, options->optimization_level);
+  if (!options->no_memoize) {
+    mark_pure_functions(program->program);
+  }
+  char *c_source = emit_c_program(program->program);
+  vector_free(tokens);
+  return c_source;
+}
+
+struct ir_program *ir_pipeline(const char *file_name,
+                               struct pipeline_options *options) {
+  char *input = read_file(file_name);
+  if (!input) {
+    return NULL;
+  }
+  struct vector *tokens = scan_tokens(input);
+  struct parser *program = parse_program(tokens);
+  if (program->parser_errors) {
+    exit(1);
+  }
+  optimize_program(program->program, options->optimization_level);
+  struct ir_program *ir = lower_program_to_ir(program->program);
+  infer_types(ir);
+  struct result *verified = verify_ir(ir);
+  vector_free(tokens);
+  if (verified->type == RESULT_ERROR) {
+    print_interpreter_error(verified->error.runtime);
+    return NULL;
+  }
+  return ir;
+}
+
 void print_ast_pipeline(const char *file_name) {
   char *input = read_file(file_name);
   if (!input) {
@@ -95,15 +207,13 @@ const char *convert_object_to_string(struct object *obj) {
     struct string_builder *str_builder = string_builder_init();
     string_builder_append(str_builder, "[");
     for (size_t i = 0; i < obj->array_value->size; i++) {
-      struct object *val = vector_at(obj->array_value, i);
+      struct object *val = obj->array_value->items[i];
       if (val->data_type == STRING_VALUE) {
         string_builder_append(str_builder, "\"");
-        string_builder_append(str_builder, convert_object_to_string(
-                                               vector_at(obj->array_value, i)));
+        string_builder_append(str_builder, convert_object_to_string(val));
         string_builder_append(str_builder, "\"");
       } else {
-        string_builder_append(str_builder, convert_object_to_string(
-                                               vector_at(obj->array_value, i)));
+        string_builder_append(str_builder, convert_object_to_string(val));
       }
       if (i != obj->array_value->size - 1) {
         string_builder_append(str_builder, ", ");
@@ -113,7 +223,7 @@ const char *convert_object_to_string(struct object *obj) {
     return str_builder->str;
   }
   case STRING_VALUE: {
-    return obj->string_value;
+    return obj->string_value->chars;
   }
   default: {
     printf("Unsupported type to convert as string.\n");
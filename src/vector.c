@@ -1,7 +1,8 @@
 #include "vector.h"
+#include "pool.h"
 
 struct vector *vector_init() {
-  struct vector *vector_ = calloc(1, sizeof(struct vector));
+  struct vector *vector_ = pool_alloc(POOL_VECTOR);
   if (!vector_) {
     perror("Vector initilization error");
     return NULL;
@@ -10,7 +11,7 @@ struct vector *vector_init() {
       calloc(DEFAULT_INITIAL_SIZE, sizeof(GENERIC_TYPE_PTR));
   if (!vector_->_internal_buffer) {
     perror("Vector initilization error");
-    free(vector_);
+    pool_free(POOL_VECTOR, vector_);
     return NULL;
   }
   vector_->size = 0;
@@ -64,7 +65,7 @@ void *vector_at(struct vector *vector_, size_t index) {
 
 void vector_free(struct vector *vector_) {
   free(vector_->_internal_buffer);
-  free(vector_);
+  pool_free(POOL_VECTOR, vector_);
 }
 
 bool _vector_increase_capacity(struct vector *vector_) {
@@ -0,0 +1,874 @@
+#include "vm.h"
+#include "ast.h"
+#include "builtin_functions.h"
+#include "closure.h"
+#include "errors.h"
+#include "interpreter.h"
+#include "pool.h"
+#include "trace.h"
+#include "utils.h"
+#include "vector.h"
+
+struct vm_loop {
+  size_t scope_depth; /* Scopes to keep when leaving the loop on 'break' */
+  size_t *break_jumps;
+  size_t num_break_jumps;
+};
+
+struct vm_compiler {
+  struct vm_chunk *chunk;
+  size_t scope_depth;
+  struct vm_loop *loop; /* Innermost loop, NULL outside loops */
+  bool is_top_level;
+  bool is_function_body;
+};
+
+static void compile_statement(struct vm_compiler *compiler,
+                              struct ast_node *stmt);
+static void compile_expression(struct vm_compiler *compiler,
+                               struct ast_node *expr);
+static struct vm_chunk *compile_body(struct ast_node *block);
+
+static struct vm_chunk *chunk_init() {
+  struct vm_chunk *chunk = malloc(sizeof(struct vm_chunk));
+  chunk->size = 0;
+  chunk->capacity = VM_INITIAL_CAPACITY;
+  chunk->code = malloc(sizeof(struct vm_instruction) * chunk->capacity);
+  return chunk;
+}
+
+static struct vm_instruction *emit(struct vm_compiler *compiler,
+                                   enum vm_opcode opcode) {
+  struct vm_chunk *chunk = compiler->chunk;
+  if (chunk->size == chunk->capacity) {
+    chunk->capacity *= 2;
+    chunk->code =
+        realloc(chunk->code, sizeof(struct vm_instruction) * chunk->capacity);
+  }
+  struct vm_instruction *instruction = &chunk->code[chunk->size++];
+  memset(instruction, 0, sizeof(struct vm_instruction));
+  instruction->opcode = opcode;
+  return instruction;
+}
+
+static struct vm_instruction *emit_string(struct vm_compiler *compiler,
+                                          enum vm_opcode opcode,
+                                          char *string) {
+  struct vm_instruction *instruction = emit(compiler, opcode);
+  instruction->string = string;
+  return instruction;
+}
+
+static size_t current_position(struct vm_compiler *compiler) {
+  return compiler->chunk->size;
+}
+
+static void patch_jump(struct vm_compiler *compiler, size_t jump) {
+  compiler->chunk->code[jump].operand = current_position(compiler);
+}
+
+static void compile_block(struct vm_compiler *compiler,
+                          struct ast_node *block) {
+  emit(compiler, VM_PUSH_SCOPE);
+  compiler->scope_depth++;
+  for (size_t i = 0; i < block->block_stmt_stmts->size; i++) {
+    compile_statement(compiler, vector_at(block->block_stmt_stmts, i));
+  }
+  compiler->scope_depth--;
+  emit(compiler, VM_POP_SCOPE);
+}
+
+static void compile_expressions(struct vm_compiler *compiler,
+                                struct vector *expressions) {
+  for (size_t i = 0; i < expressions->size; i++) {
+    struct result *val = vector_at(expressions, i);
+    compile_expression(compiler, val->node);
+  }
+}
+
+static void compile_method_call(struct vm_compiler *compiler,
+                                struct ast_node *expr) {
+  compile_expression(compiler, expr->method_call.object->node);
+  emit_string(compiler, VM_CHECK_ARRAY,
+              "Method calls are only supported for arrays for now");
+  struct ast_node *member = expr->method_call.member->node;
+  if (member->primary_node_type != FN_CALL_PRIMARY_NODE) {
+    emit_string(compiler, VM_FAIL, "Array methods can only be function calls");
+    return;
+  }
+  struct ast_node *method = member->fn_call.primary->node;
+  if (method->primary_node_type != IDENTIFIER_PRIMARY_NODE) {
+    emit_string(compiler, VM_FAIL,
+                "Method calls to array should must be an identifier type");
+    return;
+  }
+  struct vector *parameters = member->fn_call.parameters;
+  if (strcmp(method->id, "add") == 0) {
+    for (size_t i = 0; i < parameters->size; i++) {
+      struct result *val = vector_at(parameters, i);
+      compile_expression(compiler, val->node);
+      emit(compiler, VM_ARRAY_PUSH);
+    }
+    emit(compiler, VM_POP);
+    emit(compiler, VM_PUSH_NULL);
+  } else if (strcmp(method->id, "len") == 0) {
+    emit(compiler, VM_ARRAY_LEN);
+  } else if (strcmp(method->id, "pop") == 0) {
+    emit(compiler, VM_CHECK_ARRAY_POP);
+    if (parameters->size > 1) {
+      emit_string(compiler, VM_FAIL,
+                  ".pop() only supports one optional argument");
+      return;
+    }
+    compile_expressions(compiler, parameters);
+    emit(compiler, VM_ARRAY_POP)->operand = parameters->size;
+  } else {
+    emit_string(compiler, VM_FAIL,
+                format_string("Invalid method '%s' for array operation",
+                              method->id));
+  }
+}
+
+static void compile_expression(struct vm_compiler *compiler,
+                               struct ast_node *expr) {
+  switch (expr->node_type) {
+  case BINARY_NODE:
+    compile_expression(compiler, expr->binary.left->node);
+    compile_expression(compiler, expr->binary.right->node);
+    emit(compiler, expr->binary.is_int_typed ? VM_INT_BINARY : VM_BINARY)
+        ->op = expr->binary.op;
+    return;
+  case UNARY_NODE:
+    compile_expression(compiler, expr->unary.primary->node);
+    emit(compiler, VM_UNARY)->op = expr->unary.op;
+    return;
+  default:
+    break;
+  }
+  switch (expr->primary_node_type) {
+  case NUMBER_PRIMARY_NODE:
+  case STRING_PRIMARY_NODE:
+  case BOOLEAN_PRIMARY_NODE:
+  case NIL_PRIMARY_NODE:
+    emit(compiler, VM_PUSH_LITERAL)->node = expr;
+    break;
+  case IDENTIFIER_PRIMARY_NODE:
+    emit_string(compiler, VM_LOAD, expr->id);
+    break;
+  case FN_CALL_PRIMARY_NODE:
+    compile_expression(compiler, expr->fn_call.primary->node);
+    emit(compiler, VM_CHECK_CALLABLE)->operand =
+        expr->fn_call.parameters->size;
+    compile_expressions(compiler, expr->fn_call.parameters);
+    emit(compiler, VM_CALL)->operand = expr->fn_call.parameters->size;
+    break;
+  case METHOD_CALL_PRIMARY_NODE:
+    compile_method_call(compiler, expr);
+    break;
+  case ARRAY_CREATION_PRIMARY_NODE:
+    emit(compiler, VM_ARRAY_NEW)->operand = expr->array->size;
+    for (size_t i = 0; i < expr->array->size; i++) {
+      struct result *val = vector_at(expr->array, i);
+      compile_expression(compiler, val->node);
+      emit(compiler, VM_ARRAY_PUSH);
+    }
+    break;
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    compile_expression(compiler, expr->array_access.primary->node);
+    if (expr->array_access.is_in_bounds) {
+      compile_expression(compiler, expr->array_access.index->node);
+      emit(compiler, VM_ARRAY_LOAD);
+      break;
+    }
+    emit_string(compiler, VM_CHECK_ARRAY,
+                "Array access can only be used for arrays");
+    compile_expression(compiler, expr->array_access.index->node);
+    emit(compiler, VM_ARRAY_INDEX);
+    break;
+  case INVARIANT_PRIMARY_NODE: {
+    size_t load = current_position(compiler);
+    emit(compiler, VM_LOAD_INVARIANT)->node = expr;
+    compile_expression(compiler, expr->invariant.expr->node);
+    emit(compiler, VM_STORE_INVARIANT)->node = expr;
+    patch_jump(compiler, load);
+    break;
+  }
+  case SAVED_PRIMARY_NODE:
+    compile_expression(compiler, expr->saved.expr->node);
+    emit(compiler, VM_STORE_SAVED)->node = expr;
+    break;
+  case REUSED_PRIMARY_NODE:
+    emit(compiler, VM_LOAD_SAVED)->node = expr->reused;
+    break;
+  }
+}
+
+static void compile_assignment(struct vm_compiler *compiler,
+                               struct ast_node *stmt) {
+  struct ast_node *target = stmt->var_assign_stmt.primary->node;
+  if (target->primary_node_type == IDENTIFIER_PRIMARY_NODE) {
+    emit_string(compiler, VM_CHECK_ASSIGNABLE, target->id);
+    compile_expression(compiler, stmt->var_assign_stmt.expr->node);
+    emit_string(compiler, VM_ASSIGN, target->id);
+    return;
+  }
+  compile_expression(compiler, target->array_access.primary->node);
+  if (target->array_access.is_in_bounds) {
+    compile_expression(compiler, target->array_access.index->node);
+  } else {
+    emit_string(compiler, VM_CHECK_ARRAY,
+                "Variable array assignment can only be used for arrays");
+    compile_expression(compiler, target->array_access.index->node);
+    emit(compiler, VM_CHECK_ARRAY_STORE);
+  }
+  compile_expression(compiler, stmt->var_assign_stmt.expr->node);
+  emit(compiler, VM_ARRAY_STORE);
+}
+
+/* Compiles what follows the condition of a loop, up to the jump back to
+ * `loop_start`. Leaving the loop, by condition, trace or 'break', lands right
+ * after it. */
+static void compile_loop_body(struct vm_compiler *compiler,
+                              struct ast_node *loop_node,
+                              struct ast_node *block,
+                              struct ast_node *update_stmt, size_t loop_start,
+                              char *error_message) {
+  size_t exit_jump = current_position(compiler);
+  emit_string(compiler, VM_JUMP_IF_FALSE, error_message);
+  size_t trace_exit = current_position(compiler);
+  emit(compiler, VM_TRACE_LOOP)->node = loop_node;
+
+  struct vm_loop *enclosing_loop = compiler->loop;
+  struct vm_loop loop = {.scope_depth = compiler->scope_depth,
+                         .break_jumps = NULL,
+                         .num_break_jumps = 0};
+  compiler->loop = &loop;
+  compile_block(compiler, block);
+  compiler->loop = enclosing_loop;
+  if (update_stmt) {
+    compile_assignment(compiler, update_stmt);
+  }
+  emit(compiler, VM_JUMP)->operand = loop_start;
+
+  patch_jump(compiler, exit_jump);
+  patch_jump(compiler, trace_exit);
+  for (size_t i = 0; i < loop.num_break_jumps; i++) {
+    patch_jump(compiler, loop.break_jumps[i]);
+  }
+  free(loop.break_jumps);
+}
+
+static void compile_statement(struct vm_compiler *compiler,
+                              struct ast_node *stmt) {
+  if (compiler->is_top_level) {
+    /* Like the interpreter, errors report the enclosing top level
+     * statement */
+    struct vm_instruction *instruction = emit(compiler, VM_SET_LINES);
+    instruction->operand = stmt->source_position.start_line;
+    instruction->end_line = stmt->source_position.end_line;
+  }
+  bool is_top_level = compiler->is_top_level;
+  compiler->is_top_level = false;
+  switch (stmt->node_type) {
+  case FN_DEF_STMT: {
+    struct vm_instruction *instruction = emit(compiler, VM_DEF_FN);
+    instruction->node = stmt;
+    instruction->chunk = compile_body(stmt->fn_def_stmt.block->node);
+    break;
+  }
+  case VARIABLE_DECL_STMT:
+    emit_string(compiler, VM_CHECK_UNDECLARED, stmt->var_decl_stmt.id);
+    compile_expression(compiler, stmt->var_decl_stmt.expr->node);
+    emit_string(compiler, VM_DECLARE, stmt->var_decl_stmt.id);
+    break;
+  case VARIABLE_ASSIGN_STMT:
+    compile_assignment(compiler, stmt);
+    break;
+  case IF_STMT: {
+    compile_expression(compiler, stmt->if_else_stmt.expr->node);
+    size_t else_jump = current_position(compiler);
+    emit_string(compiler, VM_JUMP_IF_FALSE,
+                "The result of the <expression> inside 'if' statement should "
+                "result in a boolean value");
+    compile_block(compiler, stmt->if_else_stmt.if_block->node);
+    if (stmt->if_else_stmt.else_block) {
+      size_t end_jump = current_position(compiler);
+      emit(compiler, VM_JUMP);
+      patch_jump(compiler, else_jump);
+      compile_block(compiler, stmt->if_else_stmt.else_block->node);
+      patch_jump(compiler, end_jump);
+    } else {
+      patch_jump(compiler, else_jump);
+    }
+    break;
+  }
+  case WHILE_STMT: {
+    if (stmt->while_stmt.invariants) {
+      emit(compiler, VM_RESET_INVARIANTS)->node = stmt;
+    }
+    size_t loop_start = current_position(compiler);
+    compile_expression(compiler, stmt->while_stmt.expr->node);
+    compile_loop_body(compiler, stmt, stmt->while_stmt.block->node, NULL,
+                      loop_start,
+                      "The <expression> of 'while' must return boolean");
+    break;
+  }
+  case FOR_STMT: {
+    if (stmt->for_stmt.invariants) {
+      emit(compiler, VM_RESET_INVARIANTS)->node = stmt;
+    }
+    emit(compiler, VM_PUSH_SCOPE);
+    compiler->scope_depth++;
+    compile_statement(compiler, stmt->for_stmt.init_stmt->node);
+    size_t loop_start = current_position(compiler);
+    compile_expression(compiler,
+                       stmt->for_stmt.expr_stmt->node->expr_stmt_expr->node);
+    compile_loop_body(
+        compiler, stmt, stmt->for_stmt.block->node,
+        stmt->for_stmt.update_stmt->node, loop_start,
+        "The expression of 'for' loop must result in a boolean value");
+    compiler->scope_depth--;
+    emit(compiler, VM_POP_SCOPE);
+    break;
+  }
+  case BREAK_STMT: {
+    struct vm_loop *loop = compiler->loop;
+    if (!loop) {
+      break;
+    }
+    for (size_t i = loop->scope_depth; i < compiler->scope_depth; i++) {
+      emit(compiler, VM_POP_SCOPE);
+    }
+    loop->break_jumps = realloc(loop->break_jumps,
+                                sizeof(size_t) * (loop->num_break_jumps + 1));
+    loop->break_jumps[loop->num_break_jumps++] = current_position(compiler);
+    emit(compiler, VM_JUMP);
+    break;
+  }
+  case RETURN_STMT: {
+    struct ast_node *expr = stmt->return_stmt_expr->node;
+    if (compiler->is_function_body && expr->node_type == PRIMARY_NODE &&
+        expr->primary_node_type == FN_CALL_PRIMARY_NODE) {
+      compile_expression(compiler, expr->fn_call.primary->node);
+      emit(compiler, VM_CHECK_CALLABLE)->operand =
+          expr->fn_call.parameters->size;
+      compile_expressions(compiler, expr->fn_call.parameters);
+      emit(compiler, VM_TAIL_CALL)->operand = expr->fn_call.parameters->size;
+      break;
+    }
+    compile_expression(compiler, expr);
+    emit(compiler, VM_RETURN);
+    break;
+  }
+  case BLOCK_STMT:
+    compile_block(compiler, stmt);
+    break;
+  case EXPR_STMT:
+    compile_expression(compiler, stmt->expr_stmt_expr->node);
+    emit(compiler, VM_POP);
+    break;
+  default:
+    emit_string(compiler, VM_FAIL, "Invalid statement");
+  }
+  compiler->is_top_level = is_top_level;
+}
+
+static struct vm_chunk *compile_body(struct ast_node *block) {
+  struct vm_compiler compiler = {.chunk = chunk_init(),
+                                 .scope_depth = 0,
+                                 .loop = NULL,
+                                 .is_top_level = false,
+                                 .is_function_body = true};
+  compile_block(&compiler, block);
+  emit(&compiler, VM_END);
+  return compiler.chunk;
+}
+
+struct vm_chunk *vm_compile_program(struct vector *program) {
+  struct vm_compiler compiler = {.chunk = chunk_init(),
+                                 .scope_depth = 0,
+                                 .loop = NULL,
+                                 .is_top_level = true,
+                                 .is_function_body = false};
+  for (size_t i = 0; i < program->size; i++) {
+    compile_statement(&compiler, vector_at(program, i));
+  }
+  emit(&compiler, VM_END);
+  return compiler.chunk;
+}
+
+static struct result *vm_error(struct vm *vm, char *error_message) {
+  return result_error_runtime(
+      runtime_error_init(error_message,
+                         vm->state->current_stmt_lines.start_line,
+                         vm->state->current_stmt_lines.end_line));
+}
+
+static bool vm_is_within_limit(struct vm *vm, size_t frames_capacity,
+                               size_t stack_capacity) {
+  return frames_capacity * sizeof(struct vm_frame) +
+             stack_capacity * sizeof(struct object *) <=
+         vm->stack_limit;
+}
+
+static bool vm_push(struct vm *vm, struct object *value) {
+  if (vm->stack_size == vm->stack_capacity) {
+    size_t capacity = vm->stack_capacity * 2;
+    if (!vm_is_within_limit(vm, vm->frames_capacity, capacity)) {
+      return false;
+    }
+    vm->stack = realloc(vm->stack, sizeof(struct object *) * capacity);
+    vm->stack_capacity = capacity;
+  }
+  vm->stack[vm->stack_size++] = value;
+  return true;
+}
+
+static struct object *vm_pop(struct vm *vm) {
+  return vm->stack[--vm->stack_size];
+}
+
+static struct object *vm_peek(struct vm *vm, size_t distance) {
+  return vm->stack[vm->stack_size - 1 - distance];
+}
+
+static struct vm_frame *vm_push_frame(struct vm *vm, struct vm_chunk *chunk,
+                                      size_t stack_base) {
+  if (vm->num_frames == vm->frames_capacity) {
+    size_t capacity = vm->frames_capacity * 2;
+    if (!vm_is_within_limit(vm, capacity, vm->stack_capacity)) {
+      return NULL;
+    }
+    vm->frames = realloc(vm->frames, sizeof(struct vm_frame) * capacity);
+    vm->frames_capacity = capacity;
+  }
+  struct vm_frame *frame = &vm->frames[vm->num_frames++];
+  frame->chunk = chunk;
+  frame->pc = 0;
+  frame->function = NULL;
+  frame->fn_env = NULL;
+  frame->memoized = NULL;
+  frame->env = vm->state->env;
+  frame->call_stack = call_stack_mark(vm->state);
+  frame->stack_base = stack_base;
+  return frame;
+}
+
+static struct object *new_object(enum object_type data_type) {
+  struct object *returner = pool_alloc(POOL_OBJECT);
+  returner->data_type = data_type;
+  return returner;
+}
+
+#define VM_PUSH(vm, value)                                                     \
+  do {                                                                         \
+    if (!vm_push(vm, value)) {                                                 \
+      return vm_stack_overflow(vm);                                            \
+    }                                                                          \
+  } while (0)
+
+static struct result *vm_stack_overflow(struct vm *vm) {
+  return vm_error(
+      vm, format_string("Stack overflow, the call stack exceeds the limit of "
+                        "%zu bytes",
+                        vm->stack_limit));
+}
+
+/* Leaves the current frame. Returns true once the program frame is done. */
+static bool vm_return(struct vm *vm, struct object *value) {
+  struct vm_frame *frame = &vm->frames[--vm->num_frames];
+  if (frame->memoized) {
+    memo_store(frame->memoized, &frame->memo_key, value);
+  }
+  /* A `return` inside blocks of the body skips their VM_POP_SCOPE */
+  environment_leave_scopes(vm->state, frame->fn_env);
+  vm->state->env = frame->env;
+  call_stack_release(vm->state, frame->call_stack);
+  vm->stack_size = frame->stack_base;
+  vm->stack[vm->stack_size++] = value;
+  return vm->num_frames == 0;
+}
+
+/* Functions defined by the tree-walker, i.e. those of an image (see
+ * "image.h"), are compiled on their first call */
+static struct vm_chunk *function_chunk(struct function *function) {
+  if (!function->chunk) {
+    function->chunk = compile_body(function->body);
+  }
+  return function->chunk;
+}
+
+/* Invokes `callee` with the `num_args` values on top of the stack. User
+ * functions get a new frame, which the dispatch loop switches to. */
+static struct result *vm_call(struct vm *vm, size_t num_args) {
+  struct object *callee = vm_peek(vm, num_args);
+  size_t stack_base = vm->stack_size - num_args - 1;
+  if (callee->is_builtin) {
+    void *(*fn_ptr)(void *) = callee->function_value.builtin_function->fn_ptr;
+    fn_ptr(vm_peek(vm, 0));
+    vm->stack_size = stack_base;
+    VM_PUSH(vm, NULL);
+    return NULL;
+  }
+  struct function *function = callee->function_value.function_value;
+  struct memo_key memo_key;
+  bool is_memoized =
+      function->memo != NULL && num_args == function->parameters->size;
+  memo_key_init(&memo_key);
+  for (size_t i = 0; i < num_args && is_memoized; i++) {
+    is_memoized = memo_key_add(&memo_key, vm->stack[stack_base + 1 + i]);
+  }
+  struct object *cached =
+      is_memoized ? memo_lookup(function, &memo_key) : NULL;
+  if (cached) {
+    vm->stack_size = stack_base;
+    VM_PUSH(vm, cached);
+    return NULL;
+  }
+  struct vm_frame *frame =
+      vm_push_frame(vm, function_chunk(function), stack_base);
+  if (!frame) {
+    return vm_stack_overflow(vm);
+  }
+  struct environment *fn_call_env =
+      environment_init_frame(vm->state, function);
+  memcpy(fn_call_env->arguments, &vm->stack[stack_base + 1],
+         num_args * sizeof(struct object *));
+  if (is_memoized) {
+    frame->memoized = function;
+    frame->memo_key = memo_key;
+  }
+  frame->function = function;
+  frame->fn_env = fn_call_env;
+  vm->state->env = fn_call_env;
+  return NULL;
+}
+
+/* `return f(...)` inside a function. A user function replaces the current
+ * frame instead of pushing a new one, like the interpreter's tail calls. */
+static struct result *vm_tail_call(struct vm *vm, size_t num_args) {
+  struct object *callee = vm_peek(vm, num_args);
+  if (callee->is_builtin) {
+    struct result *ret = vm_call(vm, num_args);
+    if (ret) {
+      return ret;
+    }
+    vm_return(vm, vm_pop(vm));
+    return NULL;
+  }
+  struct vm_frame *frame = &vm->frames[vm->num_frames - 1];
+  struct function *function = callee->function_value.function_value;
+  size_t arguments_base = vm->stack_size - num_args;
+  if (function != frame->function) {
+    /* Released with the frame */
+    frame->fn_env = environment_init_frame(vm->state, function);
+  }
+  memcpy(frame->fn_env->arguments, &vm->stack[arguments_base],
+         num_args * sizeof(struct object *));
+  environment_leave_scopes(vm->state, frame->fn_env);
+  vm->stack_size = frame->stack_base + 1;
+  vm->state->env = frame->fn_env;
+  frame->function = function;
+  frame->chunk = function_chunk(function);
+  frame->pc = 0;
+  return NULL;
+}
+
+static struct result *vm_execute(struct vm *vm) {
+  struct interpreter_state *state = vm->state;
+  for (;;) {
+    struct vm_frame *frame = &vm->frames[vm->num_frames - 1];
+    struct vm_instruction *instruction = &frame->chunk->code[frame->pc++];
+    switch (instruction->opcode) {
+    case VM_PUSH_LITERAL:
+      VM_PUSH(vm, instruction->node->literal);
+      break;
+    case VM_PUSH_NULL:
+      VM_PUSH(vm, NULL);
+      break;
+    case VM_POP:
+      vm_pop(vm);
+      break;
+    case VM_LOAD: {
+      struct object *value =
+          environment_lookup_symbol(state->env, instruction->string);
+      if (!value) {
+        struct builtin_fn *builtin_function =
+            lookup_builtin_fns(state->builtin_fns, instruction->string);
+        if (builtin_function == NULL) {
+          return vm_error(vm, format_string("Identifier '%s' does not exist",
+                                            instruction->string));
+        }
+        value = new_object(FUNCTION_VALUE);
+        value->is_builtin = true;
+        value->function_value.builtin_function = builtin_function;
+      }
+      VM_PUSH(vm, value);
+      break;
+    }
+    case VM_CHECK_UNDECLARED:
+      if (environment_lookup_symbol_current_env(state->env,
+                                                instruction->string)) {
+        return vm_error(
+            vm, format_string("Variable '%s' already exists in current scope",
+                              instruction->string));
+      }
+      break;
+    case VM_DECLARE:
+      environment_insert_symbol(state->env, instruction->string, vm_pop(vm));
+      break;
+    case VM_CHECK_ASSIGNABLE:
+      if (environment_lookup_symbol(state->env, instruction->string) == NULL) {
+        return vm_error(vm, format_string("Variable '%s' does not exist",
+                                          instruction->string));
+      }
+      break;
+    case VM_ASSIGN:
+      environment_reassign_symbol(state->env, instruction->string,
+                                  vm_pop(vm));
+      break;
+    case VM_DEF_FN: {
+      char *id = instruction->node->fn_def_stmt.id;
+      if (environment_lookup_symbol_current_env(state->env, id)) {
+        return vm_error(
+            vm, format_string("Function '%s' already exists in current scope",
+                              id));
+      }
+      struct function *fn_stmt = malloc(sizeof(struct function));
+      fn_stmt->id = id;
+      fn_stmt->body = instruction->node->fn_def_stmt.block->node;
+      fn_stmt->parameters = instruction->node->fn_def_stmt.parameters;
+      fn_stmt->native_body = NULL;
+      fn_stmt->chunk = instruction->chunk;
+      fn_stmt->memo = instruction->node->fn_def_stmt.is_pure
+                          ? memo_cache_init()
+                          : NULL;
+      struct object *fn_stmt_value = new_object(FUNCTION_VALUE);
+      fn_stmt_value->is_builtin = false;
+      fn_stmt_value->function_value.function_value = fn_stmt;
+      environment_insert_symbol(state->env, id, fn_stmt_value);
+      closure_capture(state, fn_stmt,
+                      closure_free_names(instruction->node));
+      break;
+    }
+    case VM_BINARY: {
+      struct object *rhs = vm_pop(vm);
+      struct object *lhs = vm_pop(vm);
+      VM_PUSH(vm, eval_binary_operation(instruction->op, lhs, rhs, state));
+      break;
+    }
+    case VM_INT_BINARY: {
+      struct object *rhs = vm_pop(vm);
+      struct object *lhs = vm_pop(vm);
+      VM_PUSH(vm, eval_int_binary_operation(instruction->op, lhs->int_value,
+                                            rhs->int_value));
+      break;
+    }
+    case VM_UNARY: {
+      VM_PUSH(vm, eval_unary_operation(instruction->op, vm_pop(vm), state));
+      break;
+    }
+    case VM_JUMP:
+      frame->pc = instruction->operand;
+      break;
+    case VM_JUMP_IF_FALSE: {
+      struct object *condition = vm_pop(vm);
+      if (condition->data_type != BOOLEAN_VALUE) {
+        return vm_error(vm, strdup(instruction->string));
+      }
+      if (!condition->bool_value) {
+        frame->pc = instruction->operand;
+      }
+      break;
+    }
+    case VM_TRACE_LOOP: {
+      struct ast_node *loop_node = instruction->node;
+      struct trace **trace_slot = loop_node->node_type == WHILE_STMT
+                                      ? &loop_node->while_stmt.trace
+                                      : &loop_node->for_stmt.trace;
+      if (trace_run_loop(trace_slot, loop_node, state) != TRACE_EXIT_SIDE) {
+        frame->pc = instruction->operand;
+      }
+      break;
+    }
+    case VM_PUSH_SCOPE:
+      state->env = environment_init_enclosed(state->env);
+      break;
+    case VM_POP_SCOPE:
+      environment_leave_scopes(state, state->env->parent_environment);
+      break;
+    case VM_SET_LINES:
+      state->current_stmt_lines.start_line = instruction->operand;
+      state->current_stmt_lines.end_line = instruction->end_line;
+      break;
+    case VM_CHECK_CALLABLE: {
+      struct object *callee = vm_peek(vm, 0);
+      if (callee->data_type != FUNCTION_VALUE) {
+        return vm_error(
+            vm, strdup("Function calls can only be performed on callable"));
+      }
+      if (!callee->is_builtin) {
+        check_arity(callee->function_value.function_value,
+                    instruction->operand, state);
+        break;
+      }
+      struct builtin_fn *builtin_function =
+          callee->function_value.builtin_function;
+      if (builtin_function->num_parameters != instruction->operand) {
+        return vm_error(vm, format_string(
+                                "Function '%s' takes %ld, gut given %ld",
+                                builtin_function->fn_name,
+                                builtin_function->num_parameters,
+                                instruction->operand));
+      }
+      break;
+    }
+    case VM_CALL: {
+      struct result *ret = vm_call(vm, instruction->operand);
+      if (ret) {
+        return ret;
+      }
+      break;
+    }
+    case VM_TAIL_CALL: {
+      struct result *ret = vm_tail_call(vm, instruction->operand);
+      if (ret) {
+        return ret;
+      }
+      break;
+    }
+    case VM_RETURN:
+      if (vm_return(vm, vm_pop(vm))) {
+        return result_ok_object(vm_pop(vm));
+      }
+      break;
+    case VM_END:
+      if (vm_return(vm, NULL)) {
+        return result_ok_object(NULL);
+      }
+      break;
+    case VM_ARRAY_NEW: {
+      struct object *array_obj = new_object(ARRAY_VALUE);
+      array_obj->array_value = array_init(instruction->operand);
+      array_obj->is_in_image = false;
+      VM_PUSH(vm, array_obj);
+      break;
+    }
+    case VM_ARRAY_PUSH: {
+      struct object *value = vm_pop(vm);
+      array_push(vm_peek(vm, 0), value);
+      break;
+    }
+    case VM_CHECK_ARRAY:
+      if (vm_peek(vm, 0)->data_type != ARRAY_VALUE) {
+        return vm_error(vm, strdup(instruction->string));
+      }
+      break;
+    case VM_ARRAY_INDEX: {
+      struct object *index = vm_pop(vm);
+      VM_PUSH(vm, eval_array_index_operation(vm_pop(vm), index, state));
+      break;
+    }
+    case VM_ARRAY_LOAD: {
+      struct object *index = vm_pop(vm);
+      VM_PUSH(vm, vm_pop(vm)->array_value->items[index->int_value]);
+      break;
+    }
+    case VM_LOAD_INVARIANT:
+      if (instruction->node->invariant.value) {
+        VM_PUSH(vm, instruction->node->invariant.value);
+        frame->pc = instruction->operand;
+      }
+      break;
+    case VM_STORE_INVARIANT:
+      instruction->node->invariant.value = vm_peek(vm, 0);
+      break;
+    case VM_STORE_SAVED:
+      instruction->node->saved.value = vm_peek(vm, 0);
+      break;
+    case VM_LOAD_SAVED:
+      VM_PUSH(vm, instruction->node->saved.value);
+      break;
+    case VM_RESET_INVARIANTS: {
+      struct ast_node *loop = instruction->node;
+      reset_loop_invariants(loop->node_type == WHILE_STMT
+                                ? loop->while_stmt.invariants
+                                : loop->for_stmt.invariants);
+      break;
+    }
+    case VM_CHECK_ARRAY_STORE: {
+      struct object *index = vm_peek(vm, 0);
+      if (index->data_type != INT_VALUE) {
+        return vm_error(
+            vm, strdup("Variable array assignment index must be an integer"));
+      }
+      if (index->int_value < 0 ||
+          index->int_value >= vm_peek(vm, 1)->array_value->size) {
+        return vm_error(vm, strdup("Index out of bound"));
+      }
+      break;
+    }
+    case VM_ARRAY_STORE: {
+      struct object *value = vm_pop(vm);
+      struct object *index = vm_pop(vm);
+      struct object *array_obj = vm_pop(vm);
+      array_obj->array_value->items[index->int_value] = value;
+      break;
+    }
+    case VM_ARRAY_LEN:
+      VM_PUSH(vm, object_int(vm_pop(vm)->array_value->size));
+      break;
+    case VM_CHECK_ARRAY_POP:
+      if (vm_peek(vm, 0)->array_value->size <= 0) {
+        return vm_error(vm, strdup("Calling .pop() on an empty array"));
+      }
+      break;
+    case VM_ARRAY_POP: {
+      struct object *index = instruction->operand ? vm_pop(vm) : NULL;
+      VM_PUSH(vm, eval_array_pop_operation(vm_pop(vm), index, state));
+      break;
+    }
+    case VM_FAIL:
+      return vm_error(vm, strdup(instruction->string));
+    }
+  }
+}
+
+struct result *vm_run(struct vm_chunk *program, struct interpreter_state *state,
+                      size_t stack_limit) {
+  struct vm vm = {.state = state,
+                  .num_frames = 0,
+                  .frames_capacity = VM_INITIAL_CAPACITY,
+                  .stack_size = 0,
+                  .stack_capacity = VM_INITIAL_CAPACITY,
+                  .stack_limit = stack_limit};
+  vm.frames = malloc(sizeof(struct vm_frame) * vm.frames_capacity);
+  vm.stack = malloc(sizeof(struct object *) * vm.stack_capacity);
+  vm_push_frame(&vm, program, 0);
+  struct result *ret = vm_execute(&vm);
+  free(vm.frames);
+  free(vm.stack);
+  return ret;
+}
+
+struct object *vm_interpret(struct vector *program, size_t stack_limit) {
+  return vm_interpret_in(program, environment_init(), stack_limit);
+}
+
+struct object *vm_interpret_in(struct vector *program,
+                               struct environment *globals,
+                               size_t stack_limit) {
+  if (!program) {
+    return NULL;
+  }
+  struct interpreter_state state = {.env = globals,
+                                    .builtin_fns =
+                                        init_and_register_builtin_fns()};
+  state.globals = state.env;
+  struct result *ret = vm_run(vm_compile_program(program), &state, stack_limit);
+  if (ret->type == RESULT_ERROR) {
+    print_interpreter_error(ret->error.runtime);
+    exit(1);
+  }
+  return ret->object;
+}
@@ -14,7 +14,7 @@ static size_t total_pass_count_ = 0;
 #define JIX_ASSERT_TRUE(expected_value, test_value, test_name)                 \
   do {                                                                         \
     total_test_count_++;                                                       \
-    if (expected_value == test_value) {                                        \
+    if ((long)(expected_value) == (long)(test_value)) {                        \
       total_pass_count_++;                                                     \
       printf("TEST: %s, STATUS: %s[ OK ]%s\n", test_name, GREEN_COLOR,         \
              RESET_COLOR);                                                     \
@@ -22,7 +22,8 @@ static size_t total_pass_count_ = 0;
       total_fail_count_++;                                                     \
       printf("TEST: %s, STATUS: %s[ FAIL ]%s, EXPECTED: %li, GOT: "            \
              "%li\n",                                                          \
-             test_name, RED_COLOR, RESET_COLOR, expected_value, test_value);   \
+             test_name, RED_COLOR, RESET_COLOR, (long)(expected_value),        \
+             (long)(test_value));                                              \
     }                                                                          \
   } while (0)
 
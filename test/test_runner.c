@@ -1,5 +1,191 @@
 #include "test_helper.h"
+#include "memo.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "scanner.h"
+#include "trace.h"
 #include "utils.h"
+#include "vm.h"
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* What running `file` prints, in a child process, since a runtime error
+ * exits */
+static char *pipeline_output(const char *file,
+                             struct pipeline_options *options) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return strdup("");
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    interpreter_pipeline_with_options(file, options);
+    fflush(stdout);
+    exit(0);
+  }
+  close(fds[1]);
+  size_t size = 0;
+  size_t capacity = 256;
+  char *output = malloc(capacity);
+  ssize_t num_read;
+  while ((num_read = read(fds[0], output + size, capacity - size - 1)) > 0) {
+    size += num_read;
+    if (size + 1 == capacity) {
+      capacity *= 2;
+      output = realloc(output, capacity);
+    }
+  }
+  output[size] = '\0';
+  close(fds[0]);
+  waitpid(pid, NULL, 0);
+  return output;
+}
+
+/* Nodes of `node` and the nodes under it, nested functions included, for
+ * which `matches` is true */
+static size_t count_nodes(struct ast_node *node,
+                          bool (*matches)(struct ast_node *));
+
+static size_t count_in_results(struct vector *results,
+                               bool (*matches)(struct ast_node *)) {
+  size_t count = 0;
+  for (size_t i = 0; i < results->size; i++) {
+    struct result *val = vector_at(results, i);
+    count += count_nodes(val->node, matches);
+  }
+  return count;
+}
+
+static size_t count_in_nodes(struct vector *nodes,
+                             bool (*matches)(struct ast_node *)) {
+  size_t count = 0;
+  for (size_t i = 0; i < nodes->size; i++) {
+    count += count_nodes(vector_at(nodes, i), matches);
+  }
+  return count;
+}
+
+static size_t count_nodes(struct ast_node *node,
+                          bool (*matches)(struct ast_node *)) {
+  size_t count = matches(node);
+  switch (node->node_type) {
+  case FN_DEF_STMT:
+    return count + count_nodes(node->fn_def_stmt.block->node, matches);
+  case EXPR_STMT:
+    return count + count_nodes(node->expr_stmt_expr->node, matches);
+  case RETURN_STMT:
+    return count + count_nodes(node->return_stmt_expr->node, matches);
+  case VARIABLE_DECL_STMT:
+    return count + count_nodes(node->var_decl_stmt.expr->node, matches);
+  case VARIABLE_ASSIGN_STMT:
+    return count + count_nodes(node->var_assign_stmt.primary->node, matches) +
+           count_nodes(node->var_assign_stmt.expr->node, matches);
+  case IF_STMT:
+    count += count_nodes(node->if_else_stmt.expr->node, matches) +
+             count_nodes(node->if_else_stmt.if_block->node, matches);
+    return node->if_else_stmt.else_block
+               ? count + count_nodes(node->if_else_stmt.else_block->node,
+                                     matches)
+               : count;
+  case WHILE_STMT:
+    return count + count_nodes(node->while_stmt.expr->node, matches) +
+           count_nodes(node->while_stmt.block->node, matches);
+  case FOR_STMT:
+    return count + count_nodes(node->for_stmt.init_stmt->node, matches) +
+           count_nodes(node->for_stmt.expr_stmt->node, matches) +
+           count_nodes(node->for_stmt.update_stmt->node, matches) +
+           count_nodes(node->for_stmt.block->node, matches);
+  case BLOCK_STMT:
+    return count + count_in_nodes(node->block_stmt_stmts, matches);
+  case BINARY_NODE:
+    return count + count_nodes(node->binary.left->node, matches) +
+           count_nodes(node->binary.right->node, matches);
+  case UNARY_NODE:
+    return count + count_nodes(node->unary.primary->node, matches);
+  case PRIMARY_NODE:
+    break;
+  default:
+    return count;
+  }
+  switch (node->primary_node_type) {
+  case FN_CALL_PRIMARY_NODE:
+    return count + count_nodes(node->fn_call.primary->node, matches) +
+           count_in_results(node->fn_call.parameters, matches);
+  case METHOD_CALL_PRIMARY_NODE:
+    return count + count_nodes(node->method_call.object->node, matches) +
+           count_nodes(node->method_call.member->node, matches);
+  case ARRAY_CREATION_PRIMARY_NODE:
+    return count + count_in_results(node->array, matches);
+  case ARRAY_ACCESS_PRIMARY_NODE:
+    return count + count_nodes(node->array_access.primary->node, matches) +
+           count_nodes(node->array_access.index->node, matches);
+  case INVARIANT_PRIMARY_NODE:
+    return count + count_nodes(node->invariant.expr->node, matches);
+  case SAVED_PRIMARY_NODE:
+    return count + count_nodes(node->saved.expr->node, matches);
+  default:
+    return count;
+  }
+}
+
+/* Nodes of `file` matching `matches`, once optimized at `level` */
+static size_t count_optimized_nodes(const char *file, int level,
+                                    bool (*matches)(struct ast_node *)) {
+  struct parser *parser = parse_program(scan_tokens(read_file(file)));
+  optimize_program(parser->program, level);
+  return count_in_nodes(parser->program, matches);
+}
+
+static bool is_folded_day_length(struct ast_node *node) {
+  return node->node_type == VARIABLE_DECL_STMT &&
+         strcmp(node->var_decl_stmt.id, "seconds_per_day") == 0 &&
+         node->var_decl_stmt.expr->node->node_type == PRIMARY_NODE &&
+         node->var_decl_stmt.expr->node->primary_node_type ==
+             NUMBER_PRIMARY_NODE &&
+         node->var_decl_stmt.expr->node->number == 86400;
+}
+
+static bool is_never_called_definition(struct ast_node *node) {
+  return node->node_type == FN_DEF_STMT &&
+         strcmp(node->fn_def_stmt.id, "never_called") == 0;
+}
+
+static bool is_clamp_call(struct ast_node *node) {
+  return node->node_type == PRIMARY_NODE &&
+         node->primary_node_type == FN_CALL_PRIMARY_NODE &&
+         node->fn_call.primary->node->primary_node_type ==
+             IDENTIFIER_PRIMARY_NODE &&
+         strcmp(node->fn_call.primary->node->id, "clamp") == 0;
+}
+
+static bool is_invariant(struct ast_node *node) {
+  return node->node_type == PRIMARY_NODE &&
+         node->primary_node_type == INVARIANT_PRIMARY_NODE;
+}
+
+static bool is_saved(struct ast_node *node) {
+  return node->node_type == PRIMARY_NODE &&
+         node->primary_node_type == SAVED_PRIMARY_NODE;
+}
+
+static bool is_int_typed(struct ast_node *node) {
+  return node->node_type == BINARY_NODE && node->binary.is_int_typed;
+}
+
+static bool is_in_bounds(struct ast_node *node) {
+  return node->node_type == PRIMARY_NODE &&
+         node->primary_node_type == ARRAY_ACCESS_PRIMARY_NODE &&
+         node->array_access.is_in_bounds;
+}
+
+static bool is_point_declaration(struct ast_node *node) {
+  return node->node_type == VARIABLE_DECL_STMT &&
+         strcmp(node->var_decl_stmt.id, "point") == 0;
+}
 
 int main(int argc, const char *argv[]) {
 
@@ -9,11 +195,19 @@ int main(int argc, const char *argv[]) {
       "break_stmt.jix",    "functions.jix",  "array_test1.jix",
       "array_test2.jix",   "array_add.jix",  "array_len.jix",
       "array_pop.jix",     "fn_ptr1.jix",    "fn_ptr2.jix",
-      "string_concat.jix",
+      "string_concat.jix", "trace_loop.jix", "tail_call.jix",
+      "constant_folding.jix", "dead_code.jix", "inlining.jix",
+      "loop_invariants.jix", "common_subexpressions.jix",
+      "type_inference.jix", "bounds_checks.jix",
+      "scalar_replacement.jix", "induction_variables.jix",
+      "memoization.jix", "call_frames.jix", "closures.jix",
+      "block_scopes.jix", "object_layout.jix", "shared_values.jix",
   };
 
   long expected_results[] = {
-      10, 40, 99, 50, 10, 10, 20, 10, 7, 10, 1, 1, 10, 99, 32, 10,
+      10, 40, 99, 50, 10, 10, 20, 10, 7, 10, 1, 1, 10, 99, 32, 10, 336,
+      20005100, 267, 79, 428, 2222, 319, 1496, 173255, 6260, 64966, 724,
+      505750, 542, 80118, 2445, 2943,
   };
 
   const char *test_name[] = {
@@ -33,6 +227,23 @@ int main(int argc, const char *argv[]) {
       "Function pointer test 1",
       "Function pointer test 2",
       "String concatenation test",
+      "Trace JIT test",
+      "Tail call test",
+      "Constant folding test",
+      "Dead code elimination test",
+      "Function inlining test",
+      "Loop-invariant code motion test",
+      "Common subexpression elimination test",
+      "Type inference test",
+      "Bounds-check elimination test",
+      "Scalar replacement test",
+      "Induction variable test",
+      "Memoization test",
+      "Call frame test",
+      "Closure test",
+      "Block scope test",
+      "Object layout test",
+      "Shared value test",
   };
 
   size_t total_tests = sizeof(test_files) / sizeof(test_files[0]);
@@ -42,6 +253,162 @@ int main(int argc, const char *argv[]) {
     JIX_ASSERT_TRUE(expected_results[i], return_value->int_value, test_name[i]);
   }
 
+  /* Same programs on the stackless evaluator */
+  struct pipeline_options stackless_options = {
+      .use_profile = false,
+      .stackless = true,
+      .stack_limit = VM_DEFAULT_STACK_LIMIT,
+      .optimization_level = OPTIMIZATION_LEVEL_DEFAULT};
+  for (size_t i = 0; i < total_tests; i++) {
+    struct object *return_value =
+        interpreter_pipeline_with_options(test_files[i], &stackless_options);
+    JIX_ASSERT_TRUE(expected_results[i], return_value->int_value,
+                    format_string("%s (stackless)", test_name[i]));
+  }
+  /* Same programs lowered to the SSA IR, which must pass its verifier */
+  for (size_t i = 0; i < total_tests; i++) {
+    struct pipeline_options ir_options = {
+        .use_profile = false,
+        .stackless = false,
+        .stack_limit = VM_DEFAULT_STACK_LIMIT,
+        .optimization_level = OPTIMIZATION_LEVEL_DEFAULT};
+    bool is_valid = ir_pipeline(test_files[i], &ir_options) != NULL;
+    JIX_ASSERT_TRUE(true, is_valid,
+                    format_string("%s (IR verification)", test_name[i]));
+  }
+
+  /* Each -O1 pass rewrites the program it is tested on: the nodes it adds
+   * are not there at -O0, and those it removes are gone at -O1 */
+  struct {
+    const char *file;
+    bool (*matches)(struct ast_node *);
+    bool is_removed;
+    const char *name;
+  } pass_checks[] = {
+      {"constant_folding.jix", is_folded_day_length, false,
+       "Constant folding ran"},
+      {"dead_code.jix", is_never_called_definition, true,
+       "Dead code elimination ran"},
+      {"inlining.jix", is_clamp_call, true, "Function inlining ran"},
+      {"loop_invariants.jix", is_invariant, false,
+       "Loop-invariant code motion ran"},
+      {"common_subexpressions.jix", is_saved, false,
+       "Common subexpression elimination ran"},
+      {"type_inference.jix", is_int_typed, false, "Type inference ran"},
+      {"bounds_checks.jix", is_in_bounds, false,
+       "Bounds-check elimination ran"},
+      {"scalar_replacement.jix", is_point_declaration, true,
+       "Scalar replacement ran"},
+  };
+  for (size_t i = 0; i < sizeof(pass_checks) / sizeof(pass_checks[0]); i++) {
+    size_t unoptimized =
+        count_optimized_nodes(pass_checks[i].file, 0, pass_checks[i].matches);
+    size_t optimized = count_optimized_nodes(
+        pass_checks[i].file, OPTIMIZATION_LEVEL_DEFAULT,
+        pass_checks[i].matches);
+    bool has_run = pass_checks[i].is_removed
+                       ? unoptimized > 0 && optimized == 0
+                       : unoptimized == 0 && optimized > 0;
+    JIX_ASSERT_TRUE(true, has_run, pass_checks[i].name);
+  }
+
+  /* The trace JIT compiles the hot loops, and rewrites induction variables */
+  struct trace_stats before_traces = trace_get_stats();
+  interpreter_pipeline("trace_loop.jix");
+  struct trace_stats after_traces = trace_get_stats();
+  JIX_ASSERT_TRUE(true, after_traces.compiled > before_traces.compiled,
+                  "Trace JIT compiled loops");
+  interpreter_pipeline("induction_variables.jix");
+  struct trace_stats induction_traces = trace_get_stats();
+  JIX_ASSERT_TRUE(true,
+                  induction_traces.reduced > after_traces.reduced &&
+                      induction_traces.counted > after_traces.counted,
+                  "Induction variables reduced");
+
+  struct object *deep_recursion_value = interpreter_pipeline_with_options(
+      "deep_recursion.jix", &stackless_options);
+  JIX_ASSERT_TRUE(2004000, deep_recursion_value->int_value,
+                  "Deep recursion (stackless)");
+
+  /* Pure functions hit their cache, impure ones are never looked up. At
+   * -O0, so that none of the calls are inlined. */
+  const char *memo_files[] = {"memoization.jix", "memo_negation.jix",
+                              "memo_impure.jix"};
+  long memo_results[] = {724, 70, 72};
+  for (size_t i = 0; i < 3; i++) {
+    struct pipeline_options memo_options = {
+        .use_profile = false,
+        .stackless = false,
+        .stack_limit = VM_DEFAULT_STACK_LIMIT,
+        .optimization_level = 0};
+    struct memo_stats before = memo_get_stats();
+    struct object *return_value =
+        interpreter_pipeline_with_options(memo_files[i], &memo_options);
+    struct memo_stats after = memo_get_stats();
+    JIX_ASSERT_TRUE(memo_results[i], return_value->int_value,
+                    format_string("Memoization stats run (%s)", memo_files[i]));
+    bool is_pure = i < 2;
+    bool is_expected =
+        is_pure ? after.hits > before.hits
+                : after.hits == before.hits && after.misses == before.misses;
+    JIX_ASSERT_TRUE(true, is_expected,
+                    format_string("Memoization stats (%s)", memo_files[i]));
+  }
+
+  /* The second run starts out from the profile written by the first one */
+  struct pipeline_options profile_options = {
+      .use_profile = true,
+      .stackless = false,
+      .stack_limit = VM_DEFAULT_STACK_LIMIT,
+      .optimization_level = OPTIMIZATION_LEVEL_DEFAULT};
+  remove("profile.jix.prof");
+  for (size_t run = 0; run < 2; run++) {
+    struct object *return_value =
+        interpreter_pipeline_with_options("profile.jix", &profile_options);
+    JIX_ASSERT_TRUE(443, return_value->int_value, "Profile-guided run");
+  }
+
+  /* The script runs in the environment the prelude left in the image */
+  struct pipeline_options snapshot_options = {
+      .use_profile = false,
+      .stackless = false,
+      .stack_limit = VM_DEFAULT_STACK_LIMIT,
+      .optimization_level = OPTIMIZATION_LEVEL_DEFAULT};
+  bool is_written = snapshot_pipeline("image_prelude.jix", "image_prelude.img",
+                                      &snapshot_options);
+  JIX_ASSERT_TRUE(true, is_written, "Heap image snapshot");
+  for (size_t stackless = 0; stackless < 2; stackless++) {
+    struct pipeline_options image_options = {
+        .use_profile = false,
+        .stackless = stackless,
+        .stack_limit = VM_DEFAULT_STACK_LIMIT,
+        .optimization_level = OPTIMIZATION_LEVEL_DEFAULT,
+        .image = "image_prelude.img"};
+    struct object *return_value =
+        interpreter_pipeline_with_options("image_main.jix", &image_options);
+    JIX_ASSERT_TRUE(10803, return_value->int_value,
+                    stackless ? "Heap image run (stackless)"
+                              : "Heap image run");
+  }
+  remove("image_prelude.img");
+
+  /* Inlining keeps the runtime errors of the original program */
+  for (size_t level = 0; level < 3; level++) {
+    struct pipeline_options error_options = {
+        .use_profile = false,
+        .stackless = level == 2,
+        .stack_limit = VM_DEFAULT_STACK_LIMIT,
+        .optimization_level = level == 0 ? 0 : OPTIMIZATION_LEVEL_DEFAULT};
+    char *output = pipeline_output("inlining_errors.jix", &error_options);
+    bool is_same = strcmp(output, "Runtime Error (line 6): Variable 'b' "
+                                  "already exists in current scope\n") == 0;
+    JIX_ASSERT_TRUE(true, is_same,
+                    level == 0   ? "Runtime error (-O0)"
+                    : level == 1 ? "Runtime error (-O1)"
+                                 : "Runtime error (-O1, stackless)");
+    free(output);
+  }
+
   JIX_TEST_STATS();
 
   if (total_fail_count_ > 0) {